@@ -0,0 +1,66 @@
+// Copyright (c) 2020 The PIVX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "blockcompression.h"
+#include "clientversion.h"
+#include "primitives/block.h"
+#include "streams.h"
+
+#include <cassert>
+
+namespace block_bench {
+#include "bench/data/block2680960.raw.h"
+}
+
+// Reading a block stored raw and stored compressed (-blockcompression), from memory
+// (i.e. from a memory mapped block file in the OS cache), plus the cost of compressing it
+// when it is written.
+
+static const unsigned char* RawBlock()
+{
+    return block_bench::block2680960;
+}
+
+static size_t RawBlockSize()
+{
+    return sizeof(block_bench::block2680960);
+}
+
+static void ReadRawBlock(benchmark::State& state)
+{
+    while (state.KeepRunning()) {
+        CBlock block;
+        CMemoryReader reader(SER_DISK, CLIENT_VERSION, RawBlock(), RawBlockSize());
+        reader >> block;
+    }
+}
+
+static void ReadCompressedBlock(benchmark::State& state)
+{
+    std::vector<unsigned char> vFrame;
+    CompressBlockFrame(RawBlock(), RawBlockSize(), vFrame);
+
+    std::vector<unsigned char> vRaw;
+    while (state.KeepRunning()) {
+        CBlock block;
+        bool fOk = DecompressBlockFrame(vFrame.data(), vFrame.size(), vRaw, RawBlockSize());
+        assert(fOk);
+        CMemoryReader reader(SER_DISK, CLIENT_VERSION, vRaw.data(), vRaw.size());
+        reader >> block;
+    }
+}
+
+static void WriteCompressedBlock(benchmark::State& state)
+{
+    std::vector<unsigned char> vFrame;
+    while (state.KeepRunning()) {
+        CompressBlockFrame(RawBlock(), RawBlockSize(), vFrame);
+    }
+}
+
+BENCHMARK(ReadRawBlock);
+BENCHMARK(ReadCompressedBlock);
+BENCHMARK(WriteCompressedBlock);
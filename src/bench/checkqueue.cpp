@@ -5,6 +5,7 @@
 #include "bench.h"
 #include "util.h"
 #include "checkqueue.h"
+#include "hash.h"
 #include "prevector.h"
 #include "random.h"
 
@@ -20,7 +21,7 @@ static const size_t BATCHES = 101;
 static const size_t BATCH_SIZE = 30;
 static const int PREVECTOR_SIZE = 28;
 static const int QUEUE_BATCH_SIZE = 128;
-static void CCheckQueueSpeed(benchmark::State& state)
+static void RunCCheckQueueSpeed(benchmark::State& state, int nThreads)
 {
     struct FakeJobNoWork {
         bool operator()()
@@ -31,7 +32,7 @@ static void CCheckQueueSpeed(benchmark::State& state)
     };
     CCheckQueue<FakeJobNoWork> queue {QUEUE_BATCH_SIZE};
     boost::thread_group tg;
-    for (auto x = 0; x < std::max(MIN_CORES, GetNumCores()); ++x) {
+    for (auto x = 0; x < nThreads; ++x) {
        tg.create_thread([&]{queue.Thread();});
     }
     while (state.KeepRunning()) {
@@ -58,6 +59,27 @@ static void CCheckQueueSpeed(benchmark::State& state)
     tg.join_all();
 }
 
+static void CCheckQueueSpeed(benchmark::State& state)
+{
+    RunCCheckQueueSpeed(state, std::max(MIN_CORES, GetNumCores()));
+}
+
+// The same with more and more threads contending for the queue
+static void CCheckQueueSpeed4Threads(benchmark::State& state)
+{
+    RunCCheckQueueSpeed(state, 4);
+}
+
+static void CCheckQueueSpeed16Threads(benchmark::State& state)
+{
+    RunCCheckQueueSpeed(state, 16);
+}
+
+static void CCheckQueueSpeed64Threads(benchmark::State& state)
+{
+    RunCCheckQueueSpeed(state, 64);
+}
+
 // This Benchmark tests the CheckQueue with a slightly realistic workload,
 // where checks all contain a prevector that is indirect 50% of the time
 // and there is a little bit of work done between calls to Add.
@@ -99,5 +121,51 @@ static void CCheckQueueSpeedPrevectorJob(benchmark::State& state)
     tg.interrupt_all();
     tg.join_all();
 }
+
+// This Benchmark tests the CheckQueue with jobs of very different costs, like
+// the checks of a block (scripts, Sapling proofs, tier two signatures), where
+// the workers left with the cheap jobs have to take over the others' work.
+static void CCheckQueueSpeedUnevenJobs(benchmark::State& state)
+{
+    struct UnevenJob {
+        uint32_t nWork;
+        UnevenJob() : nWork(0) {}
+        UnevenJob(uint32_t nWorkIn) : nWork(nWorkIn) {}
+        bool operator()()
+        {
+            uint256 hash;
+            for (uint32_t i = 0; i < nWork; i++) {
+                hash = Hash(hash.begin(), hash.end());
+            }
+            return true;
+        }
+        void swap(UnevenJob& x){std::swap(nWork, x.nWork);};
+    };
+    CCheckQueue<UnevenJob> queue {QUEUE_BATCH_SIZE};
+    boost::thread_group tg;
+    for (auto x = 0; x < std::max(MIN_CORES, GetNumCores()); ++x) {
+       tg.create_thread([&]{queue.Thread();});
+    }
+    while (state.KeepRunning()) {
+        FastRandomContext insecure_rand(true);
+        CCheckQueueControl<UnevenJob> control(&queue);
+        std::vector<std::vector<UnevenJob>> vBatches(BATCHES);
+        for (auto& vChecks : vBatches) {
+            vChecks.reserve(BATCH_SIZE);
+            for (size_t x = 0; x < BATCH_SIZE; ++x)
+                // One job out of 64 is 100 times more expensive
+                vChecks.emplace_back(insecure_rand.randbits(6) ? 1 : 100);
+            control.Add(vChecks);
+        }
+        control.Wait();
+    }
+    tg.interrupt_all();
+    tg.join_all();
+}
+
 BENCHMARK(CCheckQueueSpeed);
+BENCHMARK(CCheckQueueSpeed4Threads);
+BENCHMARK(CCheckQueueSpeed16Threads);
+BENCHMARK(CCheckQueueSpeed64Threads);
 BENCHMARK(CCheckQueueSpeedPrevectorJob);
+BENCHMARK(CCheckQueueSpeedUnevenJobs);
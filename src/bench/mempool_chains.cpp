@@ -0,0 +1,90 @@
+// Copyright (c) 2022 The PIVX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "policy/feerate.h"
+#include "primitives/transaction.h"
+#include "script/script.h"
+#include "txmempool.h"
+
+#include <vector>
+
+static const size_t CHAIN_LENGTH = 25;
+
+//! A chain of CHAIN_LENGTH transactions, each one spending the only output of the previous one
+static std::vector<CTransactionRef> CreateChain(uint32_t nSeed, size_t nLength)
+{
+    std::vector<CTransactionRef> vChain;
+    vChain.reserve(nLength);
+    COutPoint prevout(uint256(), nSeed);
+    for (size_t i = 0; i < nLength; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = prevout;
+        tx.vin[0].scriptSig = CScript() << OP_TRUE;
+        tx.vout.resize(1);
+        tx.vout[0].scriptPubKey = CScript() << OP_TRUE;
+        tx.vout[0].nValue = 10 * COIN - i * 1000;
+        vChain.emplace_back(MakeTransactionRef(tx));
+        prevout = COutPoint(vChain.back()->GetHash(), 0);
+    }
+    return vChain;
+}
+
+static void AddTx(CTxMemPool& pool, const CTransactionRef& tx)
+{
+    pool.addUnchecked(tx->GetHash(), CTxMemPoolEntry(tx, 1000, 0, 0.0, 1, false, 0, false, 1));
+}
+
+// Accepting long chains: every transaction walks its 24 ancestors.
+static void MempoolAddChains(benchmark::State& state)
+{
+    std::vector<std::vector<CTransactionRef> > vChains;
+    for (uint32_t i = 0; i < 40; i++) {
+        vChains.emplace_back(CreateChain(i, CHAIN_LENGTH));
+    }
+
+    CTxMemPool pool(CFeeRate(1000));
+    while (state.KeepRunning()) {
+        for (const auto& vChain : vChains) {
+            for (const auto& tx : vChain) {
+                AddTx(pool, tx);
+            }
+        }
+        pool.clear();
+    }
+}
+
+// Re-adding 10k transactions of disconnected blocks: the descendants left in the mempool are
+// there first, and UpdateTransactionsFromBlock walks them from each re-added transaction.
+static void MempoolReorgReAdd(benchmark::State& state)
+{
+    const size_t nInBlock = 20;
+    std::vector<CTransactionRef> vBlockTxes, vMempoolTxes;
+    std::vector<uint256> vHashes;
+    for (uint32_t i = 0; i < 500; i++) {
+        std::vector<CTransactionRef> vChain = CreateChain(i, CHAIN_LENGTH);
+        vBlockTxes.insert(vBlockTxes.end(), vChain.begin(), vChain.begin() + nInBlock);
+        vMempoolTxes.insert(vMempoolTxes.end(), vChain.begin() + nInBlock, vChain.end());
+    }
+    for (const auto& tx : vBlockTxes) {
+        vHashes.push_back(tx->GetHash());
+    }
+
+    CTxMemPool pool(CFeeRate(1000));
+    while (state.KeepRunning()) {
+        for (const auto& tx : vMempoolTxes) {
+            AddTx(pool, tx);
+        }
+        for (const auto& tx : vBlockTxes) {
+            AddTx(pool, tx);
+        }
+        pool.UpdateTransactionsFromBlock(vHashes);
+        pool.clear();
+    }
+}
+
+BENCHMARK(MempoolAddChains);
+BENCHMARK(MempoolReorgReAdd);
@@ -0,0 +1,130 @@
+// Copyright (c) 2022 The PIVX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "arith_uint256.h"
+#include "core_io.h"
+#include "primitives/block.h"
+#include "rpc/server.h"
+#include "streams.h"
+#include "tinyformat.h"
+#include "uint256.h"
+#include "version.h"
+
+#include <univalue.h>
+
+namespace block_bench {
+#include "bench/data/block2680960.raw.h"
+}
+
+//! The getblock result of a real block, with the details of its transactions
+static UniValue BlockJSON()
+{
+    CDataStream stream((const char*)block_bench::block2680960,
+            (const char*)&block_bench::block2680960[sizeof(block_bench::block2680960)],
+            SER_NETWORK, PROTOCOL_VERSION);
+    CBlock block;
+    stream >> block;
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("hash", block.GetHash().GetHex());
+    result.pushKV("confirmations", 1);
+    result.pushKV("size", (int)sizeof(block_bench::block2680960));
+    result.pushKV("height", 2680960);
+    result.pushKV("version", block.nVersion);
+    result.pushKV("merkleroot", block.hashMerkleRoot.GetHex());
+    UniValue txs(UniValue::VARR);
+    for (const auto& tx : block.vtx) {
+        UniValue objTx(UniValue::VOBJ);
+        TxToUniv(*tx, UINT256_ZERO, objTx);
+        txs.push_back(objTx);
+    }
+    result.pushKV("tx", txs);
+    result.pushKV("time", block.GetBlockTime());
+    result.pushKV("nonce", (uint64_t)block.nNonce);
+    result.pushKV("bits", strprintf("%08x", block.nBits));
+    result.pushKV("previousblockhash", block.hashPrevBlock.GetHex());
+    return result;
+}
+
+//! The getrawmempool true result of a mempool of nSize transactions
+static UniValue MempoolJSON(int nSize)
+{
+    UniValue result(UniValue::VOBJ);
+    for (int i = 0; i < nSize; i++) {
+        UniValue info(UniValue::VOBJ);
+        info.pushKV("size", 225 + i % 500);
+        info.pushKV("fee", ValueFromAmount(10000 + i));
+        info.pushKV("modifiedfee", ValueFromAmount(10000 + i));
+        info.pushKV("time", (int64_t)1650000000 + i);
+        info.pushKV("height", 2680960 - i % 10);
+        info.pushKV("startingpriority", 1e6 + i);
+        info.pushKV("currentpriority", 2e6 + i);
+        info.pushKV("descendantcount", 1 + i % 3);
+        info.pushKV("descendantsize", 225 + i % 700);
+        info.pushKV("descendantfees", 10000 + i);
+        UniValue depends(UniValue::VARR);
+        if (i % 3) {
+            depends.push_back(ArithToUint256(arith_uint256(i - 1)).GetHex());
+        }
+        info.pushKV("depends", depends);
+        result.pushKV(ArithToUint256(arith_uint256(i)).GetHex(), info);
+    }
+    return result;
+}
+
+static void JsonWriteBlock(benchmark::State& state)
+{
+    const UniValue block = BlockJSON();
+    while (state.KeepRunning()) {
+        std::string strJSON = block.write();
+        assert(!strJSON.empty());
+    }
+}
+
+static void JsonReadBlock(benchmark::State& state)
+{
+    const std::string strJSON = BlockJSON().write();
+    while (state.KeepRunning()) {
+        UniValue block;
+        assert(block.read(strJSON));
+    }
+}
+
+static void JsonBuildMempool(benchmark::State& state)
+{
+    while (state.KeepRunning()) {
+        UniValue mempool = MempoolJSON(5000);
+        assert(mempool.size() == 5000);
+    }
+}
+
+static void JsonWriteMempool(benchmark::State& state)
+{
+    const UniValue mempool = MempoolJSON(5000);
+    while (state.KeepRunning()) {
+        std::string strJSON = mempool.write();
+        assert(!strJSON.empty());
+    }
+}
+
+static void JsonReadMempool(benchmark::State& state)
+{
+    const std::string strJSON = MempoolJSON(5000).write();
+    while (state.KeepRunning()) {
+        UniValue mempool;
+        assert(mempool.read(strJSON));
+        // Look every transaction up, as the clients do
+        for (const std::string& key : mempool.getKeys()) {
+            assert(find_value(mempool, key).isObject());
+        }
+    }
+}
+
+BENCHMARK(JsonWriteBlock);
+BENCHMARK(JsonReadBlock);
+BENCHMARK(JsonBuildMempool);
+BENCHMARK(JsonWriteMempool);
+BENCHMARK(JsonReadMempool);
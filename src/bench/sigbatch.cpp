@@ -0,0 +1,77 @@
+// Copyright (c) 2020 The PIVX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "key.h"
+#include "pubkey.h"
+#include "random.h"
+#include "sigbatch.h"
+
+// Verifying 1000 block signatures, by 100 stakers, one by one and as a batch.
+
+static const int BATCH_SIGNATURES = 1000;
+static const int BATCH_KEYS = 100;
+
+struct SignedHash {
+    CPubKey pubkey;
+    uint256 hash;
+    std::vector<unsigned char> vchSig;
+};
+
+static std::vector<SignedHash> SignHashes()
+{
+    std::vector<CKey> vKeys(BATCH_KEYS);
+    for (CKey& key : vKeys) {
+        key.MakeNewKey(true);
+    }
+    std::vector<SignedHash> vSigned(BATCH_SIGNATURES);
+    for (int i = 0; i < BATCH_SIGNATURES; i++) {
+        const CKey& key = vKeys[i % BATCH_KEYS];
+        vSigned[i].pubkey = key.GetPubKey();
+        vSigned[i].hash = GetRandHash();
+        key.Sign(vSigned[i].hash, vSigned[i].vchSig);
+    }
+    return vSigned;
+}
+
+static void VerifySignaturesSerial(benchmark::State& state)
+{
+    ECCVerifyHandle verifyHandle;
+    const std::vector<SignedHash> vSigned = SignHashes();
+    while (state.KeepRunning()) {
+        for (const SignedHash& sh : vSigned) {
+            bool fValid = sh.pubkey.Verify(sh.hash, sh.vchSig);
+            assert(fValid);
+        }
+    }
+}
+
+static void VerifySignaturesBatch(benchmark::State& state, int nThreads)
+{
+    ECCVerifyHandle verifyHandle;
+    const std::vector<SignedHash> vSigned = SignHashes();
+    while (state.KeepRunning()) {
+        CSignatureBatch batch;
+        for (const SignedHash& sh : vSigned) {
+            batch.Add(sh.pubkey, sh.hash, sh.vchSig);
+        }
+        bool fValid = batch.Verify(nThreads);
+        assert(fValid);
+    }
+}
+
+static void VerifySignaturesBatch1Thread(benchmark::State& state)
+{
+    VerifySignaturesBatch(state, 1);
+}
+
+static void VerifySignaturesBatch4Threads(benchmark::State& state)
+{
+    VerifySignaturesBatch(state, 4);
+}
+
+BENCHMARK(VerifySignaturesSerial);
+BENCHMARK(VerifySignaturesBatch1Thread);
+BENCHMARK(VerifySignaturesBatch4Threads);
@@ -0,0 +1,59 @@
+// Copyright (c) 2020 The PIVX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "primitives/transaction.h"
+#include "script/interpreter.h"
+#include "script/script.h"
+
+#include <memory>
+
+// Legacy signature hashes (SIGHASH_ALL) of all the inputs of a transaction spending
+// 1000 P2PKH outputs, serializing the whole transaction for each input, and with the
+// precomputed data (including the time to precompute it).
+
+static const unsigned int LARGE_TX_INPUTS = 1000;
+
+static CTransaction LargeLegacyTransaction()
+{
+    CMutableTransaction mtx;
+    mtx.nVersion = CTransaction::TxVersion::LEGACY;
+    mtx.vin.resize(LARGE_TX_INPUTS);
+    for (unsigned int i = 0; i < LARGE_TX_INPUTS; i++) {
+        mtx.vin[i].prevout.n = i;
+        mtx.vin[i].scriptSig = CScript() << std::vector<unsigned char>(72, 1) << std::vector<unsigned char>(33, 2);
+    }
+    mtx.vout.resize(2);
+    mtx.vout[0].nValue = 1;
+    mtx.vout[0].scriptPubKey = CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 3) << OP_EQUALVERIFY << OP_CHECKSIG;
+    mtx.vout[1] = mtx.vout[0];
+    return CTransaction(mtx);
+}
+
+static void SighashLargeTx(benchmark::State& state, bool fPrecompute)
+{
+    const CTransaction tx = LargeLegacyTransaction();
+    const CScript scriptCode = tx.vout[0].scriptPubKey;
+    while (state.KeepRunning()) {
+        std::unique_ptr<PrecomputedTransactionData> precomTxData;
+        if (fPrecompute) precomTxData.reset(new PrecomputedTransactionData(tx));
+        for (unsigned int i = 0; i < tx.vin.size(); i++) {
+            SignatureHash(scriptCode, tx, i, SIGHASH_ALL, 0, SIGVERSION_BASE, precomTxData.get());
+        }
+    }
+}
+
+static void SighashLargeTxSerialized(benchmark::State& state)
+{
+    SighashLargeTx(state, false);
+}
+
+static void SighashLargeTxPrecomputed(benchmark::State& state)
+{
+    SighashLargeTx(state, true);
+}
+
+BENCHMARK(SighashLargeTxSerialized);
+BENCHMARK(SighashLargeTxPrecomputed);
@@ -0,0 +1,161 @@
+// Copyright (c) 2020 The PIVX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockcompression.h"
+
+#include "crypto/common.h"
+
+#include <algorithm>
+#include <string.h>
+
+namespace {
+
+//! Constraints of the LZ4 block format
+const size_t MIN_MATCH = 4;
+const size_t LAST_LITERALS = 5;  //! The last 5 bytes are always literals
+const size_t MF_LIMIT = 12;      //! The last match starts at least 12 bytes before the end
+const size_t MAX_DISTANCE = 65535;
+
+const int HASH_LOG = 16;
+
+inline uint32_t HashSequence(uint32_t sequence)
+{
+    return (sequence * 2654435761U) >> (32 - HASH_LOG);
+}
+
+void WriteLength(std::vector<unsigned char>& vOut, size_t nLength)
+{
+    while (nLength >= 255) {
+        vOut.push_back(255);
+        nLength -= 255;
+    }
+    vOut.push_back((unsigned char)nLength);
+}
+
+void WriteSequence(std::vector<unsigned char>& vOut, const unsigned char* literals, size_t nLiterals, size_t nOffset, size_t nMatchLength)
+{
+    const size_t nMatchCode = nMatchLength - MIN_MATCH;
+    vOut.push_back((unsigned char)((std::min<size_t>(nLiterals, 15) << 4) | std::min<size_t>(nMatchCode, 15)));
+    if (nLiterals >= 15) WriteLength(vOut, nLiterals - 15);
+    vOut.insert(vOut.end(), literals, literals + nLiterals);
+    vOut.push_back((unsigned char)(nOffset & 0xff));
+    vOut.push_back((unsigned char)(nOffset >> 8));
+    if (nMatchCode >= 15) WriteLength(vOut, nMatchCode - 15);
+}
+
+void WriteLastLiterals(std::vector<unsigned char>& vOut, const unsigned char* literals, size_t nLiterals)
+{
+    vOut.push_back((unsigned char)(std::min<size_t>(nLiterals, 15) << 4));
+    if (nLiterals >= 15) WriteLength(vOut, nLiterals - 15);
+    vOut.insert(vOut.end(), literals, literals + nLiterals);
+}
+
+/** Read an extended length. Returns false if the input ends first. */
+bool ReadLength(const unsigned char* src, size_t nSize, size_t& ip, size_t& nLength)
+{
+    unsigned char b;
+    do {
+        if (ip >= nSize) return false;
+        b = src[ip++];
+        nLength += b;
+    } while (b == 255);
+    return true;
+}
+
+} // anon namespace
+
+void LZ4CompressBlock(const unsigned char* src, size_t nSize, std::vector<unsigned char>& vOut)
+{
+    vOut.clear();
+    vOut.reserve(nSize + nSize / 255 + 16);
+
+    size_t nAnchor = 0;
+    if (nSize > MF_LIMIT) {
+        // Last position seen for each hash of 4 bytes, plus one (zero is empty)
+        std::vector<uint32_t> vTable(1 << HASH_LOG, 0);
+        const size_t nMatchLimit = nSize - LAST_LITERALS;
+        const size_t nInputLimit = nSize - MF_LIMIT;
+        size_t ip = 0;
+        while (ip < nInputLimit) {
+            const uint32_t sequence = ReadLE32(src + ip);
+            uint32_t& entry = vTable[HashSequence(sequence)];
+            const size_t nRef = entry;
+            entry = (uint32_t)(ip + 1);
+            if (nRef == 0 || ip - (nRef - 1) > MAX_DISTANCE || ReadLE32(src + nRef - 1) != sequence) {
+                // Skip faster through data that does not compress
+                ip += 1 + ((ip - nAnchor) >> 6);
+                continue;
+            }
+
+            size_t nMatch = nRef - 1;
+            while (ip > nAnchor && nMatch > 0 && src[ip - 1] == src[nMatch - 1]) {
+                ip--;
+                nMatch--;
+            }
+            size_t nLength = MIN_MATCH;
+            while (ip + nLength < nMatchLimit && src[ip + nLength] == src[nMatch + nLength]) {
+                nLength++;
+            }
+            WriteSequence(vOut, src + nAnchor, ip - nAnchor, ip - nMatch, nLength);
+            ip += nLength;
+            nAnchor = ip;
+        }
+    }
+    WriteLastLiterals(vOut, src + nAnchor, nSize - nAnchor);
+}
+
+bool LZ4DecompressBlock(const unsigned char* src, size_t nSize, unsigned char* dst, size_t nRawSize)
+{
+    size_t ip = 0;
+    size_t op = 0;
+    while (true) {
+        if (ip >= nSize) return false;
+        const unsigned char token = src[ip++];
+
+        size_t nLiterals = token >> 4;
+        if (nLiterals == 15 && !ReadLength(src, nSize, ip, nLiterals)) return false;
+        if (nLiterals > nSize - ip || nLiterals > nRawSize - op) return false;
+        if (nLiterals > 0) memcpy(dst + op, src + ip, nLiterals);
+        ip += nLiterals;
+        op += nLiterals;
+        // The last sequence has no match
+        if (ip == nSize) return op == nRawSize;
+
+        if (nSize - ip < 2) return false;
+        const size_t nOffset = src[ip] | (src[ip + 1] << 8);
+        ip += 2;
+        if (nOffset == 0 || nOffset > op) return false;
+
+        size_t nLength = token & 15;
+        if (nLength == 15 && !ReadLength(src, nSize, ip, nLength)) return false;
+        nLength += MIN_MATCH;
+        if (nLength > nRawSize - op) return false;
+        if (nOffset >= nLength) {
+            memcpy(dst + op, dst + op - nOffset, nLength);
+        } else {
+            // Overlapping match: repeats the last nOffset bytes
+            for (size_t i = 0; i < nLength; i++) {
+                dst[op + i] = dst[op + i - nOffset];
+            }
+        }
+        op += nLength;
+    }
+}
+
+void CompressBlockFrame(const unsigned char* src, size_t nSize, std::vector<unsigned char>& vFrame)
+{
+    LZ4CompressBlock(src, nSize, vFrame);
+    unsigned char header[BLOCK_FRAME_HEADER_SIZE];
+    WriteLE32(header, (uint32_t)nSize);
+    vFrame.insert(vFrame.begin(), header, header + BLOCK_FRAME_HEADER_SIZE);
+}
+
+bool DecompressBlockFrame(const unsigned char* pframe, size_t nFrameSize, std::vector<unsigned char>& vRaw, size_t nMaxRawSize)
+{
+    if (nFrameSize <= BLOCK_FRAME_HEADER_SIZE) return false;
+    const size_t nRawSize = ReadLE32(pframe);
+    if (nRawSize > nMaxRawSize) return false;
+    vRaw.resize(nRawSize);
+    return LZ4DecompressBlock(pframe + BLOCK_FRAME_HEADER_SIZE, nFrameSize - BLOCK_FRAME_HEADER_SIZE, vRaw.data(), nRawSize);
+}
@@ -0,0 +1,41 @@
+// Copyright (c) 2020 The PIVX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKCOMPRESSION_H
+#define BITCOIN_BLOCKCOMPRESSION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * Compression of the blocks stored in the blk?????.dat files (-blockcompression).
+ *
+ * Every block is compressed on its own, in a frame made of its uncompressed size
+ * (4 bytes, little endian) followed by the data compressed in the LZ4 block format.
+ * Frames are independent of each other, so reading a block decompresses only its frame.
+ */
+
+//! Size of the header of a block frame (the uncompressed size)
+static const size_t BLOCK_FRAME_HEADER_SIZE = 4;
+
+/** Compress nSize bytes at src in the LZ4 block format, replacing the content of vOut. */
+void LZ4CompressBlock(const unsigned char* src, size_t nSize, std::vector<unsigned char>& vOut);
+
+/**
+ * Decompress nSize bytes at src, in the LZ4 block format, into dst which must hold
+ * exactly nRawSize bytes. Returns false if the data is malformed.
+ */
+bool LZ4DecompressBlock(const unsigned char* src, size_t nSize, unsigned char* dst, size_t nRawSize);
+
+/** Build the frame of the nSize bytes of serialized block at src. */
+void CompressBlockFrame(const unsigned char* src, size_t nSize, std::vector<unsigned char>& vFrame);
+
+/**
+ * Decompress the frame of nFrameSize bytes at pframe into vRaw. Returns false if the frame
+ * is malformed, or if its uncompressed size exceeds nMaxRawSize.
+ */
+bool DecompressBlockFrame(const unsigned char* pframe, size_t nFrameSize, std::vector<unsigned char>& vRaw, size_t nMaxRawSize);
+
+#endif // BITCOIN_BLOCKCOMPRESSION_H
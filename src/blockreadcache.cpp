@@ -0,0 +1,157 @@
+// Copyright (c) 2020 The PIVX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockreadcache.h"
+
+#include "memusage.h"
+#include "util.h"
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+std::shared_ptr<const CMappedBlockFile> CMappedBlockFile::Open(const fs::path& path)
+{
+#ifndef WIN32
+    // Mapping the block files would exhaust the address space of 32-bit systems
+    if (sizeof(void*) < 8) return nullptr;
+
+    int fd = open(path.string().c_str(), O_RDONLY);
+    if (fd == -1) return nullptr;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return nullptr;
+    }
+    void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+    if (addr == MAP_FAILED) {
+        LogPrintf("%s: unable to map %s\n", __func__, path.string());
+        return nullptr;
+    }
+    return std::shared_ptr<const CMappedBlockFile>(new CMappedBlockFile(static_cast<const unsigned char*>(addr), st.st_size));
+#else
+    return nullptr;
+#endif
+}
+
+CMappedBlockFile::~CMappedBlockFile()
+{
+#ifndef WIN32
+    munmap(const_cast<unsigned char*>(pdata), nSize);
+#endif
+}
+
+size_t CBlockReadCache::BlockMemoryUsage(const CBlock& block)
+{
+    return memusage::MallocUsage(sizeof(CBlock)) +
+           memusage::RecursiveDynamicUsage(block.vtx) +
+           memusage::DynamicUsage(block.vchBlockSig);
+}
+
+void CBlockReadCache::SetMaxMemory(size_t nMaxMemoryIn)
+{
+    LOCK(cs);
+    nMaxMemory = nMaxMemoryIn;
+    EvictBlocks();
+    if (nMaxMemory == 0) listMappedFiles.clear();
+}
+
+bool CBlockReadCache::IsEnabled() const
+{
+    LOCK(cs);
+    return nMaxMemory > 0;
+}
+
+void CBlockReadCache::EvictBlocks()
+{
+    AssertLockHeld(cs);
+    while (nMemoryUsage > nMaxMemory && !listBlocks.empty()) {
+        nMemoryUsage -= BlockMemoryUsage(*listBlocks.back().second);
+        mapBlocks.erase(listBlocks.back().first);
+        listBlocks.pop_back();
+    }
+}
+
+std::shared_ptr<const CBlock> CBlockReadCache::GetBlock(const uint256& hash)
+{
+    LOCK(cs);
+    if (nMaxMemory == 0) return nullptr;
+    auto it = mapBlocks.find(hash);
+    if (it == mapBlocks.end()) {
+        nMisses++;
+        return nullptr;
+    }
+    nHits++;
+    listBlocks.splice(listBlocks.begin(), listBlocks, it->second);
+    return it->second->second;
+}
+
+void CBlockReadCache::AddBlock(const uint256& hash, const std::shared_ptr<const CBlock>& pblock)
+{
+    const size_t nUsage = BlockMemoryUsage(*pblock);
+    LOCK(cs);
+    if (nUsage > nMaxMemory || mapBlocks.count(hash)) return;
+    listBlocks.emplace_front(hash, pblock);
+    mapBlocks.emplace(hash, listBlocks.begin());
+    nMemoryUsage += nUsage;
+    EvictBlocks();
+}
+
+std::shared_ptr<const CMappedBlockFile> CBlockReadCache::GetMappedFile(int nFile, const char* prefix, const fs::path& path, size_t nMinSize)
+{
+    const std::pair<char, int> key(prefix[0], nFile);
+
+    LOCK(cs);
+    if (nMaxMemory == 0 || nFile == nWriteFile) return nullptr;
+    for (auto it = listMappedFiles.begin(); it != listMappedFiles.end(); it++) {
+        if (it->first != key) continue;
+        if (it->second->size() >= nMinSize) {
+            listMappedFiles.splice(listMappedFiles.begin(), listMappedFiles, it);
+            return it->second;
+        }
+        // The file grew since it was mapped (undo data of old blocks is appended to old files)
+        listMappedFiles.erase(it);
+        break;
+    }
+
+    std::shared_ptr<const CMappedBlockFile> mapped = CMappedBlockFile::Open(path);
+    if (!mapped || mapped->size() < nMinSize) return nullptr;
+    listMappedFiles.emplace_front(key, mapped);
+    // Readers still holding an evicted mapping keep it alive until they are done
+    if (listMappedFiles.size() > MAX_MAPPED_FILES) listMappedFiles.pop_back();
+    return mapped;
+}
+
+void CBlockReadCache::SetWriteFile(int nFile)
+{
+    LOCK(cs);
+    nWriteFile = nFile;
+    listMappedFiles.remove_if([nFile](const MappedFileList::value_type& entry) { return entry.first.second == nFile; });
+}
+
+void CBlockReadCache::Clear()
+{
+    LOCK(cs);
+    listBlocks.clear();
+    mapBlocks.clear();
+    nMemoryUsage = 0;
+    listMappedFiles.clear();
+}
+
+CBlockReadCache::Stats CBlockReadCache::GetStats() const
+{
+    LOCK(cs);
+    Stats stats;
+    stats.nBlocks = listBlocks.size();
+    stats.nMemoryUsage = nMemoryUsage;
+    stats.nMappedFiles = listMappedFiles.size();
+    stats.nHits = nHits;
+    stats.nMisses = nMisses;
+    return stats;
+}
@@ -0,0 +1,108 @@
+// Copyright (c) 2020 The PIVX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKREADCACHE_H
+#define BITCOIN_BLOCKREADCACHE_H
+
+#include "fs.h"
+#include "primitives/block.h"
+#include "sync.h"
+#include "uint256.h"
+
+#include <list>
+#include <map>
+#include <memory>
+#include <unordered_map>
+
+/** Read-only memory mapping of a whole block (blk) or undo (rev) file */
+class CMappedBlockFile
+{
+private:
+    const unsigned char* pdata;
+    size_t nSize;
+
+    CMappedBlockFile(const unsigned char* pdataIn, size_t nSizeIn) : pdata(pdataIn), nSize(nSizeIn) {}
+
+public:
+    //! Map the file at path. Returns nullptr if it cannot be mapped (e.g. memory mapping is not supported).
+    static std::shared_ptr<const CMappedBlockFile> Open(const fs::path& path);
+    ~CMappedBlockFile();
+
+    CMappedBlockFile(const CMappedBlockFile&) = delete;
+    CMappedBlockFile& operator=(const CMappedBlockFile&) = delete;
+
+    const unsigned char* data() const { return pdata; }
+    size_t size() const { return nSize; }
+};
+
+/**
+ * Cache for the reads of block and undo data:
+ * - a LRU of deserialized blocks (keyed by hash, within a memory budget), so that the
+ *   recent blocks requested over and over (by peers, RPC, REST, wallet rescans, reorgs)
+ *   are deserialized only once,
+ * - a LRU of memory mapped block and undo files, which replaces the open/seek/read/close
+ *   sequence of every read. The file currently being written is never mapped, as it grows
+ *   and gets truncated when finalized.
+ * A memory budget of zero disables both.
+ */
+class CBlockReadCache
+{
+public:
+    //! Max number of files mapped at once
+    static const size_t MAX_MAPPED_FILES = 16;
+
+    struct Stats {
+        size_t nBlocks;
+        size_t nMemoryUsage;
+        size_t nMappedFiles;
+        uint64_t nHits;
+        uint64_t nMisses;
+    };
+
+private:
+    typedef std::list<std::pair<uint256, std::shared_ptr<const CBlock> > > BlockList;
+    typedef std::list<std::pair<std::pair<char, int>, std::shared_ptr<const CMappedBlockFile> > > MappedFileList;
+
+    mutable Mutex cs;
+    size_t nMaxMemory{0};
+    size_t nMemoryUsage{0};
+    //! Most recently used first
+    BlockList listBlocks;
+    std::unordered_map<uint256, BlockList::iterator> mapBlocks;
+    MappedFileList listMappedFiles;
+    uint64_t nHits{0};
+    uint64_t nMisses{0};
+    //! The block file currently written to, which is not mapped
+    int nWriteFile{-1};
+
+    void EvictBlocks();
+
+public:
+    //! Set the memory budget of the cache of blocks, in bytes (0 to disable the cache and the mappings).
+    void SetMaxMemory(size_t nMaxMemoryIn);
+    bool IsEnabled() const;
+
+    //! Look up a block in the cache. Returns nullptr if not found.
+    std::shared_ptr<const CBlock> GetBlock(const uint256& hash);
+    //! Add a block to the cache, evicting the least recently used ones if over budget.
+    void AddBlock(const uint256& hash, const std::shared_ptr<const CBlock>& pblock);
+
+    /**
+     * Get the mapping of a block or undo file (prefix "blk" or "rev"), which must cover
+     * at least nMinSize bytes (the file is mapped again if it grew). Returns nullptr if the
+     * file cannot or must not be mapped: callers then fall back to regular file access.
+     */
+    std::shared_ptr<const CMappedBlockFile> GetMappedFile(int nFile, const char* prefix, const fs::path& path, size_t nMinSize);
+
+    //! Signal which block file is being written to (its mappings are dropped).
+    void SetWriteFile(int nFile);
+
+    void Clear();
+    Stats GetStats() const;
+
+    //! Estimate of the memory used by a deserialized block
+    static size_t BlockMemoryUsage(const CBlock& block);
+};
+
+#endif // BITCOIN_BLOCKREADCACHE_H
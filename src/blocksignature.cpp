@@ -5,6 +5,7 @@
 #include "blocksignature.h"
 
 #include "script/standard.h"
+#include "sigbatch.h"
 #include "zqrtcchain.h"
 
 bool SignBlockWithKey(CBlock& block, const CKey& key)
@@ -40,7 +41,7 @@ bool SignBlock(CBlock& block, const CKeyStore& keystore)
     return SignBlockWithKey(block, key);
 }
 
-bool CheckBlockSignature(const CBlock& block)
+bool CheckBlockSignature(const CBlock& block, CSignatureBatch* pbatch)
 {
     if (block.IsProofOfWork())
         return block.vchBlockSig.empty();
@@ -91,5 +92,9 @@ bool CheckBlockSignature(const CBlock& block)
     if (!pubkey.IsValid())
         return error("%s: invalid pubkey %s", __func__, HexStr(pubkey));
 
+    if (pbatch) {
+        pbatch->Add(pubkey, block.GetHash(), block.vchBlockSig);
+        return true;
+    }
     return pubkey.Verify(block.GetHash(), block.vchBlockSig);
 }
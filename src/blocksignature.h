@@ -9,8 +9,12 @@
 #include "primitives/block.h"
 #include "keystore.h"
 
+class CSignatureBatch;
+
 bool SignBlockWithKey(CBlock& block, const CKey& key);
 bool SignBlock(CBlock& block, const CKeyStore& keystore);
-bool CheckBlockSignature(const CBlock& block);
+/** Check the signature of a block. If pbatch is given, the signature itself is only added to
+ *  it, to be verified with the ones of other blocks. */
+bool CheckBlockSignature(const CBlock& block, CSignatureBatch* pbatch = nullptr);
 
 #endif //quirkyturt_BLOCKSIGNATURE_H
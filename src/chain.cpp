@@ -6,6 +6,23 @@
 
 #include "chain.h"
 #include "legacy/stakemodifier.h"  // for ComputeNextStakeModifier
+#include "sync.h"
+
+#include <unordered_map>
+
+// Accumulator checkpoints are only set for zerocoin-era blocks (versions 4 to 6),
+// so they are kept here instead of reserving 32 bytes in every CBlockIndex.
+struct CAccCheckpoints {
+    Mutex cs;
+    std::unordered_map<const CBlockIndex*, uint256> map;
+};
+
+static CAccCheckpoints& AccCheckpoints()
+{
+    // Never destroyed: the block indexes are deleted at exit (CMainCleanup), in no order relative to this
+    static CAccCheckpoints* accCheckpoints = new CAccCheckpoints();
+    return *accCheckpoints;
+}
 
 
 /**
@@ -122,14 +139,14 @@ void CBlockIndex::BuildSkip()
 
 CBlockIndex::CBlockIndex(const CBlock& block):
         nVersion{block.nVersion},
-        hashMerkleRoot{block.hashMerkleRoot},
-        hashFinalSaplingRoot(block.hashFinalSaplingRoot),
         nTime{block.nTime},
         nBits{block.nBits},
-        nNonce{block.nNonce}
+        nNonce{block.nNonce},
+        hashMerkleRoot{block.hashMerkleRoot},
+        hashFinalSaplingRoot(block.hashFinalSaplingRoot)
 {
     if(block.nVersion > 3 && block.nVersion < 7)
-        nAccumulatorCheckpoint = block.nAccumulatorCheckpoint;
+        SetAccumulatorCheckpoint(block.nAccumulatorCheckpoint);
     if (block.IsProofOfStake())
         SetProofOfStake();
 }
@@ -171,7 +188,7 @@ CBlockHeader CBlockIndex::GetBlockHeader() const
     block.nTime = nTime;
     block.nBits = nBits;
     block.nNonce = nNonce;
-    if (nVersion > 3 && nVersion < 7) block.nAccumulatorCheckpoint = nAccumulatorCheckpoint;
+    if (nVersion > 3 && nVersion < 7) block.nAccumulatorCheckpoint = GetAccumulatorCheckpoint();
     if (nVersion >= 8) block.hashFinalSaplingRoot = hashFinalSaplingRoot;
     return block;
 }
@@ -231,10 +248,7 @@ bool CBlockIndex::SetStakeEntropyBit(unsigned int nEntropyBit)
 // Sets V1 stake modifier (uint64_t)
 void CBlockIndex::SetStakeModifier(const uint64_t nStakeModifier, bool fGeneratedStakeModifier)
 {
-    vStakeModifier.clear();
-    const size_t modSize = sizeof(nStakeModifier);
-    vStakeModifier.resize(modSize);
-    std::memcpy(vStakeModifier.data(), &nStakeModifier, modSize);
+    vStakeModifier.assign((const unsigned char*)&nStakeModifier, sizeof(nStakeModifier));
     if (fGeneratedStakeModifier)
         nFlags |= BLOCK_STAKE_MODIFIER;
 
@@ -256,8 +270,7 @@ void CBlockIndex::SetNewStakeModifier()
 // Sets V2 stake modifiers (uint256)
 void CBlockIndex::SetStakeModifier(const uint256& nStakeModifier)
 {
-    vStakeModifier.clear();
-    vStakeModifier.insert(vStakeModifier.begin(), nStakeModifier.begin(), nStakeModifier.end());
+    vStakeModifier.assign(nStakeModifier.begin(), nStakeModifier.size());
 }
 
 // Generates and sets new V2 stake modifier
@@ -279,8 +292,8 @@ uint64_t CBlockIndex::GetStakeModifierV1() const
 {
     if (vStakeModifier.empty() || Params().GetConsensus().NetworkUpgradeActive(nHeight, Consensus::UPGRADE_V3_4))
         return 0;
-    uint64_t nStakeModifier;
-    std::memcpy(&nStakeModifier, vStakeModifier.data(), vStakeModifier.size());
+    uint64_t nStakeModifier = 0;
+    std::memcpy(&nStakeModifier, vStakeModifier.begin(), std::min((size_t)vStakeModifier.size(), sizeof(nStakeModifier)));
     return nStakeModifier;
 }
 
@@ -290,10 +303,79 @@ uint256 CBlockIndex::GetStakeModifierV2() const
     if (vStakeModifier.empty() || !Params().GetConsensus().NetworkUpgradeActive(nHeight, Consensus::UPGRADE_V3_4))
         return UINT256_ZERO;
     uint256 nStakeModifier;
-    std::memcpy(nStakeModifier.begin(), vStakeModifier.data(), vStakeModifier.size());
+    std::memcpy(nStakeModifier.begin(), vStakeModifier.begin(), vStakeModifier.size());
     return nStakeModifier;
 }
 
+uint256 CBlockIndex::GetAccumulatorCheckpoint() const
+{
+    if (nVersion <= 3 || nVersion >= 7)
+        return UINT256_ZERO;
+    CAccCheckpoints& acc = AccCheckpoints();
+    LOCK(acc.cs);
+    auto it = acc.map.find(this);
+    return it != acc.map.end() ? it->second : UINT256_ZERO;
+}
+
+CBlockIndex::CBlockIndex(const CBlockIndex& other) :
+        phashBlock(other.phashBlock),
+        pprev(other.pprev),
+        pskip(other.pskip),
+        nHeight(other.nHeight),
+        nFile(other.nFile),
+        nDataPos(other.nDataPos),
+        nUndoPos(other.nUndoPos),
+        nChainWork(other.nChainWork),
+        nTx(other.nTx),
+        nChainTx(other.nChainTx),
+        nStatus(other.nStatus),
+        nFlags(other.nFlags),
+        nSaplingValue(other.nSaplingValue),
+        nChainSaplingValue(other.nChainSaplingValue),
+        nVersion(other.nVersion),
+        nTime(other.nTime),
+        nBits(other.nBits),
+        nNonce(other.nNonce),
+        hashMerkleRoot(other.hashMerkleRoot),
+        hashFinalSaplingRoot(other.hashFinalSaplingRoot),
+        nSequenceId(other.nSequenceId),
+        nTimeMax(other.nTimeMax),
+        vStakeModifier(other.vStakeModifier)
+{
+    SetAccumulatorCheckpoint(other.GetAccumulatorCheckpoint());
+}
+
+CBlockIndex::~CBlockIndex()
+{
+    // Otherwise an index allocated later at the same address would get the checkpoint
+    if (nVersion > 3 && nVersion < 7) {
+        CAccCheckpoints& acc = AccCheckpoints();
+        LOCK(acc.cs);
+        acc.map.erase(this);
+    }
+}
+
+void CBlockIndex::SetAccumulatorCheckpoint(const uint256& nCheckpoint)
+{
+    // Only the zerocoin-era blocks have one, see GetAccumulatorCheckpoint
+    if (nVersion <= 3 || nVersion >= 7)
+        return;
+    CAccCheckpoints& acc = AccCheckpoints();
+    LOCK(acc.cs);
+    if (nCheckpoint.IsNull()) {
+        acc.map.erase(this);
+    } else {
+        acc.map[this] = nCheckpoint;
+    }
+}
+
+void ClearAccumulatorCheckpoints()
+{
+    CAccCheckpoints& acc = AccCheckpoints();
+    LOCK(acc.cs);
+    acc.map.clear();
+}
+
 void CBlockIndex::SetChainSaplingValue()
 {
     // Sapling, update chain value
@@ -167,6 +167,58 @@ enum BlockStatus {
     BLOCK_FAILED_MASK = BLOCK_FAILED_VALID | BLOCK_FAILED_CHILD,
 };
 
+/**
+ * Inline storage for the stake modifier of a block index entry.
+ * Holds nothing (not set / PoW), a V1 modifier (64 bit) or a V2 modifier (256 bit),
+ * avoiding a heap allocation per entry. Serializes exactly like the
+ * std::vector<unsigned char> previously used, so the block index db format is unchanged.
+ */
+class CStakeModifier
+{
+private:
+    static const unsigned int MAX_SIZE = 32;
+    unsigned char data[MAX_SIZE];
+    uint8_t nSize{0};
+
+public:
+    CStakeModifier() { memset(data, 0, MAX_SIZE); }
+
+    bool empty() const { return nSize == 0; }
+    unsigned int size() const { return nSize; }
+    const unsigned char* begin() const { return data; }
+
+    void clear()
+    {
+        memset(data, 0, MAX_SIZE);
+        nSize = 0;
+    }
+
+    void assign(const unsigned char* pbegin, size_t len)
+    {
+        if (len > MAX_SIZE) throw std::ios_base::failure("CStakeModifier::assign(): invalid size");
+        clear();
+        if (len > 0) memcpy(data, pbegin, len);
+        nSize = (uint8_t)len;
+    }
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        WriteCompactSize(s, nSize);
+        if (nSize > 0) s.write((const char*)data, nSize);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        const uint64_t len = ReadCompactSize(s);
+        if (len > MAX_SIZE) throw std::ios_base::failure("CStakeModifier::Unserialize(): invalid size");
+        clear();
+        if (len > 0) s.read((char*)data, len);
+        nSize = (uint8_t)len;
+    }
+};
+
 // BlockIndex flags
 enum {
     BLOCK_PROOF_OF_STAKE = (1 << 0), // is proof-of-stake block
@@ -219,9 +271,6 @@ public:
     unsigned int nStatus{0};
 
     // proof-of-stake specific fields
-    // char vector holding the stake modifier bytes. It is empty for PoW blocks.
-    // Modifier V1 is 64 bit while modifier V2 is 256 bit.
-    std::vector<unsigned char> vStakeModifier{};
     unsigned int nFlags{0};
 
     //! Change in value held by the Sapling circuit over this block.
@@ -231,16 +280,15 @@ public:
 
     //! (memory only) Total value held by the Sapling circuit up to and including this block.
     //! Will be nullopt if nChainTx is zero.
-   Optional<CAmount> nChainSaplingValue{nullopt};
+    Optional<CAmount> nChainSaplingValue{nullopt};
 
     //! block header
     int nVersion{0};
-    uint256 hashMerkleRoot{};
-    uint256 hashFinalSaplingRoot{};
     unsigned int nTime{0};
     unsigned int nBits{0};
     unsigned int nNonce{0};
-    uint256 nAccumulatorCheckpoint{};
+    uint256 hashMerkleRoot{};
+    uint256 hashFinalSaplingRoot{};
 
     //! (memory only) Sequential id assigned to distinguish order in which blocks are received.
     uint32_t nSequenceId{0};
@@ -248,8 +296,17 @@ public:
     //! (memory only) Maximum nTime in the chain upto and including this block.
     unsigned int nTimeMax{0};
 
+    //! Stake modifier bytes, empty for PoW blocks.
+    //! Modifier V1 is 64 bit while modifier V2 is 256 bit.
+    CStakeModifier vStakeModifier{};
+
     CBlockIndex() {}
     CBlockIndex(const CBlock& block);
+    //! Copies the accumulator checkpoint too, which is kept aside by address
+    CBlockIndex(const CBlockIndex& other);
+    CBlockIndex& operator=(const CBlockIndex&) = delete;
+    //! Drops the accumulator checkpoint of the index, kept aside by address
+    ~CBlockIndex();
 
     std::string ToString() const;
 
@@ -280,6 +337,11 @@ public:
     uint64_t GetStakeModifierV1() const;
     uint256 GetStakeModifierV2() const;
 
+    // Zerocoin accumulator checkpoint (block versions 4 to 6 only).
+    // Null for every other block, so it is kept in a side table instead of in each entry.
+    uint256 GetAccumulatorCheckpoint() const;
+    void SetAccumulatorCheckpoint(const uint256& nCheckpoint);
+
     // Update Sapling chain value
     void SetChainSaplingValue();
 
@@ -298,6 +360,9 @@ public:
 /** Find the forking point between two chain tips. */
 const CBlockIndex* LastCommonAncestor(const CBlockIndex* pa, const CBlockIndex* pb);
 
+/** Drop every accumulator checkpoint side table entry (to be called when the block index is freed). */
+void ClearAccumulatorCheckpoints();
+
 /** Used to marshal pointers into hashes for db storage. */
 
 // New serialization introduced with 4.0.99
@@ -308,6 +373,7 @@ class CDiskBlockIndex : public CBlockIndex
 {
 public:
     uint256 hashPrev;
+    uint256 nAccumulatorCheckpoint;
 
     CDiskBlockIndex()
     {
@@ -317,6 +383,7 @@ public:
     explicit CDiskBlockIndex(const CBlockIndex* pindex) : CBlockIndex(*pindex)
     {
         hashPrev = (pprev ? pprev->GetBlockHash() : UINT256_ZERO);
+        nAccumulatorCheckpoint = pindex->GetAccumulatorCheckpoint();
     }
 
     ADD_SERIALIZE_METHODS;
@@ -416,7 +483,8 @@ public:
     }
 
 
-    uint256 GetBlockHash() const
+    //! The header built from the fields of this entry (the accumulator checkpoint isn't in mapAccCheckpoints yet)
+    CBlockHeader GetBlockHeader() const
     {
         CBlockHeader block;
         block.nVersion = nVersion;
@@ -429,7 +497,12 @@ public:
             block.nAccumulatorCheckpoint = nAccumulatorCheckpoint;
         if (nVersion >= 8)
             block.hashFinalSaplingRoot = hashFinalSaplingRoot;
-        return block.GetHash();
+        return block;
+    }
+
+    uint256 GetBlockHash() const
+    {
+        return GetBlockHeader().GetHash();
     }
 
 
@@ -451,6 +524,7 @@ public:
     int64_t nMint = 0;
     uint256 hashNext{};
     uint256 hashPrev{};
+    uint256 nAccumulatorCheckpoint{};
     uint64_t nStakeModifier = 0;
     uint256 nStakeModifierV2{};
     COutPoint prevoutStake{};
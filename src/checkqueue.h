@@ -6,6 +6,9 @@
 #define BITCOIN_CHECKQUEUE_H
 
 #include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
 #include <vector>
 
 #include <boost/thread/condition_variable.hpp>
@@ -23,12 +26,29 @@ class CCheckQueueControl;
   * onto the queue, where they are processed by N-1 worker threads. When
   * the master is done adding work, it temporarily joins the worker pool
   * as an N'th worker, until all jobs are done.
+  *
+  * Every worker has its own queue, and the batches added are spread over
+  * them. A worker takes the newest jobs of its own queue, and when it is
+  * empty steals the oldest half of the jobs of another one, so that the
+  * workers only contend for a queue when they run out of work. Once a
+  * verification fails, the ones that are left are skipped.
   */
 template <typename T>
 class CCheckQueue
 {
 private:
-    //! Mutex to protect the inner state
+    //! The jobs of one worker
+    struct WorkerQueue {
+        boost::mutex mutex;
+        std::deque<T> jobs;
+        //! Size of jobs, to skip empty queues without locking them
+        std::atomic<unsigned int> nSize{0};
+    };
+
+    //! Maximum number of worker queues; the workers after it share them
+    static const int MAX_QUEUES = 128;
+
+    //! Mutex to protect the accounting of the workers
     boost::mutex mutex;
 
     //! Worker threads block on this when out of work
@@ -37,25 +57,34 @@ private:
     //! Master thread blocks on this when out of work
     boost::condition_variable condMaster;
 
-    //! The queue of elements to be processed.
-    //! As the order of booleans doesn't matter, it is used as a LIFO (stack)
-    std::vector<T> queue;
+    //! The queues of the workers, the first one being the master's
+    std::unique_ptr<WorkerQueue[]> queues;
 
-    //! The number of workers (including the master) that are idle.
-    int nIdle;
+    //! The number of queues in use
+    std::atomic<int> nQueues;
+
+    //! The number of worker threads (not including the master) started so far
+    int nWorkers;
 
-    //! The total number of workers (including the master).
-    int nTotal;
+    //! The queue that gets the next batch added
+    int nNextQueue;
+
+    //! The number of worker threads that are idle.
+    int nIdle;
 
     //! The temporary evaluation result.
-    bool fAllOk;
+    std::atomic<bool> fAllOk;
 
     /**
      * Number of verifications that haven't completed yet.
-     * This includes elements that are not anymore in queue, but still in
+     * This includes elements that are not anymore in the queues, but still in
      * worker's own batches.
      */
-    unsigned int nTodo;
+    std::atomic<unsigned int> nTodo;
+
+    //! Number of verifications in the queues, not yet taken by a worker (briefly negative
+    //! when some are taken before Add accounts for them)
+    std::atomic<int> nQueued;
 
     //! Whether we're shutting down.
     bool fQuit;
@@ -63,70 +92,115 @@ private:
     //! The maximum number of elements to be processed in one batch
     unsigned int nBatchSize;
 
+    /** Take a batch of jobs from the queue nQueue, or steal one from another queue. */
+    bool TakeBatch(int nQueue, std::vector<T>& vChecks)
+    {
+        {
+            WorkerQueue& own = queues[nQueue];
+            boost::unique_lock<boost::mutex> lock(own.mutex);
+            if (!own.jobs.empty()) {
+                // Leave about half of the jobs to the others, in batches getting smaller
+                // towards the end so all workers finish approximately simultaneously.
+                unsigned int nNow = std::max(1U, std::min(nBatchSize, (unsigned int)own.jobs.size() / 2));
+                for (unsigned int i = 0; i < nNow; i++) {
+                    vChecks.emplace_back();
+                    vChecks.back().swap(own.jobs.back());
+                    own.jobs.pop_back();
+                }
+                nQueued -= nNow;
+                own.nSize = own.jobs.size();
+                return true;
+            }
+        }
+
+        // Steal without waiting for the queues that are busy, and only wait for them if they are
+        // the only ones left with jobs.
+        for (int nPass = 0; nPass < 2 && nQueued > 0; nPass++) {
+            const int nQueuesNow = nQueues;
+            bool fBusy = false;
+            for (int i = 1; i < nQueuesNow; i++) {
+                WorkerQueue& victim = queues[(nQueue + i) % nQueuesNow];
+                if (victim.nSize == 0)
+                    continue;
+                boost::unique_lock<boost::mutex> lock(victim.mutex, boost::defer_lock);
+                if (nPass == 0 && !lock.try_lock()) {
+                    fBusy = true;
+                    continue;
+                }
+                if (nPass > 0)
+                    lock.lock();
+                if (victim.jobs.empty())
+                    continue;
+                unsigned int nNow = std::min(nBatchSize, ((unsigned int)victim.jobs.size() + 1) / 2);
+                for (unsigned int j = 0; j < nNow; j++) {
+                    vChecks.emplace_back();
+                    vChecks.back().swap(victim.jobs.front());
+                    victim.jobs.pop_front();
+                }
+                nQueued -= nNow;
+                victim.nSize = victim.jobs.size();
+                return true;
+            }
+            if (!fBusy)
+                break;
+        }
+        return false;
+    }
+
     /** Internal function that does bulk of the verification work. */
     bool Loop(bool fMaster = false)
     {
         boost::condition_variable& cond = fMaster ? condMaster : condWorker;
+        int nQueue = 0;
+        if (!fMaster) {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            nQueue = 1 + nWorkers++ % (MAX_QUEUES - 1);
+            if (nQueues <= nQueue)
+                nQueues = nQueue + 1;
+        }
         std::vector<T> vChecks;
         vChecks.reserve(nBatchSize);
-        unsigned int nNow = 0;
-        bool fOk = true;
         do {
-            {
-                boost::unique_lock<boost::mutex> lock(mutex);
-                // first do the clean-up of the previous loop run (allowing us to do it in the same critsect)
-                if (nNow) {
-                    fAllOk &= fOk;
-                    nTodo -= nNow;
-                    if (nTodo == 0 && !fMaster)
-                        // We processed the last element; inform the master he can exit and return the result
-                        condMaster.notify_one();
-                } else {
-                    // first iteration
-                    nTotal++;
+            if (TakeBatch(nQueue, vChecks)) {
+                // execute work, unless a verification already failed
+                for (T& check : vChecks) {
+                    if (!fAllOk)
+                        break;
+                    if (!check())
+                        fAllOk = false;
+                }
+                const unsigned int nNow = vChecks.size();
+                vChecks.clear();
+                if (nTodo.fetch_sub(nNow) == nNow) {
+                    // We processed the last element; inform the master he can exit and return the result
+                    boost::unique_lock<boost::mutex> lock(mutex);
+                    condMaster.notify_one();
                 }
-                // logically, the do loop starts here
-                while (queue.empty()) {
-                    if ((fMaster || fQuit) && nTodo == 0) {
-                        nTotal--;
-                        bool fRet = fAllOk;
-                        // reset the status for new work later
-                        if (fMaster)
-                            fAllOk = true;
-                        // return the current status
-                        return fRet;
-                    }
+                continue;
+            }
+
+            boost::unique_lock<boost::mutex> lock(mutex);
+            if ((fMaster || fQuit) && nTodo == 0) {
+                bool fRet = fAllOk;
+                // reset the status for new work later
+                if (fMaster)
+                    fAllOk = true;
+                // return the current status
+                return fRet;
+            }
+            if (nQueued <= 0) {
+                if (!fMaster)
                     nIdle++;
-                    cond.wait(lock); // wait
+                cond.wait(lock); // wait
+                if (!fMaster)
                     nIdle--;
-                }
-                // Decide how many work units to process now.
-                // * Do not try to do everything at once, but aim for increasingly smaller batches so
-                //   all workers finish approximately simultaneously.
-                // * Try to account for idle jobs which will instantly start helping.
-                // * Don't do batches smaller than 1 (duh), or larger than nBatchSize.
-                nNow = std::max(1U, std::min(nBatchSize, (unsigned int)queue.size() / (nTotal + nIdle + 1)));
-                vChecks.resize(nNow);
-                for (unsigned int i = 0; i < nNow; i++) {
-                    // We want the lock on the mutex to be as short as possible, so swap jobs from the global
-                    // queue to the local batch vector instead of copying.
-                    vChecks[i].swap(queue.back());
-                    queue.pop_back();
-                }
-                // Check whether we need to do work at all
-                fOk = fAllOk;
             }
-            // execute work
-            for (T& check : vChecks)
-                if (fOk)
-                    fOk = check();
-            vChecks.clear();
         } while (true);
     }
 
 public:
     //! Create a new check queue
-    CCheckQueue(unsigned int nBatchSizeIn) : nIdle(0), nTotal(0), fAllOk(true), nTodo(0), fQuit(false), nBatchSize(nBatchSizeIn) {}
+    CCheckQueue(unsigned int nBatchSizeIn) : queues(new WorkerQueue[MAX_QUEUES]), nQueues(1), nWorkers(0), nNextQueue(0), nIdle(0), fAllOk(true), nTodo(0), nQueued(0), fQuit(false), nBatchSize(nBatchSizeIn) {}
 
     //! Worker thread
     void Thread()
@@ -143,26 +217,47 @@ public:
     //! Add a batch of checks to the queue
     void Add(std::vector<T>& vChecks)
     {
-        boost::unique_lock<boost::mutex> lock(mutex);
-        for (T& check : vChecks) {
-            queue.push_back(T());
-            check.swap(queue.back());
+        if (vChecks.empty())
+            return;
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            nTodo += vChecks.size();
+        }
+        // Spread the checks over the queues of the workers
+        const int nQueuesNow = nQueues;
+        const size_t nPerQueue = (vChecks.size() + nQueuesNow - 1) / nQueuesNow;
+        size_t nPos = 0;
+        int nFilled = 0;
+        while (nPos < vChecks.size()) {
+            WorkerQueue& queue = queues[nNextQueue % nQueuesNow];
+            nNextQueue = (nNextQueue + 1) % nQueuesNow;
+            boost::unique_lock<boost::mutex> lock(queue.mutex);
+            for (size_t nEnd = std::min(vChecks.size(), nPos + nPerQueue); nPos < nEnd; nPos++) {
+                queue.jobs.emplace_back();
+                queue.jobs.back().swap(vChecks[nPos]);
+            }
+            queue.nSize = queue.jobs.size();
+            nFilled++;
         }
-        nTodo += vChecks.size();
-        if (vChecks.size() == 1)
-            condWorker.notify_one();
-        else if (vChecks.size() > 1)
+        // Wake up a worker per queue filled; the others would only find nothing left to steal
+        boost::unique_lock<boost::mutex> lock(mutex);
+        nQueued += vChecks.size();
+        if (nFilled >= nIdle) {
             condWorker.notify_all();
+        } else {
+            for (int i = 0; i < nFilled; i++)
+                condWorker.notify_one();
+        }
     }
 
     ~CCheckQueue()
     {
     }
 
+    //! Whether there is no work in progress (the workers may still be on their way to sleep)
     bool IsIdle()
     {
-        boost::unique_lock<boost::mutex> lock(mutex);
-        return (nTotal == nIdle && nTodo == 0 && fAllOk == true);
+        return (nTodo == 0 && nQueued == 0 && fAllOk == true);
     }
 };
 
@@ -13,6 +13,7 @@
 #include "sapling/incrementalmerkletree.h"
 #include "script/standard.h"
 #include "serialize.h"
+#include "support/allocators/pool.h"
 #include "uint256.h"
 
 #include <assert.h>
@@ -173,7 +174,19 @@ struct CNullifiersCacheEntry
 typedef std::unordered_map<uint256, CAnchorsSaplingCacheEntry, SaltedIdHasher> CAnchorsSaplingMap;
 typedef std::unordered_map<uint256, CNullifiersCacheEntry, SaltedIdHasher> CNullifiersMap;
 
-typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> CCoinsMap;
+/**
+ * The coins cache nodes are allocated from a PoolResource: one malloc per node would add
+ * its bookkeeping overhead to every cached coin. The block size covers a node (the value
+ * plus the next pointer and the cached hash of the hashtable) with some slack.
+ */
+typedef std::unordered_map<COutPoint,
+                           CCoinsCacheEntry,
+                           SaltedOutpointHasher,
+                           std::equal_to<COutPoint>,
+                           PoolAllocator<std::pair<const COutPoint, CCoinsCacheEntry>,
+                                         sizeof(std::pair<const COutPoint, CCoinsCacheEntry>) + sizeof(void*) * 4> >
+    CCoinsMap;
+typedef CCoinsMap::allocator_type::ResourceType CCoinsMapMemoryResource;
 
 /** Cursor for iterating over CoinsView state */
 class CCoinsViewCursor
@@ -287,6 +300,7 @@ protected:
      * declared as "const".
      */
     mutable uint256 hashBlock;
+    mutable CCoinsMapMemoryResource cacheCoinsMemoryResource;
     mutable CCoinsMap cacheCoins;
 
     // Sapling
@@ -338,6 +352,13 @@ public:
      */
     bool HaveCoinInCache(const COutPoint& outpoint) const;
 
+    /**
+     * Insert a coin read from the backing view by someone else (e.g. prefetched
+     * by another thread), as if it had been fetched by this cache.
+     * No effect if the outpoint is already cached or the coin is spent.
+     */
+    void InsertFetchedCoin(const COutPoint& outpoint, Coin&& coin);
+
     /**
      * Return a reference to a Coin in the cache, or a pruned one if not found. This is
      * more efficient than GetCoin. Modifications to other cache entries are
@@ -365,6 +386,12 @@ public:
      */
     bool Flush();
 
+    /**
+     * Force a reallocation of the coins cache, returning the memory of its pool
+     * to the system. Must only be called on an empty cache.
+     */
+    void ReallocateCache();
+
     /**
      * Removes the UTXO with the given outpoint from the cache, if it is not modified.
      */
@@ -7,6 +7,7 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <string>
 
 /** A hasher class for SHA-256. */
 class CSHA256
@@ -26,4 +27,15 @@ public:
     CSHA256& Reset();
 };
 
+/** Enable the SHA-256 implementations for several inputs at once supported by the CPU, and
+ *  return a description of them. To be called once at startup.
+ */
+std::string SHA256AutoDetect();
+
+/** Compute the double SHA-256 of blocks consecutive 64 byte inputs (e.g. pairs of hashes of a
+ *  merkle tree level) into blocks consecutive 32 byte outputs. The output may overlap with the
+ *  start of the input (out == in).
+ */
+void SHA256D64(unsigned char* output, const unsigned char* input, size_t blocks);
+
 #endif // BITCOIN_CRYPTO_SHA256_H
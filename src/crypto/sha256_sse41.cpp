@@ -0,0 +1,160 @@
+// Copyright (c) 2022 The PIVX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// Double SHA-256 of four 64 byte inputs at once, one per 32-bit lane of the SSE registers.
+// Built with -msse4.1, and only called when the CPU supports it (see SHA256AutoDetect).
+
+#ifdef ENABLE_SSE41
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include "crypto/common.h"
+
+namespace sha256d64_sse41
+{
+namespace
+{
+typedef __m128i Lanes;
+
+const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+const uint32_t INIT[8] = {0x6a09e667ul, 0xbb67ae85ul, 0x3c6ef372ul, 0xa54ff53aul, 0x510e527ful, 0x9b05688cul, 0x1f83d9abul, 0x5be0cd19ul};
+
+inline Lanes K1(uint32_t x) { return _mm_set1_epi32(x); }
+inline Lanes Add(Lanes x, Lanes y) { return _mm_add_epi32(x, y); }
+inline Lanes Xor(Lanes x, Lanes y) { return _mm_xor_si128(x, y); }
+inline Lanes Or(Lanes x, Lanes y) { return _mm_or_si128(x, y); }
+inline Lanes And(Lanes x, Lanes y) { return _mm_and_si128(x, y); }
+inline Lanes ShR(Lanes x, int n) { return _mm_srli_epi32(x, n); }
+inline Lanes ShL(Lanes x, int n) { return _mm_slli_epi32(x, n); }
+inline Lanes RotR(Lanes x, int n) { return Or(ShR(x, n), ShL(x, 32 - n)); }
+
+inline Lanes Ch(Lanes x, Lanes y, Lanes z) { return Xor(z, And(x, Xor(y, z))); }
+inline Lanes Maj(Lanes x, Lanes y, Lanes z) { return Or(And(x, y), And(z, Or(x, y))); }
+inline Lanes Sigma0(Lanes x) { return Xor(Xor(RotR(x, 2), RotR(x, 13)), RotR(x, 22)); }
+inline Lanes Sigma1(Lanes x) { return Xor(Xor(RotR(x, 6), RotR(x, 11)), RotR(x, 25)); }
+inline Lanes sigma0(Lanes x) { return Xor(Xor(RotR(x, 7), RotR(x, 18)), ShR(x, 3)); }
+inline Lanes sigma1(Lanes x) { return Xor(Xor(RotR(x, 17), RotR(x, 19)), ShR(x, 10)); }
+
+/** The 64 rounds over the state s, with kw[i] = K[i] + w[i] for a message schedule w. */
+template <typename KW>
+inline void Rounds(Lanes* s, KW kw)
+{
+    Lanes a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+    for (int i = 0; i < 64; i++) {
+        const Lanes t1 = Add(Add(Add(h, Sigma1(e)), Ch(e, f, g)), kw(i));
+        const Lanes t2 = Add(Sigma0(a), Maj(a, b, c));
+        h = g;
+        g = f;
+        f = e;
+        e = Add(d, t1);
+        d = c;
+        c = b;
+        b = a;
+        a = Add(t1, t2);
+    }
+    s[0] = Add(s[0], a);
+    s[1] = Add(s[1], b);
+    s[2] = Add(s[2], c);
+    s[3] = Add(s[3], d);
+    s[4] = Add(s[4], e);
+    s[5] = Add(s[5], f);
+    s[6] = Add(s[6], g);
+    s[7] = Add(s[7], h);
+}
+
+/** Transform of the state s by the 16 words w, different in each lane. */
+inline void Transform(Lanes* s, Lanes* w)
+{
+    Rounds(s, [w](int i) {
+        if (i >= 16) {
+            w[i & 15] = Add(Add(Add(w[i & 15], sigma1(w[(i + 14) & 15])), w[(i + 9) & 15]), sigma0(w[(i + 1) & 15]));
+        }
+        return Add(K1(K[i]), w[i & 15]);
+    });
+}
+
+/** K[i] + w[i] for the schedule of a padding block, the same for all the inputs. */
+struct PaddingSchedule {
+    uint32_t kw[64];
+
+    explicit PaddingSchedule(const uint32_t* pad)
+    {
+        uint32_t w[64];
+        for (int i = 0; i < 16; i++) {
+            w[i] = pad[i];
+        }
+        for (int i = 16; i < 64; i++) {
+            const uint32_t s0 = (w[i - 15] >> 7 | w[i - 15] << 25) ^ (w[i - 15] >> 18 | w[i - 15] << 14) ^ (w[i - 15] >> 3);
+            const uint32_t s1 = (w[i - 2] >> 17 | w[i - 2] << 15) ^ (w[i - 2] >> 19 | w[i - 2] << 13) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        for (int i = 0; i < 64; i++) {
+            kw[i] = K[i] + w[i];
+        }
+    }
+};
+
+//! The second block of the first hash: the padding of 64 bytes
+const uint32_t PADDING_64[16] = {0x80000000, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x200};
+const PaddingSchedule SCHEDULE_64(PADDING_64);
+
+inline Lanes Read4(const unsigned char* in, int offset)
+{
+    return _mm_set_epi32(ReadBE32(in + 192 + offset), ReadBE32(in + 128 + offset), ReadBE32(in + 64 + offset), ReadBE32(in + offset));
+}
+
+inline void Write4(unsigned char* out, int offset, Lanes v)
+{
+    WriteBE32(out + offset, _mm_extract_epi32(v, 0));
+    WriteBE32(out + 32 + offset, _mm_extract_epi32(v, 1));
+    WriteBE32(out + 64 + offset, _mm_extract_epi32(v, 2));
+    WriteBE32(out + 96 + offset, _mm_extract_epi32(v, 3));
+}
+
+} // namespace
+
+void Transform_4way(unsigned char* out, const unsigned char* in)
+{
+    Lanes s[8], w[16];
+
+    // First hash: the input, then its padding
+    for (int i = 0; i < 8; i++) {
+        s[i] = K1(INIT[i]);
+    }
+    for (int i = 0; i < 16; i++) {
+        w[i] = Read4(in, 4 * i);
+    }
+    Transform(s, w);
+    Rounds(s, [](int i) { return K1(SCHEDULE_64.kw[i]); });
+
+    // Second hash: the first one, padded to a block
+    for (int i = 0; i < 8; i++) {
+        w[i] = s[i];
+        s[i] = K1(INIT[i]);
+    }
+    w[8] = K1(0x80000000);
+    for (int i = 9; i < 15; i++) {
+        w[i] = K1(0);
+    }
+    w[15] = K1(0x100);
+    Transform(s, w);
+
+    for (int i = 0; i < 8; i++) {
+        Write4(out, 4 * i, s[i]);
+    }
+}
+
+} // namespace sha256d64_sse41
+
+#endif
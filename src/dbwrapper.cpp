@@ -4,7 +4,9 @@
 
 #include "dbwrapper.h"
 
+#include "sync.h"
 #include "util.h"
+#include "utilstrencodings.h"
 
 #include <leveldb/cache.h>
 #include <leveldb/env.h>
@@ -12,6 +14,124 @@
 #include <memenv.h>
 #include <stdint.h>
 
+#include <algorithm>
+#include <atomic>
+#include <set>
+
+const std::vector<std::string> DB_PROFILE_NAMES = {"blockindex", "chainstate", "evodb", "sporks", "zerocoin"};
+
+namespace dbwrapper_private {
+
+/** LevelDB block cache counting the hits and misses of its lookups */
+class CountingCache : public leveldb::Cache
+{
+private:
+    leveldb::Cache* const base;
+    const size_t nCapacity;
+
+public:
+    std::atomic<uint64_t> nHits{0};
+    std::atomic<uint64_t> nMisses{0};
+
+    explicit CountingCache(size_t nCapacityIn) : base(leveldb::NewLRUCache(nCapacityIn)), nCapacity(nCapacityIn) {}
+    ~CountingCache() { delete base; }
+
+    Handle* Insert(const leveldb::Slice& key, void* value, size_t charge, void (*deleter)(const leveldb::Slice& key, void* value)) override
+    {
+        return base->Insert(key, value, charge, deleter);
+    }
+    Handle* Lookup(const leveldb::Slice& key) override
+    {
+        Handle* handle = base->Lookup(key);
+        (handle ? nHits : nMisses)++;
+        return handle;
+    }
+    void Release(Handle* handle) override { base->Release(handle); }
+    void* Value(Handle* handle) override { return base->Value(handle); }
+    void Erase(const leveldb::Slice& key) override { base->Erase(key); }
+    uint64_t NewId() override { return base->NewId(); }
+    void Prune() override { base->Prune(); }
+    size_t TotalCharge() const override { return base->TotalCharge(); }
+
+    size_t Capacity() const { return nCapacity; }
+};
+
+};
+
+/** Apply a "<db>:<setting>=<value>" -dbprofile argument to profile if it is about the database name */
+static bool ApplyDBProfileArg(const std::string& strArg, const std::string& name, CDBProfile& profile, std::string& strError)
+{
+    const size_t nColon = strArg.find(':');
+    const size_t nEquals = strArg.find('=', nColon == std::string::npos ? 0 : nColon);
+    if (nColon == std::string::npos || nEquals == std::string::npos) {
+        strError = strprintf("Invalid -dbprofile=%s, the format is <db>:<setting>=<value>", strArg);
+        return false;
+    }
+    const std::string strName = strArg.substr(0, nColon);
+    const std::string strSetting = strArg.substr(nColon + 1, nEquals - nColon - 1);
+    const std::string strValue = strArg.substr(nEquals + 1);
+    if (std::find(DB_PROFILE_NAMES.begin(), DB_PROFILE_NAMES.end(), strName) == DB_PROFILE_NAMES.end()) {
+        std::string strNames;
+        for (const std::string& strKnown : DB_PROFILE_NAMES) {
+            strNames += (strNames.empty() ? "" : ", ") + strKnown;
+        }
+        strError = strprintf("Invalid -dbprofile=%s, unknown database %s (one of: %s)", strArg, strName, strNames);
+        return false;
+    }
+    int64_t nValue;
+    if (!ParseInt64(strValue, &nValue) || nValue < 0) {
+        strError = strprintf("Invalid -dbprofile=%s, the value must be a non negative number", strArg);
+        return false;
+    }
+
+    CDBProfile parsed = profile;
+    if (strSetting == "blockcache" && nValue <= 100) {
+        parsed.nBlockCachePercent = nValue;
+    } else if (strSetting == "writebuffer" && nValue <= 1024) {
+        parsed.nWriteBufferSize = nValue << 20;
+    } else if (strSetting == "compression" && nValue <= 1) {
+        parsed.fCompression = nValue;
+    } else if (strSetting == "verifychecksums" && nValue <= 1) {
+        parsed.fVerifyChecksums = nValue;
+    } else if (strSetting == "maxfilesize" && nValue >= 1 && nValue <= 1024) {
+        parsed.nMaxFileSize = nValue << 20;
+    } else if (strSetting == "bloombits" && nValue <= 64) {
+        parsed.nBloomBits = nValue;
+    } else {
+        strError = strprintf("Invalid -dbprofile=%s, unknown setting or value out of range", strArg);
+        return false;
+    }
+    if (strName == name) profile = parsed;
+    return true;
+}
+
+bool CheckDBProfiles(const std::vector<std::string>& vArgs, std::string& strError)
+{
+    CDBProfile profile;
+    for (const std::string& strArg : vArgs) {
+        if (!ApplyDBProfileArg(strArg, "", profile, strError))
+            return false;
+    }
+    return true;
+}
+
+CDBProfile GetDBProfile(const std::string& name)
+{
+    CDBProfile profile;
+    if (name.empty())
+        return profile;
+    std::string strError;
+    for (const std::string& strArg : gArgs.GetArgs("-dbprofile")) {
+        // Invalid arguments are rejected at startup by CheckDBProfiles
+        ApplyDBProfileArg(strArg, name, profile, strError);
+    }
+    return profile;
+}
+
+//! The named databases currently open, for getdbstats
+static Mutex cs_dbwrappers;
+static std::set<const CDBWrapper*> setDBWrappers;
+
 
 static void SetMaxOpenFiles(leveldb::Options *options) {
     // On most platforms the default setting of max_open_files (which is 1000)
@@ -38,13 +158,16 @@ static void SetMaxOpenFiles(leveldb::Options *options) {
              options->max_open_files, default_open_files);
 }
 
-static leveldb::Options GetOptions(size_t nCacheSize)
+static leveldb::Options GetOptions(size_t nCacheSize, const CDBProfile& profile, dbwrapper_private::CountingCache*& pcache)
 {
     leveldb::Options options;
-    options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
-    options.write_buffer_size = nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
-    options.filter_policy = leveldb::NewBloomFilterPolicy(10);
-    options.compression = leveldb::kNoCompression;
+    pcache = new dbwrapper_private::CountingCache(nCacheSize * profile.nBlockCachePercent / 100);
+    options.block_cache = pcache;
+    // up to two write buffers may be held in memory simultaneously
+    options.write_buffer_size = profile.nWriteBufferSize ? profile.nWriteBufferSize : nCacheSize * (100 - profile.nBlockCachePercent) / 200;
+    options.filter_policy = profile.nBloomBits > 0 ? leveldb::NewBloomFilterPolicy(profile.nBloomBits) : nullptr;
+    options.compression = profile.fCompression ? leveldb::kSnappyCompression : leveldb::kNoCompression;
+    options.max_file_size = profile.nMaxFileSize;
     if (leveldb::kMajorVersion > 1 || (leveldb::kMajorVersion == 1 && leveldb::kMinorVersion >= 16)) {
         // LevelDB versions before 1.16 consider short writes to be corruption. Only trigger error
         // on corruption in later versions.
@@ -54,14 +177,18 @@ static leveldb::Options GetOptions(size_t nCacheSize)
     return options;
 }
 
-CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe)
+CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe, const std::string& name) :
+    m_name(name),
+    m_path(path.string()),
+    m_cache_size(nCacheSize),
+    m_profile(GetDBProfile(name))
 {
     penv = NULL;
-    readoptions.verify_checksums = true;
-    iteroptions.verify_checksums = true;
+    readoptions.verify_checksums = m_profile.fVerifyChecksums;
+    iteroptions.verify_checksums = m_profile.fVerifyChecksums;
     iteroptions.fill_cache = false;
     syncoptions.sync = true;
-    options = GetOptions(nCacheSize);
+    options = GetOptions(nCacheSize, m_profile, pcache);
     options.create_if_missing = true;
     if (fMemory) {
         penv = leveldb::NewMemEnv(leveldb::Env::Default());
@@ -78,16 +205,26 @@ CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bo
     leveldb::Status status = leveldb::DB::Open(options, path.string(), &pdb);
     dbwrapper_private::HandleError(status);
     LogPrintf("Opened LevelDB successfully\n");
+
+    if (!m_name.empty()) {
+        LOCK(cs_dbwrappers);
+        setDBWrappers.insert(this);
+    }
 }
 
 CDBWrapper::~CDBWrapper()
 {
+    {
+        LOCK(cs_dbwrappers);
+        setDBWrappers.erase(this);
+    }
     delete pdb;
     pdb = NULL;
     delete options.filter_policy;
     options.filter_policy = NULL;
     delete options.block_cache;
     options.block_cache = NULL;
+    pcache = NULL;
     delete penv;
     options.env = NULL;
 }
@@ -106,6 +243,47 @@ bool CDBWrapper::IsEmpty()
     return !(it->Valid());
 }
 
+CDBStats CDBWrapper::GetStats() const
+{
+    CDBStats stats;
+    stats.strName = m_name;
+    stats.strPath = m_path;
+    stats.profile = m_profile;
+    stats.nCacheSize = m_cache_size;
+    stats.nBlockCacheCapacity = pcache->Capacity();
+    stats.nBlockCacheUsage = pcache->TotalCharge();
+    stats.nBlockCacheHits = pcache->nHits;
+    stats.nBlockCacheMisses = pcache->nMisses;
+
+    // Keys are never made of 0xff bytes only: this covers the whole key range
+    const std::string strLast(16, '\xff');
+    leveldb::Range range{leveldb::Slice(), leveldb::Slice(strLast)};
+    uint64_t nSize = 0;
+    pdb->GetApproximateSizes(&range, 1, &nSize);
+    stats.nApproximateSize = nSize;
+
+    std::string strValue;
+    stats.nMemoryUsage = pdb->GetProperty("leveldb.approximate-memory-usage", &strValue) ? atoi64(strValue) : 0;
+    for (int nLevel = 0; pdb->GetProperty(strprintf("leveldb.num-files-at-level%d", nLevel), &strValue); nLevel++) {
+        stats.vFilesPerLevel.push_back(atoi(strValue));
+    }
+    if (pdb->GetProperty("leveldb.stats", &strValue)) {
+        stats.strLevelDBStats = strValue;
+    }
+    return stats;
+}
+
+std::vector<CDBStats> GetAllDBStats()
+{
+    LOCK(cs_dbwrappers);
+    std::vector<CDBStats> vStats;
+    for (const CDBWrapper* pdbw : setDBWrappers) {
+        vStats.push_back(pdbw->GetStats());
+    }
+    std::sort(vStats.begin(), vStats.end(), [](const CDBStats& a, const CDBStats& b) { return a.strName < b.strName; });
+    return vStats;
+}
+
 CDBIterator::~CDBIterator() { delete piter; }
 bool CDBIterator::Valid() { return piter->Valid(); }
 void CDBIterator::SeekToFirst() { piter->SeekToFirst(); }
@@ -28,6 +28,57 @@ public:
     dbwrapper_error(const std::string& msg) : std::runtime_error(msg) {}
 };
 
+/**
+ * LevelDB tuning of a database. The defaults are the same for every database,
+ * they can be changed per database with -dbprofile=<db>:<setting>=<value>.
+ */
+struct CDBProfile
+{
+    //! Share of the cache budget given to the block cache (percent), the rest goes to the write buffers
+    int nBlockCachePercent{50};
+    //! Size of the write buffer in bytes, overriding its share of the cache budget (0 to use the share)
+    size_t nWriteBufferSize{0};
+    //! Compress the table blocks (only effective if LevelDB is built with snappy)
+    bool fCompression{false};
+    //! Verify the checksums of all the data read
+    bool fVerifyChecksums{true};
+    //! Size of the table files in bytes: larger files mean fewer, but longer, compactions
+    size_t nMaxFileSize{2 * 1024 * 1024};
+    //! Bits per key of the bloom filter (0 to disable it)
+    int nBloomBits{10};
+};
+
+/** Names of the databases which can be tuned with -dbprofile */
+extern const std::vector<std::string> DB_PROFILE_NAMES;
+
+/** Check the -dbprofile arguments. Returns false, with an error message, if one is invalid. */
+bool CheckDBProfiles(const std::vector<std::string>& vArgs, std::string& strError);
+
+/** Get the profile of the database name, from the default one and the -dbprofile arguments */
+CDBProfile GetDBProfile(const std::string& name);
+
+/** Statistics of a database, for getdbstats */
+struct CDBStats
+{
+    std::string strName;
+    std::string strPath;
+    CDBProfile profile;
+    //! Cache budget of the database (block cache and write buffers)
+    size_t nCacheSize;
+    size_t nBlockCacheCapacity;
+    size_t nBlockCacheUsage;
+    uint64_t nBlockCacheHits;
+    uint64_t nBlockCacheMisses;
+    //! Approximate size on disk of the whole key range
+    uint64_t nApproximateSize;
+    //! "leveldb.approximate-memory-usage"
+    uint64_t nMemoryUsage;
+    //! "leveldb.num-files-at-level<N>", for every level
+    std::vector<int> vFilesPerLevel;
+    //! "leveldb.stats": compaction statistics of every level
+    std::string strLevelDBStats;
+};
+
 class CDBWrapper;
 
 /** These should be considered an implementation detail of the specific database.
@@ -38,6 +89,8 @@ namespace dbwrapper_private {
  */
 void HandleError(const leveldb::Status& status);
 
+class CountingCache;
+
 };
 
 
@@ -221,14 +274,24 @@ private:
     //! the database itself
     leveldb::DB* pdb;
 
+    //! the block cache, counting its hits and misses
+    dbwrapper_private::CountingCache* pcache;
+
+    //! name of the database (for -dbprofile and getdbstats), empty for unnamed databases
+    std::string m_name;
+    std::string m_path;
+    size_t m_cache_size;
+    CDBProfile m_profile;
+
 public:
     /**
      * @param[in] path        Location in the filesystem where leveldb data will be stored.
      * @param[in] nCacheSize  Configures various leveldb cache settings.
      * @param[in] fMemory     If true, use leveldb's memory environment.
      * @param[in] fWipe       If true, remove all existing data.
+     * @param[in] name        Name of the database, selecting its -dbprofile and listing it in getdbstats.
      */
-    CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, const std::string& name = "");
     ~CDBWrapper();
 
     template <typename K>
@@ -383,8 +446,12 @@ public:
         pdb->CompactRange(nullptr, nullptr);
     }
 
+    CDBStats GetStats() const;
 };
 
+/** Statistics of all the named databases currently open */
+std::vector<CDBStats> GetAllDBStats();
+
 template<typename CDBTransaction>
 class CDBTransactionIterator
 {
@@ -33,9 +33,10 @@ void CEvoDBScopedCommitter::Rollback()
 }
 
 CEvoDB::CEvoDB(size_t nCacheSize, bool fMemory, bool fWipe) :
-        db(fMemory ? "" : (GetDataDir() / "evodb"), nCacheSize, fMemory, fWipe),
+        db(fMemory ? "" : (GetDataDir() / "evodb"), nCacheSize, fMemory, fWipe, "evodb"),
         rootBatch(),
-        rootDBTransaction(db, rootBatch),
+        frozenDBTransaction(db, rootBatch),
+        rootDBTransaction(frozenDBTransaction, frozenDBTransaction),
         curDBTransaction(rootDBTransaction, rootDBTransaction)
 {
 }
@@ -54,8 +55,23 @@ void CEvoDB::RollbackCurTransaction()
 
 bool CEvoDB::CommitRootTransaction()
 {
+    LOCK(cs);
+    FreezeRootTransaction();
+    return CommitFrozenTransaction();
+}
+
+void CEvoDB::FreezeRootTransaction()
+{
+    LOCK(cs);
     assert(curDBTransaction.IsClean());
     rootDBTransaction.Commit();
+}
+
+bool CEvoDB::CommitFrozenTransaction()
+{
+    // Hold cs until written: the changes are not readable between the commit and the write
+    LOCK(cs);
+    frozenDBTransaction.Commit();
     bool ret = db.WriteBatch(rootBatch);
     rootBatch.Clear();
     return ret;
@@ -36,10 +36,13 @@ public:
 private:
     CDBWrapper db;
 
-    typedef CDBTransaction<CDBWrapper, CDBBatch> RootTransaction;
+    typedef CDBTransaction<CDBWrapper, CDBBatch> FrozenTransaction;
+    typedef CDBTransaction<FrozenTransaction, FrozenTransaction> RootTransaction;
     typedef CDBTransaction<RootTransaction, RootTransaction> CurTransaction;
 
     CDBBatch rootBatch;
+    // Changes set aside by FreezeRootTransaction, readable until written to disk
+    FrozenTransaction frozenDBTransaction;
     RootTransaction rootDBTransaction;
     CurTransaction curDBTransaction;
 
@@ -93,11 +96,19 @@ public:
 
     size_t GetMemoryUsage()
     {
-        return rootDBTransaction.GetMemoryUsage();
+        LOCK(cs);
+        return rootDBTransaction.GetMemoryUsage() + frozenDBTransaction.GetMemoryUsage();
     }
 
     bool CommitRootTransaction();
 
+    /**
+     * Set the changes of the root transaction aside, to be written by CommitFrozenTransaction
+     * once the coins they go with are on disk. They stay visible to reads meanwhile.
+     */
+    void FreezeRootTransaction();
+    bool CommitFrozenTransaction();
+
     bool VerifyBestBlock(const uint256& hash);
     void WriteBestBlock(const uint256& hash);
 
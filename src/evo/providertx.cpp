@@ -45,8 +45,15 @@ static bool CheckService(const CService& addr, CValidationState& state)
 }
 
 template <typename Payload>
-static bool CheckStringSig(const Payload& pl, const CKeyID& keyID, CValidationState& state)
+static bool CheckStringSig(const Payload& pl, const CKeyID& keyID, CValidationState& state, std::vector<CBlockCheck>* pvChecks)
 {
+    if (pvChecks) {
+        pvChecks->emplace_back([pl, keyID]() {
+            std::string strError;
+            return CMessageSigner::VerifyMessage(keyID, pl.vchSig, pl.MakeSignString(), strError);
+        });
+        return true;
+    }
     std::string strError;
     if (!CMessageSigner::VerifyMessage(keyID, pl.vchSig, pl.MakeSignString(), strError)) {
         return state.DoS(100, false, REJECT_INVALID, "bad-protx-sig", false, strError);
@@ -83,7 +90,7 @@ static bool CheckCollateralOut(const CTxOut& out, const ProRegPL& pl, CValidatio
     return true;
 }
 
-bool CheckProRegTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state)
+bool CheckProRegTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state, std::vector<CBlockCheck>* pvChecks)
 {
     assert(tx.nType == CTransaction::TxType::PROREG);
 
@@ -171,7 +178,7 @@ bool CheckProRegTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValid
             return state.DoS(10, false, REJECT_INVALID, "bad-protx-collateral-pkh");
         }
         // collateral is not part of this ProRegTx, so we must verify ownership of the collateral
-        if (!CheckStringSig(pl, *keyForPayloadSig, state)) {
+        if (!CheckStringSig(pl, *keyForPayloadSig, state, pvChecks)) {
             // pass the state returned by the function above
             return false;
         }
@@ -13,6 +13,7 @@
 
 #include <univalue.h>
 
+class CBlockCheck;
 class CBlockIndex;
 
 // Provider-Register tx payload
@@ -68,6 +69,7 @@ public:
     void ToJson(UniValue& obj) const;
 };
 
-bool CheckProRegTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state);
+// If pvChecks is not null, the payload signature check is appended to it instead of being run
+bool CheckProRegTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state, std::vector<CBlockCheck>* pvChecks = nullptr);
 
 #endif  //quirkyturt_PROVIDERTX_H
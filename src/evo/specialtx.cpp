@@ -79,7 +79,7 @@ bool CheckSpecialTxNoContext(const CTransaction& tx, CValidationState& state)
                      REJECT_INVALID, "bad-tx-type");
 }
 
-bool CheckSpecialTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state)
+bool CheckSpecialTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state, std::vector<CBlockCheck>* pvChecks)
 {
     // This function is not called when connecting the genesis block
     assert(pindexPrev != nullptr);
@@ -103,7 +103,7 @@ bool CheckSpecialTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CVali
     switch (tx.nType) {
         case CTransaction::TxType::PROREG: {
             // provider-register
-            return CheckProRegTx(tx, pindexPrev, state);
+            return CheckProRegTx(tx, pindexPrev, state, pvChecks);
         }
     }
 
@@ -111,15 +111,24 @@ bool CheckSpecialTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CVali
                      REJECT_INVALID, "bad-tx-type");
 }
 
-bool ProcessSpecialTxsInBlock(const CBlock& block, const CBlockIndex* pindex, CValidationState& state, bool fJustCheck)
+bool CheckSpecialTxsInBlock(const CBlock& block, const CBlockIndex* pindex, CValidationState& state, std::vector<CBlockCheck>* pvChecks)
 {
-    // check special txes
     for (const CTransactionRef& tx: block.vtx) {
-        if (!CheckSpecialTx(*tx, pindex->pprev, state)) {
+        if (!CheckSpecialTx(*tx, pindex->pprev, state, pvChecks)) {
             // pass the state returned by the function above
             return false;
         }
     }
+    return true;
+}
+
+bool ProcessSpecialTxsInBlock(const CBlock& block, const CBlockIndex* pindex, CValidationState& state, bool fJustCheck, bool fCheckTxs)
+{
+    // check special txes
+    if (fCheckTxs && !CheckSpecialTxsInBlock(block, pindex, state)) {
+        // pass the state returned by the function above
+        return false;
+    }
 
     if (!deterministicMNManager->ProcessBlock(block, pindex, state, fJustCheck)) {
         // pass the state returned by the function above
@@ -11,6 +11,7 @@
 #include "primitives/transaction.h"
 
 class CBlock;
+class CBlockCheck;
 class CBlockIndex;
 class CValidationState;
 class uint256;
@@ -21,14 +22,19 @@ static const unsigned int MAX_SPECIALTX_EXTRAPAYLOAD = 10000;
 /** Payload validity checks (including duplicate unique properties against list at pindexPrev)*/
 // Note: for +v2, if the tx is not a special tx, this method returns true.
 // Note2: This function only performs extra payload related checks, it does NOT checks regular inputs and outputs.
-bool CheckSpecialTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state);
+// Note3: If pvChecks is not null, the signature checks are appended to it instead of being run.
+bool CheckSpecialTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state, std::vector<CBlockCheck>* pvChecks = nullptr);
 
 // Basic non-contextual checks for special txes
 // Note: for +v2, if the tx is not a special tx, this method returns true.
 bool CheckSpecialTxNoContext(const CTransaction& tx, CValidationState& state);
 
+// CheckSpecialTx for all the special txes of a block
+bool CheckSpecialTxsInBlock(const CBlock& block, const CBlockIndex* pindex, CValidationState& state, std::vector<CBlockCheck>* pvChecks = nullptr);
+
 // Update internal tiertwo data when blocks containing special txes get connected/disconnected
-bool ProcessSpecialTxsInBlock(const CBlock& block, const CBlockIndex* pindex, CValidationState& state, bool fJustCheck);
+// (fCheckTxs=false when the special txes were already checked with CheckSpecialTxsInBlock)
+bool ProcessSpecialTxsInBlock(const CBlock& block, const CBlockIndex* pindex, CValidationState& state, bool fJustCheck, bool fCheckTxs = true);
 bool UndoSpecialTxsInBlock(const CBlock& block, const CBlockIndex* pindex);
 
 template <typename T>
@@ -9,6 +9,7 @@
 #include "chainparams.h"
 #include "crypto/hmac_sha256.h"
 #include "httpserver.h"
+#include "rpc/jsonstream.h"
 #include "rpc/protocol.h"
 #include "rpc/server.h"
 #include "random.h"
@@ -166,6 +167,16 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         return false;
     }
 
+    // The calls with large results write them into the stream, sent as they are produced
+    bool fReplyStarted = false;
+    JSONStreamWriter stream([req, &fReplyStarted](const std::string& strData, bool fLast) {
+        if (!fReplyStarted) {
+            req->WriteHeader("Content-Type", "application/json");
+            fReplyStarted = true;
+        }
+        return req->WriteReplyPart(HTTP_OK, strData, fLast);
+    }, HTTP_REPLY_CHUNK_SIZE);
+
     try {
         // Parse request
         UniValue valRequest;
@@ -180,7 +191,18 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         if (valRequest.isObject()) {
             jreq.parse(valRequest);
 
+            stream.BeginObject();
+            stream.Key("result");
+            jreq.stream = &stream;
             UniValue result = tableRPC.execute(jreq);
+            if (!stream.IsAfterKey()) {
+                // The result was written into the stream
+                stream.PushKV("error", NullUniValue);
+                stream.PushKV("id", jreq.id);
+                stream.EndObject();
+                stream.Finish();
+                return true;
+            }
 
             // Send reply
             strReply = JSONRPCReply(result, NullUniValue, jreq.id);
@@ -194,9 +216,18 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         req->WriteHeader("Content-Type", "application/json");
         req->WriteReply(HTTP_OK, strReply);
     } catch (const UniValue& objError) {
+        if (fReplyStarted) {
+            // Too late for an error reply, the client sees the result cut short
+            LogPrintf("%s: error while sending the result of %s: %s\n", __func__, jreq.strMethod, objError.write());
+            return false;
+        }
         JSONErrorReply(req, objError, jreq.id);
         return false;
     } catch (const std::exception& e) {
+        if (fReplyStarted) {
+            LogPrintf("%s: error while sending the result of %s: %s\n", __func__, jreq.strMethod, e.what());
+            return false;
+        }
         JSONErrorReply(req, JSONRPCError(RPC_PARSE_ERROR, e.what()), jreq.id);
         return false;
     }
@@ -20,6 +20,8 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <signal.h>
+#include <chrono>
+#include <condition_variable>
 #include <future>
 
 #include <event2/event.h>
@@ -40,6 +42,9 @@
 /** Maximum size of http request (request line + headers) */
 static const size_t MAX_HEADERS_SIZE = 8192;
 
+/** Maximum size of a chunked reply waiting to be sent, before its writer blocks */
+static const size_t MAX_REPLY_BUFFERED = 4 * HTTP_REPLY_CHUNK_SIZE;
+
 /** HTTP request work item */
 class HTTPWorkItem : public HTTPClosure
 {
@@ -150,6 +155,8 @@ struct HTTPPathHandler
 
 //! libevent event loop
 static struct event_base* eventBase = 0;
+//! Seconds without progress after which a chunked reply is given up
+static int64_t httpServerTimeout = DEFAULT_HTTP_SERVER_TIMEOUT;
 //! HTTP server
 struct evhttp* eventHTTP = 0;
 //! List of subnets to allow RPC connections from
@@ -399,7 +406,8 @@ bool InitHTTPServer()
         return false;
     }
 
-    evhttp_set_timeout(http, gArgs.GetArg("-rpcservertimeout", DEFAULT_HTTP_SERVER_TIMEOUT));
+    httpServerTimeout = gArgs.GetArg("-rpcservertimeout", DEFAULT_HTTP_SERVER_TIMEOUT);
+    evhttp_set_timeout(http, httpServerTimeout);
     evhttp_set_max_headers_size(http, MAX_HEADERS_SIZE);
     evhttp_set_max_body_size(http, MAX_SIZE);
     evhttp_set_gencb(http, http_request_cb, NULL);
@@ -542,7 +550,10 @@ HTTPRequest::HTTPRequest(struct evhttp_request* req) : req(req),
 }
 HTTPRequest::~HTTPRequest()
 {
-    if (!replySent) {
+    if (chunkedReply) {
+        // Cut short
+        AbortChunkedReply();
+    } else if (!replySent) {
         // Keep track of whether reply was sent to avoid request leaks
         LogPrintf("%s: Unhandled request\n", __func__);
         WriteReply(HTTP_INTERNAL, "Unhandled request");
@@ -588,6 +599,20 @@ void HTTPRequest::WriteHeader(const std::string& hdr, const std::string& value)
     evhttp_add_header(headers, hdr.c_str(), value.c_str());
 }
 
+/** Re-enable reading from the socket. This is the second part of the libevent workaround above. */
+static void EnableReading(struct evhttp_request* req)
+{
+    if (event_get_version_number() >= 0x02010600 && event_get_version_number() < 0x02020001) {
+        evhttp_connection* conn = evhttp_request_get_connection(req);
+        if (conn) {
+            bufferevent* bev = evhttp_connection_get_bufferevent(conn);
+            if (bev) {
+                bufferevent_enable(bev, EV_READ | EV_WRITE);
+            }
+        }
+    }
+}
+
 /** Closure sent to main thread to request a reply to be sent to
  * a HTTP request.
  * Replies must be sent in the main loop in the main http thread,
@@ -603,23 +628,191 @@ void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
     auto req_copy = req;
     HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, nStatus]{
         evhttp_send_reply(req_copy, nStatus, nullptr, nullptr);
-        // Re-enable reading from the socket. This is the second part of the libevent
-        // workaround above.
-        if (event_get_version_number() >= 0x02010600 && event_get_version_number() < 0x02020001) {
-            evhttp_connection* conn = evhttp_request_get_connection(req_copy);
-            if (conn) {
-                bufferevent* bev = evhttp_connection_get_bufferevent(conn);
-                if (bev) {
-                    bufferevent_enable(bev, EV_READ | EV_WRITE);
-                }
+        EnableReading(req_copy);
+    });
+    ev->trigger(nullptr);
+    replySent = true;
+    req = 0; // transferred back to main thread
+}
+
+/** The state of a chunked reply, shared by the worker writing it and the events sending it */
+struct HTTPRequest::HTTPChunkedReply
+{
+    Mutex cs;
+    std::condition_variable cond;
+    //! Bytes handed to the main http thread and not sent to the connection yet
+    size_t nQueued GUARDED_BY(cs){0};
+    //! Bytes in the output buffer of the connection, as of the last event
+    size_t nBuffered GUARDED_BY(cs){0};
+    //! The connection was closed: the request is gone. Only set by the main http thread.
+    bool fClosed GUARDED_BY(cs){false};
+};
+
+/**
+ * Connection close callback of the chunked replies. Set until the reply is ended, so the
+ * reply is still referenced by the event ending it.
+ */
+static void http_chunked_reply_close_cb(struct evhttp_connection* conn, void* arg)
+{
+    HTTPRequest::HTTPChunkedReply* reply = static_cast<HTTPRequest::HTTPChunkedReply*>(arg);
+    {
+        LOCK(reply->cs);
+        reply->fClosed = true;
+    }
+    reply->cond.notify_all();
+}
+
+static size_t GetOutputBufferLength(struct evhttp_request* req)
+{
+    evhttp_connection* conn = evhttp_request_get_connection(req);
+    bufferevent* bev = conn ? evhttp_connection_get_bufferevent(conn) : nullptr;
+    return bev ? evbuffer_get_length(bufferevent_get_output(bev)) : 0;
+}
+
+void HTTPRequest::StartChunkedReply(int nStatus)
+{
+    assert(!replySent && req && !chunkedReply);
+    chunkedReply = std::make_shared<HTTPChunkedReply>();
+    auto req_copy = req;
+    auto reply = chunkedReply;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, reply, nStatus]{
+        evhttp_send_reply_start(req_copy, nStatus, nullptr);
+        evhttp_connection* conn = evhttp_request_get_connection(req_copy);
+        if (conn) {
+            evhttp_connection_set_closecb(conn, http_chunked_reply_close_cb, reply.get());
+        }
+    });
+    ev->trigger(nullptr);
+}
+
+bool HTTPRequest::WriteReplyChunk(const std::string& strChunk)
+{
+    assert(!replySent && req && chunkedReply);
+    auto req_copy = req;
+    auto reply = chunkedReply;
+    {
+        WAIT_LOCK(reply->cs, lock);
+        int64_t nLastProgress = GetTime();
+        size_t nPending = reply->nQueued + reply->nBuffered;
+        while (!reply->fClosed && reply->nQueued + reply->nBuffered > MAX_REPLY_BUFFERED) {
+            if (reply->cond.wait_for(lock, std::chrono::milliseconds(100)) == std::cv_status::timeout && reply->nQueued == 0) {
+                // Nothing tells when the connection sends its buffer: look again
+                HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, reply]{
+                    size_t nBuffered = 0;
+                    if (!WITH_LOCK(reply->cs, return reply->fClosed)) {
+                        nBuffered = GetOutputBufferLength(req_copy);
+                    }
+                    WITH_LOCK(reply->cs, reply->nBuffered = nBuffered);
+                    reply->cond.notify_all();
+                });
+                ev->trigger(nullptr);
+            }
+            if (reply->nQueued + reply->nBuffered < nPending) {
+                nLastProgress = GetTime();
+            } else if (GetTime() - nLastProgress > httpServerTimeout) {
+                LogPrint(BCLog::HTTP, "Giving up on a chunked reply, the client does not read it\n");
+                return false;
+            }
+            nPending = reply->nQueued + reply->nBuffered;
+        }
+        if (reply->fClosed) {
+            return false;
+        }
+        reply->nQueued += strChunk.size();
+    }
+
+    struct evbuffer* evb = evbuffer_new();
+    assert(evb);
+    evbuffer_add(evb, strChunk.data(), strChunk.size());
+    const size_t nSize = strChunk.size();
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, reply, evb, nSize]{
+        // The close callback runs in this thread: the request only goes away while sending
+        size_t nBuffered = 0;
+        if (!WITH_LOCK(reply->cs, return reply->fClosed)) {
+            evhttp_send_reply_chunk(req_copy, evb);
+            if (!WITH_LOCK(reply->cs, return reply->fClosed)) {
+                nBuffered = GetOutputBufferLength(req_copy);
             }
         }
+        evbuffer_free(evb);
+        {
+            LOCK(reply->cs);
+            reply->nQueued -= nSize;
+            reply->nBuffered = nBuffered;
+        }
+        reply->cond.notify_all();
+    });
+    ev->trigger(nullptr);
+    return true;
+}
+
+void HTTPRequest::EndChunkedReply()
+{
+    assert(!replySent && req && chunkedReply);
+    auto req_copy = req;
+    auto reply = chunkedReply;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, reply]{
+        if (WITH_LOCK(reply->cs, return reply->fClosed)) {
+            return;
+        }
+        evhttp_connection* conn = evhttp_request_get_connection(req_copy);
+        if (conn) {
+            // The connection may outlive the reply, serving other requests
+            evhttp_connection_set_closecb(conn, nullptr, nullptr);
+        }
+        evhttp_send_reply_end(req_copy);
+        EnableReading(req_copy);
     });
     ev->trigger(nullptr);
     replySent = true;
+    chunkedReply.reset();
     req = 0; // transferred back to main thread
 }
 
+void HTTPRequest::AbortChunkedReply()
+{
+    assert(!replySent && req && chunkedReply);
+    auto req_copy = req;
+    auto reply = chunkedReply;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, reply]{
+        {
+            LOCK(reply->cs);
+            if (reply->fClosed) {
+                return;
+            }
+            reply->fClosed = true;
+        }
+        reply->cond.notify_all();
+        // Close the connection without the last chunk: the client sees the body is incomplete.
+        // This frees the request as well.
+        evhttp_connection* conn = evhttp_request_get_connection(req_copy);
+        if (conn) {
+            evhttp_connection_set_closecb(conn, nullptr, nullptr);
+            evhttp_connection_free(conn);
+        }
+    });
+    ev->trigger(nullptr);
+    replySent = true;
+    chunkedReply.reset();
+    req = 0;
+}
+
+bool HTTPRequest::WriteReplyPart(int nStatus, const std::string& strPart, bool fLast)
+{
+    if (!chunkedReply) {
+        if (fLast) {
+            WriteReply(nStatus, strPart);
+            return true;
+        }
+        StartChunkedReply(nStatus);
+    }
+    const bool ret = strPart.empty() || WriteReplyChunk(strPart);
+    if (fLast) {
+        EndChunkedReply();
+    }
+    return ret;
+}
+
 CService HTTPRequest::GetPeer()
 {
     evhttp_connection* con = evhttp_request_get_connection(req);
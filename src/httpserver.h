@@ -8,10 +8,13 @@
 #include <string>
 #include <stdint.h>
 #include <functional>
+#include <memory>
 
 static const int DEFAULT_HTTP_THREADS=4;
 static const int DEFAULT_HTTP_WORKQUEUE=16;
 static const int DEFAULT_HTTP_SERVER_TIMEOUT=30;
+/** Size of the pieces of the chunked replies */
+static const size_t HTTP_REPLY_CHUNK_SIZE = 64 * 1024;
 
 struct evhttp_request;
 struct event_base;
@@ -56,9 +59,14 @@ struct event_base* EventBase();
  */
 class HTTPRequest
 {
+public:
+    struct HTTPChunkedReply;
+
 private:
     struct evhttp_request* req;
     bool replySent;
+    //! Set while a chunked reply is being sent
+    std::shared_ptr<HTTPChunkedReply> chunkedReply;
 
 public:
     HTTPRequest(struct evhttp_request* req);
@@ -114,6 +122,44 @@ public:
      * main thread, do not call any other HTTPRequest methods after calling this.
      */
     void WriteReply(int nStatus, const std::string& strReply = "");
+
+    /**
+     * Start a reply whose body is sent in pieces as it is produced (chunked transfer
+     * encoding), instead of WriteReply. Send the body with WriteReplyChunk, then call
+     * EndChunkedReply.
+     *
+     * @note As for WriteReply, write the headers before calling this.
+     */
+    void StartChunkedReply(int nStatus);
+
+    /**
+     * Send a piece of the body of a chunked reply. Blocks while too much of the reply is
+     * waiting to be sent, so a slow client does not make the reply pile up in memory.
+     * Returns false if the connection was closed, or did not make progress within the
+     * server timeout: the rest of the reply can be dropped.
+     */
+    bool WriteReplyChunk(const std::string& strChunk);
+
+    /**
+     * End a chunked reply. As for WriteReply, do not call any other HTTPRequest methods
+     * after calling this.
+     */
+    void EndChunkedReply();
+
+    /**
+     * Cut a chunked reply short: the connection is closed without ending the body, so the
+     * client can tell it is incomplete. This is done when the request is destroyed with
+     * its chunked reply not ended. As for WriteReply, do not call any other HTTPRequest
+     * methods after calling this.
+     */
+    void AbortChunkedReply();
+
+    /**
+     * Send a reply made of parts produced one after the other, fLast set on the last one.
+     * A reply of a single part is sent with WriteReply, otherwise it is chunked. Returns
+     * false when the rest of the reply can be dropped (see WriteReplyChunk).
+     */
+    bool WriteReplyPart(int nStatus, const std::string& strPart, bool fLast);
 };
 
 /** Event handler closure.
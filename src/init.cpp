@@ -17,11 +17,13 @@
 #include "activemasternode.h"
 #include "addrman.h"
 #include "amount.h"
+#include "blockreadcache.h"
 #include "budget/budgetdb.h"
 #include "budget/budgetmanager.h"
 #include "checkpoints.h"
 #include "compat/sanity.h"
 #include "consensus/upgrades.h"
+#include "crypto/sha256.h"
 #include "evo/evonotificationinterface.h"
 #include "fs.h"
 #include "httpserver.h"
@@ -46,6 +48,7 @@
 #include "sporkdb.h"
 #include "evo/deterministicmns.h"
 #include "evo/evodb.h"
+#include "txacceptqueue.h"
 #include "txdb.h"
 #include "torcontrol.h"
 #include "guiinterface.h"
@@ -231,7 +234,11 @@ void PrepareShutdown()
     // Because these depend on each-other, we make sure that neither can be
     // using the other before destroying them.
     if (peerLogic) UnregisterValidationInterface(peerLogic.get());
+    // Its callbacks use the connection manager: stop its threads first. The message handler
+    // can still push to it until the connection manager stops, which the stopped queue refuses.
+    if (g_txacceptqueue) g_txacceptqueue->Stop();
     if (g_connman) g_connman->Stop();
+    g_txacceptqueue.reset();
 
     StopTorControl();
 
@@ -288,6 +295,8 @@ void PrepareShutdown()
         }
         delete pcoinsTip;
         pcoinsTip = NULL;
+        delete pcoinsAsyncFlush;
+        pcoinsAsyncFlush = nullptr;
         delete pcoinscatcher;
         pcoinscatcher = NULL;
         delete pcoinsdbview;
@@ -435,6 +444,8 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-?", _("This help message"));
     strUsage += HelpMessageOpt("-version", _("Print version and exit"));
     strUsage += HelpMessageOpt("-alertnotify=<cmd>", _("Execute command when a relevant alert is received or we see a really long fork (%s in cmd is replaced by message)"));
+    strUsage += HelpMessageOpt("-blockcompression", strprintf(_("Store new blocks compressed in the block files. Blocks already stored are not converted and remain readable either way (default: %u)"), DEFAULT_BLOCK_COMPRESSION));
+    strUsage += HelpMessageOpt("-blockreadcache=<n>", strprintf(_("Set the memory budget of the cache of recently read blocks in megabytes, 0 disables the cache and the memory mapping of block files (default: %u)"), DEFAULT_BLOCK_READ_CACHE));
     strUsage += HelpMessageOpt("-blocksdir=<dir>", _("Specify directory to hold blocks subdirectory for *.dat files (default: <datadir>)"));
     strUsage += HelpMessageOpt("-blocknotify=<cmd>", _("Execute command when the best block changes (%s in cmd is replaced by block hash)"));
     strUsage += HelpMessageOpt("-checkblocks=<n>", strprintf(_("How many blocks to check at startup (default: %u, 0 = all)"), DEFAULT_CHECKBLOCKS));
@@ -446,7 +457,13 @@ std::string HelpMessage(HelpMessageMode mode)
     }
     strUsage += HelpMessageOpt("-datadir=<dir>", _("Specify data directory"));
     if (showDebug) {
+        strUsage += HelpMessageOpt("-asyncflush", strprintf("Write the coins cache to disk in a background thread, so that block validation is not stalled by flushes (memory usage can reach twice -dbcache while writing) (default: %u)", DEFAULT_ASYNC_FLUSH));
         strUsage += HelpMessageOpt("-dbbatchsize", strprintf("Maximum database write batch size in bytes (default: %u)", nDefaultDbBatchSize));
+        strUsage += HelpMessageOpt("-dbprofile=<db>:<setting>=<value>", "Tune the LevelDB options of a database (blockindex, chainstate, evodb, sporks or zerocoin). "
+            "Settings: blockcache (percent of the database cache used by the block cache, the rest by the write buffers, default: 50), "
+            "writebuffer (write buffer size in megabytes, overriding its share of the cache), compression (0 or 1, default: 0), "
+            "verifychecksums (verify the checksums of the data read, 0 or 1, default: 1), maxfilesize (table file size in megabytes, default: 2), "
+            "bloombits (bloom filter bits per key, 0 to disable, default: 10). Can be specified multiple times");
     }
     strUsage += HelpMessageOpt("-paramsdir=<dir>", strprintf(_("Specify zk params directory (default: %s)"), ZC_GetParamsDir().string()));
     strUsage += HelpMessageOpt("-debuglogfile=<file>", strprintf(_("Specify location of debug log file: this can be an absolute path or a path relative to the data directory (default: %s)"), DEFAULT_DEBUGLOGFILE));
@@ -463,10 +480,13 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-pid=<file>", strprintf(_("Specify pid file (default: %s)"), quirkyturt_PID_FILENAME));
 #endif
     strUsage += HelpMessageOpt("-reindex", _("Rebuild block chain index from current blk000??.dat files") + " " + _("on startup"));
+    strUsage += HelpMessageOpt("-reindexthreads=<n>", strprintf(_("Number of threads scanning the blk000??.dat files concurrently during -reindex (0 to %d, 0 = scan them serially, default: %d)"), MAX_REINDEX_THREADS, DEFAULT_REINDEX_THREADS));
     strUsage += HelpMessageOpt("-resync", _("Delete blockchain folders and resync from scratch") + " " + _("on startup"));
 #if !defined(WIN32)
     strUsage += HelpMessageOpt("-sysperms", _("Create new files with system default permissions, instead of umask 077 (only effective with disabled wallet functionality)"));
 #endif
+    strUsage += HelpMessageOpt("-txacceptqueuesize=<n>", strprintf(_("Keep at most <n> relayed transactions waiting to be checked, the next ones are checked on arrival (default: %u)"), DEFAULT_TXACCEPT_QUEUE_SIZE));
+    strUsage += HelpMessageOpt("-txacceptthreads=<n>", strprintf(_("Set the number of threads checking the relayed transactions before they enter the mempool (0 to %d, 0 = check them on arrival, default: %d)"), MAX_TXACCEPT_THREADS, DEFAULT_TXACCEPT_THREADS));
     strUsage += HelpMessageOpt("-txindex", strprintf(_("Maintain a full transaction index, used by the getrawtransaction rpc call (default: %u)"), DEFAULT_TXINDEX));
     strUsage += HelpMessageOpt("-forcestart", _("Attempt to force blockchain corruption recovery") + " " + _("on startup"));
 
@@ -516,6 +536,9 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-zmqpubhashtx=<address>", _("Enable publish hash transaction in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawblock=<address>", _("Enable publish raw block in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawtx=<address>", _("Enable publish raw transaction in <address>"));
+    if (showDebug) {
+        strUsage += HelpMessageOpt("-zmqqueuesize=<n>", strprintf("Maximum number of notifications waiting to be published, the newer ones are dropped past it (default: %u)", DEFAULT_ZMQ_QUEUE_SIZE));
+    }
 #endif
 
     strUsage += HelpMessageGroup(_("Debugging/Testing options:"));
@@ -551,7 +574,7 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-mocktime=<n>", "Replace actual time with <n> seconds since epoch (default: 0)");
         strUsage += HelpMessageOpt("-limitfreerelay=<n>", strprintf(_("Continuously rate-limit free transactions to <n>*1000 bytes per minute (default:%u)"), DEFAULT_LIMITFREERELAY));
         strUsage += HelpMessageOpt("-relaypriority", strprintf(_("Require high priority for relaying free or low-fee transactions (default:%u)"), DEFAULT_RELAYPRIORITY));
-        strUsage += HelpMessageOpt("-maxsigcachesize=<n>", strprintf(_("Limit size of signature cache to <n> MiB (default: %u)"), DEFAULT_MAX_SIG_CACHE_SIZE));
+        strUsage += HelpMessageOpt("-maxsigcachesize=<n>", strprintf(_("Limit sum of signature cache and script execution cache sizes to <n> MiB (default: %u)"), DEFAULT_MAX_SIG_CACHE_SIZE));
     }
     strUsage += HelpMessageOpt("-maxtipage=<n>", strprintf("Maximum tip age in seconds to consider node in initial block download (default: %u)", DEFAULT_MAX_TIP_AGE));
     strUsage += HelpMessageOpt("-minrelaytxfee=<amt>", strprintf(_("Fees (in %s/Kb) smaller than this are considered zero fee for relaying, mining and transaction creation (default: %s)"), CURRENCY_UNIT, FormatMoney(::minRelayTxFee.GetFeePerK())));
@@ -601,6 +624,8 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-rpcport=<port>", strprintf(_("Listen for JSON-RPC connections on <port> (default: %u or testnet: %u)"), defaultBaseParams->RPCPort(), testnetBaseParams->RPCPort()));
     strUsage += HelpMessageOpt("-rpcallowip=<ip>", _("Allow JSON-RPC connections from specified source. Valid for <ip> are a single IP (e.g. 1.2.3.4), a network/netmask (e.g. 1.2.3.4/255.255.255.0) or a network/CIDR (e.g. 1.2.3.4/24). This option can be specified multiple times"));
     strUsage += HelpMessageOpt("-rpcthreads=<n>", strprintf(_("Set the number of threads to service RPC calls (default: %d)"), DEFAULT_HTTP_THREADS));
+    strUsage += HelpMessageOpt("-rpcbatchconcurrency=<n>", strprintf(_("Run at most <n> of the read only calls of a JSON-RPC batch at once (default: %d)"), DEFAULT_RPC_BATCH_CONCURRENCY));
+    strUsage += HelpMessageOpt("-rpcbatchthreads=<n>", strprintf(_("Set the number of threads running the read only calls of the JSON-RPC batches, next to the thread servicing the batch (0 = one after the other, default: %d)"), DEFAULT_RPC_BATCH_THREADS));
     if (showDebug) {
         strUsage += HelpMessageOpt("-rpcworkqueue=<n>", strprintf("Set the depth of the work queue to service RPC calls (default: %d)", DEFAULT_HTTP_WORKQUEUE));
         strUsage += HelpMessageOpt("-rpcservertimeout=<n>", strprintf("Timeout during HTTP requests (default: %d)", DEFAULT_HTTP_SERVER_TIMEOUT));
@@ -686,17 +711,28 @@ void ThreadImport(const std::vector<fs::path>& vImportFiles)
     // -reindex
     if (fReindex) {
         CImportingNow imp;
-        int nFile = 0;
-        while (true) {
-            CDiskBlockPos pos(nFile, 0);
-            if (!fs::exists(GetBlockPosFilename(pos, "blk")))
-                break; // No block files left to reindex
-            FILE* file = OpenBlockFile(pos, true);
-            if (!file)
-                break; // This error is logged in OpenBlockFile
-            LogPrintf("Reindexing block file blk%05u.dat...\n", (unsigned int)nFile);
-            LoadExternalBlockFile(file, &pos);
-            nFile++;
+        const int nReindexThreads = gArgs.GetArg("-reindexthreads", DEFAULT_REINDEX_THREADS);
+        bool fReindexed = true;
+        if (nReindexThreads > 0) {
+            fReindexed = ReindexBlockFiles(nReindexThreads);
+        } else {
+            int nFile = 0;
+            while (true) {
+                CDiskBlockPos pos(nFile, 0);
+                if (!fs::exists(GetBlockPosFilename(pos, "blk")))
+                    break; // No block files left to reindex
+                FILE* file = OpenBlockFile(pos, true);
+                if (!file)
+                    break; // This error is logged in OpenBlockFile
+                LogPrintf("Reindexing block file blk%05u.dat...\n", (unsigned int)nFile);
+                LoadExternalBlockFile(file, &pos);
+                nFile++;
+            }
+        }
+        if (!fReindexed || ShutdownRequested()) {
+            // The reindex flag stays set, so it starts over on the next start
+            LogPrintf("Reindexing interrupted\n");
+            return;
         }
         pblocktree->WriteReindexing(false);
         fReindex = false;
@@ -1106,6 +1142,10 @@ bool AppInitParameterInteraction()
         mempool.setSanityCheck(1.0 / ratio);
     }
     fCheckBlockIndex = gArgs.GetBoolArg("-checkblockindex", Params().DefaultConsistencyChecks());
+    fBlockCompression = gArgs.GetBoolArg("-blockcompression", DEFAULT_BLOCK_COMPRESSION);
+    std::string strDBProfileError;
+    if (!CheckDBProfiles(gArgs.GetArgs("-dbprofile"), strDBProfileError))
+        return UIError(strDBProfileError);
     Checkpoints::fEnabled = gArgs.GetBoolArg("-checkpoints", DEFAULT_CHECKPOINTS_ENABLED);
 
     // -mempoollimit limits
@@ -1216,6 +1256,9 @@ bool AppInitSanityChecks()
 {
     // ********************************************************* Step 4: sanity checks
 
+    std::string sha256_algo = SHA256AutoDetect();
+    LogPrintf("Using the '%s' SHA256 implementation\n", sha256_algo);
+
     // Initialize elliptic curve code
     RandomInit();
     ECC_Start();
@@ -1261,11 +1304,14 @@ bool AppInitMain()
     std::ostringstream strErrors;
 
     InitSignatureCache();
+    InitScriptExecutionCache();
 
     LogPrintf("Using %u threads for script verification\n", nScriptCheckThreads);
     if (nScriptCheckThreads) {
         for (int i = 0; i < nScriptCheckThreads - 1; i++)
             threadGroup.create_thread(&ThreadScriptCheck);
+        for (int i = 0; i < nScriptCheckThreads - 1; i++)
+            threadGroup.create_thread(&ThreadCoinsPrefetch);
     }
 
     if (gArgs.IsArgSet("-sporkkey")) // spork priv key
@@ -1520,6 +1566,9 @@ bool AppInitMain()
     LogPrintf("* Using %.1fMiB for block index database\n", nBlockTreeDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for chain state database\n", nCoinDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for in-memory UTXO set\n", nCoinCacheUsage * (1.0 / 1024 / 1024));
+    const int64_t nBlockReadCache = std::max<int64_t>(0, gArgs.GetArg("-blockreadcache", DEFAULT_BLOCK_READ_CACHE)) << 20;
+    blockReadCache.SetMaxMemory(nBlockReadCache);
+    LogPrintf("* Using %.1fMiB for recently read blocks\n", nBlockReadCache * (1.0 / 1024 / 1024));
 
     const CChainParams& chainparams = Params();
     const Consensus::Params& consensus = chainparams.GetConsensus();
@@ -1535,6 +1584,7 @@ bool AppInitMain()
             try {
                 UnloadBlockIndex();
                 delete pcoinsTip;
+                delete pcoinsAsyncFlush;
                 delete pcoinsdbview;
                 delete pcoinscatcher;
                 delete pblocktree;
@@ -1616,7 +1666,8 @@ bool AppInitMain()
                 }
 
                 // The on-disk coinsdb is now in a good state, create the cache
-                pcoinsTip = new CCoinsViewCache(pcoinscatcher);
+                pcoinsAsyncFlush = new CCoinsViewAsyncFlush(pcoinscatcher, pcoinsdbview, gArgs.GetBoolArg("-asyncflush", DEFAULT_ASYNC_FLUSH));
+                pcoinsTip = new CCoinsViewCache(pcoinsAsyncFlush);
 
                 // !TODO: after enabling reindex-chainstate
                 // if (!fReindex && !fReindexChainState) {
@@ -1950,6 +2001,14 @@ bool AppInitMain()
     connOptions.nSendBufferMaxSize = 1000*gArgs.GetArg("-maxsendbuffer", DEFAULT_MAXSENDBUFFER);
     connOptions.nReceiveFloodSize = 1000*gArgs.GetArg("-maxreceivebuffer", DEFAULT_MAXRECEIVEBUFFER);
 
+    // Checks the relayed transactions, needed by the message handler
+    int nTxAcceptThreads = std::max(0, std::min((int)gArgs.GetArg("-txacceptthreads", DEFAULT_TXACCEPT_THREADS), MAX_TXACCEPT_THREADS));
+    if (nTxAcceptThreads > 0) {
+        size_t nTxAcceptQueueSize = std::max((int64_t)1, gArgs.GetArg("-txacceptqueuesize", DEFAULT_TXACCEPT_QUEUE_SIZE));
+        g_txacceptqueue = MakeUnique<CTxAcceptQueue>(::mempool, nTxAcceptThreads, nTxAcceptQueueSize);
+        LogPrintf("Using %d threads to check the relayed transactions\n", nTxAcceptThreads);
+    }
+
     if (!connman.Start(scheduler, strNodeError, connOptions))
         return UIError(strNodeError);
 
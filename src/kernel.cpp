@@ -11,6 +11,8 @@
 #include "legacy/stakemodifier.h"
 #include "policy/policy.h"
 #include "script/interpreter.h"
+#include "script/standard.h"
+#include "sigbatch.h"
 #include "stakeinput.h"
 #include "util.h"
 #include "utilmoneystr.h"
@@ -137,9 +139,11 @@ bool Stake(const CBlockIndex* pindexPrev, CStakeInput* stakeInput, unsigned int
  * @param[out]  strError        string error (if any, else empty)
  * @param[in]   pindexPrev      index of the parent block
  *                              (if nullptr, it will be searched in mapBlockIndex)
+ * @param[in]   pbatch          if set, the coinstake input signature may be added to it
+ *                              instead of being verified (see CheckStakeInputSignature)
  * @return      bool            true if the block has a valid proof of stake
  */
-bool CheckProofOfStake(const CBlock& block, std::string& strError, const CBlockIndex* pindexPrev)
+bool CheckProofOfStake(const CBlock& block, std::string& strError, const CBlockIndex* pindexPrev, CSignatureBatch* pbatch)
 {
     const int nHeight = pindexPrev->nHeight + 1;
     // Initialize stake input
@@ -171,11 +175,36 @@ bool CheckProofOfStake(const CBlock& block, std::string& strError, const CBlockI
         strError = "unable to get stake prevout for coinstake";
         return false;
     }
-    const auto& tx = block.vtx[1];
-    const CTxIn& txin = tx->vin[0];
+    return CheckStakeInputSignature(*block.vtx[1], stakePrevout, strError, pbatch);
+}
+
+/*
+ * CheckStakeInputSignature    Check the signature of the input of a coinstake
+ *
+ * @param[in]   tx              the coinstake transaction
+ * @param[in]   stakePrevout    the output spent by its first input
+ * @param[out]  strError        string error (if any, else empty)
+ * @param[in]   pbatch          if set, and the signature can't change the flow of the script,
+ *                              it is added to it instead of being verified
+ * @return      bool            true if the input signature is valid
+ */
+bool CheckStakeInputSignature(const CTransaction& tx, const CTxOut& stakePrevout, std::string& strError, CSignatureBatch* pbatch)
+{
+    const CTxIn& txin = tx.vin[0];
+    // The signature can only be left to the batch if the script fails without a valid one:
+    // a scriptSig with opcodes could act on the result of a CHECKSIG that the batch forces to true
+    bool fBatch = false;
+    if (pbatch && txin.scriptSig.IsPushOnly()) {
+        txnouttype whichType;
+        std::vector<std::vector<unsigned char>> vSolutions;
+        fBatch = Solver(stakePrevout.scriptPubKey, whichType, vSolutions) &&
+                 (whichType == TX_PUBKEY || whichType == TX_PUBKEYHASH || whichType == TX_COLDSTAKE);
+    }
     ScriptError serror;
     if (!VerifyScript(txin.scriptSig, stakePrevout.scriptPubKey, STANDARD_SCRIPT_VERIFY_FLAGS,
-             TransactionSignatureChecker(tx.get(), 0, stakePrevout.nValue), tx->GetRequiredSigVersion(), &serror)) {
+             fBatch ? static_cast<const BaseSignatureChecker&>(BatchingTransactionSignatureChecker(&tx, 0, stakePrevout.nValue, *pbatch)) :
+                      static_cast<const BaseSignatureChecker&>(TransactionSignatureChecker(&tx, 0, stakePrevout.nValue)),
+             tx.GetRequiredSigVersion(), &serror)) {
         strError = strprintf("signature fails: %s", serror ? ScriptErrorString(serror) : "");
         return false;
     }
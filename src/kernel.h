@@ -10,6 +10,8 @@
 
 #include "stakeinput.h"
 
+class CSignatureBatch;
+
 class CStakeKernel {
 public:
     /**
@@ -59,9 +61,24 @@ bool Stake(const CBlockIndex* pindexPrev, CStakeInput* stakeInput, unsigned int
  * @param[out]  strError        string returning error message (if any, else empty)
  * @param[in]   pindexPrev      index of the parent block
  *                              (if nullptr, it will be searched in mapBlockIndex)
+ * @param[in]   pbatch          if set, the coinstake input signature may be added to it
+ *                              instead of being verified (see CheckStakeInputSignature)
  * @return      bool            true if the block has a valid proof of stake
  */
-bool CheckProofOfStake(const CBlock& block, std::string& strError, const CBlockIndex* pindexPrev = nullptr);
+bool CheckProofOfStake(const CBlock& block, std::string& strError, const CBlockIndex* pindexPrev = nullptr, CSignatureBatch* pbatch = nullptr);
+
+/*
+ * CheckStakeInputSignature    Check the signature of the input of a coinstake
+ *
+ * @param[in]   tx              the coinstake transaction
+ * @param[in]   stakePrevout    the output spent by its first input
+ * @param[out]  strError        string returning error message (if any, else empty)
+ * @param[in]   pbatch          if set, the signature of a push only input spending a standard
+ *                              output is added to it instead of being verified: the signature
+ *                              is only valid if the batch verifies
+ * @return      bool            true if the input signature is valid
+ */
+bool CheckStakeInputSignature(const CTransaction& tx, const CTxOut& stakePrevout, std::string& strError, CSignatureBatch* pbatch = nullptr);
 
 /*
  * GetStakeKernelHash   Return stake kernel of a block
@@ -52,11 +52,11 @@ void DataBaseAccChecksum(const CBlockIndex* pindex, bool fWrite)
     if (!pindex ||
         !consensus.NetworkUpgradeActive(pindex->nHeight, Consensus::UPGRADE_ZC_V2) ||
         pindex->nHeight > consensus.height_last_ZC_AccumCheckpoint ||
-        pindex->nAccumulatorCheckpoint == pindex->pprev->nAccumulatorCheckpoint)
+        pindex->GetAccumulatorCheckpoint() == pindex->pprev->GetAccumulatorCheckpoint())
         return;
 
-    arith_uint256 accCurr = UintToArith256(pindex->nAccumulatorCheckpoint);
-    arith_uint256 accPrev = UintToArith256(pindex->pprev->nAccumulatorCheckpoint);
+    arith_uint256 accCurr = UintToArith256(pindex->GetAccumulatorCheckpoint());
+    arith_uint256 accPrev = UintToArith256(pindex->pprev->GetAccumulatorCheckpoint());
     // add/remove changed checksums to/from DB
     for (int i = (int)libzerocoin::zerocoinDenomList.size()-1; i >= 0; i--) {
         const uint32_t& nChecksum = accCurr.Get32();
@@ -13,8 +13,33 @@
 #include "utilstrencodings.h"
 #include "util.h"
 
+#include <atomic>
+
+static std::atomic<uint64_t> nBlockHeaderHashCount{0};
+
+uint64_t GetBlockHeaderHashCount()
+{
+    return nBlockHeaderHashCount.load(std::memory_order_relaxed);
+}
+
 uint256 CBlockHeader::GetHash() const
 {
+    return fHashCached ? hashCached : ComputeHash();
+}
+
+const uint256& CBlockHeader::CacheHash()
+{
+    if (!fHashCached) {
+        hashCached = ComputeHash();
+        fHashCached = true;
+    }
+    return hashCached;
+}
+
+uint256 CBlockHeader::ComputeHash() const
+{
+    nBlockHeaderHashCount.fetch_add(1, std::memory_order_relaxed);
+
     if (nVersion < 4)  {
 #if defined(WORDS_BIGENDIAN)
         uint8_t data[80];
@@ -42,6 +42,8 @@ public:
 
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action) {
+        if (ser_action.ForRead())
+            fHashCached = false;
         READWRITE(nVersion);
         READWRITE(hashPrevBlock);
         READWRITE(hashMerkleRoot);
@@ -68,6 +70,7 @@ public:
         nNonce = 0;
         nAccumulatorCheckpoint.SetNull();
         hashFinalSaplingRoot.SetNull();
+        fHashCached = false;
     }
 
     bool IsNull() const
@@ -75,14 +78,34 @@ public:
         return (nBits == 0);
     }
 
+    /** Returns the block hash: the one memoized by CacheHash() if any, else it is computed */
     uint256 GetHash() const;
 
+    /**
+     * Compute and memoize the block hash. The header fields are public: only call it once they
+     * are final and before the header is shared with other threads (e.g. right after a block
+     * is read from disk or from the network), and call InvalidateHash() if they change later.
+     */
+    const uint256& CacheHash();
+    void InvalidateHash() { fHashCached = false; }
+
     int64_t GetBlockTime() const
     {
         return (int64_t)nTime;
     }
+
+private:
+    //! Hash the header fields (HashQuark for version < 4, double-SHA256 otherwise)
+    uint256 ComputeHash() const;
+
+    // memory only
+    uint256 hashCached;
+    bool fHashCached{false};
 };
 
+/** Number of block header hashes actually computed (not memoized by CBlockHeader::CacheHash) since startup */
+uint64_t GetBlockHeaderHashCount();
+
 
 class CBlock : public CBlockHeader
 {
@@ -127,17 +150,12 @@ public:
 
     CBlockHeader GetBlockHeader() const
     {
-        CBlockHeader block;
-        block.nVersion       = nVersion;
-        block.hashPrevBlock  = hashPrevBlock;
-        block.hashMerkleRoot = hashMerkleRoot;
-        block.nTime          = nTime;
-        block.nBits          = nBits;
-        block.nNonce         = nNonce;
-        if(nVersion > 3 && nVersion < 7)
-            block.nAccumulatorCheckpoint = nAccumulatorCheckpoint;
-        if (nVersion >= 8)
-            block.hashFinalSaplingRoot   = hashFinalSaplingRoot;
+        // Copy (along with the memoized hash), then drop the fields unused by this version
+        CBlockHeader block(*this);
+        if (nVersion <= 3 || nVersion >= 7)
+            block.nAccumulatorCheckpoint.SetNull();
+        if (nVersion < 8)
+            block.hashFinalSaplingRoot.SetNull();
         return block;
     }
 
@@ -168,20 +168,7 @@ static int ecdsa_signature_parse_der_lax(const secp256k1_context* ctx, secp256k1
 
 bool CPubKey::Verify(const uint256& hash, const std::vector<unsigned char>& vchSig) const
 {
-    if (!IsValid())
-        return false;
-    secp256k1_pubkey pubkey;
-    secp256k1_ecdsa_signature sig;
-    if (!secp256k1_ec_pubkey_parse(secp256k1_context_verify, &pubkey, &(*this)[0], size())) {
-        return false;
-    }
-    if (!ecdsa_signature_parse_der_lax(secp256k1_context_verify, &sig, vchSig.data(), vchSig.size())) {
-        return false;
-    }
-    /* libsecp256k1's ECDSA verification requires lower-S signatures, which have
-     * not historically been enforced in Bitcoin, so normalize them first. */
-    secp256k1_ecdsa_signature_normalize(secp256k1_context_verify, &sig, &sig);
-    return secp256k1_ecdsa_verify(secp256k1_context_verify, &sig, hash.begin(), &pubkey);
+    return CParsedPubKey(*this).Verify(hash, vchSig);
 }
 
 bool CPubKey::RecoverCompact(const uint256& hash, const std::vector<unsigned char>& vchSig)
@@ -250,6 +237,28 @@ bool CPubKey::Derive(CPubKey& pubkeyChild, ChainCode &ccChild, unsigned int nChi
 return true;
 }
 
+static_assert(sizeof(secp256k1_pubkey) == 64, "CParsedPubKey::data must hold a secp256k1_pubkey");
+
+CParsedPubKey::CParsedPubKey(const CPubKey& pubkey) : fValid(false)
+{
+    secp256k1_pubkey* ppubkey = reinterpret_cast<secp256k1_pubkey*>(data);
+    fValid = pubkey.IsValid() && secp256k1_ec_pubkey_parse(secp256k1_context_verify, ppubkey, pubkey.begin(), pubkey.size());
+}
+
+bool CParsedPubKey::Verify(const uint256& hash, const std::vector<unsigned char>& vchSig) const
+{
+    if (!fValid)
+        return false;
+    secp256k1_ecdsa_signature sig;
+    if (!ecdsa_signature_parse_der_lax(secp256k1_context_verify, &sig, vchSig.data(), vchSig.size())) {
+        return false;
+    }
+    /* libsecp256k1's ECDSA verification requires lower-S signatures, which have
+     * not historically been enforced in Bitcoin, so normalize them first. */
+    secp256k1_ecdsa_signature_normalize(secp256k1_context_verify, &sig, &sig);
+    return secp256k1_ecdsa_verify(secp256k1_context_verify, &sig, hash.begin(), reinterpret_cast<const secp256k1_pubkey*>(data));
+}
+
 void CExtPubKey::Encode(unsigned char code[BIP32_EXTKEY_SIZE]) const
 {
     code[0] = nDepth;
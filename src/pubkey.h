@@ -207,6 +207,24 @@ public:
 
 };
 
+/** A public key parsed once, to verify several signatures by it. */
+class CParsedPubKey
+{
+private:
+    //! The parsed key (a secp256k1_pubkey)
+    unsigned char data[64];
+    bool fValid;
+
+public:
+    explicit CParsedPubKey(const CPubKey& pubkey);
+
+    //! Whether the key was fully valid
+    bool IsValid() const { return fValid; }
+
+    //! Verify a DER signature, like CPubKey::Verify.
+    bool Verify(const uint256& hash, const std::vector<unsigned char>& vchSig) const;
+};
+
 struct CExtPubKey {
     unsigned char nDepth;
     unsigned char vchFingerprint[4];
@@ -5,13 +5,16 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "chain.h"
+#include "clientversion.h"
 #include "core_io.h"
 #include "primitives/block.h"
 #include "primitives/transaction.h"
 #include "httpserver.h"
+#include "rpc/jsonstream.h"
 #include "rpc/server.h"
 #include "streams.h"
 #include "sync.h"
+#include "txdb.h"
 #include "txmempool.h"
 #include "utilstrencodings.h"
 #include "validation.h"
@@ -23,6 +26,7 @@
 
 
 static const size_t MAX_GETUTXOS_OUTPOINTS = 15; //allow a max of 15 outpoints to be queried at once
+static const int MAX_REST_BLOCKS_RANGE = 10000; //allow a max of 10000 blocks or undo records to be exported at once
 
 enum RetFormat {
     RF_UNDEF,
@@ -61,9 +65,9 @@ struct CCoin {
 };
 
 extern void TxToJSON(const CTransaction& tx, const uint256 hashBlock, UniValue& entry);
-extern UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false);
+extern void blockToJSON(RPCResultWriter& result, const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false);
 extern UniValue mempoolInfoToJSON();
-extern UniValue mempoolToJSON(bool fVerbose = false);
+extern void mempoolToJSON(RPCResultWriter& result, bool fVerbose = false);
 extern UniValue blockheaderToJSON(const CBlockIndex* blockindex);
 
 static bool RESTERR(HTTPRequest* req, enum HTTPStatusCode status, std::string message)
@@ -73,6 +77,109 @@ static bool RESTERR(HTTPRequest* req, enum HTTPStatusCode status, std::string me
     return false;
 }
 
+/**
+ * Reply with the JSON written by write, sent in chunks as it is produced. Returns false
+ * if the client went away before the end of it.
+ */
+static bool RESTJSONReply(HTTPRequest* req, const std::function<void(RPCResultWriter&)>& write)
+{
+    JSONStreamWriter stream([req, fStarted = false](const std::string& strData, bool fLast) mutable {
+        if (!fStarted) {
+            req->WriteHeader("Content-Type", "application/json");
+            fStarted = true;
+        }
+        return req->WriteReplyPart(HTTP_OK, strData, fLast);
+    }, HTTP_REPLY_CHUNK_SIZE);
+    RPCResultWriter result(&stream);
+    try {
+        write(result);
+        stream.Finish();
+    } catch (const JSONStreamWriter::Aborted&) {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * A binary reply, sent in chunks of HTTP_REPLY_CHUNK_SIZE as it is serialized, so large
+ * exports are never held in memory whole. Throws std::ios_base::failure once the client
+ * went away.
+ */
+class RESTBinaryReply
+{
+private:
+    HTTPRequest* req;
+    const int nType;
+    const int nVersion;
+    std::string strBuffer;
+    bool fStarted{false};
+
+    bool WritePart(bool fLast)
+    {
+        if (!fStarted) {
+            req->WriteHeader("Content-Type", "application/octet-stream");
+            fStarted = true;
+        }
+        return req->WriteReplyPart(HTTP_OK, strBuffer, fLast);
+    }
+
+public:
+    RESTBinaryReply(HTTPRequest* reqIn, int nTypeIn, int nVersionIn) : req(reqIn), nType(nTypeIn), nVersion(nVersionIn)
+    {
+        strBuffer.reserve(HTTP_REPLY_CHUNK_SIZE);
+    }
+
+    void write(const char* pch, size_t nSize)
+    {
+        while (nSize > 0) {
+            const size_t nTake = std::min(nSize, HTTP_REPLY_CHUNK_SIZE - strBuffer.size());
+            strBuffer.append(pch, nTake);
+            pch += nTake;
+            nSize -= nTake;
+            if (strBuffer.size() == HTTP_REPLY_CHUNK_SIZE) {
+                if (!WritePart(false))
+                    throw std::ios_base::failure("client went away");
+                strBuffer.clear();
+            }
+        }
+    }
+
+    /** Write a record: its size, then its data */
+    void WriteRecord(const std::vector<unsigned char>& vData)
+    {
+        *this << (uint32_t)vData.size();
+        write((const char*)vData.data(), vData.size());
+    }
+
+    void Finish()
+    {
+        WritePart(true);
+    }
+
+    /**
+     * Give up on the reply after an error: with an error status if nothing was sent yet,
+     * otherwise by closing the connection before the end of the body.
+     */
+    bool Abort(const std::string& strError)
+    {
+        if (!fStarted)
+            return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, strError);
+        LogPrintf("REST: %s, reply cut short\n", strError);
+        req->AbortChunkedReply();
+        return false;
+    }
+
+    int GetType() const { return nType; }
+    int GetVersion() const { return nVersion; }
+
+    template <typename T>
+    RESTBinaryReply& operator<<(const T& obj)
+    {
+        ::Serialize(*this, obj);
+        return *this;
+    }
+};
+
 static enum RetFormat ParseDataFormat(std::vector<std::string>& params, const std::string& strReq)
 {
     boost::split(params, strReq, boost::is_any_of("."));
@@ -231,11 +338,9 @@ static bool rest_block(HTTPRequest* req,
     }
 
     case RF_JSON: {
-        UniValue objBlock = blockToJSON(block, pblockindex, showTxDetails);
-        std::string strJSON = objBlock.write() + "\n";
-        req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
-        return true;
+        return RESTJSONReply(req, [&](RPCResultWriter& result) {
+            blockToJSON(result, block, pblockindex, showTxDetails);
+        });
     }
 
     default: {
@@ -257,6 +362,135 @@ static bool rest_block_notxdetails(HTTPRequest* req, const std::string& strURIPa
     return rest_block(req, strURIPart, false);
 }
 
+static bool rest_block_range(HTTPRequest* req, const std::string& strURIPart, bool fUndo)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::vector<std::string> params;
+    const RetFormat rf = ParseDataFormat(params, strURIPart);
+    std::vector<std::string> path;
+    boost::split(path, params[0], boost::is_any_of("/"));
+
+    const std::string strPrefix = fUndo ? "/rest/undo/" : "/rest/blocks/";
+    if (path.size() != 2)
+        return RESTERR(req, HTTP_BAD_REQUEST, "No range specified. Use " + strPrefix + "<from>/<count>.bin.");
+
+    int nFrom, nCount;
+    if (!ParseInt32(path[0], &nFrom) || nFrom < 0)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid height: " + path[0]);
+    if (!ParseInt32(path[1], &nCount) || nCount < 1 || nCount > MAX_REST_BLOCKS_RANGE)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Block count out of range: " + path[1]);
+
+    if (rf != RF_BINARY)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: bin)");
+
+    // The positions of the records are read under cs_main, the records without it.
+    // Each one comes with a hash: the undo records are checked against the one of the previous
+    // block (which their checksum covers), the block records only name theirs in the errors.
+    std::vector<std::pair<CDiskBlockPos, uint256> > vRecords;
+    {
+        LOCK(cs_main);
+        if (nFrom > chainActive.Height())
+            return RESTERR(req, HTTP_NOT_FOUND, "Block height out of range: " + path[0]);
+        const int nTo = std::min(chainActive.Height(), nFrom + nCount - 1);
+        vRecords.reserve(nTo - nFrom + 1);
+        for (int nHeight = nFrom; nHeight <= nTo; nHeight++) {
+            const CBlockIndex* pindex = chainActive[nHeight];
+            if (fUndo && !pindex->pprev) {
+                // The genesis block spends nothing: an empty record
+                vRecords.emplace_back(CDiskBlockPos(), UINT256_ZERO);
+                continue;
+            }
+            if (!(pindex->nStatus & (fUndo ? BLOCK_HAVE_UNDO : BLOCK_HAVE_DATA)))
+                return RESTERR(req, HTTP_NOT_FOUND, strprintf("Block %d not available (pruned data)", nHeight));
+            if (fUndo)
+                vRecords.emplace_back(pindex->GetUndoPos(), pindex->pprev->GetBlockHash());
+            else
+                vRecords.emplace_back(pindex->GetBlockPos(), pindex->GetBlockHash());
+        }
+    }
+
+    RESTBinaryReply reply(req, SER_NETWORK, PROTOCOL_VERSION);
+    std::vector<unsigned char> vData;
+    try {
+        for (const auto& record : vRecords) {
+            bool fRead = true;
+            if (record.first.IsNull())
+                vData.clear();
+            else if (fUndo)
+                fRead = ReadRawUndoFromDisk(vData, record.first, record.second);
+            else
+                fRead = ReadRawBlockFromDisk(vData, record.first);
+            if (!fRead) {
+                // Pruned or corrupted since
+                return reply.Abort("Cannot read the record of block " + record.second.GetHex());
+            }
+            reply.WriteRecord(vData);
+        }
+    } catch (const std::ios_base::failure& e) {
+        return false;
+    }
+    reply.Finish();
+    return true;
+}
+
+static bool rest_blocks(HTTPRequest* req, const std::string& strURIPart)
+{
+    return rest_block_range(req, strURIPart, false);
+}
+
+static bool rest_undo(HTTPRequest* req, const std::string& strURIPart)
+{
+    return rest_block_range(req, strURIPart, true);
+}
+
+static bool rest_utxoset(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::vector<std::string> params;
+    const RetFormat rf = ParseDataFormat(params, strURIPart);
+
+    if (rf != RF_BINARY || !params[0].empty())
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: bin)");
+
+    // The cursor iterates over a snapshot of the database, as of its best block: the coins
+    // are read without cs_main. Nothing is flushed or waited for, the set served can be behind the tip.
+    std::unique_ptr<CCoinsViewCursor> pcursor;
+    int nHeight;
+    {
+        LOCK(cs_main);
+        if (!pcoinsAsyncFlush)
+            return RESTERR(req, HTTP_SERVICE_UNAVAILABLE, "The coins database is not loaded");
+        pcursor.reset(pcoinsAsyncFlush->DBCursor());
+        if (!pcursor)
+            return RESTERR(req, HTTP_SERVICE_UNAVAILABLE, "The coins database is being written, try again later");
+        if (pcursor->GetBestBlock().IsNull())
+            return RESTERR(req, HTTP_SERVICE_UNAVAILABLE, "The coins database was not written yet");
+        BlockMap::const_iterator it = mapBlockIndex.find(pcursor->GetBestBlock());
+        if (it == mapBlockIndex.end())
+            return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, "Best block of the coins database not found");
+        nHeight = it->second->nHeight;
+    }
+
+    RESTBinaryReply reply(req, SER_DISK, CLIENT_VERSION);
+    try {
+        reply << pcursor->GetBestBlock() << nHeight;
+        COutPoint key;
+        Coin coin;
+        while (pcursor->Valid()) {
+            if (!pcursor->GetKey(key) || !pcursor->GetValue(coin))
+                return reply.Abort("Cannot read the coins database");
+            reply << key << coin;
+            pcursor->Next();
+        }
+    } catch (const std::ios_base::failure& e) {
+        return false;
+    }
+    reply.Finish();
+    return true;
+}
+
 // A bit of a hack - dependency on a function defined in rpc/blockchain.cpp
 UniValue getblockchaininfo(const JSONRPCRequest& request);
 
@@ -320,12 +554,9 @@ static bool rest_mempool_contents(HTTPRequest* req, const std::string& strURIPar
 
     switch (rf) {
     case RF_JSON: {
-        UniValue mempoolObject = mempoolToJSON(true);
-
-        std::string strJSON = mempoolObject.write() + "\n";
-        req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
-        return true;
+        return RESTJSONReply(req, [](RPCResultWriter& result) {
+            mempoolToJSON(result, true);
+        });
     }
     default: {
         return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: json)");
@@ -583,6 +814,9 @@ static const struct {
       {"/rest/tx/", rest_tx},
       {"/rest/block/notxdetails/", rest_block_notxdetails},
       {"/rest/block/", rest_block_extended},
+      {"/rest/blocks/", rest_blocks},
+      {"/rest/undo/", rest_undo},
+      {"/rest/utxoset", rest_utxoset},
       {"/rest/chaininfo", rest_chaininfo},
       {"/rest/mempool/info", rest_mempool_info},
       {"/rest/mempool/contents", rest_mempool_contents},
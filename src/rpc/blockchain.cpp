@@ -15,8 +15,10 @@
 #include "masternodeman.h"
 #include "policy/feerate.h"
 #include "policy/policy.h"
+#include "rpc/jsonstream.h"
 #include "rpc/server.h"
 #include "sync.h"
+#include "txacceptqueue.h"
 #include "txdb.h"
 #include "util.h"
 #include "utilmoneystr.h"
@@ -116,7 +118,7 @@ UniValue blockheaderToJSON(const CBlockIndex* blockindex)
     result.pushKV("bits", strprintf("%08x", blockindex->nBits));
     result.pushKV("difficulty", GetDifficulty(blockindex));
     result.pushKV("chainwork", blockindex->nChainWork.GetHex());
-    result.pushKV("acc_checkpoint", blockindex->nAccumulatorCheckpoint.GetHex());
+    result.pushKV("acc_checkpoint", blockindex->GetAccumulatorCheckpoint().GetHex());
     // Sapling shield pool value
     result.pushKV("shield_pool_value", ValuePoolDesc(blockindex->nChainSaplingValue, blockindex->nSaplingValue));
     if (blockindex->pprev)
@@ -127,61 +129,72 @@ UniValue blockheaderToJSON(const CBlockIndex* blockindex)
     return result;
 }
 
-UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false)
+void blockToJSON(RPCResultWriter& result, const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false)
 {
-    UniValue result(UniValue::VOBJ);
-    result.pushKV("hash", block.GetHash().GetHex());
-    int confirmations = -1;
-    // Only report confirmations if the block is on the main chain
-    if (chainActive.Contains(blockindex))
-        confirmations = chainActive.Height() - blockindex->nHeight + 1;
-    result.pushKV("confirmations", confirmations);
-    result.pushKV("size", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION));
-    result.pushKV("height", blockindex->nHeight);
-    result.pushKV("version", block.nVersion);
-    result.pushKV("merkleroot", block.hashMerkleRoot.GetHex());
-    result.pushKV("acc_checkpoint", block.nAccumulatorCheckpoint.GetHex());
-    result.pushKV("finalsaplingroot", block.hashFinalSaplingRoot.GetHex());
-    UniValue txs(UniValue::VARR);
+    // The fields around the transactions are read under cs_main, the transactions are
+    // written without it
+    UniValue head(UniValue::VOBJ);
+    UniValue tail(UniValue::VOBJ);
+    {
+        LOCK(cs_main);
+        head.pushKV("hash", block.GetHash().GetHex());
+        int confirmations = -1;
+        // Only report confirmations if the block is on the main chain
+        if (chainActive.Contains(blockindex))
+            confirmations = chainActive.Height() - blockindex->nHeight + 1;
+        head.pushKV("confirmations", confirmations);
+        head.pushKV("size", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION));
+        head.pushKV("height", blockindex->nHeight);
+        head.pushKV("version", block.nVersion);
+        head.pushKV("merkleroot", block.hashMerkleRoot.GetHex());
+        head.pushKV("acc_checkpoint", block.nAccumulatorCheckpoint.GetHex());
+        head.pushKV("finalsaplingroot", block.hashFinalSaplingRoot.GetHex());
+
+        tail.pushKV("time", block.GetBlockTime());
+        tail.pushKV("mediantime", (int64_t)blockindex->GetMedianTimePast());
+        tail.pushKV("nonce", (uint64_t)block.nNonce);
+        tail.pushKV("bits", strprintf("%08x", block.nBits));
+        tail.pushKV("difficulty", GetDifficulty(blockindex));
+        tail.pushKV("chainwork", blockindex->nChainWork.GetHex());
+
+        if (blockindex->pprev)
+            tail.pushKV("previousblockhash", blockindex->pprev->GetBlockHash().GetHex());
+        CBlockIndex* pnext = chainActive.Next(blockindex);
+        if (pnext)
+            tail.pushKV("nextblockhash", pnext->GetBlockHash().GetHex());
+
+        //////////
+        ////////// Coin stake data ////////////////
+        /////////
+        if (block.IsProofOfStake()) {
+            uint256 hashProofOfStakeRet{UINT256_ZERO};
+            if (blockindex->pprev && !GetStakeKernelHash(hashProofOfStakeRet, block, blockindex->pprev))
+                throw JSONRPCError(RPC_INTERNAL_ERROR, "Cannot get proof of stake hash");
+
+            std::string stakeModifier = (Params().GetConsensus().NetworkUpgradeActive(blockindex->nHeight, Consensus::UPGRADE_V3_4) ?
+                                         blockindex->GetStakeModifierV2().GetHex() :
+                                         strprintf("%016x", blockindex->GetStakeModifierV1()));
+            tail.pushKV("stakeModifier", stakeModifier);
+            tail.pushKV("hashProofOfStake", hashProofOfStakeRet.GetHex());
+        }
+    }
+
+    result.BeginObject();
+    result.PushKVs(head);
+    result.Key("tx");
+    result.BeginArray();
     for (const auto& txIn : block.vtx) {
         const CTransaction& tx = *txIn;
         if (txDetails) {
             UniValue objTx(UniValue::VOBJ);
             TxToJSON(tx, UINT256_ZERO, objTx);
-            txs.push_back(objTx);
+            result.Value(objTx);
         } else
-            txs.push_back(tx.GetHash().GetHex());
+            result.Value(tx.GetHash().GetHex());
     }
-    result.pushKV("tx", txs);
-    result.pushKV("time", block.GetBlockTime());
-    result.pushKV("mediantime", (int64_t)blockindex->GetMedianTimePast());
-    result.pushKV("nonce", (uint64_t)block.nNonce);
-    result.pushKV("bits", strprintf("%08x", block.nBits));
-    result.pushKV("difficulty", GetDifficulty(blockindex));
-    result.pushKV("chainwork", blockindex->nChainWork.GetHex());
-
-    if (blockindex->pprev)
-        result.pushKV("previousblockhash", blockindex->pprev->GetBlockHash().GetHex());
-    CBlockIndex* pnext = chainActive.Next(blockindex);
-    if (pnext)
-        result.pushKV("nextblockhash", pnext->GetBlockHash().GetHex());
-
-    //////////
-    ////////// Coin stake data ////////////////
-    /////////
-    if (block.IsProofOfStake()) {
-        uint256 hashProofOfStakeRet{UINT256_ZERO};
-        if (blockindex->pprev && !GetStakeKernelHash(hashProofOfStakeRet, block, blockindex->pprev))
-            throw JSONRPCError(RPC_INTERNAL_ERROR, "Cannot get proof of stake hash");
-
-        std::string stakeModifier = (Params().GetConsensus().NetworkUpgradeActive(blockindex->nHeight, Consensus::UPGRADE_V3_4) ?
-                                     blockindex->GetStakeModifierV2().GetHex() :
-                                     strprintf("%016x", blockindex->GetStakeModifierV1()));
-        result.pushKV("stakeModifier", stakeModifier);
-        result.pushKV("hashProofOfStake", hashProofOfStakeRet.GetHex());
-    }
-
-    return result;
+    result.EndArray();
+    result.PushKVs(tail);
+    result.EndObject();
 }
 
 UniValue getblockcount(const JSONRPCRequest& request)
@@ -393,49 +406,51 @@ UniValue getdifficulty(const JSONRPCRequest& request)
 }
 
 
-UniValue mempoolToJSON(bool fVerbose = false)
+static UniValue MempoolEntryToJSON(const CTxMemPoolEntry& e, const CTxMemPoolSnapshot& snapshot, int nHeight)
 {
-    if (fVerbose) {
-        LOCK(mempool.cs);
-        UniValue o(UniValue::VOBJ);
-        for (const CTxMemPoolEntry& e : mempool.mapTx) {
-            const uint256& hash = e.GetTx().GetHash();
-            UniValue info(UniValue::VOBJ);
-            info.pushKV("size", (int)e.GetTxSize());
-            info.pushKV("fee", ValueFromAmount(e.GetFee()));
-            info.pushKV("modifiedfee", ValueFromAmount(e.GetModifiedFee()));
-            info.pushKV("time", e.GetTime());
-            info.pushKV("height", (int)e.GetHeight());
-            info.pushKV("startingpriority", e.GetPriority(e.GetHeight()));
-            info.pushKV("currentpriority", e.GetPriority(chainActive.Height()));
-            info.pushKV("descendantcount", e.GetCountWithDescendants());
-            info.pushKV("descendantsize", e.GetSizeWithDescendants());
-            info.pushKV("descendantfees", e.GetModFeesWithDescendants());
-            const CTransaction& tx = e.GetTx();
-            std::set<std::string> setDepends;
-            for (const CTxIn& txin : tx.vin) {
-                if (mempool.exists(txin.prevout.hash))
-                    setDepends.insert(txin.prevout.hash.ToString());
-            }
+    UniValue info(UniValue::VOBJ);
+    info.pushKV("size", (int)e.GetTxSize());
+    info.pushKV("fee", ValueFromAmount(e.GetFee()));
+    info.pushKV("modifiedfee", ValueFromAmount(e.GetModifiedFee()));
+    info.pushKV("time", e.GetTime());
+    info.pushKV("height", (int)e.GetHeight());
+    info.pushKV("startingpriority", e.GetPriority(e.GetHeight()));
+    info.pushKV("currentpriority", e.GetPriority(nHeight));
+    info.pushKV("descendantcount", e.GetCountWithDescendants());
+    info.pushKV("descendantsize", e.GetSizeWithDescendants());
+    info.pushKV("descendantfees", e.GetModFeesWithDescendants());
+    const CTransaction& tx = e.GetTx();
+    std::set<std::string> setDepends;
+    for (const CTxIn& txin : tx.vin) {
+        if (snapshot.exists(txin.prevout.hash))
+            setDepends.insert(txin.prevout.hash.ToString());
+    }
 
-            UniValue depends(UniValue::VARR);
-            for (const std::string& dep : setDepends) {
-                depends.push_back(dep);
-            }
+    UniValue depends(UniValue::VARR);
+    for (const std::string& dep : setDepends) {
+        depends.push_back(dep);
+    }
+
+    info.pushKV("depends", depends);
+    return info;
+}
 
-            info.pushKV("depends", depends);
-            o.pushKV(hash.ToString(), info);
+void mempoolToJSON(RPCResultWriter& result, bool fVerbose = false)
+{
+    // Neither cs_main nor the mempool lock are held while the JSON is built
+    const CTxMemPoolSnapshotRef snapshot = mempool.GetSnapshot();
+    if (fVerbose) {
+        const int nHeight = WITH_LOCK(cs_main, return chainActive.Height());
+        result.BeginObject();
+        for (const CTxMemPoolEntry& e : snapshot->GetEntries()) {
+            result.PushKV(e.GetTx().GetHash().ToString(), MempoolEntryToJSON(e, *snapshot, nHeight));
         }
-        return o;
+        result.EndObject();
     } else {
-        std::vector<uint256> vtxid;
-        mempool.queryHashes(vtxid);
-
-        UniValue a(UniValue::VARR);
-        for (const uint256& hash : vtxid)
-            a.push_back(hash.ToString());
-
-        return a;
+        result.BeginArray();
+        for (const CTxMemPoolEntry* e : snapshot->GetSortedDepthAndScore())
+            result.Value(e->GetTx().GetHash().ToString());
+        result.EndArray();
     }
 }
 
@@ -477,13 +492,13 @@ UniValue getrawmempool(const JSONRPCRequest& request)
             "\nExamples\n" +
             HelpExampleCli("getrawmempool", "true") + HelpExampleRpc("getrawmempool", "true"));
 
-    LOCK(cs_main);
-
     bool fVerbose = false;
     if (request.params.size() > 0)
         fVerbose = request.params[0].get_bool();
 
-    return mempoolToJSON(fVerbose);
+    RPCResultWriter result(request.stream);
+    mempoolToJSON(result, fVerbose);
+    return result.GetResult();
 }
 
 UniValue getblockhash(const JSONRPCRequest& request)
@@ -556,8 +571,6 @@ UniValue getblock(const JSONRPCRequest& request)
             HelpExampleCli("getblock", "\"00000000000fd08c2fb661d2fcb0d49abb3a91e5f27082ce64feed3b4dede2e2\"") +
             HelpExampleRpc("getblock", "\"00000000000fd08c2fb661d2fcb0d49abb3a91e5f27082ce64feed3b4dede2e2\""));
 
-    LOCK(cs_main);
-
     std::string strHash = request.params[0].get_str();
     uint256 hash(uint256S(strHash));
 
@@ -565,14 +578,18 @@ UniValue getblock(const JSONRPCRequest& request)
     if (request.params.size() > 1)
         fVerbose = request.params[1].get_bool();
 
-    if (mapBlockIndex.count(hash) == 0)
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
-
     CBlock block;
-    CBlockIndex* pblockindex = mapBlockIndex[hash];
+    CBlockIndex* pblockindex = nullptr;
+    {
+        LOCK(cs_main);
+        if (mapBlockIndex.count(hash) == 0)
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
 
-    if (!ReadBlockFromDisk(block, pblockindex))
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+        pblockindex = mapBlockIndex[hash];
+
+        if (!ReadBlockFromDisk(block, pblockindex))
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+    }
 
     if (!fVerbose) {
         CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
@@ -581,7 +598,9 @@ UniValue getblock(const JSONRPCRequest& request)
         return strHex;
     }
 
-    return blockToJSON(block, pblockindex);
+    RPCResultWriter result(request.stream);
+    blockToJSON(result, block, pblockindex);
+    return result.GetResult();
 }
 
 UniValue getblockheader(const JSONRPCRequest& request)
@@ -994,6 +1013,10 @@ UniValue getblockchaininfo(const JSONRPCRequest& request)
             "    \"valueDelta\":        (numeric) Change in value held by the Sapling circuit over the chain tip block\n"
             "  },\n"
             "  \"initial_block_downloading\": true|false, (boolean) whether the node is in initial block downloading state or not\n"
+            "  \"inputs_prefetch\": {    (object) Inputs of the blocks connected since the start\n"
+            "    \"cached\": xxxxxx,      (numeric) found in the coins cache\n"
+            "    \"read\": xxxxxx         (numeric) read from the database in parallel before connecting the block\n"
+            "  },\n"
             "  \"softforks\": [            (array) status of softforks in progress\n"
             "     {\n"
             "        \"id\": \"xxxx\",        (string) name of softfork\n"
@@ -1031,6 +1054,12 @@ UniValue getblockchaininfo(const JSONRPCRequest& request)
     // Sapling shield pool value
     obj.pushKV("shield_pool_value", pChainTip ? ValuePoolDesc(pChainTip->nChainSaplingValue, pChainTip->nSaplingValue) : 0);
     obj.pushKV("initial_block_downloading", IsInitialBlockDownload());
+    uint64_t nPrefetchCached, nPrefetchRead;
+    GetInputsPrefetchStats(nPrefetchCached, nPrefetchRead);
+    UniValue prefetch(UniValue::VOBJ);
+    prefetch.pushKV("cached", nPrefetchCached);
+    prefetch.pushKV("read", nPrefetchRead);
+    obj.pushKV("inputs_prefetch", prefetch);
     UniValue softforks(UniValue::VARR);
     softforks.push_back(SoftForkDesc("bip65", 5, pChainTip));
     obj.pushKV("softforks",             softforks);
@@ -1185,6 +1214,64 @@ UniValue getmempoolinfo(const JSONRPCRequest& request)
     return mempoolInfoToJSON();
 }
 
+UniValue gettxacceptqueueinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            "gettxacceptqueueinfo\n"
+            "\nReturns details on the queue accepting the relayed transactions to the mempool.\n"
+
+            "\nResult:\n"
+            "{\n"
+            "  \"enabled\": true|false        (boolean) False if the transactions are accepted inline (-txacceptthreads=0)\n"
+            "  \"workers\": n                 (numeric) Number of threads checking the transactions\n"
+            "  \"size\": n                    (numeric) Current number of transactions in the queue\n"
+            "  \"maxsize\": n                 (numeric) Maximum number of transactions in the queue\n"
+            "  \"accepted\": n                (numeric) Transactions accepted to the mempool\n"
+            "  \"rejected\": n                (numeric) Transactions rejected\n"
+            "  \"missinginputs\": n           (numeric) Transactions with missing inputs\n"
+            "  \"full\": n                    (numeric) Transactions accepted inline because the queue was full\n"
+            "  \"stages\": {                  (json object) The steps of the acceptance\n"
+            "    \"name\": {                  (json object) precheck, prepare, verify or finish\n"
+            "      \"queued\": n              (numeric) Transactions waiting for, or going through, the step\n"
+            "      \"done\": n                (numeric) Transactions done with the step\n"
+            "      \"avg_ms\": x.xxx          (numeric) Average time spent in the step, waiting included\n"
+            "      \"max_ms\": x.xxx          (numeric) Maximum time spent in the step, waiting included\n"
+            "    }, ...\n"
+            "  }\n"
+            "}\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("gettxacceptqueueinfo", "") + HelpExampleRpc("gettxacceptqueueinfo", ""));
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("enabled", g_txacceptqueue != nullptr);
+    if (!g_txacceptqueue) {
+        return ret;
+    }
+
+    const CTxAcceptQueue::Stats stats = g_txacceptqueue->GetStats();
+    ret.pushKV("workers", stats.nWorkers);
+    ret.pushKV("size", (int64_t)stats.nSize);
+    ret.pushKV("maxsize", (int64_t)stats.nMaxSize);
+    ret.pushKV("accepted", (int64_t)stats.nAccepted);
+    ret.pushKV("rejected", (int64_t)stats.nRejected);
+    ret.pushKV("missinginputs", (int64_t)stats.nMissingInputs);
+    ret.pushKV("full", (int64_t)stats.nFull);
+    UniValue stages(UniValue::VOBJ);
+    for (int i = 0; i < CTxAcceptQueue::NUM_STAGES; i++) {
+        const CTxAcceptQueue::StageStats& stage = stats.stages[i];
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("queued", (int64_t)stage.nQueued);
+        obj.pushKV("done", (int64_t)stage.nDone);
+        obj.pushKV("avg_ms", stage.nDone ? 0.001 * stage.nTotalTime / stage.nDone : 0.0);
+        obj.pushKV("max_ms", 0.001 * stage.nMaxTime);
+        stages.pushKV(CTxAcceptQueue::StageName((CTxAcceptQueue::Stage)i), obj);
+    }
+    ret.pushKV("stages", stages);
+    return ret;
+}
+
 UniValue invalidateblock(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 1)
@@ -1441,33 +1528,34 @@ UniValue getfeeinfo(const JSONRPCRequest& request)
 }
 
 static const CRPCCommand commands[] =
-{ //  category              name                      actor (function)         okSafeMode
-  //  --------------------- ------------------------  -----------------------  ----------
-    { "blockchain",         "getblockindexstats",     &getblockindexstats,     true  },
-    { "blockchain",         "getblockchaininfo",      &getblockchaininfo,      true  },
-    { "blockchain",         "getbestblockhash",       &getbestblockhash,       true  },
-    { "blockchain",         "getbestsaplinganchor",   &getbestsaplinganchor,   true  },
-    { "blockchain",         "getblockcount",          &getblockcount,          true  },
-    { "blockchain",         "getblock",               &getblock,               true  },
-    { "blockchain",         "getblockhash",           &getblockhash,           true  },
-    { "blockchain",         "getblockheader",         &getblockheader,         false },
-    { "blockchain",         "getchaintips",           &getchaintips,           true  },
-    { "blockchain",         "getdifficulty",          &getdifficulty,          true  },
-    { "blockchain",         "getfeeinfo",             &getfeeinfo,             true  },
-    { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         true  },
-    { "blockchain",         "getsupplyinfo",          &getsupplyinfo,          true  },
-    { "blockchain",         "getrawmempool",          &getrawmempool,          true  },
-    { "blockchain",         "gettxout",               &gettxout,               true  },
-    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        true  },
-    { "blockchain",         "verifychain",            &verifychain,            true  },
+{ //  category              name                      actor (function)         okSafeMode  okConcurrent
+  //  --------------------- ------------------------  -----------------------  ----------  ------------
+    { "blockchain",         "getblockindexstats",     &getblockindexstats,     true,       true  },
+    { "blockchain",         "getblockchaininfo",      &getblockchaininfo,      true,       true  },
+    { "blockchain",         "getbestblockhash",       &getbestblockhash,       true,       true  },
+    { "blockchain",         "getbestsaplinganchor",   &getbestsaplinganchor,   true,       true  },
+    { "blockchain",         "getblockcount",          &getblockcount,          true,       true  },
+    { "blockchain",         "getblock",               &getblock,               true,       true  },
+    { "blockchain",         "getblockhash",           &getblockhash,           true,       true  },
+    { "blockchain",         "getblockheader",         &getblockheader,         false,      true  },
+    { "blockchain",         "getchaintips",           &getchaintips,           true,       true  },
+    { "blockchain",         "getdifficulty",          &getdifficulty,          true,       true  },
+    { "blockchain",         "getfeeinfo",             &getfeeinfo,             true,       true  },
+    { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         true,       true  },
+    { "blockchain",         "getsupplyinfo",          &getsupplyinfo,          true,       false },
+    { "blockchain",         "gettxacceptqueueinfo",   &gettxacceptqueueinfo,   true,       true  },
+    { "blockchain",         "getrawmempool",          &getrawmempool,          true,       true  },
+    { "blockchain",         "gettxout",               &gettxout,               true,       true  },
+    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        true,       false },
+    { "blockchain",         "verifychain",            &verifychain,            true,       false },
 
     /* Not shown in help */
-    { "hidden",             "invalidateblock",        &invalidateblock,        true  },
-    { "hidden",             "reconsiderblock",        &reconsiderblock,        true  },
-    { "hidden",             "waitfornewblock",        &waitfornewblock,        true  },
-    { "hidden",             "waitforblock",           &waitforblock,           true  },
-    { "hidden",             "waitforblockheight",     &waitforblockheight,     true  },
-    { "hidden",             "syncwithvalidationinterfacequeue", &syncwithvalidationinterfacequeue, true },
+    { "hidden",             "invalidateblock",        &invalidateblock,        true,       false },
+    { "hidden",             "reconsiderblock",        &reconsiderblock,        true,       false },
+    { "hidden",             "waitfornewblock",        &waitfornewblock,        true,       false },
+    { "hidden",             "waitforblock",           &waitforblock,           true,       false },
+    { "hidden",             "waitforblockheight",     &waitforblockheight,     true,       false },
+    { "hidden",             "syncwithvalidationinterfacequeue", &syncwithvalidationinterfacequeue, true,       false },
 
 
 };
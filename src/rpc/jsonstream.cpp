@@ -0,0 +1,160 @@
+// Copyright (c) 2022 The PIVX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "rpc/jsonstream.h"
+
+#include <assert.h>
+
+JSONStreamWriter::JSONStreamWriter(Sink sinkIn, size_t nChunkSizeIn) :
+    sink(std::move(sinkIn)),
+    nChunkSize(nChunkSizeIn)
+{
+    strBuffer.reserve(nChunkSize + nChunkSize / 4);
+}
+
+void JSONStreamWriter::BeginElement()
+{
+    if (fAborted) throw Aborted();
+    if (fAfterKey) {
+        fAfterKey = false;
+        return;
+    }
+    if (!vHasElements.empty()) {
+        if (vHasElements.back()) strBuffer += ',';
+        vHasElements.back() = true;
+    }
+}
+
+void JSONStreamWriter::BeginObject()
+{
+    BeginElement();
+    strBuffer += '{';
+    vHasElements.push_back(false);
+}
+
+void JSONStreamWriter::EndObject()
+{
+    assert(!vHasElements.empty() && !fAfterKey);
+    vHasElements.pop_back();
+    strBuffer += '}';
+    FlushIfFull();
+}
+
+void JSONStreamWriter::BeginArray()
+{
+    BeginElement();
+    strBuffer += '[';
+    vHasElements.push_back(false);
+}
+
+void JSONStreamWriter::EndArray()
+{
+    assert(!vHasElements.empty() && !fAfterKey);
+    vHasElements.pop_back();
+    strBuffer += ']';
+    FlushIfFull();
+}
+
+void JSONStreamWriter::Key(const std::string& key)
+{
+    assert(!vHasElements.empty() && !fAfterKey);
+    BeginElement();
+    strBuffer += UniValue(key).write();
+    strBuffer += ':';
+    fAfterKey = true;
+}
+
+void JSONStreamWriter::Value(const UniValue& value)
+{
+    BeginElement();
+    strBuffer += value.write();
+    FlushIfFull();
+}
+
+void JSONStreamWriter::Finish()
+{
+    assert(vHasElements.empty() && !fAfterKey);
+    strBuffer += '\n';
+    Flush(true);
+}
+
+void JSONStreamWriter::Flush(bool fLast)
+{
+    if (fAborted) throw Aborted();
+    fFlushed = true;
+    if (!sink(strBuffer, fLast)) {
+        fAborted = true;
+    }
+    strBuffer.clear();
+    if (fAborted && !fLast) throw Aborted();
+}
+
+void RPCResultWriter::Key(const std::string& key)
+{
+    if (stream) {
+        stream->Key(key);
+    } else {
+        strKey = key;
+    }
+}
+
+void RPCResultWriter::Value(const UniValue& value)
+{
+    if (stream) {
+        stream->Value(value);
+    } else if (vStack.empty()) {
+        result = value;
+    } else if (vStack.back().second.isObject()) {
+        vStack.back().second.pushKV(strKey, value);
+    } else {
+        vStack.back().second.push_back(value);
+    }
+}
+
+void RPCResultWriter::PushKVs(const UniValue& obj)
+{
+    assert(obj.isObject());
+    const std::vector<std::string>& keys = obj.getKeys();
+    const std::vector<UniValue>& values = obj.getValues();
+    for (size_t i = 0; i < keys.size(); i++) {
+        PushKV(keys[i], values[i]);
+    }
+}
+
+void RPCResultWriter::Begin(UniValue::VType type)
+{
+    if (stream) {
+        if (type == UniValue::VOBJ) {
+            stream->BeginObject();
+        } else {
+            stream->BeginArray();
+        }
+    } else {
+        vStack.emplace_back(std::move(strKey), UniValue(type));
+        strKey.clear();
+    }
+}
+
+void RPCResultWriter::End(UniValue::VType type)
+{
+    if (stream) {
+        if (type == UniValue::VOBJ) {
+            stream->EndObject();
+        } else {
+            stream->EndArray();
+        }
+    } else {
+        assert(!vStack.empty() && vStack.back().second.getType() == type);
+        std::pair<std::string, UniValue> top = std::move(vStack.back());
+        vStack.pop_back();
+        strKey = std::move(top.first);
+        Value(top.second);
+    }
+}
+
+UniValue RPCResultWriter::GetResult()
+{
+    assert(vStack.empty());
+    return stream ? NullUniValue : result;
+}
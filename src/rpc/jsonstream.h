@@ -0,0 +1,121 @@
+// Copyright (c) 2022 The PIVX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_RPC_JSONSTREAM_H
+#define BITCOIN_RPC_JSONSTREAM_H
+
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <univalue.h>
+
+/**
+ * Writes JSON as it is produced, handing it to a sink in pieces of about nChunkSize bytes,
+ * instead of building the whole UniValue tree and writing it at once. The output is the
+ * same as UniValue::write() with no indentation.
+ */
+class JSONStreamWriter
+{
+public:
+    /** Receives the output, fLast is set on the last call (from Finish). Returns false to stop the writer. */
+    typedef std::function<bool(const std::string& strData, bool fLast)> Sink;
+
+    /** Thrown by the writing methods once the sink stopped the writer */
+    class Aborted : public std::runtime_error
+    {
+    public:
+        Aborted() : std::runtime_error("JSON output aborted") {}
+    };
+
+    static const size_t DEFAULT_CHUNK_SIZE = 64 * 1024;
+
+    explicit JSONStreamWriter(Sink sinkIn, size_t nChunkSizeIn = DEFAULT_CHUNK_SIZE);
+
+    void BeginObject();
+    void EndObject();
+    void BeginArray();
+    void EndArray();
+    /** Write the key of the next value of an object */
+    void Key(const std::string& key);
+    /** Write a value, a whole tree for objects and arrays */
+    void Value(const UniValue& value);
+    void PushKV(const std::string& key, const UniValue& value)
+    {
+        Key(key);
+        Value(value);
+    }
+
+    /** Hand the rest of the output to the sink, ended by a newline */
+    void Finish();
+
+    /** Whether part of the output was handed to the sink already */
+    bool HasFlushed() const { return fFlushed; }
+    /** Number of objects and arrays open */
+    size_t GetDepth() const { return vHasElements.size(); }
+    /** Whether a key was written, and not its value yet */
+    bool IsAfterKey() const { return fAfterKey; }
+
+private:
+    Sink sink;
+    const size_t nChunkSize;
+    std::string strBuffer;
+    //! For each object or array open, whether it has an element already
+    std::vector<bool> vHasElements;
+    bool fAfterKey{false};
+    bool fFlushed{false};
+    bool fAborted{false};
+
+    //! Write the separator before an element
+    void BeginElement();
+    void Flush(bool fLast);
+    void FlushIfFull()
+    {
+        if (strBuffer.size() >= nChunkSize) Flush(false);
+    }
+};
+
+/**
+ * The result of a call, written with the same calls whether it is streamed or not: into
+ * a JSONStreamWriter when there is one (see JSONRPCRequest::stream), into a UniValue
+ * otherwise. The calls returning large results write them through this, so they are
+ * streamed by the transports that can.
+ */
+class RPCResultWriter
+{
+public:
+    explicit RPCResultWriter(JSONStreamWriter* streamIn) : stream(streamIn) {}
+
+    void BeginObject() { Begin(UniValue::VOBJ); }
+    void EndObject() { End(UniValue::VOBJ); }
+    void BeginArray() { Begin(UniValue::VARR); }
+    void EndArray() { End(UniValue::VARR); }
+    void Key(const std::string& key);
+    void Value(const UniValue& value);
+    void PushKV(const std::string& key, const UniValue& value)
+    {
+        Key(key);
+        Value(value);
+    }
+    /** Write the keys and values of an object, as UniValue::pushKVs */
+    void PushKVs(const UniValue& obj);
+
+    bool IsStreamed() const { return stream != nullptr; }
+    /** The result to return from the call: NullUniValue if it was streamed */
+    UniValue GetResult();
+
+private:
+    JSONStreamWriter* stream;
+    //! The objects and arrays open, with the key of each in its parent
+    std::vector<std::pair<std::string, UniValue> > vStack;
+    std::string strKey;
+    UniValue result;
+
+    void Begin(UniValue::VType type);
+    void End(UniValue::VType type);
+};
+
+#endif // BITCOIN_RPC_JSONSTREAM_H
@@ -7,6 +7,7 @@
 
 #include "base58.h"
 #include "clientversion.h"
+#include "dbwrapper.h"
 #include "httpserver.h"
 #include "init.h"
 #include "sapling/key_io_sapling.h"
@@ -740,6 +741,91 @@ UniValue getmemoryinfo(const JSONRPCRequest& request)
     return obj;
 }
 
+UniValue getdbstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 1)
+        throw std::runtime_error(
+            "getdbstats ( \"name\" )\n"
+            "Returns the LevelDB tuning and statistics of the databases (see -dbprofile).\n"
+            "\nArguments:\n"
+            "1. \"name\"             (string, optional) Only return the database with this name\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"name\": \"xxxx\",            (string) The name of the database\n"
+            "    \"path\": \"xxxx\",            (string) The location of the database\n"
+            "    \"cache\": n,                (numeric) The cache budget of the database, in bytes\n"
+            "    \"profile\": {               (json object) The tuning of the database\n"
+            "      \"blockcache\": n,         (numeric) The share of the cache budget used by the block cache (percent)\n"
+            "      \"writebuffer\": n,        (numeric) The write buffer size in bytes, 0 if it is the rest of the cache budget\n"
+            "      \"compression\": true|false,\n"
+            "      \"verifychecksums\": true|false,\n"
+            "      \"maxfilesize\": n,        (numeric) The size of the table files in bytes\n"
+            "      \"bloombits\": n           (numeric) The bloom filter bits per key\n"
+            "    },\n"
+            "    \"size\": n,                 (numeric) The approximate size on disk, in bytes\n"
+            "    \"memoryusage\": n,          (numeric) The approximate memory used by LevelDB, in bytes\n"
+            "    \"blockcache\": {            (json object) The block cache\n"
+            "      \"capacity\": n,           (numeric) The capacity in bytes\n"
+            "      \"usage\": n,              (numeric) The bytes currently cached\n"
+            "      \"hits\": n,               (numeric) The number of lookups found in the cache\n"
+            "      \"misses\": n,             (numeric) The number of lookups not found in the cache\n"
+            "      \"hitrate\": x.xxx         (numeric) The share of lookups found in the cache\n"
+            "    },\n"
+            "    \"files\": [ n, ... ],       (json array) The number of table files of every level\n"
+            "    \"stats\": \"xxxx\"            (string) The compaction statistics reported by LevelDB\n"
+            "  },\n"
+            "  ...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getdbstats", "") + HelpExampleCli("getdbstats", "\"chainstate\"")
+            + HelpExampleRpc("getdbstats", "\"chainstate\""));
+
+    const std::string strName = request.params.size() > 0 ? request.params[0].get_str() : "";
+    if (!strName.empty() && std::find(DB_PROFILE_NAMES.begin(), DB_PROFILE_NAMES.end(), strName) == DB_PROFILE_NAMES.end())
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown database " + strName);
+
+    UniValue ret(UniValue::VARR);
+    for (const CDBStats& stats : GetAllDBStats()) {
+        if (!strName.empty() && stats.strName != strName)
+            continue;
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("name", stats.strName);
+        obj.pushKV("path", stats.strPath);
+        obj.pushKV("cache", (uint64_t)stats.nCacheSize);
+
+        UniValue profile(UniValue::VOBJ);
+        profile.pushKV("blockcache", stats.profile.nBlockCachePercent);
+        profile.pushKV("writebuffer", (uint64_t)stats.profile.nWriteBufferSize);
+        profile.pushKV("compression", stats.profile.fCompression);
+        profile.pushKV("verifychecksums", stats.profile.fVerifyChecksums);
+        profile.pushKV("maxfilesize", (uint64_t)stats.profile.nMaxFileSize);
+        profile.pushKV("bloombits", stats.profile.nBloomBits);
+        obj.pushKV("profile", profile);
+
+        obj.pushKV("size", stats.nApproximateSize);
+        obj.pushKV("memoryusage", stats.nMemoryUsage);
+
+        UniValue blockcache(UniValue::VOBJ);
+        const uint64_t nLookups = stats.nBlockCacheHits + stats.nBlockCacheMisses;
+        blockcache.pushKV("capacity", (uint64_t)stats.nBlockCacheCapacity);
+        blockcache.pushKV("usage", (uint64_t)stats.nBlockCacheUsage);
+        blockcache.pushKV("hits", stats.nBlockCacheHits);
+        blockcache.pushKV("misses", stats.nBlockCacheMisses);
+        blockcache.pushKV("hitrate", nLookups ? (double)stats.nBlockCacheHits / nLookups : 0.0);
+        obj.pushKV("blockcache", blockcache);
+
+        UniValue files(UniValue::VARR);
+        for (int nFiles : stats.vFilesPerLevel) {
+            files.push_back(nFiles);
+        }
+        obj.pushKV("files", files);
+        obj.pushKV("stats", stats.strLevelDBStats);
+        ret.push_back(obj);
+    }
+    return ret;
+}
+
 static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         okSafeMode
   //  --------------------- ------------------------  -----------------------  ----------
@@ -747,6 +833,7 @@ static const CRPCCommand commands[] =
     { "control",            "mnsync",                 &mnsync,                 true  },
     { "control",            "spork",                  &spork,                  true  },
     { "control",            "getmemoryinfo",          &getmemoryinfo,          true  },
+    { "control",            "getdbstats",             &getdbstats,             true  },
     { "util",               "validateaddress",        &validateaddress,        true  }, /* uses wallet if enabled */
     { "util",               "createmultisig",         &createmultisig,         true  },
     { "util",               "logging",                &logging,                true  },
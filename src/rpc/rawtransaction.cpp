@@ -987,15 +987,15 @@ UniValue sendrawtransaction(const JSONRPCRequest& request)
 }
 
 static const CRPCCommand commands[] =
-{ //  category              name                      actor (function)         okSafeMode
-  //  --------------------- ------------------------  -----------------------  ----------
-    { "rawtransactions",    "getrawtransaction",      &getrawtransaction,      true  },
-    { "rawtransactions",    "createrawtransaction",   &createrawtransaction,   true  },
-    { "rawtransactions",    "decoderawtransaction",   &decoderawtransaction,   true  },
-    { "rawtransactions",    "decodescript",           &decodescript,           true  },
-    { "rawtransactions",    "fundrawtransaction",     &fundrawtransaction,     false },
-    { "rawtransactions",    "signrawtransaction",     &signrawtransaction,     false }, /* uses wallet if enabled */
-    { "rawtransactions",    "sendrawtransaction",     &sendrawtransaction,     false },
+{ //  category              name                      actor (function)         okSafeMode  okConcurrent
+  //  --------------------- ------------------------  -----------------------  ----------  ------------
+    { "rawtransactions",    "getrawtransaction",      &getrawtransaction,      true,       true  },
+    { "rawtransactions",    "createrawtransaction",   &createrawtransaction,   true,       true  },
+    { "rawtransactions",    "decoderawtransaction",   &decoderawtransaction,   true,       true  },
+    { "rawtransactions",    "decodescript",           &decodescript,           true,       true  },
+    { "rawtransactions",    "fundrawtransaction",     &fundrawtransaction,     false,      false },
+    { "rawtransactions",    "signrawtransaction",     &signrawtransaction,     false,      false }, /* uses wallet if enabled */
+    { "rawtransactions",    "sendrawtransaction",     &sendrawtransaction,     false,      false },
 };
 
 void RegisterRawTransactionRPCCommands(CRPCTable &tableRPC)
@@ -14,6 +14,7 @@
 #include "operationresult.h"
 #include "policy/policy.h"
 #include "pubkey.h" // COMPACT_SIGNATURE_SIZE
+#include "rpc/jsonstream.h"
 #include "rpc/server.h"
 #include "script/sign.h"
 #include "utilmoneystr.h"
@@ -632,10 +633,9 @@ static Optional<int> GetUTXOConfirmations(const COutPoint& outpoint)
     return Optional<int>(nChainHeight - *coinHeight + 1);
 }
 
-static void AddDMNEntryToList(UniValue& ret, CWallet* pwallet, const CDeterministicMNCPtr& dmn, bool fVerbose, bool fFromWallet)
+static void AddDMNEntryToList(RPCResultWriter& ret, CWallet* pwallet, const CDeterministicMNCPtr& dmn, bool fVerbose, bool fFromWallet)
 {
     assert(!fFromWallet || pwallet);
-    assert(ret.isArray());
 
     bool hasOwnerKey{false};
     bool hasOperatorKey{false};
@@ -674,9 +674,9 @@ static void AddDMNEntryToList(UniValue& ret, CWallet* pwallet, const CDeterminis
         o.pushKV("hasVotingKey", hasVotingKey);
         o.pushKV("ownsCollateral", ownsCollateral);
         o.pushKV("ownsPayeeScript", ownsPayeeScript);
-        ret.push_back(o);
+        ret.Value(o);
     } else {
-        ret.push_back(dmn->proTxHash.ToString());
+        ret.Value(dmn->proTxHash.ToString());
     }
 }
 
@@ -736,11 +736,13 @@ UniValue protx_list(const JSONRPCRequest& request)
     CDeterministicMNList mnList = deterministicMNManager->GetListForBlock(pindex);
 
     // Build/filter the list
-    UniValue ret(UniValue::VARR);
+    RPCResultWriter ret(request.stream);
+    ret.BeginArray();
     mnList.ForEachMN(fValidOnly, [&](const CDeterministicMNCPtr& dmn) {
         AddDMNEntryToList(ret, pwallet, dmn, fVerbose, fFromWallet);
     });
-    return ret;
+    ret.EndArray();
+    return ret.GetResult();
 }
 
 
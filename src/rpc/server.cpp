@@ -25,13 +25,87 @@
 
 #include <univalue.h>
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <memory> // for unique_ptr
+#include <thread>
 
 static bool fRPCRunning = false;
 static bool fRPCInWarmup = true;
 static std::string rpcWarmupStatus("RPC server started");
 static RecursiveMutex cs_rpcWarmup;
 
+/**
+ * Threads helping the HTTP workers with the elements of the JSON-RPC batches.
+ * The worker that received a batch runs its elements too, so a batch never waits on the
+ * helpers: they only make it finish earlier when they are idle.
+ */
+class RPCBatchExecutor
+{
+private:
+    Mutex cs;
+    std::condition_variable cond;
+    std::deque<std::function<void()> > queue;
+    bool fStop{false};
+    std::vector<std::thread> threads;
+
+    void ThreadRun()
+    {
+        while (true) {
+            std::function<void()> task;
+            {
+                WAIT_LOCK(cs, lock);
+                while (!fStop && queue.empty()) {
+                    cond.wait(lock);
+                }
+                if (fStop) {
+                    return;
+                }
+                task = std::move(queue.front());
+                queue.pop_front();
+            }
+            task();
+        }
+    }
+
+public:
+    const int nThreads;
+
+    explicit RPCBatchExecutor(int nThreadsIn) : nThreads(nThreadsIn)
+    {
+        for (int i = 0; i < nThreads; i++) {
+            threads.emplace_back(&TraceThread<std::function<void()> >, "rpcbatch", std::function<void()>(std::bind(&RPCBatchExecutor::ThreadRun, this)));
+        }
+    }
+
+    ~RPCBatchExecutor()
+    {
+        {
+            LOCK(cs);
+            fStop = true;
+        }
+        cond.notify_all();
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+
+    void Push(std::function<void()> task)
+    {
+        {
+            LOCK(cs);
+            queue.push_back(std::move(task));
+        }
+        cond.notify_one();
+    }
+};
+
+static Mutex cs_rpcBatch;
+//! Shared with the batches running, which may still be when RPC is stopped
+static std::shared_ptr<RPCBatchExecutor> g_rpc_batch_executor GUARDED_BY(cs_rpcBatch);
+static int g_rpc_batch_concurrency GUARDED_BY(cs_rpcBatch) = DEFAULT_RPC_BATCH_CONCURRENCY;
+
 /* Timer-creating functions */
 static RPCTimerInterface* timerInterface = NULL;
 /* Map of name to timer. */
@@ -308,6 +382,14 @@ bool CRPCTable::appendCommand(const std::string& name, const CRPCCommand* pcmd)
 bool StartRPC()
 {
     LogPrint(BCLog::RPC, "Starting RPC\n");
+    const int nBatchThreads = std::max(0, (int)gArgs.GetArg("-rpcbatchthreads", DEFAULT_RPC_BATCH_THREADS));
+    {
+        LOCK(cs_rpcBatch);
+        g_rpc_batch_concurrency = std::max(1, (int)gArgs.GetArg("-rpcbatchconcurrency", DEFAULT_RPC_BATCH_CONCURRENCY));
+        if (nBatchThreads > 0 && g_rpc_batch_concurrency > 1) {
+            g_rpc_batch_executor = std::make_shared<RPCBatchExecutor>(nBatchThreads);
+        }
+    }
     fRPCRunning = true;
     g_rpcSignals.Started();
     return true;
@@ -324,6 +406,7 @@ void StopRPC()
 {
     LogPrint(BCLog::RPC, "Stopping RPC\n");
     deadlineTimers.clear();
+    WITH_LOCK(cs_rpcBatch, g_rpc_batch_executor.reset());
     g_rpcSignals.Stopped();
 }
 
@@ -410,11 +493,95 @@ static UniValue JSONRPCExecOne(const UniValue& req)
     return rpc_result;
 }
 
+static bool IsConcurrentRequest(const UniValue& req)
+{
+    if (!req.isObject()) {
+        return false;
+    }
+    const UniValue& method = find_value(req.get_obj(), "method");
+    if (!method.isStr()) {
+        return false;
+    }
+    const CRPCCommand* pcmd = tableRPC[method.get_str()];
+    return pcmd && pcmd->okConcurrent;
+}
+
+/** The elements [begin, end) of a batch, taken in turn by the worker and the helpers */
+struct BatchRun
+{
+    const UniValue& vReq;
+    const size_t begin;
+    const size_t end;
+    std::vector<UniValue> results;
+    std::atomic<size_t> next;
+
+    Mutex cs;
+    std::condition_variable cond;
+    size_t nDone{0};
+
+    BatchRun(const UniValue& vReqIn, size_t beginIn, size_t endIn) :
+        vReq(vReqIn), begin(beginIn), end(endIn), results(endIn - beginIn), next(beginIn) {}
+
+    /** Run elements until there are none left to take */
+    void Run()
+    {
+        size_t nRun = 0;
+        for (size_t idx = next++; idx < end; idx = next++) {
+            results[idx - begin] = JSONRPCExecOne(vReq[idx]);
+            nRun++;
+        }
+        if (nRun > 0) {
+            {
+                LOCK(cs);
+                nDone += nRun;
+            }
+            cond.notify_all();
+        }
+    }
+};
+
 std::string JSONRPCExecBatch(const UniValue& vReq)
 {
+    std::shared_ptr<RPCBatchExecutor> executor;
+    size_t nConcurrency;
+    {
+        LOCK(cs_rpcBatch);
+        executor = g_rpc_batch_executor;
+        nConcurrency = g_rpc_batch_concurrency;
+    }
+
     UniValue ret(UniValue::VARR);
-    for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
-        ret.push_back(JSONRPCExecOne(vReq[reqIdx]));
+    for (size_t reqIdx = 0; reqIdx < vReq.size();) {
+        // The elements changing the state, or whose command is unknown, are run alone and in
+        // order. The runs of read only elements between them are spread over the helpers.
+        size_t reqEnd = reqIdx;
+        while (reqEnd < vReq.size() && IsConcurrentRequest(vReq[reqEnd])) {
+            reqEnd++;
+        }
+        if (reqEnd - reqIdx < 2 || !executor) {
+            reqEnd = std::max(reqEnd, reqIdx + 1);
+            for (; reqIdx < reqEnd; reqIdx++) {
+                ret.push_back(JSONRPCExecOne(vReq[reqIdx]));
+            }
+            continue;
+        }
+
+        // The helpers may start after the run is over: they then find no element left
+        auto run = std::make_shared<BatchRun>(vReq, reqIdx, reqEnd);
+        const size_t nHelpers = std::min({reqEnd - reqIdx - 1, nConcurrency - 1, (size_t)executor->nThreads});
+        for (size_t i = 0; i < nHelpers; i++) {
+            executor->Push([run]() { run->Run(); });
+        }
+        run->Run();
+        {
+            WAIT_LOCK(run->cs, lock);
+            run->cond.wait(lock, [&run]() { return run->nDone == run->results.size(); });
+        }
+        for (UniValue& result : run->results) {
+            ret.push_back(std::move(result));
+        }
+        reqIdx = reqEnd;
+    }
 
     return ret.write() + "\n";
 }
@@ -20,6 +20,11 @@
 
 class CRPCCommand;
 
+/** Default for -rpcbatchthreads, the threads running the elements of the JSON-RPC batches (0 = one after the other) */
+static const int DEFAULT_RPC_BATCH_THREADS = 4;
+/** Default for -rpcbatchconcurrency, the maximum number of elements of one batch running at once */
+static const int DEFAULT_RPC_BATCH_CONCURRENCY = 4;
+
 namespace RPCServer
 {
     void OnStarted(std::function<void ()> slot);
@@ -30,6 +35,7 @@ namespace RPCServer
 
 class CBlockIndex;
 class CNetAddr;
+class JSONStreamWriter;
 
 /** Wrapper for UniValue::VType, which includes typeAny:
  * Used to denote don't care type. Only used by RPCTypeCheckObj */
@@ -49,6 +55,11 @@ public:
     bool fHelp;
     std::string URI;
     std::string authUser;
+    /**
+     * Set when the transport sends the result as it is produced: the calls with large
+     * results write it there through an RPCResultWriter, and return NullUniValue.
+     */
+    JSONStreamWriter* stream{nullptr};
 
     JSONRPCRequest() { id = NullUniValue; params = NullUniValue; fHelp = false; }
     void parse(const UniValue& valRequest);
@@ -133,6 +144,8 @@ public:
     std::string name;
     rpcfn_type actor;
     bool okSafeMode;
+    //! Read only, and taking its own locks: can run concurrently with the other elements of a batch
+    bool okConcurrent{false};
 };
 
 /**
@@ -13,6 +13,7 @@
 #include "crypto/sha256.h"
 #include "pubkey.h"
 #include "script/script.h"
+#include "streams.h"
 #include "uint256.h"
 
 
@@ -1154,9 +1155,32 @@ uint256 GetShieldedOutputsHash(const CTransaction& txTo) {
     return ss.GetHash();
 }
 
+/** Appends to a byte vector of any allocator (CVectorWriter only takes std::vector). */
+template <typename Vector>
+class CAppendWriter
+{
+    const int nType;
+    const int nVersion;
+    Vector& vchData;
+
+public:
+    CAppendWriter(int nTypeIn, int nVersionIn, Vector& vchDataIn) : nType(nTypeIn), nVersion(nVersionIn), vchData(vchDataIn) {}
+
+    void write(const char* pch, size_t nSize)
+    {
+        vchData.insert(vchData.end(), reinterpret_cast<const unsigned char*>(pch), reinterpret_cast<const unsigned char*>(pch) + nSize);
+    }
+
+    int GetVersion() const { return nVersion; }
+    int GetType() const { return nType; }
+};
+
 } // anon namespace
 
-PrecomputedTransactionData::PrecomputedTransactionData(const CTransaction& txTo)
+PrecomputedTransactionData::PrecomputedTransactionData(const CTransaction& txTo, MonotonicResource* resource) :
+    vLegacyBlankTx(MonotonicAllocator<unsigned char>(resource)),
+    vLegacyInputPos(MonotonicAllocator<size_t>(resource)),
+    vLegacyMidstates(MonotonicAllocator<CHashWriter>(resource))
 {
     hashPrevouts = GetPrevoutHash(txTo);
     hashSequence = GetSequenceHash(txTo);
@@ -1165,6 +1189,33 @@ PrecomputedTransactionData::PrecomputedTransactionData(const CTransaction& txTo)
         hashShieldedSpends = GetShieldedSpendsHash(txTo);
         hashShieldedOutputs = GetShieldedOutputsHash(txTo);
     }
+    if (!txTo.isSaplingVersion() && txTo.vin.size() > 1) {
+        // Blanking the scripts only shrinks the transaction: allocate the buffer once
+        vLegacyBlankTx.reserve(::GetSerializeSize(txTo, SER_GETHASH, 0));
+        CAppendWriter<decltype(vLegacyBlankTx)> s(SER_GETHASH, 0, vLegacyBlankTx);
+        ::Serialize(s, txTo.nVersion);
+        ::Serialize(s, txTo.nType);
+        ::WriteCompactSize(s, txTo.vin.size());
+        vLegacyInputPos.reserve(txTo.vin.size() + 1);
+        for (const CTxIn& in : txTo.vin) {
+            vLegacyInputPos.push_back(vLegacyBlankTx.size());
+            ::Serialize(s, in.prevout);
+            ::Serialize(s, CScript());
+            ::Serialize(s, in.nSequence);
+        }
+        vLegacyInputPos.push_back(vLegacyBlankTx.size());
+        ::Serialize(s, txTo.vout);
+        ::Serialize(s, txTo.nLockTime);
+
+        CHashWriter ss(SER_GETHASH, 0);
+        size_t nPos = 0;
+        vLegacyMidstates.reserve(txTo.vin.size());
+        for (size_t n = 0; n < txTo.vin.size(); n++) {
+            ss.write((const char*)vLegacyBlankTx.data() + nPos, vLegacyInputPos[n] - nPos);
+            nPos = vLegacyInputPos[n];
+            vLegacyMidstates.push_back(ss);
+        }
+    }
 }
 
 uint256 SignatureHash(const CScript& scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType, const CAmount& amount, SigVersion sigversion, const PrecomputedTransactionData* cache)
@@ -1275,6 +1326,20 @@ uint256 SignatureHash(const CScript& scriptCode, const CTransaction& txTo, unsig
     // Wrapper to serialize only the necessary parts of the transaction being signed
     CTransactionSignatureSerializer txTmp(txTo, scriptCode, nIn, nHashType);
 
+    if (cache && nIn != NOT_AN_INPUT && cache->vLegacyMidstates.size() == txTo.vin.size() &&
+            !(nHashType & SIGHASH_ANYONECANPAY) && (nHashType & 0x1f) != SIGHASH_SINGLE && (nHashType & 0x1f) != SIGHASH_NONE) {
+        // Same serialization as below: resume from the state at the start of the input
+        // being signed, write it with scriptCode, then the rest of the blanked transaction.
+        CHashWriter ss(cache->vLegacyMidstates[nIn]);
+        ss << txTo.vin[nIn].prevout;
+        txTmp.SerializeScriptCode(ss);
+        ss << txTo.vin[nIn].nSequence;
+        const size_t nPos = cache->vLegacyInputPos[nIn + 1];
+        ss.write((const char*)cache->vLegacyBlankTx.data() + nPos, cache->vLegacyBlankTx.size() - nPos);
+        ss << nHashType;
+        return ss.GetHash();
+    }
+
     // Serialize and hash
     CHashWriter ss(SER_GETHASH, 0);
     ss << txTmp << nHashType;
@@ -1399,7 +1464,187 @@ bool TransactionSignatureChecker::CheckColdStake(bool fAllowLastOutputFree, cons
 }
 
 
+namespace {
+
+/** The size of the P2PKH and P2CS script templates, and the position of their key hashes. */
+const size_t P2PKH_SIZE = 25;
+const size_t P2PKH_HASH = 3;
+const size_t P2CS_SIZE = 51;
+const size_t P2CS_STAKER_HASH = 6;
+const size_t P2CS_OWNER_HASH = 28;
+
+bool MatchPayToPubKeyHash(const CScript& script)
+{
+    return script.size() == P2PKH_SIZE &&
+           script[0] == OP_DUP && script[1] == OP_HASH160 && script[2] == 0x14 &&
+           script[23] == OP_EQUALVERIFY && script[24] == OP_CHECKSIG;
+}
+
+bool MatchPayToColdStaking(const CScript& script)
+{
+    return script.size() == P2CS_SIZE &&
+           script[0] == OP_DUP && script[1] == OP_HASH160 && script[2] == OP_ROT && script[3] == OP_IF &&
+           (script[4] == OP_CHECKCOLDSTAKEVERIFY || script[4] == OP_CHECKCOLDSTAKEVERIFY_LOF) && script[5] == 0x14 &&
+           script[26] == OP_ELSE && script[27] == 0x14 && script[48] == OP_ENDIF &&
+           script[49] == OP_EQUALVERIFY && script[50] == OP_CHECKSIG;
+}
+
+/**
+ * Read a direct push of a signature or a public key at pc, that no flag can reject as
+ * non-minimal. Signatures of 20 bytes are refused: their push could be the one of a key
+ * hash in the script code, where CHECKSIG would have to FindAndDelete it.
+ */
+bool ReadKeyPush(const CScript& script, size_t& pc, size_t nMinSize, size_t nExclude, const unsigned char*& pdata, size_t& nSize)
+{
+    if (pc >= script.size())
+        return false;
+    nSize = script[pc];
+    if (nSize < nMinSize || nSize > 75 || nSize == nExclude || script.size() - pc - 1 < nSize)
+        return false;
+    pdata = &script[pc + 1];
+    pc += 1 + nSize;
+    return true;
+}
+
+/** Read the <sig> [<flag>] <pubkey> scriptSig of the P2PKH and P2CS templates. */
+bool ReadTemplateScriptSig(const CScript& scriptSig, bool fWithFlag, valtype& vchSig, valtype& vchPubKey, bool& fFlag)
+{
+    size_t pc = 0;
+    const unsigned char* pdata;
+    size_t nSize;
+    if (!ReadKeyPush(scriptSig, pc, 2, 20, pdata, nSize))
+        return false;
+    vchSig.assign(pdata, pdata + nSize);
+    if (fWithFlag) {
+        if (pc >= scriptSig.size() || (scriptSig[pc] != OP_0 && scriptSig[pc] != OP_1))
+            return false;
+        fFlag = scriptSig[pc++] == OP_1;
+    }
+    if (!ReadKeyPush(scriptSig, pc, 2, 0, pdata, nSize) || pc != scriptSig.size())
+        return false;
+    vchPubKey.assign(pdata, pdata + nSize);
+    return true;
+}
+
+/** The end of the P2PKH and P2CS scripts: <hash> OP_EQUALVERIFY OP_CHECKSIG. */
+bool CheckKeyHashAndSig(const valtype& vchSig, const valtype& vchPubKey, const unsigned char* pkeyhash, const CScript& scriptCode, unsigned int flags, const BaseSignatureChecker& checker, SigVersion sigversion, ScriptError* serror)
+{
+    unsigned char hash[20];
+    CHash160().Write(vchPubKey.data(), vchPubKey.size()).Finalize(hash);
+    if (memcmp(hash, pkeyhash, sizeof(hash)) != 0)
+        return set_error(serror, SCRIPT_ERR_EQUALVERIFY);
+    if (!CheckSignatureEncoding(vchSig, flags, serror) || !CheckPubKeyEncoding(vchPubKey, flags, serror)) {
+        // serror is set
+        return false;
+    }
+    if (!checker.CheckSig(vchSig, vchPubKey, scriptCode, sigversion))
+        return set_error(serror, SCRIPT_ERR_EVAL_FALSE);
+    return set_success(serror);
+}
+
+/**
+ * Verify the scripts without the generic interpreter when they are one of the standard
+ * templates: P2PKH, P2CS and the outer script of P2SH. Returns false if they are not,
+ * and otherwise sets fResult (and serror) exactly as VerifyScriptGeneric would.
+ */
+bool VerifyTemplateScript(const CScript& scriptSig, const CScript& scriptPubKey, unsigned int flags, const BaseSignatureChecker& checker, SigVersion sigversion, ScriptError* serror, bool& fResult)
+{
+    try {
+        if (MatchPayToPubKeyHash(scriptPubKey)) {
+            valtype vchSig, vchPubKey;
+            bool fFlag;
+            if (!ReadTemplateScriptSig(scriptSig, false, vchSig, vchPubKey, fFlag))
+                return false;
+            fResult = CheckKeyHashAndSig(vchSig, vchPubKey, &scriptPubKey[P2PKH_HASH], scriptPubKey, flags, checker, sigversion, serror);
+            return true;
+        }
+
+        if (MatchPayToColdStaking(scriptPubKey)) {
+            valtype vchSig, vchPubKey;
+            bool fStaker;
+            if (!ReadTemplateScriptSig(scriptSig, true, vchSig, vchPubKey, fStaker))
+                return false;
+            if (!fStaker) {
+                fResult = CheckKeyHashAndSig(vchSig, vchPubKey, &scriptPubKey[P2CS_OWNER_HASH], scriptPubKey, flags, checker, sigversion, serror);
+                return true;
+            }
+            // OP_CHECKCOLDSTAKEVERIFY ends the script, leaving <sig> <pubkey> <hash> on the stack
+            std::vector<valtype> stack(3);
+            stack[0] = std::move(vchSig);
+            stack[2].resize(20);
+            CHash160().Write(vchPubKey.data(), vchPubKey.size()).Finalize(stack[2].data());
+            stack[1] = std::move(vchPubKey);
+            set_error(serror, SCRIPT_ERR_UNKNOWN_ERROR);
+            if (!checker.CheckColdStake(scriptPubKey[4] == OP_CHECKCOLDSTAKEVERIFY_LOF, scriptPubKey, stack, flags, serror)) {
+                // serror is set
+                fResult = false;
+            } else if (!CastToBool(stack.back())) {
+                fResult = set_error(serror, SCRIPT_ERR_EVAL_FALSE);
+            } else {
+                fResult = set_success(serror);
+            }
+            return true;
+        }
+
+        if (scriptPubKey.IsPayToScriptHash() && scriptSig.IsPushOnly()) {
+            // As HASH160 <hash> EQUAL, without copying the stack for the redeem script
+            std::vector<valtype> stack;
+            if (!EvalScript(stack, scriptSig, flags, checker, sigversion, serror)) {
+                // serror is set
+                fResult = false;
+                return true;
+            }
+            if (stack.empty()) {
+                fResult = set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
+                return true;
+            }
+            if (stack.size() >= 1000) {
+                // the push of <hash> would exceed the stack size limit
+                fResult = set_error(serror, SCRIPT_ERR_STACK_SIZE);
+                return true;
+            }
+            unsigned char hash[20];
+            CHash160().Write(stack.back().data(), stack.back().size()).Finalize(hash);
+            if (memcmp(hash, &scriptPubKey[2], sizeof(hash)) != 0) {
+                fResult = set_error(serror, SCRIPT_ERR_EVAL_FALSE);
+                return true;
+            }
+            if (!(flags & SCRIPT_VERIFY_P2SH)) {
+                fResult = set_success(serror);
+                return true;
+            }
+
+            const valtype& pubKeySerialized = stack.back();
+            CScript pubKey2(pubKeySerialized.begin(), pubKeySerialized.end());
+            popstack(stack);
+            if (!EvalScript(stack, pubKey2, flags, checker, sigversion, serror)) {
+                // serror is set
+                fResult = false;
+            } else if (stack.empty() || !CastToBool(stack.back())) {
+                fResult = set_error(serror, SCRIPT_ERR_EVAL_FALSE);
+            } else {
+                fResult = set_success(serror);
+            }
+            return true;
+        }
+    } catch (...) {
+        fResult = set_error(serror, SCRIPT_ERR_UNKNOWN_ERROR);
+        return true;
+    }
+    return false;
+}
+
+} // anon namespace
+
 bool VerifyScript(const CScript& scriptSig, const CScript& scriptPubKey, unsigned int flags, const BaseSignatureChecker& checker, SigVersion sigversion, ScriptError* serror)
+{
+    bool fResult;
+    if (VerifyTemplateScript(scriptSig, scriptPubKey, flags, checker, sigversion, serror, fResult))
+        return fResult;
+    return VerifyScriptGeneric(scriptSig, scriptPubKey, flags, checker, sigversion, serror);
+}
+
+bool VerifyScriptGeneric(const CScript& scriptSig, const CScript& scriptPubKey, unsigned int flags, const BaseSignatureChecker& checker, SigVersion sigversion, ScriptError* serror)
 {
     set_error(serror, SCRIPT_ERR_UNKNOWN_ERROR);
 
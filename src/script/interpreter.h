@@ -7,8 +7,10 @@
 #ifndef BITCOIN_SCRIPT_INTERPRETER_H
 #define BITCOIN_SCRIPT_INTERPRETER_H
 
+#include "hash.h"
 #include "primitives/transaction.h"
 #include "script_error.h"
+#include "support/allocators/monotonic.h"
 #include "uint256.h"
 
 #include <vector>
@@ -89,7 +91,19 @@ struct PrecomputedTransactionData
 {
     uint256 hashPrevouts, hashSequence, hashOutputs, hashShieldedSpends, hashShieldedOutputs;
 
-    PrecomputedTransactionData(const CTransaction& tx);
+    /**
+     * For the legacy signature hash with SIGHASH_ALL, only the script of the input being signed
+     * differs from one input to the other: the transaction serialized with all the scripts blanked
+     * out, the position of each input in it (plus the end of the last one), and the hasher state
+     * at the start of each input. Only filled for legacy transactions with more than one input.
+     * They are allocated from the given resource if any (e.g. the arena of the block being
+     * connected), from the heap otherwise.
+     */
+    std::vector<unsigned char, MonotonicAllocator<unsigned char> > vLegacyBlankTx;
+    std::vector<size_t, MonotonicAllocator<size_t> > vLegacyInputPos;
+    std::vector<CHashWriter, MonotonicAllocator<CHashWriter> > vLegacyMidstates;
+
+    explicit PrecomputedTransactionData(const CTransaction& tx, MonotonicResource* resource = nullptr);
 };
 
 uint256 SignatureHash(const CScript &scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType, const CAmount& amount, SigVersion sigversion, const PrecomputedTransactionData* cache = nullptr);
@@ -146,5 +160,7 @@ public:
 
 bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript& script, unsigned int flags, const BaseSignatureChecker& checker, SigVersion sigversion, ScriptError* error = NULL);
 bool VerifyScript(const CScript& scriptSig, const CScript& scriptPubKey, unsigned int flags, const BaseSignatureChecker& checker, SigVersion sigversion, ScriptError* serror = NULL);
+/** VerifyScript without the fast paths for the standard templates, running every script through EvalScript. */
+bool VerifyScriptGeneric(const CScript& scriptSig, const CScript& scriptPubKey, unsigned int flags, const BaseSignatureChecker& checker, SigVersion sigversion, ScriptError* serror = NULL);
 
 #endif // BITCOIN_SCRIPT_INTERPRETER_H
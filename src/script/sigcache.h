@@ -10,9 +10,9 @@
 
 #include <vector>
 
-// DoS prevention: limit cache size to 32MB (over 1000000 entries on 64-bit
-// systems). Due to how we count cache size, actual memory usage is slightly
-// more (~32.25 MB)
+// DoS prevention: limit the sum of the signature and script execution cache sizes
+// to 32MB (over 1000000 entries on 64-bit systems). Due to how we count cache size,
+// actual memory usage is slightly more (~32.25 MB)
 static const unsigned int DEFAULT_MAX_SIG_CACHE_SIZE = 32;
 // Maximum sig cache size allowed
 static const int64_t MAX_MAX_SIG_CACHE_SIZE = 16384;
@@ -0,0 +1,92 @@
+// Copyright (c) 2020 The PIVX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "sigbatch.h"
+
+#include <algorithm>
+#include <functional>
+
+#include <boost/thread/thread.hpp>
+
+//! Below this many signatures per thread, starting the threads costs more than they save
+static const size_t MIN_SIGNATURES_PER_THREAD = 64;
+
+size_t CSignatureBatch::AddEntry(Entry&& entry)
+{
+    std::vector<size_t>& vSameHash = mapEntries[entry.hash];
+    for (size_t nEntry : vSameHash) {
+        if (vEntries[nEntry] == entry) {
+            vAdded.push_back(nEntry);
+            return vAdded.size() - 1;
+        }
+    }
+    vSameHash.push_back(vEntries.size());
+    vAdded.push_back(vEntries.size());
+    vEntries.emplace_back(std::move(entry));
+    return vAdded.size() - 1;
+}
+
+size_t CSignatureBatch::Add(const CPubKey& pubkey, const uint256& hash, const std::vector<unsigned char>& vchSig)
+{
+    auto it = mapPubKeys.emplace(pubkey, (int)vPubKeys.size());
+    if (it.second)
+        vPubKeys.push_back(pubkey);
+    return AddEntry(Entry{hash, vchSig, it.first->second, CKeyID()});
+}
+
+size_t CSignatureBatch::AddCompact(const CKeyID& keyID, const uint256& hash, const std::vector<unsigned char>& vchSig)
+{
+    return AddEntry(Entry{hash, vchSig, -1, keyID});
+}
+
+void CSignatureBatch::clear()
+{
+    vPubKeys.clear();
+    mapPubKeys.clear();
+    vEntries.clear();
+    mapEntries.clear();
+    vAdded.clear();
+}
+
+bool CSignatureBatch::Verify(int nThreads, std::vector<bool>* pvResults) const
+{
+    std::vector<CParsedPubKey> vParsed;
+    vParsed.reserve(vPubKeys.size());
+    for (const CPubKey& pubkey : vPubKeys) {
+        vParsed.emplace_back(pubkey);
+    }
+
+    // One byte per entry, as the threads write their results concurrently
+    std::vector<unsigned char> vValid(vEntries.size(), 0);
+    auto verifyRange = [this, &vParsed, &vValid](size_t nBegin, size_t nEnd) {
+        for (size_t i = nBegin; i < nEnd; i++) {
+            const Entry& entry = vEntries[i];
+            if (entry.nKey >= 0) {
+                vValid[i] = vParsed[entry.nKey].Verify(entry.hash, entry.vchSig);
+            } else {
+                CPubKey pubkeyFromSig;
+                vValid[i] = pubkeyFromSig.RecoverCompact(entry.hash, entry.vchSig) && pubkeyFromSig.GetID() == entry.keyID;
+            }
+        }
+    };
+
+    nThreads = std::max(1, std::min(nThreads, (int)(vEntries.size() / MIN_SIGNATURES_PER_THREAD)));
+    const size_t nPerThread = (vEntries.size() + nThreads - 1) / nThreads;
+    boost::thread_group threads;
+    for (int i = 1; i < nThreads; i++) {
+        const size_t nBegin = std::min(vEntries.size(), i * nPerThread);
+        const size_t nEnd = std::min(vEntries.size(), nBegin + nPerThread);
+        threads.create_thread(std::bind(verifyRange, nBegin, nEnd));
+    }
+    verifyRange(0, std::min(vEntries.size(), nPerThread));
+    threads.join_all();
+
+    if (pvResults) {
+        pvResults->resize(vAdded.size());
+        for (size_t i = 0; i < vAdded.size(); i++) {
+            (*pvResults)[i] = vValid[vAdded[i]];
+        }
+    }
+    return std::all_of(vValid.begin(), vValid.end(), [](unsigned char fValid) { return fValid != 0; });
+}
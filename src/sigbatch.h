@@ -0,0 +1,97 @@
+// Copyright (c) 2020 The PIVX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef quirkyturt_SIGBATCH_H
+#define quirkyturt_SIGBATCH_H
+
+#include "pubkey.h"
+#include "script/interpreter.h"
+#include "uint256.h"
+
+#include <map>
+#include <vector>
+
+/**
+ * A batch of ECDSA signatures, verified all at once.
+ *
+ * It takes DER signatures by a known public key (checked like CPubKey::Verify, e.g. the
+ * block signatures), and compact signatures that must recover to a key id (checked like
+ * CHashSigner::VerifyHash, e.g. the tier two messages).
+ * Every public key is parsed once for all its signatures, identical entries are verified
+ * once, and large batches are split over several threads. There is no batch verification
+ * equation for ECDSA, so each signature is still verified on its own.
+ */
+class CSignatureBatch
+{
+private:
+    struct Entry {
+        uint256 hash;
+        std::vector<unsigned char> vchSig;
+        //! Index in vPubKeys of the key of a DER signature, -1 for a compact signature
+        int nKey;
+        //! The key id a compact signature must recover to
+        CKeyID keyID;
+
+        bool operator==(const Entry& other) const
+        {
+            return hash == other.hash && nKey == other.nKey && keyID == other.keyID && vchSig == other.vchSig;
+        }
+    };
+
+    //! The distinct public keys of the DER signatures
+    std::vector<CPubKey> vPubKeys;
+    std::map<CPubKey, int> mapPubKeys;
+
+    //! The distinct entries, and the distinct entries with a given hash
+    std::vector<Entry> vEntries;
+    std::map<uint256, std::vector<size_t>> mapEntries;
+
+    //! Index in vEntries of every entry added
+    std::vector<size_t> vAdded;
+
+    size_t AddEntry(Entry&& entry);
+
+public:
+    /** Add the DER signature vchSig of hash by pubkey. Returns the index of the entry. */
+    size_t Add(const CPubKey& pubkey, const uint256& hash, const std::vector<unsigned char>& vchSig);
+
+    /** Add the compact signature vchSig of hash by the key keyID. Returns the index of the entry. */
+    size_t AddCompact(const CKeyID& keyID, const uint256& hash, const std::vector<unsigned char>& vchSig);
+
+    size_t size() const { return vAdded.size(); }
+    bool empty() const { return vAdded.empty(); }
+    void clear();
+
+    /**
+     * Verify all the entries, using up to nThreads threads.
+     * Returns whether they are all valid. pvResults, if given, is set to the result of
+     * every entry, in the order they were added.
+     */
+    bool Verify(int nThreads = 1, std::vector<bool>* pvResults = nullptr) const;
+};
+
+/**
+ * A transaction signature checker that adds the signatures to a batch instead of verifying
+ * them, so that the script succeeds as if they were valid.
+ * Only use it for scripts that fail unless their signatures are valid (i.e. that don't branch
+ * on the result of a CHECKSIG, like the P2PK, P2PKH and P2CS scripts), and verify the batch.
+ */
+class BatchingTransactionSignatureChecker : public TransactionSignatureChecker
+{
+private:
+    CSignatureBatch& batch;
+
+protected:
+    bool VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& pubkey, const uint256& sighash) const override
+    {
+        batch.Add(pubkey, sighash, vchSig);
+        return true;
+    }
+
+public:
+    BatchingTransactionSignatureChecker(const CTransaction* txToIn, unsigned int nInIn, const CAmount& amountIn, CSignatureBatch& batchIn) :
+        TransactionSignatureChecker(txToIn, nInIn, amountIn), batch(batchIn) {}
+};
+
+#endif // quirkyturt_SIGBATCH_H
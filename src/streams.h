@@ -362,6 +362,52 @@ private:
     size_t nPos;
 };
 
+/* Minimal stream for reading from an existing memory area (e.g. a memory mapped file),
+ * without copying it.
+ */
+class CMemoryReader
+{
+private:
+    const int nType;
+    const int nVersion;
+    const unsigned char* pdata;
+    size_t nRemaining;
+
+public:
+    CMemoryReader(int nTypeIn, int nVersionIn, const unsigned char* pdataIn, size_t nSizeIn) : nType(nTypeIn), nVersion(nVersionIn), pdata(pdataIn), nRemaining(nSizeIn) {}
+
+    void read(char* pch, size_t nSize)
+    {
+        if (nSize > nRemaining) {
+            throw std::ios_base::failure("CMemoryReader::read(): end of data");
+        }
+        if (nSize) {
+            memcpy(pch, pdata, nSize);
+        }
+        pdata += nSize;
+        nRemaining -= nSize;
+    }
+    void ignore(size_t nSize)
+    {
+        if (nSize > nRemaining) {
+            throw std::ios_base::failure("CMemoryReader::ignore(): end of data");
+        }
+        pdata += nSize;
+        nRemaining -= nSize;
+    }
+    template<typename T>
+    CMemoryReader& operator>>(T&& obj)
+    {
+        // Unserialize from this stream
+        ::Unserialize(*this, obj);
+        return (*this);
+    }
+    int GetVersion() const { return nVersion; }
+    int GetType() const { return nType; }
+    size_t size() const { return nRemaining; }
+    bool empty() const { return nRemaining == 0; }
+};
+
 class CDataStream : public CBaseDataStream<CSerializeData>
 {
 public:
@@ -0,0 +1,173 @@
+// Copyright (c) 2022 The PIVX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SUPPORT_ALLOCATORS_MONOTONIC_H
+#define BITCOIN_SUPPORT_ALLOCATORS_MONOTONIC_H
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+/**
+ * A memory resource similar to std::pmr::monotonic_buffer_resource, for temporaries that all
+ * die together (e.g. the ones of the validation of a block).
+ *
+ * Allocations are carved one after the other out of large chunks (256 KiB by default), and
+ * deallocations do nothing, except for the last allocation which is given back (so a vector
+ * growing at the end of the chunk is reallocated in place). All the memory is reclaimed at
+ * once by Release(), which keeps the first chunk for the next round.
+ *
+ * Not thread safe: all allocations and deallocations must be externally synchronized.
+ */
+class MonotonicResource
+{
+    const std::size_t m_chunk_size_bytes;
+    //! The chunks taken from the system, the first one being kept across releases
+    std::vector<std::pair<char*, std::size_t> > m_chunks;
+    //! Untouched memory left in the current chunk
+    char* m_available_memory_it = nullptr;
+    char* m_available_memory_end = nullptr;
+    //! The last allocation, which can be given back
+    char* m_last_allocation = nullptr;
+
+    //! Statistics since the last release
+    std::size_t m_num_allocations = 0;
+    std::size_t m_allocated_bytes = 0;
+
+    void AllocateChunk(std::size_t min_bytes)
+    {
+        const std::size_t bytes = min_bytes > m_chunk_size_bytes ? min_bytes : m_chunk_size_bytes;
+        char* chunk = static_cast<char*>(::operator new(bytes));
+        m_chunks.emplace_back(chunk, bytes);
+        m_available_memory_it = chunk;
+        m_available_memory_end = chunk + bytes;
+    }
+
+public:
+    static constexpr std::size_t DEFAULT_CHUNK_SIZE_BYTES = 262144;
+
+    explicit MonotonicResource(std::size_t chunk_size_bytes) : m_chunk_size_bytes(chunk_size_bytes)
+    {
+        // The first chunk is allocated lazily, like in PoolResource.
+    }
+
+    MonotonicResource() : MonotonicResource(DEFAULT_CHUNK_SIZE_BYTES) {}
+
+    MonotonicResource(const MonotonicResource&) = delete;
+    MonotonicResource& operator=(const MonotonicResource&) = delete;
+
+    ~MonotonicResource()
+    {
+        for (const auto& chunk : m_chunks) {
+            ::operator delete(chunk.first);
+        }
+    }
+
+    void* Allocate(std::size_t bytes, std::size_t alignment)
+    {
+        assert(alignment > 0 && (alignment & (alignment - 1)) == 0 && alignment <= alignof(std::max_align_t));
+        std::size_t padding = -reinterpret_cast<std::uintptr_t>(m_available_memory_it) & (alignment - 1);
+        if (m_available_memory_it == nullptr || padding + bytes > static_cast<std::size_t>(m_available_memory_end - m_available_memory_it)) {
+            // Chunks from operator new are aligned for any type
+            AllocateChunk(bytes);
+            padding = 0;
+        }
+        m_last_allocation = m_available_memory_it + padding;
+        m_available_memory_it = m_last_allocation + bytes;
+        m_num_allocations++;
+        m_allocated_bytes += bytes;
+        return m_last_allocation;
+    }
+
+    void Deallocate(void* p, std::size_t bytes) noexcept
+    {
+        if (p == m_last_allocation && m_last_allocation + bytes == m_available_memory_it) {
+            m_available_memory_it = m_last_allocation;
+            m_last_allocation = nullptr;
+        }
+    }
+
+    /** Reclaim all the memory allocated so far. Nothing allocated from it may be used after that. */
+    void Release() noexcept
+    {
+        if (!m_chunks.empty()) {
+            for (std::size_t i = 1; i < m_chunks.size(); i++) {
+                ::operator delete(m_chunks[i].first);
+            }
+            m_chunks.resize(1);
+            m_available_memory_it = m_chunks[0].first;
+            m_available_memory_end = m_chunks[0].first + m_chunks[0].second;
+        }
+        m_last_allocation = nullptr;
+        m_num_allocations = 0;
+        m_allocated_bytes = 0;
+    }
+
+    std::size_t NumAllocations() const { return m_num_allocations; }
+    std::size_t AllocatedBytes() const { return m_allocated_bytes; }
+    std::size_t NumAllocatedChunks() const { return m_chunks.size(); }
+};
+
+/**
+ * Standard allocator forwarding to a MonotonicResource. Like PoolAllocator, a default
+ * constructed allocator has no resource and uses ::operator new.
+ */
+template <class T>
+class MonotonicAllocator
+{
+    MonotonicResource* m_resource;
+
+    template <typename U>
+    friend class MonotonicAllocator;
+
+public:
+    typedef T value_type;
+
+    template <typename U>
+    struct rebind {
+        typedef MonotonicAllocator<U> other;
+    };
+
+    MonotonicAllocator() noexcept : m_resource(nullptr) {}
+    explicit MonotonicAllocator(MonotonicResource* resource) noexcept : m_resource(resource) {}
+
+    template <typename U>
+    MonotonicAllocator(const MonotonicAllocator<U>& other) noexcept : m_resource(other.m_resource) {}
+
+    T* allocate(std::size_t n)
+    {
+        if (m_resource == nullptr) {
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        }
+        return static_cast<T*>(m_resource->Allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept
+    {
+        if (m_resource == nullptr) {
+            ::operator delete(p);
+            return;
+        }
+        m_resource->Deallocate(p, n * sizeof(T));
+    }
+
+    MonotonicResource* resource() const noexcept { return m_resource; }
+
+    template <typename U>
+    bool operator==(const MonotonicAllocator<U>& other) const noexcept
+    {
+        return m_resource == other.m_resource;
+    }
+
+    template <typename U>
+    bool operator!=(const MonotonicAllocator<U>& other) const noexcept
+    {
+        return !(*this == other);
+    }
+};
+
+#endif // BITCOIN_SUPPORT_ALLOCATORS_MONOTONIC_H
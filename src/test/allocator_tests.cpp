@@ -4,6 +4,9 @@
 
 #include "util.h"
 
+#include "memusage.h"
+#include "support/allocators/monotonic.h"
+#include "support/allocators/pool.h"
 #include "support/allocators/zeroafterfree.h"
 #include "test/test_quirkyturt.h"
 
@@ -221,4 +224,125 @@ BOOST_AUTO_TEST_CASE(lockedpool_tests_live)
     BOOST_CHECK(pool.stats().used == initial.used);
 }
 
+BOOST_AUTO_TEST_CASE(pool_resource_tests)
+{
+    PoolResource<64, 8> resource(1024);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 0U);
+
+    // Blocks are carved out of the chunk, and reused once freed
+    void* a = resource.Allocate(24, 8);
+    void* b = resource.Allocate(24, 8);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1U);
+    BOOST_CHECK_EQUAL((char*)b - (char*)a, 24);
+    resource.Deallocate(a, 24, 8);
+    BOOST_CHECK(resource.Allocate(17, 8) == a); // same size class (24 bytes)
+    resource.Deallocate(b, 24, 8);
+    BOOST_CHECK(resource.Allocate(8, 8) != b); // different size class
+
+    // Too large for the pool: served by operator new
+    void* big = resource.Allocate(65, 8);
+    resource.Deallocate(big, 65, 8);
+
+    // Fill up the first chunk: a second one is allocated
+    for (int i = 0; i < 1024 / 64; i++) {
+        resource.Allocate(64, 8);
+    }
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 2U);
+    BOOST_CHECK_EQUAL(resource.ChunkSizeBytes(), 1024U);
+}
+
+BOOST_AUTO_TEST_CASE(pool_allocator_map_tests)
+{
+    typedef std::unordered_map<uint64_t, uint64_t, std::hash<uint64_t>, std::equal_to<uint64_t>,
+                               PoolAllocator<std::pair<const uint64_t, uint64_t>, 48> > PoolMap;
+    PoolMap::allocator_type::ResourceType resource(4096);
+    {
+        PoolMap map(0, std::hash<uint64_t>(), std::equal_to<uint64_t>(), PoolMap::allocator_type(&resource));
+        for (uint64_t i = 0; i < 1000; i++) {
+            map[i] = i * 2;
+        }
+        for (uint64_t i = 0; i < 1000; i += 2) {
+            map.erase(i);
+        }
+        BOOST_CHECK_EQUAL(map.size(), 500U);
+        for (uint64_t i = 1; i < 1000; i += 2) {
+            BOOST_CHECK_EQUAL(map[i], i * 2);
+        }
+        // The memory usage accounts for whole chunks
+        const size_t chunks = resource.NumAllocatedChunks();
+        BOOST_CHECK(chunks > 0);
+        BOOST_CHECK(memusage::DynamicUsage(map) >= chunks * 4096);
+        // Erased nodes are reused
+        for (uint64_t i = 0; i < 1000; i += 2) {
+            map[i] = i;
+        }
+        BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), chunks);
+    }
+
+    // Without resource, plain operator new is used
+    PoolMap map;
+    map[1] = 1;
+    BOOST_CHECK(map.get_allocator().resource() == nullptr);
+    BOOST_CHECK(memusage::DynamicUsage(map) > 0);
+}
+
+BOOST_AUTO_TEST_CASE(monotonic_resource_tests)
+{
+    MonotonicResource resource(1024);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 0U);
+
+    // Allocations follow each other, aligned
+    char* a = (char*)resource.Allocate(3, 1);
+    char* b = (char*)resource.Allocate(8, 8);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1U);
+    BOOST_CHECK_EQUAL(b - a, 8);
+    BOOST_CHECK_EQUAL(resource.NumAllocations(), 2U);
+    BOOST_CHECK_EQUAL(resource.AllocatedBytes(), 11U);
+
+    // Only the last allocation is given back
+    resource.Deallocate(a, 3);
+    BOOST_CHECK((char*)resource.Allocate(1, 1) == b + 8);
+    char* c = (char*)resource.Allocate(16, 8);
+    resource.Deallocate(c, 16);
+    BOOST_CHECK((char*)resource.Allocate(16, 8) == c);
+
+    // Larger than a chunk: gets a chunk of its own
+    resource.Allocate(4096, 8);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 2U);
+    resource.Allocate(1000, 8);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 3U);
+
+    // The first chunk is kept, and reused from its start
+    resource.Release();
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1U);
+    BOOST_CHECK_EQUAL(resource.NumAllocations(), 0U);
+    BOOST_CHECK_EQUAL(resource.AllocatedBytes(), 0U);
+    BOOST_CHECK((char*)resource.Allocate(8, 8) == a);
+}
+
+BOOST_AUTO_TEST_CASE(monotonic_allocator_vector_tests)
+{
+    MonotonicResource resource(4096);
+    {
+        std::vector<uint64_t, MonotonicAllocator<uint64_t> > vec{MonotonicAllocator<uint64_t>(&resource)};
+        for (uint64_t i = 0; i < 1000; i++) {
+            vec.push_back(i * 2);
+        }
+        for (uint64_t i = 0; i < 1000; i++) {
+            BOOST_CHECK_EQUAL(vec[i], i * 2);
+        }
+        // Each reallocation is a new allocation, the old buffers stay until released
+        BOOST_CHECK(resource.NumAllocations() > 1);
+        BOOST_CHECK(resource.AllocatedBytes() >= 1000 * sizeof(uint64_t));
+    }
+    resource.Release();
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1U);
+
+    // Without resource, plain operator new is used
+    std::vector<uint64_t, MonotonicAllocator<uint64_t> > vec;
+    vec.assign(100, 1);
+    BOOST_CHECK(vec.get_allocator().resource() == nullptr);
+    BOOST_CHECK(vec.get_allocator() == MonotonicAllocator<char>());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
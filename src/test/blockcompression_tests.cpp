@@ -0,0 +1,96 @@
+// Copyright (c) 2020 The PIVX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "test/test_quirkyturt.h"
+
+#include "blockcompression.h"
+
+#include <boost/test/unit_test.hpp>
+
+namespace block_tests {
+#include "data/block2680960.raw.h"
+}
+
+BOOST_FIXTURE_TEST_SUITE(blockcompression_tests, BasicTestingSetup)
+
+static void CheckRoundTrip(const std::vector<unsigned char>& vData)
+{
+    std::vector<unsigned char> vFrame;
+    std::vector<unsigned char> vRaw;
+    CompressBlockFrame(vData.data(), vData.size(), vFrame);
+    BOOST_CHECK(DecompressBlockFrame(vFrame.data(), vFrame.size(), vRaw, vData.size()));
+    BOOST_CHECK(vRaw == vData);
+}
+
+BOOST_AUTO_TEST_CASE(round_trip)
+{
+    for (int i = 0; i < 200; i++) {
+        std::vector<unsigned char> vData(InsecureRandRange(i < 100 ? 40 : 100000));
+        const int nMode = i % 3;
+        for (size_t j = 0; j < vData.size(); j++) {
+            if (nMode == 0) {
+                vData[j] = InsecureRand32(); // incompressible
+            } else if (nMode == 1) {
+                vData[j] = InsecureRandRange(4); // small alphabet
+            } else {
+                // repeats of earlier data, including overlapping ones
+                vData[j] = j > 16 && InsecureRandRange(4) ? vData[j - 1 - InsecureRandRange(16)] : InsecureRand32();
+            }
+        }
+        CheckRoundTrip(vData);
+    }
+
+    // Long runs exercise the extended lengths
+    CheckRoundTrip(std::vector<unsigned char>(100000, 0x42));
+}
+
+BOOST_AUTO_TEST_CASE(compresses)
+{
+    std::vector<unsigned char> vData(10000);
+    for (size_t j = 0; j < vData.size(); j++) {
+        vData[j] = j % 100;
+    }
+    std::vector<unsigned char> vFrame;
+    CompressBlockFrame(vData.data(), vData.size(), vFrame);
+    BOOST_CHECK(vFrame.size() < vData.size() / 10);
+}
+
+BOOST_AUTO_TEST_CASE(compresses_block)
+{
+    // A mainnet block, as stored on disk: the frame must be worth its header
+    const std::vector<unsigned char> vBlock(std::begin(block_tests::block2680960), std::end(block_tests::block2680960));
+    std::vector<unsigned char> vFrame;
+    CompressBlockFrame(vBlock.data(), vBlock.size(), vFrame);
+    BOOST_TEST_MESSAGE("block2680960: " << vBlock.size() << " bytes raw, " << vFrame.size() << " bytes compressed");
+    BOOST_CHECK_LT(vFrame.size(), vBlock.size());
+    CheckRoundTrip(vBlock);
+}
+
+BOOST_AUTO_TEST_CASE(malformed_frames)
+{
+    std::vector<unsigned char> vData(5000);
+    for (size_t j = 0; j < vData.size(); j++) {
+        vData[j] = InsecureRandRange(8);
+    }
+    std::vector<unsigned char> vFrame;
+    std::vector<unsigned char> vRaw;
+    CompressBlockFrame(vData.data(), vData.size(), vFrame);
+
+    // Uncompressed size over the limit
+    BOOST_CHECK(!DecompressBlockFrame(vFrame.data(), vFrame.size(), vRaw, vData.size() - 1));
+    // Truncated frames
+    BOOST_CHECK(!DecompressBlockFrame(vFrame.data(), BLOCK_FRAME_HEADER_SIZE, vRaw, vData.size()));
+    BOOST_CHECK(!DecompressBlockFrame(vFrame.data(), vFrame.size() - 1, vRaw, vData.size()));
+
+    // Corrupted data is either rejected or decompressed to the wrong content, never read or written out of bounds
+    for (int i = 0; i < 1000; i++) {
+        std::vector<unsigned char> vCorrupted(vFrame);
+        vCorrupted[BLOCK_FRAME_HEADER_SIZE + InsecureRandRange(vCorrupted.size() - BLOCK_FRAME_HEADER_SIZE)] ^= 1 + InsecureRandRange(255);
+        if (DecompressBlockFrame(vCorrupted.data(), vCorrupted.size(), vRaw, vData.size())) {
+            BOOST_CHECK_EQUAL(vRaw.size(), vData.size());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
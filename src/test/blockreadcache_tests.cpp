@@ -0,0 +1,110 @@
+// Copyright (c) 2020 The PIVX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "test/test_quirkyturt.h"
+
+#include "blockreadcache.h"
+#include "clientversion.h"
+#include "primitives/transaction.h"
+#include "streams.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockreadcache_tests, TestingSetup)
+
+static std::shared_ptr<const CBlock> MakeBlock(int nTxs)
+{
+    auto pblock = std::make_shared<CBlock>();
+    for (int i = 0; i < nTxs; i++) {
+        CMutableTransaction mtx;
+        mtx.vin.resize(1);
+        mtx.vin[0].prevout = COutPoint(InsecureRand256(), 0);
+        mtx.vout.resize(1);
+        mtx.vout[0].nValue = i;
+        pblock->vtx.push_back(MakeTransactionRef(mtx));
+    }
+    pblock->nNonce = InsecureRand32();
+    return pblock;
+}
+
+BOOST_AUTO_TEST_CASE(block_lru)
+{
+    CBlockReadCache cache;
+    std::vector<std::shared_ptr<const CBlock> > blocks;
+    for (int i = 0; i < 4; i++) {
+        blocks.push_back(MakeBlock(10));
+    }
+    const size_t nBlockUsage = CBlockReadCache::BlockMemoryUsage(*blocks[0]);
+
+    // Disabled by default
+    cache.AddBlock(blocks[0]->GetHash(), blocks[0]);
+    BOOST_CHECK(!cache.GetBlock(blocks[0]->GetHash()));
+
+    // Room for three blocks
+    cache.SetMaxMemory(nBlockUsage * 3 + nBlockUsage / 2);
+    for (int i = 0; i < 3; i++) {
+        cache.AddBlock(blocks[i]->GetHash(), blocks[i]);
+    }
+    BOOST_CHECK(cache.GetBlock(blocks[0]->GetHash()) == blocks[0]);
+    BOOST_CHECK_EQUAL(cache.GetStats().nBlocks, 3U);
+
+    // blocks[1] is the least recently used one
+    cache.AddBlock(blocks[3]->GetHash(), blocks[3]);
+    BOOST_CHECK_EQUAL(cache.GetStats().nBlocks, 3U);
+    BOOST_CHECK(!cache.GetBlock(blocks[1]->GetHash()));
+    BOOST_CHECK(cache.GetBlock(blocks[0]->GetHash()) == blocks[0]);
+    BOOST_CHECK(cache.GetBlock(blocks[2]->GetHash()) == blocks[2]);
+    BOOST_CHECK(cache.GetBlock(blocks[3]->GetHash()) == blocks[3]);
+    BOOST_CHECK(cache.GetStats().nMemoryUsage <= nBlockUsage * 3 + nBlockUsage / 2);
+    BOOST_CHECK_EQUAL(cache.GetStats().nHits, 4U);
+    BOOST_CHECK_EQUAL(cache.GetStats().nMisses, 1U);
+
+    // Shrinking the budget evicts
+    cache.SetMaxMemory(nBlockUsage);
+    BOOST_CHECK_EQUAL(cache.GetStats().nBlocks, 1U);
+    cache.Clear();
+    BOOST_CHECK_EQUAL(cache.GetStats().nBlocks, 0U);
+    BOOST_CHECK_EQUAL(cache.GetStats().nMemoryUsage, 0U);
+}
+
+BOOST_AUTO_TEST_CASE(mapped_files)
+{
+    CBlockReadCache cache;
+    cache.SetMaxMemory(1 << 20);
+    const fs::path path = GetDataDir() / "blk_mapped_test.dat";
+
+    std::shared_ptr<const CBlock> pblock = MakeBlock(3);
+    {
+        CAutoFile file(fsbridge::fopen(path, "wb"), SER_DISK, CLIENT_VERSION);
+        file << *pblock;
+    }
+
+    std::shared_ptr<const CMappedBlockFile> mapped = cache.GetMappedFile(0, "blk", path, 1);
+#ifndef WIN32
+    if (sizeof(void*) == 8) {
+        BOOST_REQUIRE(mapped);
+        CBlock block;
+        CMemoryReader reader(SER_DISK, CLIENT_VERSION, mapped->data(), mapped->size());
+        reader >> block;
+        BOOST_CHECK(reader.empty());
+        BOOST_CHECK(block.GetHash() == pblock->GetHash());
+        BOOST_CHECK_EQUAL(block.vtx.size(), 3U);
+        // Reading past the end of the mapping throws
+        BOOST_CHECK_THROW(reader >> block, std::ios_base::failure);
+
+        // Mapped once, and mapped again when more data is needed
+        BOOST_CHECK(cache.GetMappedFile(0, "blk", path, 1) == mapped);
+        BOOST_CHECK(!cache.GetMappedFile(0, "blk", path, mapped->size() + 1));
+        BOOST_CHECK_EQUAL(cache.GetStats().nMappedFiles, 0U);
+    }
+#endif
+
+    // The file being written to is never mapped
+    cache.SetWriteFile(0);
+    BOOST_CHECK(!cache.GetMappedFile(0, "blk", path, 1));
+    BOOST_CHECK_EQUAL(cache.GetStats().nMappedFiles, 0U);
+    fs::remove(path);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -10,6 +10,7 @@
 
 #include "clientversion.h"
 #include "fs.h"
+#include "primitives/transaction.h"
 #include "utiltime.h"
 #include "validation.h"
 
@@ -64,4 +65,83 @@ BOOST_AUTO_TEST_CASE(May15)
     SetMockTime(0);
 }
 
+BOOST_AUTO_TEST_CASE(header_hash_cache)
+{
+    for (int32_t nVersion : {3, 4, 8}) {
+        CBlock block;
+        block.nVersion = nVersion;
+        block.nTime = 1600000000;
+        block.nBits = 0x1e0ffff0;
+        block.hashMerkleRoot = uint256S("0x01");
+
+        // Not memoized until CacheHash() is called
+        const uint64_t nHashes = GetBlockHeaderHashCount();
+        const uint256 hash = block.GetHash();
+        BOOST_CHECK(block.GetHash() == hash);
+        BOOST_CHECK_EQUAL(GetBlockHeaderHashCount() - nHashes, 2);
+        block.nNonce++;
+        const uint256 hash2 = block.GetHash();
+        BOOST_CHECK(hash2 != hash);
+        block.nNonce--;
+
+        // Then repeated calls, and copies, don't recompute it
+        const uint64_t nHashes2 = GetBlockHeaderHashCount();
+        BOOST_CHECK(block.CacheHash() == hash);
+        BOOST_CHECK(block.GetHash() == hash);
+        BOOST_CHECK(block.GetBlockHeader().GetHash() == hash);
+        BOOST_CHECK_EQUAL(GetBlockHeaderHashCount() - nHashes2, 1);
+
+        // Until the header is invalidated, or read again
+        block.nNonce++;
+        BOOST_CHECK(block.GetHash() == hash);
+        block.InvalidateHash();
+        BOOST_CHECK(block.GetHash() == hash2);
+        block.nNonce--;
+        BOOST_CHECK(block.CacheHash() == hash);
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        block.nNonce++;
+        ss << block;
+        block.nNonce--;
+        ss >> block;
+        BOOST_CHECK(block.GetHash() == hash2);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(parallel_transaction_checks, TestingSetup)
+{
+    // Enough transactions for CheckBlock to check them in chunks on the script check threads
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].scriptSig = CScript() << 1 << OP_0;
+    coinbase.vout.emplace_back(0, CScript() << OP_TRUE);
+    std::vector<CMutableTransaction> vTxes(200);
+    for (size_t i = 0; i < vTxes.size(); i++) {
+        vTxes[i].vin.emplace_back(COutPoint(InsecureRand256(), i));
+        vTxes[i].vout.emplace_back(1, CScript() << OP_CHECKSIG);
+    }
+    auto makeBlock = [&coinbase, &vTxes]() {
+        CBlock block;
+        block.vtx.push_back(MakeTransactionRef(coinbase));
+        for (const CMutableTransaction& mtx : vTxes) {
+            block.vtx.push_back(MakeTransactionRef(mtx));
+        }
+        return block;
+    };
+
+    CValidationState state;
+    BOOST_CHECK(CheckBlock(makeBlock(), state, false, false, false));
+
+    // The first invalid transaction of the block is reported, whichever chunk is checked first
+    vTxes[150].vin.push_back(vTxes[150].vin[0]);
+    state = CValidationState();
+    BOOST_CHECK(!CheckBlock(makeBlock(), state, false, false, false));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "bad-txns-inputs-duplicate");
+    vTxes[30].vout[0].nValue = -1;
+    for (int i = 0; i < 10; i++) {
+        state = CValidationState();
+        BOOST_CHECK(!CheckBlock(makeBlock(), state, false, false, false));
+        BOOST_CHECK_EQUAL(state.GetRejectReason(), "bad-txns-vout-negative");
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,76 @@
+// Copyright (c) 2020 The PIVX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "test/test_quirkyturt.h"
+
+#include "checkqueue.h"
+
+#include <atomic>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/thread/thread.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(checkqueue_tests, BasicTestingSetup)
+
+static std::atomic<int> nChecksRun;
+
+struct CountingCheck {
+    bool fOk;
+    CountingCheck() : fOk(true) {}
+    explicit CountingCheck(bool fOkIn) : fOk(fOkIn) {}
+    bool operator()()
+    {
+        nChecksRun++;
+        return fOk;
+    }
+    void swap(CountingCheck& x) { std::swap(fOk, x.fOk); }
+};
+
+static void RunChecks(int nThreads)
+{
+    CCheckQueue<CountingCheck> queue(16);
+    boost::thread_group tg;
+    for (int i = 0; i < nThreads; i++) {
+        tg.create_thread([&]{ queue.Thread(); });
+    }
+
+    for (int nRound = 0; nRound < 200; nRound++) {
+        nChecksRun = 0;
+        const bool fFail = nRound % 5 == 4;
+        size_t nTotal = 0;
+        CCheckQueueControl<CountingCheck> control(&queue);
+        for (int nBatch = 0; nBatch < 20; nBatch++) {
+            std::vector<CountingCheck> vChecks(InsecureRandRange(50));
+            if (fFail && nBatch == 10) {
+                vChecks.emplace_back(false);
+            }
+            nTotal += vChecks.size();
+            control.Add(vChecks);
+        }
+        BOOST_CHECK_EQUAL(control.Wait(), !fFail);
+        if (fFail) {
+            // The checks after the failure may be skipped
+            BOOST_CHECK(nChecksRun <= (int)nTotal);
+        } else {
+            // Every check ran exactly once
+            BOOST_CHECK_EQUAL(nChecksRun, (int)nTotal);
+        }
+    }
+
+    tg.interrupt_all();
+    tg.join_all();
+}
+
+BOOST_AUTO_TEST_CASE(checkqueue_no_workers)
+{
+    RunChecks(0);
+}
+
+BOOST_AUTO_TEST_CASE(checkqueue_workers)
+{
+    RunChecks(3);
+    RunChecks(20);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -7,6 +7,7 @@
 
 #include "coins.h"
 #include "script/standard.h"
+#include "txdb.h"
 #include "uint256.h"
 #include "undo.h"
 #include "utilstrencodings.h"
@@ -1320,4 +1321,73 @@ BOOST_AUTO_TEST_CASE(ccoins_write)
                     CheckWriteCoins(parent_value, child_value, parent_value, parent_flags, child_flags, parent_flags);
 }
 
+BOOST_AUTO_TEST_CASE(coins_async_flush)
+{
+    CCoinsViewDB db(1 << 20, true);
+    CCoinsViewAsyncFlush asyncFlush(&db, &db, true);
+    CCoinsViewCache cache(&asyncFlush);
+
+    std::vector<COutPoint> outpoints;
+    for (int i = 0; i < 1000; i++) {
+        COutPoint outpoint(InsecureRand256(), InsecureRandRange(10));
+        Coin coin;
+        coin.out.nValue = InsecureRand32();
+        coin.nHeight = 1;
+        cache.AddCoin(outpoint, std::move(coin), false);
+        outpoints.push_back(outpoint);
+    }
+    const uint256 hashBlock1 = InsecureRand256();
+    cache.SetBestBlock(hashBlock1);
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 0U);
+
+    // The flushed coins are readable while (and after) being written in the background
+    for (const COutPoint& outpoint : outpoints) {
+        BOOST_CHECK(cache.HaveCoin(outpoint));
+    }
+    BOOST_CHECK(asyncFlush.GetBestBlock() == hashBlock1);
+    BOOST_CHECK(asyncFlush.WaitForFlush());
+    for (const COutPoint& outpoint : outpoints) {
+        BOOST_CHECK(db.HaveCoin(outpoint));
+    }
+    BOOST_CHECK(db.GetBestBlock() == hashBlock1);
+
+    // Spends are visible through the snapshot before reaching the database
+    cache.SpendCoin(outpoints[0]);
+    const uint256 hashBlock2 = InsecureRand256();
+    cache.SetBestBlock(hashBlock2);
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK(!cache.HaveCoin(outpoints[0]));
+    BOOST_CHECK(cache.HaveCoin(outpoints[1]));
+    BOOST_CHECK(asyncFlush.GetBestBlock() == hashBlock2);
+    BOOST_CHECK(asyncFlush.WaitForFlush());
+    BOOST_CHECK(!db.HaveCoin(outpoints[0]));
+    BOOST_CHECK(db.GetBestBlock() == hashBlock2);
+}
+
+BOOST_AUTO_TEST_CASE(coins_insert_fetched)
+{
+    CCoinsView base;
+    CCoinsViewCache cache(&base);
+    const COutPoint outpoint(InsecureRand256(), 0);
+
+    Coin coin;
+    coin.out.nValue = 100;
+    coin.nHeight = 1;
+    cache.InsertFetchedCoin(outpoint, Coin(coin));
+    BOOST_CHECK(cache.HaveCoinInCache(outpoint));
+    BOOST_CHECK_EQUAL(cache.AccessCoin(outpoint).out.nValue, 100);
+    BOOST_CHECK(cache.DynamicMemoryUsage() > 0);
+
+    // Cached entries (e.g. already spent in this cache) are never overwritten
+    cache.SpendCoin(outpoint);
+    cache.InsertFetchedCoin(outpoint, Coin(coin));
+    BOOST_CHECK(!cache.HaveCoin(outpoint));
+
+    // Spent coins are not inserted
+    const COutPoint outpoint2(InsecureRand256(), 1);
+    cache.InsertFetchedCoin(outpoint2, Coin());
+    BOOST_CHECK(!cache.HaveCoinInCache(outpoint2));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -311,5 +311,50 @@ BOOST_AUTO_TEST_CASE(iterator_string_ordering)
 }
 
 
+BOOST_AUTO_TEST_CASE(dbwrapper_profiles)
+{
+    std::string strError;
+    BOOST_CHECK(CheckDBProfiles({"chainstate:blockcache=80", "evodb:compression=1", "blockindex:maxfilesize=4"}, strError));
+    BOOST_CHECK(!CheckDBProfiles({"chainstate"}, strError));
+    BOOST_CHECK(!CheckDBProfiles({"chainstate:blockcache"}, strError));
+    BOOST_CHECK(!CheckDBProfiles({"unknown:blockcache=10"}, strError));
+    BOOST_CHECK(!CheckDBProfiles({"chainstate:unknown=10"}, strError));
+    BOOST_CHECK(!CheckDBProfiles({"chainstate:blockcache=101"}, strError));
+    BOOST_CHECK(!CheckDBProfiles({"chainstate:compression=yes"}, strError));
+    BOOST_CHECK(!CheckDBProfiles({"chainstate:maxfilesize=0"}, strError));
+
+    gArgs.ForceSetArg("-dbprofile", "chainstate:blockcache=80");
+    BOOST_CHECK_EQUAL(GetDBProfile("chainstate").nBlockCachePercent, 80);
+    BOOST_CHECK_EQUAL(GetDBProfile("evodb").nBlockCachePercent, 50);
+    BOOST_CHECK_EQUAL(GetDBProfile("").nBlockCachePercent, 50);
+
+    {
+        fs::path ph = fs::temp_directory_path() / fs::unique_path();
+        CDBWrapper dbw(ph, (1 << 20), true, false, "chainstate");
+        CDBStats stats = dbw.GetStats();
+        BOOST_CHECK_EQUAL(stats.strName, "chainstate");
+        BOOST_CHECK_EQUAL(stats.nBlockCacheCapacity, (1U << 20) * 80 / 100);
+        BOOST_CHECK(!stats.vFilesPerLevel.empty());
+
+        // Reads of data compacted into table files go through the block cache
+        for (char key = 'a'; key <= 'z'; key++) {
+            BOOST_CHECK(dbw.Write(key, InsecureRand256()));
+        }
+        dbw.CompactFull();
+        uint256 res;
+        BOOST_CHECK(dbw.Read('k', res));
+        BOOST_CHECK(dbw.Read('k', res));
+        stats = dbw.GetStats();
+        BOOST_CHECK(stats.nBlockCacheMisses > 0);
+        BOOST_CHECK(stats.nBlockCacheHits > 0);
+
+        std::vector<CDBStats> vStats = GetAllDBStats();
+        BOOST_CHECK(std::any_of(vStats.begin(), vStats.end(), [](const CDBStats& s) { return s.strName == "chainstate"; }));
+    }
+    // Closed databases are not listed anymore
+    std::vector<CDBStats> vStats = GetAllDBStats();
+    BOOST_CHECK(std::none_of(vStats.begin(), vStats.end(), [](const CDBStats& s) { return s.strName == "chainstate"; }));
+    gArgs.ClearForcedArg("-dbprofile");
+}
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -584,4 +584,124 @@ BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
     SetMockTime(0);
 }
 
+BOOST_AUTO_TEST_CASE(MempoolReorgReAddTest)
+{
+    // Transactions spending random unspent outputs of the previous ones: chains, fans and diamonds
+    TestMemPoolEntryHelper entry;
+    std::vector<CMutableTransaction> vTxes(80);
+    std::vector<COutPoint> vUnspent;
+    for (CMutableTransaction& tx : vTxes) {
+        tx.vin.resize(1 + InsecureRandRange(3));
+        for (CTxIn& in : tx.vin) {
+            in.scriptSig = CScript() << OP_11;
+            if (!vUnspent.empty() && InsecureRandRange(8) != 0) {
+                const size_t nPos = InsecureRandRange(vUnspent.size());
+                in.prevout = vUnspent[nPos];
+                vUnspent[nPos] = vUnspent.back();
+                vUnspent.pop_back();
+            } else {
+                in.prevout = COutPoint(InsecureRand256(), 0);
+            }
+        }
+        tx.vout.resize(3);
+        for (CTxOut& out : tx.vout) {
+            out.scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+            out.nValue = COIN;
+        }
+        for (uint32_t n = 0; n < tx.vout.size(); n++) {
+            vUnspent.emplace_back(tx.GetHash(), n);
+        }
+    }
+
+    // Added in order, and as after a reorg: the descendants left in the mempool first,
+    // then the transactions of the disconnected block.
+    CTxMemPool pool(CFeeRate(0));
+    for (size_t i = 0; i < vTxes.size(); i++) {
+        pool.addUnchecked(vTxes[i].GetHash(), entry.Fee(1000 * (i + 1)).FromTx(vTxes[i]));
+    }
+    CTxMemPool poolReorg(CFeeRate(0));
+    const size_t nInBlock = 50;
+    for (size_t i = nInBlock; i < vTxes.size(); i++) {
+        poolReorg.addUnchecked(vTxes[i].GetHash(), entry.Fee(1000 * (i + 1)).FromTx(vTxes[i]));
+    }
+    std::vector<uint256> vHashesToUpdate;
+    for (size_t i = 0; i < nInBlock; i++) {
+        poolReorg.addUnchecked(vTxes[i].GetHash(), entry.Fee(1000 * (i + 1)).FromTx(vTxes[i]));
+        vHashesToUpdate.push_back(vTxes[i].GetHash());
+    }
+    poolReorg.UpdateTransactionsFromBlock(vHashesToUpdate);
+
+    for (const CMutableTransaction& tx : vTxes) {
+        CTxMemPool::txiter it = pool.mapTx.find(tx.GetHash());
+        CTxMemPool::txiter itReorg = poolReorg.mapTx.find(tx.GetHash());
+        BOOST_CHECK_EQUAL(it->GetCountWithDescendants(), itReorg->GetCountWithDescendants());
+        BOOST_CHECK_EQUAL(it->GetSizeWithDescendants(), itReorg->GetSizeWithDescendants());
+        BOOST_CHECK_EQUAL(it->GetModFeesWithDescendants(), itReorg->GetModFeesWithDescendants());
+        BOOST_CHECK_EQUAL(it->GetCountWithAncestors(), itReorg->GetCountWithAncestors());
+        BOOST_CHECK_EQUAL(it->GetSizeWithAncestors(), itReorg->GetSizeWithAncestors());
+        BOOST_CHECK_EQUAL(it->GetModFeesWithAncestors(), itReorg->GetModFeesWithAncestors());
+        BOOST_CHECK_EQUAL(pool.GetMemPoolChildren(it).size(), poolReorg.GetMemPoolChildren(itReorg).size());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(MempoolSnapshotTest)
+{
+    // A chain of transactions, each one paying more than its parent
+    TestMemPoolEntryHelper entry;
+    CTxMemPool pool(CFeeRate(0));
+    std::vector<CMutableTransaction> vTxes(10);
+    for (size_t i = 0; i < vTxes.size(); i++) {
+        CMutableTransaction& tx = vTxes[i];
+        tx.vin.resize(1);
+        tx.vin[0].scriptSig = CScript() << OP_11;
+        tx.vin[0].prevout = i == 0 ? COutPoint(InsecureRand256(), 0) : COutPoint(vTxes[i - 1].GetHash(), 0);
+        tx.vout.resize(1);
+        tx.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        tx.vout[0].nValue = COIN;
+        pool.addUnchecked(tx.GetHash(), entry.Fee(1000 * (i + 1)).FromTx(tx));
+    }
+
+    CTxMemPoolSnapshotRef snapshot = pool.GetSnapshot();
+    BOOST_CHECK_EQUAL(snapshot->size(), vTxes.size());
+    // Shared while the mempool does not change
+    BOOST_CHECK(pool.GetSnapshot() == snapshot);
+
+    // The parents first, as in queryHashes
+    std::vector<uint256> vtxid;
+    pool.queryHashes(vtxid);
+    std::vector<const CTxMemPoolEntry*> sorted = snapshot->GetSortedDepthAndScore();
+    BOOST_CHECK_EQUAL(sorted.size(), vTxes.size());
+    for (size_t i = 0; i < vTxes.size(); i++) {
+        BOOST_CHECK(sorted[i]->GetTx().GetHash() == vTxes[i].GetHash());
+        BOOST_CHECK(vtxid[i] == vTxes[i].GetHash());
+        const CTxMemPoolEntry* e = snapshot->Find(vTxes[i].GetHash());
+        BOOST_CHECK(e != nullptr);
+        BOOST_CHECK_EQUAL(e->GetFee(), (CAmount)(1000 * (i + 1)));
+        BOOST_CHECK_EQUAL(e->GetCountWithAncestors(), i + 1);
+        BOOST_CHECK_EQUAL(e->GetCountWithDescendants(), vTxes.size() - i);
+    }
+    BOOST_CHECK(!snapshot->exists(vTxes[0].vin[0].prevout.hash));
+
+    // A snapshot does not see the changes made after it was taken
+    pool.removeRecursive(vTxes[5]);
+    BOOST_CHECK_EQUAL(pool.size(), 5);
+    BOOST_CHECK_EQUAL(snapshot->size(), vTxes.size());
+    BOOST_CHECK(snapshot->exists(vTxes[9].GetHash()));
+    BOOST_CHECK_EQUAL(snapshot->Find(vTxes[0].GetHash())->GetCountWithDescendants(), vTxes.size());
+
+    CTxMemPoolSnapshotRef snapshot2 = pool.GetSnapshot();
+    BOOST_CHECK(snapshot2 != snapshot);
+    BOOST_CHECK(snapshot2->GetSequence() != snapshot->GetSequence());
+    BOOST_CHECK_EQUAL(snapshot2->size(), 5);
+    BOOST_CHECK(!snapshot2->exists(vTxes[5].GetHash()));
+    BOOST_CHECK_EQUAL(snapshot2->Find(vTxes[0].GetHash())->GetCountWithDescendants(), 5);
+
+    // Prioritising a transaction changes the entries too
+    pool.PrioritiseTransaction(vTxes[4].GetHash(), vTxes[4].GetHash().ToString(), 0, 1000);
+    CTxMemPoolSnapshotRef snapshot3 = pool.GetSnapshot();
+    BOOST_CHECK(snapshot3 != snapshot2);
+    BOOST_CHECK_EQUAL(snapshot3->Find(vTxes[4].GetHash())->GetModifiedFee(), 6000);
+    BOOST_CHECK_EQUAL(snapshot2->Find(vTxes[4].GetHash())->GetModifiedFee(), 5000);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -5,10 +5,13 @@
 
 #include "rpc/server.h"
 #include "rpc/client.h"
+#include "rpc/jsonstream.h"
 
 #include "base58.h"
 #include "netbase.h"
+#include "script/script.h"
 #include "util.h"
+#include "validation.h"
 
 #include "test/test_quirkyturt.h"
 
@@ -286,4 +289,124 @@ BOOST_AUTO_TEST_CASE(rpc_ban)
     BOOST_CHECK_EQUAL(adr.get_str(), "2001:4d48:ac57:400:cacf:e9ff:fe1d:9c63/128");
 }
 
+BOOST_AUTO_TEST_CASE(rpc_batch)
+{
+    if (RPCIsInWarmup(nullptr)) SetRPCWarmupFinished();
+
+    // Read only calls, with calls changing nothing but run alone in between, and errors
+    UniValue batch(UniValue::VARR);
+    for (int i = 0; i < 30; i++) {
+        UniValue req(UniValue::VOBJ);
+        UniValue params(UniValue::VARR);
+        if (i % 11 == 5) {
+            req.pushKV("method", "help");
+        } else if (i == 20) {
+            req.pushKV("method", "nosuchmethod");
+        } else {
+            req.pushKV("method", "decodescript");
+            params.push_back(HexStr(CScript() << i << OP_DROP << OP_TRUE));
+        }
+        req.pushKV("params", params);
+        req.pushKV("id", i);
+        batch.push_back(i == 25 ? UniValue(i) : req);
+    }
+
+    // The results are the same, in the same order, when the calls are spread over threads
+    gArgs.ForceSetArg("-rpcbatchthreads", "0");
+    StartRPC();
+    const std::string strSequential = JSONRPCExecBatch(batch);
+    InterruptRPC();
+    StopRPC();
+
+    gArgs.ForceSetArg("-rpcbatchthreads", "4");
+    StartRPC();
+    const std::string strConcurrent = JSONRPCExecBatch(batch);
+    InterruptRPC();
+    StopRPC();
+    gArgs.ForceSetArg("-rpcbatchthreads", std::to_string(DEFAULT_RPC_BATCH_THREADS));
+
+    BOOST_CHECK_EQUAL(strSequential, strConcurrent);
+    UniValue results;
+    BOOST_CHECK(results.read(strConcurrent));
+    BOOST_CHECK_EQUAL(results.size(), 30);
+    for (int i = 0; i < 30; i++) {
+        const UniValue& result = results[i];
+        if (i == 25) {
+            BOOST_CHECK(find_value(result, "error").isObject());
+            continue;
+        }
+        BOOST_CHECK_EQUAL(find_value(result, "id").get_int(), i);
+        BOOST_CHECK_EQUAL(find_value(result, "error").isNull(), i != 20);
+        if (i % 11 != 5 && i != 20) {
+            BOOST_CHECK_EQUAL(find_value(find_value(result, "result"), "asm").get_str(), strprintf("%d OP_DROP 1", i));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(rpc_stream)
+{
+    // The streamed JSON is the one UniValue writes, whatever the size of the chunks
+    std::string strStreamed;
+    int nParts = 0;
+    bool fLast = false;
+    JSONStreamWriter stream([&](const std::string& strData, bool fLastIn) {
+        BOOST_CHECK(!fLast);
+        strStreamed += strData;
+        nParts++;
+        fLast = fLastIn;
+        return true;
+    }, 16);
+
+    RPCResultWriter streamed(&stream);
+    RPCResultWriter built(nullptr);
+    for (RPCResultWriter* result : {&streamed, &built}) {
+        result->BeginObject();
+        result->PushKV("a\"b", 1);
+        result->Key("list");
+        result->BeginArray();
+        for (int i = 0; i < 10; i++) {
+            UniValue o(UniValue::VOBJ);
+            o.pushKV("i", i);
+            result->Value(o);
+        }
+        result->BeginObject();
+        result->EndObject();
+        result->BeginArray();
+        result->EndArray();
+        result->EndArray();
+        result->PushKV("null", NullUniValue);
+        result->EndObject();
+    }
+    stream.Finish();
+    BOOST_CHECK(fLast);
+    BOOST_CHECK(nParts > 1);
+    BOOST_CHECK(streamed.GetResult().isNull());
+    BOOST_CHECK_EQUAL(strStreamed, built.GetResult().write() + "\n");
+
+    // A call writes the same result into a stream
+    const std::string strHash = chainActive.Genesis()->GetBlockHash().GetHex();
+    const UniValue block = CallRPC("getblock " + strHash);
+    strStreamed.clear();
+    fLast = false;
+    JSONStreamWriter blockStream([&](const std::string& strData, bool fLastIn) {
+        strStreamed += strData;
+        fLast = fLastIn;
+        return true;
+    }, 16);
+    JSONRPCRequest request;
+    request.params = UniValue(UniValue::VARR);
+    request.params.push_back(strHash);
+    request.stream = &blockStream;
+    BOOST_CHECK(tableRPC["getblock"]->actor(request).isNull());
+    blockStream.Finish();
+    BOOST_CHECK(fLast);
+    BOOST_CHECK_EQUAL(strStreamed, block.write() + "\n");
+
+    // The writer stops when the sink does
+    JSONStreamWriter stopped([](const std::string& strData, bool fLastIn) { return false; }, 4);
+    stopped.BeginArray();
+    BOOST_CHECK_THROW(stopped.Value(std::string(8, 'x')), JSONStreamWriter::Aborted);
+    BOOST_CHECK(stopped.HasFlushed());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,190 @@
+// Copyright (c) 2020 The PIVX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "test/test_quirkyturt.h"
+
+#include "hash.h"
+#include "key.h"
+#include "script/interpreter.h"
+#include "script/script.h"
+#include "script/script_error.h"
+#include "script/standard.h"
+
+#include <boost/test/unit_test.hpp>
+
+typedef std::vector<unsigned char> valtype;
+
+/**
+ * Checker whose results are a pseudo random function of all its arguments, so that
+ * the template fast paths must pass it exactly what the interpreter does.
+ */
+class TemplateTestChecker : public BaseSignatureChecker
+{
+public:
+    bool CheckSig(const valtype& vchSig, const valtype& vchPubKey, const CScript& scriptCode, SigVersion sigversion) const override
+    {
+        CHashWriter ss(SER_GETHASH, 0);
+        ss << vchSig << vchPubKey << scriptCode << (int)sigversion;
+        return (ss.GetHash().GetCheapHash() & 3) != 0;
+    }
+
+    bool CheckColdStake(bool fAllowLastOutputFree, const CScript& prevoutScript, std::vector<valtype>& stack, unsigned int flags, ScriptError* serror) const override
+    {
+        CHashWriter ss(SER_GETHASH, 0);
+        ss << fAllowLastOutputFree << prevoutScript << stack << flags;
+        if ((ss.GetHash().GetCheapHash() & 3) != 0)
+            return true;
+        if (serror)
+            *serror = SCRIPT_ERR_CHECKCOLDSTAKEVERIFY;
+        return false;
+    }
+};
+
+static valtype RandomBytes(size_t nSize)
+{
+    valtype vch(nSize);
+    for (unsigned char& c : vch) {
+        c = InsecureRand32();
+    }
+    return vch;
+}
+
+static valtype RandomPubKey(const std::vector<CKey>& vKeys)
+{
+    switch (InsecureRandRange(4)) {
+    case 0: return RandomBytes(InsecureRandRange(80));
+    case 1: return RandomBytes(20);
+    default: return ToByteVector(vKeys[InsecureRandRange(vKeys.size())].GetPubKey());
+    }
+}
+
+static valtype RandomSignature(const std::vector<CKey>& vKeys)
+{
+    switch (InsecureRandRange(5)) {
+    case 0: return RandomBytes(InsecureRandRange(80));
+    case 1: return RandomBytes(20);
+    default: {
+        valtype vchSig;
+        BOOST_CHECK(vKeys[InsecureRandRange(vKeys.size())].Sign(InsecureRand256(), vchSig));
+        static const unsigned char hashTypes[] = {SIGHASH_ALL, SIGHASH_NONE, SIGHASH_SINGLE, SIGHASH_ALL | SIGHASH_ANYONECANPAY, 0, 4};
+        vchSig.push_back(hashTypes[InsecureRandRange(sizeof(hashTypes))]);
+        return vchSig;
+    }
+    }
+}
+
+static valtype KeyHash(const valtype& vchPubKey)
+{
+    // Usually the hash of the key, so that the scripts get past OP_EQUALVERIFY
+    if (InsecureRandRange(4) == 0)
+        return RandomBytes(20);
+    uint160 hash = Hash160(vchPubKey.begin(), vchPubKey.end());
+    return valtype(hash.begin(), hash.end());
+}
+
+static CScript PushData(const valtype& vch)
+{
+    // Sometimes a non minimal push
+    if (InsecureRandRange(16) == 0) {
+        CScript script;
+        script.push_back(OP_PUSHDATA1);
+        script.push_back(vch.size());
+        script.insert(script.end(), vch.begin(), vch.end());
+        return script;
+    }
+    return CScript() << vch;
+}
+
+static CScript Mutate(CScript script)
+{
+    switch (InsecureRandRange(12)) {
+    case 0:
+        if (!script.empty()) script[InsecureRandRange(script.size())] ^= 1 + InsecureRandRange(255);
+        break;
+    case 1:
+        if (!script.empty()) script.resize(InsecureRandRange(script.size()));
+        break;
+    case 2:
+        script << OP_NOP;
+        break;
+    case 3:
+        script = CScript() << OP_1 << ToByteVector(script);
+        break;
+    }
+    return script;
+}
+
+BOOST_FIXTURE_TEST_SUITE(script_template_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(template_fast_paths_match_interpreter)
+{
+    std::vector<CKey> vKeys(4);
+    for (CKey& key : vKeys) {
+        key.MakeNewKey(InsecureRandBool());
+    }
+    const TemplateTestChecker checker;
+
+    for (int i = 0; i < 20000; i++) {
+        valtype vchSig = RandomSignature(vKeys);
+        const valtype vchPubKey = RandomPubKey(vKeys);
+        const valtype vchHash = KeyHash(vchPubKey);
+        const valtype vchOtherHash = KeyHash(vchPubKey);
+        // A signature that is the push of a key hash, which CHECKSIG deletes from the script code
+        if (InsecureRandRange(16) == 0) vchSig = InsecureRandBool() ? vchHash : vchOtherHash;
+        CScript scriptSig;
+        CScript scriptPubKey;
+        switch (InsecureRandRange(3)) {
+        case 0:
+            scriptSig = PushData(vchSig) + PushData(vchPubKey);
+            scriptPubKey = CScript() << OP_DUP << OP_HASH160 << vchHash << OP_EQUALVERIFY << OP_CHECKSIG;
+            break;
+        case 1: {
+            static const opcodetype flagOps[] = {OP_0, OP_1, OP_2, OP_1NEGATE};
+            scriptSig = PushData(vchSig);
+            if (InsecureRandRange(8) == 0) {
+                scriptSig += PushData(RandomBytes(InsecureRandRange(2)));
+            } else {
+                scriptSig << flagOps[InsecureRandRange(InsecureRandBool() ? 2 : 4)];
+            }
+            scriptSig += PushData(vchPubKey);
+            scriptPubKey = CScript() << OP_DUP << OP_HASH160 << OP_ROT <<
+                    OP_IF << (InsecureRandBool() ? OP_CHECKCOLDSTAKEVERIFY : OP_CHECKCOLDSTAKEVERIFY_LOF) << vchOtherHash <<
+                    OP_ELSE << vchHash << OP_ENDIF <<
+                    OP_EQUALVERIFY << OP_CHECKSIG;
+            break;
+        }
+        default: {
+            CScript redeemScript;
+            switch (InsecureRandRange(4)) {
+            case 0: redeemScript = CScript() << vchPubKey << OP_CHECKSIG; break;
+            case 1: redeemScript = CScript() << OP_1 << vchPubKey << OP_1 << OP_CHECKMULTISIG; break;
+            case 2: redeemScript = CScript() << OP_DROP << OP_1; break;
+            default: redeemScript = CScript(vchPubKey.begin(), vchPubKey.end()); break;
+            }
+            const size_t nPushes = InsecureRandRange(16) == 0 ? 998 + InsecureRandRange(3) : InsecureRandRange(3);
+            for (size_t j = 0; j < nPushes; j++) {
+                scriptSig += j == 0 ? PushData(vchSig) : CScript() << OP_0;
+            }
+            scriptSig += PushData(ToByteVector(redeemScript));
+            scriptPubKey = GetScriptForDestination(CScriptID(redeemScript));
+            if (InsecureRandRange(4) == 0) scriptPubKey = CScript() << OP_HASH160 << RandomBytes(20) << OP_EQUAL;
+            break;
+        }
+        }
+        if (InsecureRandRange(4) == 0) scriptSig = Mutate(scriptSig);
+        if (InsecureRandRange(8) == 0) scriptPubKey = Mutate(scriptPubKey);
+
+        const unsigned int flags = InsecureRand32() & ((SCRIPT_VERIFY_CHECKLOCKTIMEVERIFY << 1) - 1);
+        const SigVersion sigversion = InsecureRandBool() ? SIGVERSION_BASE : SIGVERSION_SAPLING;
+        ScriptError err, errGeneric;
+        const bool fResult = VerifyScript(scriptSig, scriptPubKey, flags, checker, sigversion, &err);
+        const bool fResultGeneric = VerifyScriptGeneric(scriptSig, scriptPubKey, flags, checker, sigversion, &errGeneric);
+        if (fResult != fResultGeneric || err != errGeneric) {
+            BOOST_ERROR("template fast path mismatch for scriptSig " << HexStr(scriptSig) << " scriptPubKey " << HexStr(scriptPubKey)
+                    << " flags " << flags << ": " << ScriptErrorString(err) << " instead of " << ScriptErrorString(errGeneric));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
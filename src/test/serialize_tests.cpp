@@ -3,6 +3,7 @@
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or https://www.opensource.org/licenses/mit-license.php.
 
+#include "chain.h"
 #include "optional.h"
 #include "serialize.h"
 #include "streams.h"
@@ -395,4 +396,38 @@ BOOST_AUTO_TEST_CASE(class_methods)
     BOOST_CHECK(methodtest3 == methodtest4);
 }
 
+BOOST_AUTO_TEST_CASE(stake_modifier_serialization)
+{
+    // CStakeModifier must serialize exactly like the byte vector it replaced
+    uint64_t nModifierV1 = 0x0123456789abcdefULL;
+    uint256 nModifierV2 = uint256S("0x2c4e7e2b1b7a3f0a9e0c1a5f3d1c4b7e9a8d6f5e4c3b2a1908172635445362718");
+    CBlockIndex index;
+    for (int i = 0; i < 3; i++) {
+        std::vector<unsigned char> vExpected;
+        if (i == 1) {
+            index.SetStakeModifier(nModifierV1, false);
+            vExpected.assign((const unsigned char*)&nModifierV1, (const unsigned char*)&nModifierV1 + sizeof(nModifierV1));
+        } else if (i == 2) {
+            index.SetStakeModifier(nModifierV2);
+            vExpected.assign(nModifierV2.begin(), nModifierV2.end());
+        }
+        CDataStream ssVec(SER_DISK, CLIENT_VERSION);
+        ssVec << vExpected;
+        CDataStream ssMod(SER_DISK, CLIENT_VERSION);
+        ssMod << index.vStakeModifier;
+        BOOST_CHECK(ssVec.str() == ssMod.str());
+
+        CStakeModifier modifier;
+        ssVec >> modifier;
+        BOOST_CHECK_EQUAL(modifier.size(), vExpected.size());
+        BOOST_CHECK(std::equal(vExpected.begin(), vExpected.end(), modifier.begin()));
+    }
+
+    // more than 256 bits is rejected
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << std::vector<unsigned char>(33, 0xff);
+    CStakeModifier modifier;
+    BOOST_CHECK_THROW(ss >> modifier, std::ios_base::failure);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
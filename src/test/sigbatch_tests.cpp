@@ -0,0 +1,251 @@
+// Copyright (c) 2020 The PIVX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "test/test_quirkyturt.h"
+
+#include "blocksignature.h"
+#include "kernel.h"
+#include "key.h"
+#include "script/standard.h"
+#include "sigbatch.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(sigbatch_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(sigbatch_der)
+{
+    std::vector<CKey> vKeys(4);
+    for (CKey& key : vKeys) {
+        key.MakeNewKey(InsecureRandBool());
+    }
+
+    // Enough signatures to use all the threads, by a few keys so that they are shared
+    CSignatureBatch batch;
+    std::vector<bool> vExpected;
+    for (int i = 0; i < 300; i++) {
+        const CKey& key = vKeys[i % vKeys.size()];
+        const uint256 hash = InsecureRand256();
+        std::vector<unsigned char> vchSig;
+        BOOST_CHECK(key.Sign(hash, vchSig));
+        const int nMode = InsecureRandRange(10);
+        if (nMode == 0) {
+            // signed by another key
+            BOOST_CHECK_EQUAL(batch.Add(vKeys[(i + 1) % vKeys.size()].GetPubKey(), hash, vchSig), vExpected.size());
+            vExpected.push_back(false);
+        } else if (nMode == 1) {
+            // of another hash
+            BOOST_CHECK_EQUAL(batch.Add(key.GetPubKey(), InsecureRand256(), vchSig), vExpected.size());
+            vExpected.push_back(false);
+        } else {
+            BOOST_CHECK_EQUAL(batch.Add(key.GetPubKey(), hash, vchSig), vExpected.size());
+            vExpected.push_back(true);
+        }
+    }
+    BOOST_CHECK_EQUAL(batch.size(), vExpected.size());
+
+    for (int nThreads : {1, 2, 4}) {
+        std::vector<bool> vResults;
+        BOOST_CHECK(!batch.Verify(nThreads, &vResults));
+        BOOST_CHECK(vResults == vExpected);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(sigbatch_compact)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    const CKeyID keyID = key.GetPubKey().GetID();
+    CKey otherKey;
+    otherKey.MakeNewKey(false);
+
+    CSignatureBatch batch;
+    std::vector<unsigned char> vchSig;
+    const uint256 hash = InsecureRand256();
+    BOOST_CHECK(key.SignCompact(hash, vchSig));
+    batch.AddCompact(keyID, hash, vchSig);
+    BOOST_CHECK(batch.Verify());
+
+    // Recovering to another key, and not recovering at all
+    batch.AddCompact(otherKey.GetPubKey().GetID(), hash, vchSig);
+    vchSig[0] = 0;
+    batch.AddCompact(keyID, hash, vchSig);
+    std::vector<bool> vResults;
+    BOOST_CHECK(!batch.Verify(1, &vResults));
+    BOOST_CHECK(vResults == std::vector<bool>({true, false, false}));
+
+    batch.clear();
+    BOOST_CHECK(batch.empty());
+    BOOST_CHECK(batch.Verify());
+}
+
+BOOST_AUTO_TEST_CASE(sigbatch_duplicates)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    const uint256 hash = InsecureRand256();
+    std::vector<unsigned char> vchSig;
+    BOOST_CHECK(key.Sign(hash, vchSig));
+
+    // The same signature, once as a DER signature of the key, once as a compact one
+    // that cannot be valid: the entries are distinct, and each duplicate gets its result.
+    CSignatureBatch batch;
+    for (int i = 0; i < 3; i++) {
+        batch.Add(key.GetPubKey(), hash, vchSig);
+        batch.AddCompact(key.GetPubKey().GetID(), hash, vchSig);
+    }
+    BOOST_CHECK_EQUAL(batch.size(), 6U);
+    std::vector<bool> vResults;
+    BOOST_CHECK(!batch.Verify(1, &vResults));
+    BOOST_CHECK(vResults == std::vector<bool>({true, false, true, false, true, false}));
+}
+
+static const CAmount nStakeAmount = 200 * COIN;
+
+/** A coinstake spending prevScript, and paying to it again */
+static CMutableTransaction CreateCoinStake(const CScript& prevScript)
+{
+    CMutableTransaction tx;
+    tx.vin.emplace_back(COutPoint(InsecureRand256(), 0));
+    tx.vout.emplace_back(0, CScript());
+    tx.vout.emplace_back(nStakeAmount + 2 * COIN, prevScript);
+    return tx;
+}
+
+static std::vector<unsigned char> SignStakeInput(const CMutableTransaction& mtx, const CScript& prevScript, const CKey& key)
+{
+    const CTransaction tx(mtx);
+    const uint256 hash = SignatureHash(prevScript, tx, 0, SIGHASH_ALL, nStakeAmount, tx.GetRequiredSigVersion());
+    std::vector<unsigned char> vchSig;
+    BOOST_CHECK(key.Sign(hash, vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    return vchSig;
+}
+
+/** Check the input of a coinstake serially, or in a batch. Returns the verdict and the size of the batch. */
+static std::pair<bool, size_t> CheckStakeInput(const CMutableTransaction& mtx, const CScript& prevScript, bool fBatch)
+{
+    const CTransaction tx(mtx);
+    const CTxOut prevout(nStakeAmount, prevScript);
+    std::string strError;
+    if (!fBatch) {
+        return {CheckStakeInputSignature(tx, prevout, strError), 0};
+    }
+    CSignatureBatch batch;
+    const bool fValid = CheckStakeInputSignature(tx, prevout, strError, &batch) && batch.Verify();
+    return {fValid, batch.size()};
+}
+
+BOOST_AUTO_TEST_CASE(sigbatch_stake_input)
+{
+    SelectParams(CBaseChainParams::REGTEST);
+    CKey key, otherKey;
+    key.MakeNewKey(true);
+    otherKey.MakeNewKey(true);
+    const CPubKey pubkey = key.GetPubKey();
+
+    const CScript scriptP2PK = GetScriptForRawPubKey(pubkey);
+    const CScript scriptP2PKH = GetScriptForDestination(pubkey.GetID());
+    const CScript scriptP2CS = GetScriptForStakeDelegation(pubkey.GetID(), otherKey.GetPubKey().GetID());
+    for (const CScript& prevScript : {scriptP2PK, scriptP2PKH, scriptP2CS}) {
+        const bool fP2CS = prevScript == scriptP2CS;
+        auto makeScriptSig = [&](const std::vector<unsigned char>& vchSig) {
+            CScript scriptSig = CScript() << vchSig;
+            if (fP2CS) scriptSig << std::vector<unsigned char>(1, OP_TRUE);
+            if (prevScript != scriptP2PK) scriptSig << ToByteVector(pubkey);
+            return scriptSig;
+        };
+
+        // Valid, signed by another key, and signing another transaction
+        CMutableTransaction txValid = CreateCoinStake(prevScript);
+        txValid.vin[0].scriptSig = makeScriptSig(SignStakeInput(txValid, prevScript, key));
+        CMutableTransaction txOtherKey = CreateCoinStake(prevScript);
+        txOtherKey.vin[0].scriptSig = makeScriptSig(SignStakeInput(txOtherKey, prevScript, otherKey));
+        CMutableTransaction txOtherHash = CreateCoinStake(prevScript);
+        txOtherHash.vin[0].scriptSig = makeScriptSig(SignStakeInput(txOtherHash, prevScript, key));
+        txOtherHash.vout[1].nValue++;
+
+        const std::vector<std::pair<CMutableTransaction, bool>> vTxes = {{txValid, true}, {txOtherKey, false}, {txOtherHash, false}};
+        for (const std::pair<CMutableTransaction, bool>& item : vTxes) {
+            const std::pair<bool, size_t> serial = CheckStakeInput(item.first, prevScript, false);
+            const std::pair<bool, size_t> batched = CheckStakeInput(item.first, prevScript, true);
+            BOOST_CHECK_EQUAL(serial.first, batched.first);
+            // (the P2CS verdict also depends on the cold staking rules)
+            if (!fP2CS) {
+                BOOST_CHECK_EQUAL(serial.first, item.second);
+            }
+        }
+        if (prevScript == scriptP2PK) {
+            BOOST_CHECK_EQUAL(CheckStakeInput(txValid, prevScript, true).second, 1U);
+        }
+    }
+
+    // A scriptSig with opcodes can act on the result of a CHECKSIG: a well-formed bad signature
+    // makes it push false, turned into true by OP_NOT. It must not be batched, as the batch
+    // would make the CHECKSIG push true, and reject a valid input.
+    CMutableTransaction tx = CreateCoinStake(scriptP2PK);
+    const std::vector<unsigned char> vchGoodSig = SignStakeInput(tx, scriptP2PK, key);
+    const std::vector<unsigned char> vchBadSig = SignStakeInput(tx, scriptP2PK, otherKey);
+    tx.vin[0].scriptSig = CScript() << vchBadSig << ToByteVector(pubkey) << OP_CHECKSIG << OP_NOT << OP_VERIFY << vchGoodSig;
+    BOOST_CHECK(!tx.vin[0].scriptSig.IsPushOnly());
+    BOOST_CHECK(CheckStakeInput(tx, scriptP2PK, false).first);
+    const std::pair<bool, size_t> batched = CheckStakeInput(tx, scriptP2PK, true);
+    BOOST_CHECK(batched.first);
+    BOOST_CHECK_EQUAL(batched.second, 0U);
+}
+
+/** Check the block signature and the coinstake input signature of a block, serially or in a batch */
+static bool CheckPoSSignatures(const CBlock& block, const CScript& prevScript, bool fBatch)
+{
+    const CTxOut prevout(nStakeAmount, prevScript);
+    std::string strError;
+    if (!fBatch) {
+        return CheckBlockSignature(block) && CheckStakeInputSignature(*block.vtx[1], prevout, strError);
+    }
+    CSignatureBatch batch;
+    return CheckBlockSignature(block, &batch) && CheckStakeInputSignature(*block.vtx[1], prevout, strError, &batch) &&
+           batch.Verify();
+}
+
+BOOST_AUTO_TEST_CASE(sigbatch_pos_block)
+{
+    SelectParams(CBaseChainParams::REGTEST);
+    CKey key, otherKey;
+    key.MakeNewKey(true);
+    otherKey.MakeNewKey(true);
+    const CScript prevScript = GetScriptForRawPubKey(key.GetPubKey());
+
+    auto makeBlock = [&](const CMutableTransaction& txCoinStake, const CKey& blockKey) {
+        CBlock block;
+        block.nTime = 1600000000;
+        block.vtx.emplace_back(MakeTransactionRef(CMutableTransaction()));
+        block.vtx.emplace_back(MakeTransactionRef(txCoinStake));
+        BOOST_CHECK(block.IsProofOfStake());
+        BOOST_CHECK(SignBlockWithKey(block, blockKey));
+        return block;
+    };
+
+    CMutableTransaction txValid = CreateCoinStake(prevScript);
+    txValid.vin[0].scriptSig = CScript() << SignStakeInput(txValid, prevScript, key);
+    CMutableTransaction txBad = CreateCoinStake(prevScript);
+    txBad.vin[0].scriptSig = CScript() << SignStakeInput(txBad, prevScript, otherKey);
+    CMutableTransaction txOpcodes = CreateCoinStake(prevScript);
+    txOpcodes.vin[0].scriptSig = CScript() << SignStakeInput(txOpcodes, prevScript, otherKey) << ToByteVector(key.GetPubKey())
+                                           << OP_CHECKSIG << OP_NOT << OP_VERIFY << SignStakeInput(txOpcodes, prevScript, key);
+
+    // The batched and serial checks agree, whichever signature is bad
+    const std::vector<std::pair<CBlock, bool>> vBlocks = {
+        {makeBlock(txValid, key), true},
+        {makeBlock(txValid, otherKey), false},
+        {makeBlock(txBad, key), false},
+        {makeBlock(txBad, otherKey), false},
+        {makeBlock(txOpcodes, key), true},
+    };
+    for (const std::pair<CBlock, bool>& item : vBlocks) {
+        BOOST_CHECK_EQUAL(CheckPoSSignatures(item.first, prevScript, false), item.second);
+        BOOST_CHECK_EQUAL(CheckPoSSignatures(item.first, prevScript, true), item.second);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
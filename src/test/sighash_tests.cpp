@@ -193,6 +193,33 @@ BOOST_AUTO_TEST_CASE(sighash_test)
     #endif
 }
 
+// Goal: check that the precomputed legacy hashing gives the same hash as serializing the whole transaction
+BOOST_AUTO_TEST_CASE(sighash_precomputed)
+{
+    SeedInsecureRand(false);
+
+    for (int i = 0; i < 5000; i++) {
+        int nHashType = (i % 2) ? SIGHASH_ALL : InsecureRand32();
+        CMutableTransaction txTo;
+        RandomTransaction(txTo, (nHashType & 0x1f) == SIGHASH_SINGLE);
+        if (txTo.nVersion >= CTransaction::TxVersion::SAPLING) continue;
+        if (i % 100 == 0) {
+            // Many inputs
+            txTo.vin.resize(200, txTo.vin[0]);
+            txTo.vout.resize(200, txTo.vout[0]);
+        }
+        CScript scriptCode;
+        RandomScript(scriptCode);
+        int nIn = InsecureRandRange(txTo.vin.size());
+
+        const CTransaction tx(txTo);
+        PrecomputedTransactionData precomTxData(tx);
+        BOOST_CHECK_EQUAL(precomTxData.vLegacyMidstates.size(), tx.vin.size() > 1 ? tx.vin.size() : 0);
+        BOOST_CHECK(SignatureHash(scriptCode, tx, nIn, nHashType, 0, SIGVERSION_BASE, &precomTxData) ==
+                    SignatureHashOld(scriptCode, tx, nIn, nHashType));
+    }
+}
+
 // Goal: check that SignatureHash generates correct hash
 // TODO: Update with Sapling transactions..
 BOOST_AUTO_TEST_CASE(sighash_from_data)
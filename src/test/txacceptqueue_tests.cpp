@@ -0,0 +1,126 @@
+// Copyright (c) 2022 The PIVX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or https://www.opensource.org/licenses/mit-license.php.
+
+#include "test/test_quirkyturt.h"
+
+#include "consensus/validation.h"
+#include "script/sign.h"
+#include "script/standard.h"
+#include "txacceptqueue.h"
+#include "txmempool.h"
+#include "validation.h"
+
+#include <condition_variable>
+#include <map>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(txacceptqueue_tests)
+
+/** The outcome of the transactions pushed to a queue, filled by the callbacks */
+struct AcceptResults
+{
+    Mutex cs;
+    std::condition_variable cond;
+    std::map<uint256, std::pair<bool, std::string> > results;
+    size_t nCalls{0};
+
+    CTxAcceptQueue::Callback Callback()
+    {
+        return [this](const MemPoolAccept& accept) {
+            AssertLockHeld(cs_main);
+            {
+                LOCK(cs);
+                results[accept.tx->GetHash()] = std::make_pair(accept.fValid, accept.state.GetRejectReason());
+                nCalls++;
+            }
+            cond.notify_all();
+        };
+    }
+
+    void Wait(size_t n)
+    {
+        WAIT_LOCK(cs, lock);
+        cond.wait_for(lock, std::chrono::seconds(30), [&]() { return nCalls >= n; });
+    }
+};
+
+static CMutableTransaction SpendCoinbase(const CTransaction& coinbase, const CKey& key, const CScript& scriptPubKey, CAmount nValue)
+{
+    CMutableTransaction tx;
+    tx.nVersion = 1;
+    tx.vin.resize(1);
+    tx.vin[0].prevout.hash = coinbase.GetHash();
+    tx.vin[0].prevout.n = 0;
+    tx.vout.resize(1);
+    tx.vout[0].nValue = nValue;
+    tx.vout[0].scriptPubKey = scriptPubKey;
+
+    std::vector<unsigned char> vchSig;
+    uint256 hash = SignatureHash(coinbase.vout[0].scriptPubKey, tx, 0, SIGHASH_ALL, 0, SIGVERSION_BASE);
+    BOOST_CHECK(key.Sign(hash, vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    tx.vin[0].scriptSig << vchSig;
+    return tx;
+}
+
+BOOST_FIXTURE_TEST_CASE(txacceptqueue_accept, TestChain100Setup)
+{
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+
+    // A valid spend, a double spend of its coin, and a spend with a bad signature
+    CMutableTransaction spend1 = SpendCoinbase(coinbaseTxns[0], coinbaseKey, scriptPubKey, 11 * CENT);
+    CMutableTransaction spend2 = SpendCoinbase(coinbaseTxns[0], coinbaseKey, scriptPubKey, 12 * CENT);
+    CMutableTransaction badSig = SpendCoinbase(coinbaseTxns[1], coinbaseKey, scriptPubKey, 11 * CENT);
+    badSig.vin[0].scriptSig = CScript() << std::vector<unsigned char>(72, 1);
+    // A spend of an unknown coin
+    CMutableTransaction orphan = SpendCoinbase(coinbaseTxns[2], coinbaseKey, scriptPubKey, 11 * CENT);
+    orphan.vin[0].prevout.hash = InsecureRand256();
+
+    AcceptResults results;
+    {
+        CTxAcceptQueue queue(mempool, 2, 10);
+        BOOST_CHECK(queue.Push(MakeTransactionRef(spend1), GetTime(), results.Callback()));
+        BOOST_CHECK(queue.Push(MakeTransactionRef(spend2), GetTime(), results.Callback()));
+        BOOST_CHECK(queue.Push(MakeTransactionRef(badSig), GetTime(), results.Callback()));
+        BOOST_CHECK(queue.Push(MakeTransactionRef(orphan), GetTime(), results.Callback()));
+        // A transaction already queued is not queued twice, both callbacks are called
+        BOOST_CHECK(queue.Push(MakeTransactionRef(spend1), GetTime(), results.Callback()));
+        results.Wait(5);
+
+        const CTxAcceptQueue::Stats stats = queue.GetStats();
+        BOOST_CHECK_EQUAL(stats.nSize, 0);
+        BOOST_CHECK_EQUAL(stats.nAccepted, 1);
+        BOOST_CHECK_EQUAL(stats.nRejected, 2);
+        BOOST_CHECK_EQUAL(stats.nMissingInputs, 1);
+        BOOST_CHECK_EQUAL(stats.stages[CTxAcceptQueue::PRECHECK].nDone, 4);
+        BOOST_CHECK(!queue.Contains(spend1.GetHash()));
+    }
+
+    LOCK(cs_main);
+    BOOST_CHECK_EQUAL(results.results.size(), 4);
+    BOOST_CHECK_EQUAL(results.nCalls, 5);
+    // Exactly one of the double spends made it
+    BOOST_CHECK(results.results[spend1.GetHash()].first != results.results[spend2.GetHash()].first);
+    BOOST_CHECK(mempool.exists(spend1.GetHash()) != mempool.exists(spend2.GetHash()));
+    BOOST_CHECK_EQUAL(mempool.size(), 1);
+    BOOST_CHECK(!results.results[badSig.GetHash()].first);
+    BOOST_CHECK(results.results[badSig.GetHash()].second.find("mandatory-script-verify-flag-failed") == 0);
+    BOOST_CHECK(!results.results[orphan.GetHash()].first);
+}
+
+BOOST_FIXTURE_TEST_CASE(txacceptqueue_full, TestChain100Setup)
+{
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+
+    // A stopped queue takes nothing, the caller falls back to AcceptToMemoryPool
+    CTxAcceptQueue queue(mempool, 1, 1);
+    queue.Stop();
+    CMutableTransaction spend = SpendCoinbase(coinbaseTxns[0], coinbaseKey, scriptPubKey, 11 * CENT);
+    BOOST_CHECK(!queue.Push(MakeTransactionRef(spend), GetTime(), [](const MemPoolAccept& accept) {}));
+    BOOST_CHECK_EQUAL(queue.GetStats().nFull, 1);
+    BOOST_CHECK(!queue.Contains(spend.GetHash()));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -86,4 +86,49 @@ BOOST_FIXTURE_TEST_CASE(tx_mempool_block_doublespend, TestChain100Setup)
     BOOST_CHECK_EQUAL(mempool.size(), 0);
 }
 
+BOOST_FIXTURE_TEST_CASE(checkinputs_script_cache, TestChain100Setup)
+{
+    // Transactions accepted to the mempool don't have their scripts executed
+    // again when they are connected in a block (with the same flags).
+    CScript scriptPubKey = CScript() <<  ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+
+    CMutableTransaction spend;
+    spend.nVersion = 1;
+    spend.vin.resize(1);
+    spend.vin[0].prevout.hash = coinbaseTxns[0].GetHash();
+    spend.vin[0].prevout.n = 0;
+    spend.vout.resize(1);
+    spend.vout[0].nValue = 11*CENT;
+    spend.vout[0].scriptPubKey = scriptPubKey;
+    std::vector<unsigned char> vchSig;
+    uint256 hash = SignatureHash(scriptPubKey, spend, 0, SIGHASH_ALL, 0, SIGVERSION_BASE);
+    BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    spend.vin[0].scriptSig << vchSig;
+    const CTransaction tx(spend);
+
+    LOCK(cs_main);
+    const bool fCLTVIsActivated = Params().GetConsensus().NetworkUpgradeActive(chainActive.Height(), Consensus::UPGRADE_BIP65);
+    const unsigned int flags = GetBlockScriptFlags(fCLTVIsActivated);
+    PrecomputedTransactionData precomTxData(tx);
+    CValidationState state;
+    std::vector<CScriptCheck> vChecks;
+
+    // Not cached yet: the script check is queued
+    BOOST_CHECK(CheckInputs(tx, state, *pcoinsTip, true, flags, false, false, precomTxData, &vChecks));
+    BOOST_CHECK_EQUAL(vChecks.size(), 1U);
+    vChecks.clear();
+
+    BOOST_CHECK(ToMemPool(spend));
+
+    // Cached with the flags of the blocks
+    BOOST_CHECK(CheckInputs(tx, state, *pcoinsTip, true, flags, false, false, precomTxData, &vChecks));
+    BOOST_CHECK(vChecks.empty());
+
+    // ... but not with other flags
+    BOOST_CHECK(CheckInputs(tx, state, *pcoinsTip, true, flags | SCRIPT_VERIFY_NULLDUMMY, false, false, precomTxData, &vChecks));
+    BOOST_CHECK_EQUAL(vChecks.size(), 1U);
+    mempool.clear();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -314,5 +314,48 @@ BOOST_AUTO_TEST_CASE(univalue_readwrite)
     BOOST_CHECK_EQUAL(strJson1, v.write());
 }
 
+BOOST_AUTO_TEST_CASE(univalue_large_object)
+{
+    // Large objects look their keys up by hash: the same results as the small ones
+    UniValue obj(UniValue::VOBJ);
+    std::string strJson = "{";
+    for (int i = 0; i < 100; i++) {
+        BOOST_CHECK(obj.pushKV("key" + std::to_string(i), i));
+        strJson += (i ? ",\"key" : "\"key") + std::to_string(i) + "\":" + std::to_string(i);
+    }
+    strJson += "}";
+    BOOST_CHECK_EQUAL(obj.write(), strJson);
+
+    // pushKV replaces the value of a key, pushKVs appends duplicates, the first one is found
+    BOOST_CHECK(obj.pushKV("key42", "replaced"));
+    UniValue obj2(UniValue::VOBJ);
+    BOOST_CHECK(obj2.pushKV("key7", "duplicate"));
+    BOOST_CHECK(obj.pushKVs(obj2));
+    BOOST_CHECK_EQUAL(obj.size(), 101);
+    BOOST_CHECK_EQUAL(obj["key42"].getValStr(), "replaced");
+    BOOST_CHECK_EQUAL(find_value(obj, "key7").getValStr(), "7");
+    BOOST_CHECK_EQUAL(obj["key99"].getValStr(), "99");
+    BOOST_CHECK(!obj.exists("key100"));
+
+    // Copies and parsed objects find their keys too
+    UniValue copy = obj;
+    BOOST_CHECK(copy.pushKV("key100", 100));
+    BOOST_CHECK_EQUAL(copy["key100"].getValStr(), "100");
+    BOOST_CHECK(!obj.exists("key100"));
+
+    UniValue v;
+    BOOST_CHECK(v.read(strJson));
+    BOOST_CHECK_EQUAL(v["key42"].getValStr(), "42");
+    BOOST_CHECK_EQUAL(find_value(v, "key0").getValStr(), "0");
+    BOOST_CHECK(!v.exists("key100"));
+    BOOST_CHECK_EQUAL(v.write(), strJson);
+
+    obj.clear();
+    BOOST_CHECK(!obj.exists("key0"));
+    BOOST_CHECK(obj.setObject());
+    BOOST_CHECK(obj.pushKV("key0", 1));
+    BOOST_CHECK_EQUAL(obj["key0"].getValStr(), "1");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
@@ -0,0 +1,225 @@
+// Copyright (c) 2022 The PIVX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "txacceptqueue.h"
+
+#include "util.h"
+#include "utiltime.h"
+#include "validation.h"
+
+#include <algorithm>
+
+std::unique_ptr<CTxAcceptQueue> g_txacceptqueue;
+
+struct CTxAcceptQueue::Item
+{
+    MemPoolAccept accept;
+    Callback callback;
+    //! When the item entered its current stage
+    int64_t nTimeStage;
+
+    Item(const CTransactionRef& tx, int64_t nAcceptTime, Callback callbackIn) :
+        accept(tx, nAcceptTime),
+        callback(std::move(callbackIn)),
+        nTimeStage(GetTimeMicros()) {}
+};
+
+CTxAcceptQueue::CTxAcceptQueue(CTxMemPool& poolIn, int nWorkers, size_t nMaxSizeIn) :
+    pool(poolIn),
+    nMaxSize(nMaxSizeIn)
+{
+    stats.nMaxSize = nMaxSize;
+    stats.nWorkers = nWorkers;
+    for (int i = 0; i < nWorkers; i++) {
+        workers.emplace_back(&TraceThread<std::function<void()> >, "txaccept", std::function<void()>(std::bind(&CTxAcceptQueue::ThreadWorker, this)));
+    }
+    committer = std::thread(&TraceThread<std::function<void()> >, "txcommit", std::function<void()>(std::bind(&CTxAcceptQueue::ThreadCommit, this)));
+}
+
+CTxAcceptQueue::~CTxAcceptQueue()
+{
+    Stop();
+}
+
+void CTxAcceptQueue::Stop()
+{
+    {
+        LOCK(cs);
+        fStop = true;
+    }
+    condWorkers.notify_all();
+    condCommit.notify_all();
+    for (std::thread& worker : workers) {
+        if (worker.joinable()) worker.join();
+    }
+    if (committer.joinable()) committer.join();
+
+    LOCK(cs);
+    for (auto& queue : queues) {
+        queue.clear();
+    }
+    mapQueued.clear();
+}
+
+bool CTxAcceptQueue::Push(const CTransactionRef& tx, int64_t nAcceptTime, Callback callback)
+{
+    {
+        LOCK(cs);
+        if (fStop || mapQueued.size() >= nMaxSize) {
+            stats.nFull++;
+            return false;
+        }
+        auto ret = mapQueued.emplace(tx->GetHash(), std::vector<Callback>());
+        if (!ret.second) {
+            // Already on its way, the second one would be rejected: report the outcome of the first one
+            ret.first->second.push_back(std::move(callback));
+            return true;
+        }
+        queues[PRECHECK].emplace_back(new Item(tx, nAcceptTime, std::move(callback)));
+    }
+    condWorkers.notify_one();
+    return true;
+}
+
+bool CTxAcceptQueue::Contains(const uint256& txid) const
+{
+    LOCK(cs);
+    return mapQueued.count(txid) > 0;
+}
+
+CTxAcceptQueue::Stats CTxAcceptQueue::GetStats() const
+{
+    LOCK(cs);
+    Stats ret = stats;
+    for (int i = 0; i < NUM_STAGES; i++) {
+        ret.stages[i].nQueued = queues[i].size();
+    }
+    ret.nSize = mapQueued.size();
+    return ret;
+}
+
+std::string CTxAcceptQueue::StageName(Stage stage)
+{
+    switch (stage) {
+    case PRECHECK: return "precheck";
+    case PREPARE: return "prepare";
+    case VERIFY: return "verify";
+    case FINISH: return "finish";
+    default: return "unknown";
+    }
+}
+
+static void AddStageTime(CTxAcceptQueue::StageStats& stageStats, int64_t nTime)
+{
+    stageStats.nDone++;
+    stageStats.nTotalTime += nTime;
+    stageStats.nMaxTime = std::max(stageStats.nMaxTime, nTime);
+}
+
+void CTxAcceptQueue::Advance(std::unique_ptr<Item> item, Stage stage, Stage next)
+{
+    const int64_t nNow = GetTimeMicros();
+    {
+        LOCK(cs);
+        AddStageTime(stats.stages[stage], nNow - item->nTimeStage);
+        item->nTimeStage = nNow;
+        queues[next].push_back(std::move(item));
+    }
+    if (next == VERIFY) {
+        condWorkers.notify_one();
+    } else {
+        condCommit.notify_one();
+    }
+}
+
+std::vector<CTxAcceptQueue::Callback> CTxAcceptQueue::Done(const Item& item, Stage stage)
+{
+    const MemPoolAccept& accept = item.accept;
+    LOCK(cs);
+    AddStageTime(stats.stages[stage], GetTimeMicros() - item.nTimeStage);
+    if (accept.fValid) {
+        stats.nAccepted++;
+    } else if (accept.fMissingInputs) {
+        stats.nMissingInputs++;
+    } else {
+        stats.nRejected++;
+    }
+    std::vector<Callback> vCallbacks;
+    auto it = mapQueued.find(accept.tx->GetHash());
+    if (it != mapQueued.end()) {
+        vCallbacks = std::move(it->second);
+        mapQueued.erase(it);
+    }
+    return vCallbacks;
+}
+
+void CTxAcceptQueue::ThreadWorker()
+{
+    while (true) {
+        std::unique_ptr<Item> item;
+        Stage stage;
+        {
+            WAIT_LOCK(cs, lock);
+            while (!fStop && queues[VERIFY].empty() && queues[PRECHECK].empty()) {
+                condWorkers.wait(lock);
+            }
+            if (fStop) {
+                return;
+            }
+            stage = queues[VERIFY].empty() ? PRECHECK : VERIFY;
+            item = std::move(queues[stage].front());
+            queues[stage].pop_front();
+        }
+
+        if (stage == PRECHECK) {
+            // Even a failure goes through the commit thread, which reports it
+            PreCheckMemPoolAccept(item->accept);
+            Advance(std::move(item), PRECHECK, PREPARE);
+        } else {
+            // A failure sets the reject state, FinishMemPoolAccept reports it
+            VerifyMemPoolAcceptScripts(item->accept);
+            Advance(std::move(item), VERIFY, FINISH);
+        }
+    }
+}
+
+void CTxAcceptQueue::ThreadCommit()
+{
+    while (true) {
+        std::unique_ptr<Item> item;
+        Stage stage;
+        {
+            WAIT_LOCK(cs, lock);
+            while (!fStop && queues[FINISH].empty() && queues[PREPARE].empty()) {
+                condCommit.wait(lock);
+            }
+            if (fStop) {
+                return;
+            }
+            stage = queues[FINISH].empty() ? PREPARE : FINISH;
+            item = std::move(queues[stage].front());
+            queues[stage].pop_front();
+        }
+
+        LOCK(cs_main);
+        MemPoolAccept& accept = item->accept;
+        if (stage == PREPARE) {
+            if (PrepareMemPoolAccept(pool, accept, true) && !accept.vScriptChecks.empty()) {
+                Advance(std::move(item), PREPARE, VERIFY);
+                continue;
+            }
+            // Nothing to check without the lock: all the scripts were found in the cache
+            if (accept.fValid) {
+                VerifyMemPoolAcceptScripts(accept);
+            }
+        }
+        FinishMemPoolAccept(pool, accept);
+        // Counted done before the callback, so whoever it wakes sees the stats up to date
+        std::vector<Callback> vCallbacks = Done(*item, stage);
+        item->callback(accept);
+        for (const Callback& callback : vCallbacks) {
+            callback(accept);
+        }
+    }
+}
@@ -0,0 +1,123 @@
+// Copyright (c) 2022 The PIVX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_TXACCEPTQUEUE_H
+#define BITCOIN_TXACCEPTQUEUE_H
+
+#include "primitives/transaction.h"
+#include "sync.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+class CTxMemPool;
+struct MemPoolAccept;
+
+/** Default for -txacceptthreads, the workers of the acceptance queue (0 = no queue, the transactions are accepted inline) */
+static const int DEFAULT_TXACCEPT_THREADS = 2;
+/** Maximum number of workers of the acceptance queue */
+static const int MAX_TXACCEPT_THREADS = 16;
+/** Default for -txacceptqueuesize, the maximum number of transactions in the acceptance queue */
+static const int DEFAULT_TXACCEPT_QUEUE_SIZE = 1000;
+
+/**
+ * Accepts the transactions relayed by the peers to the mempool off the message handler
+ * thread, in the steps of MemPoolAccept (see validation.h):
+ * - the workers run PreCheckMemPoolAccept (the Sapling proofs notably),
+ * - the commit thread runs PrepareMemPoolAccept under cs_main, leaving the scripts out,
+ * - the workers run VerifyMemPoolAcceptScripts,
+ * - the commit thread runs FinishMemPoolAccept under cs_main, then the callback of the
+ *   transaction, still holding cs_main.
+ * The transactions are verified concurrently, and cs_main is only held for the lookups.
+ * The workers give priority to the scripts, and the commit thread to the transactions to
+ * add, so the ones furthest along leave the queue first.
+ * The number of transactions queued is bounded: when the queue is full, Push fails and
+ * the caller accepts the transaction inline. A transaction pushed again while queued is
+ * not queued twice: its callback is called along with the first one, with its outcome.
+ */
+class CTxAcceptQueue
+{
+public:
+    typedef std::function<void(const MemPoolAccept& accept)> Callback;
+
+    enum Stage {
+        PRECHECK,
+        PREPARE,
+        VERIFY,
+        FINISH,
+        NUM_STAGES
+    };
+
+    struct StageStats {
+        size_t nQueued{0};
+        uint64_t nDone{0};
+        //! Microseconds from entering the stage to leaving it, waiting included
+        int64_t nTotalTime{0};
+        int64_t nMaxTime{0};
+    };
+
+    struct Stats {
+        StageStats stages[NUM_STAGES];
+        size_t nSize{0};
+        size_t nMaxSize{0};
+        int nWorkers{0};
+        uint64_t nAccepted{0};
+        uint64_t nRejected{0};
+        uint64_t nMissingInputs{0};
+        //! Transactions not queued because the queue was full
+        uint64_t nFull{0};
+    };
+
+    CTxAcceptQueue(CTxMemPool& poolIn, int nWorkers, size_t nMaxSizeIn);
+    ~CTxAcceptQueue();
+
+    /**
+     * Queue a transaction, unless the queue is full. callback is called by the commit thread, holding cs_main
+     * (with the outcome of the transaction already queued, if any).
+     */
+    bool Push(const CTransactionRef& tx, int64_t nAcceptTime, Callback callback);
+    /** Whether a transaction is in the queue */
+    bool Contains(const uint256& txid) const;
+    Stats GetStats() const;
+    /** Stop the threads, dropping the transactions left */
+    void Stop();
+
+    static std::string StageName(Stage stage);
+
+private:
+    struct Item;
+
+    CTxMemPool& pool;
+    const size_t nMaxSize;
+
+    mutable Mutex cs;
+    std::condition_variable condWorkers;
+    std::condition_variable condCommit;
+    std::deque<std::unique_ptr<Item> > queues[NUM_STAGES];
+    //! The transactions queued, with the callbacks of the ones pushed again meanwhile
+    std::map<uint256, std::vector<Callback> > mapQueued;
+    Stats stats;
+    bool fStop{false};
+
+    std::vector<std::thread> workers;
+    std::thread committer;
+
+    //! Move item to the queue of stage next, accounting for the time spent in stage
+    void Advance(std::unique_ptr<Item> item, Stage stage, Stage next);
+    //! Take out an item done with stage, returning the callbacks of the same transaction pushed again
+    std::vector<Callback> Done(const Item& item, Stage stage);
+
+    void ThreadWorker();
+    void ThreadCommit();
+};
+
+extern std::unique_ptr<CTxAcceptQueue> g_txacceptqueue;
+
+#endif // BITCOIN_TXACCEPTQUEUE_H
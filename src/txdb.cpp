@@ -55,7 +55,7 @@ struct CoinEntry
 }
 
 
-CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe)
+CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, "chainstate")
 {
 }
 
@@ -90,6 +90,25 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap& mapCoins,
                               const uint256& hashSaplingAnchor,
                               CAnchorsSaplingMap& mapSaplingAnchors,
                               CNullifiersMap& mapSaplingNullifiers)
+{
+    return BatchWrite(mapCoins, hashBlock, hashSaplingAnchor, mapSaplingAnchors, mapSaplingNullifiers, true);
+}
+
+bool CCoinsViewDB::WriteSnapshot(CCoinsMap& mapCoins,
+                                 const uint256& hashBlock,
+                                 const uint256& hashSaplingAnchor,
+                                 CAnchorsSaplingMap& mapSaplingAnchors,
+                                 CNullifiersMap& mapSaplingNullifiers)
+{
+    return BatchWrite(mapCoins, hashBlock, hashSaplingAnchor, mapSaplingAnchors, mapSaplingNullifiers, false);
+}
+
+bool CCoinsViewDB::BatchWrite(CCoinsMap& mapCoins,
+                              const uint256& hashBlock,
+                              const uint256& hashSaplingAnchor,
+                              CAnchorsSaplingMap& mapSaplingAnchors,
+                              CNullifiersMap& mapSaplingNullifiers,
+                              bool fErase)
 {
     CDBBatch batch;
     size_t count = 0;
@@ -126,7 +145,7 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap& mapCoins,
         }
         count++;
         CCoinsMap::iterator itOld = it++;
-        mapCoins.erase(itOld);
+        if (fErase) mapCoins.erase(itOld);
         if (batch.SizeEstimate() > batch_size) {
             LogPrint(BCLog::COINDB, "Writing partial batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
             db.WriteBatch(batch);
@@ -142,7 +161,7 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap& mapCoins,
     }
 
     // Write Sapling
-    BatchWriteSapling(hashSaplingAnchor, mapSaplingAnchors, mapSaplingNullifiers, batch);
+    BatchWriteSapling(hashSaplingAnchor, mapSaplingAnchors, mapSaplingNullifiers, batch, fErase);
 
     // In the last batch, mark the database as consistent with hashBlock again.
     batch.Erase(DB_HEAD_BLOCKS);
@@ -159,7 +178,197 @@ size_t CCoinsViewDB::EstimateSize() const
     return db.EstimateSize(DB_COIN, (char)(DB_COIN+1));
 }
 
-CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe)
+CCoinsViewAsyncFlush::CCoinsViewAsyncFlush(CCoinsView* viewIn, CCoinsViewDB* dbIn, bool fAsyncIn) :
+        CCoinsViewBacked(viewIn), db(dbIn), fAsync(fAsyncIn)
+{
+}
+
+CCoinsViewAsyncFlush::~CCoinsViewAsyncFlush()
+{
+    WaitForFlush();
+    if (writer.joinable()) writer.join();
+}
+
+bool CCoinsViewAsyncFlush::GetCoin(const COutPoint& outpoint, Coin& coin) const
+{
+    {
+        LOCK(cs);
+        if (fWriting) {
+            CCoinsMap::const_iterator it = snapCoins->find(outpoint);
+            if (it != snapCoins->end()) {
+                if (it->second.coin.IsSpent()) return false;
+                coin = it->second.coin;
+                return true;
+            }
+        }
+    }
+    return base->GetCoin(outpoint, coin);
+}
+
+bool CCoinsViewAsyncFlush::HaveCoin(const COutPoint& outpoint) const
+{
+    {
+        LOCK(cs);
+        if (fWriting) {
+            CCoinsMap::const_iterator it = snapCoins->find(outpoint);
+            if (it != snapCoins->end()) return !it->second.coin.IsSpent();
+        }
+    }
+    return base->HaveCoin(outpoint);
+}
+
+uint256 CCoinsViewAsyncFlush::GetBestBlock() const
+{
+    {
+        LOCK(cs);
+        if (fWriting && !snapBestBlock.IsNull()) return snapBestBlock;
+    }
+    return base->GetBestBlock();
+}
+
+CCoinsViewCursor* CCoinsViewAsyncFlush::Cursor() const
+{
+    // Cursors iterate over the database only: let it catch up first
+    WaitForFlush();
+    return base->Cursor();
+}
+
+bool CCoinsViewAsyncFlush::GetSaplingAnchorAt(const uint256& rt, SaplingMerkleTree& tree) const
+{
+    {
+        LOCK(cs);
+        if (fWriting) {
+            CAnchorsSaplingMap::const_iterator it = snapSaplingAnchors->find(rt);
+            if (it != snapSaplingAnchors->end()) {
+                if (!it->second.entered) return false;
+                tree = it->second.tree;
+                return true;
+            }
+        }
+    }
+    return base->GetSaplingAnchorAt(rt, tree);
+}
+
+bool CCoinsViewAsyncFlush::GetNullifier(const uint256& nullifier) const
+{
+    {
+        LOCK(cs);
+        if (fWriting) {
+            CNullifiersMap::const_iterator it = snapSaplingNullifiers->find(nullifier);
+            if (it != snapSaplingNullifiers->end()) return it->second.entered;
+        }
+    }
+    return base->GetNullifier(nullifier);
+}
+
+uint256 CCoinsViewAsyncFlush::GetBestAnchor() const
+{
+    {
+        LOCK(cs);
+        if (fWriting && !snapBestAnchor.IsNull()) return snapBestAnchor;
+    }
+    return base->GetBestAnchor();
+}
+
+bool CCoinsViewAsyncFlush::BatchWrite(CCoinsMap& mapCoins,
+                                      const uint256& hashBlock,
+                                      const uint256& hashSaplingAnchor,
+                                      CAnchorsSaplingMap& mapSaplingAnchors,
+                                      CNullifiersMap& mapSaplingNullifiers)
+{
+    // Writes are ordered: the previous snapshot must be on disk before the next one is written
+    bool fPrevOk = WaitForFlush();
+    if (writer.joinable()) writer.join();
+    std::function<bool(CCoinsView*)> fnWritten = std::move(fnOnWritten);
+    fnOnWritten = nullptr;
+    if (!fAsync) {
+        bool fOk = db->BatchWrite(mapCoins, hashBlock, hashSaplingAnchor, mapSaplingAnchors, mapSaplingNullifiers);
+        if (fOk && fnWritten) fOk = fnWritten(db);
+        return fOk && fPrevOk;
+    }
+
+    {
+        LOCK(cs);
+        // Take over the changes, keeping only the dirty entries. They are moved into a map
+        // of its own: the nodes of mapCoins belong to the memory pool of the cache on top,
+        // which must not be used from the writer thread.
+        snapCoins.reset(new CCoinsMap());
+        snapCoins->reserve(mapCoins.size());
+        for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end(); it = mapCoins.erase(it)) {
+            if (it->second.flags & CCoinsCacheEntry::DIRTY) {
+                snapCoins->emplace(it->first, std::move(it->second));
+            }
+        }
+        snapBestBlock = hashBlock;
+        snapBestAnchor = hashSaplingAnchor;
+        snapSaplingAnchors.reset(new CAnchorsSaplingMap(std::move(mapSaplingAnchors)));
+        mapSaplingAnchors.clear();
+        snapSaplingNullifiers.reset(new CNullifiersMap(std::move(mapSaplingNullifiers)));
+        mapSaplingNullifiers.clear();
+        snapOnWritten = std::move(fnWritten);
+        fWriting = true;
+        fWriteFailed = false;
+    }
+    LogPrint(BCLog::COINDB, "Writing %u changed coins to the coin database in the background...\n", snapCoins->size());
+    writer = std::thread(&TraceThread<std::function<void()> >, "coinsflush", std::function<void()>(std::bind(&CCoinsViewAsyncFlush::ThreadWriteSnapshot, this)));
+    return fPrevOk;
+}
+
+void CCoinsViewAsyncFlush::ThreadWriteSnapshot()
+{
+    int64_t nStart = GetTimeMillis();
+    bool fOk = false;
+    try {
+        // The snapshot is not modified until fWriting is reset, only read concurrently.
+        fOk = db->WriteSnapshot(*snapCoins, snapBestBlock, snapBestAnchor, *snapSaplingAnchors, *snapSaplingNullifiers);
+        if (fOk && snapOnWritten) fOk = snapOnWritten(db);
+    } catch (const std::exception& e) {
+        LogPrintf("%s: error writing the coin database: %s\n", __func__, e.what());
+    }
+
+    // Release the snapshot outside of the lock
+    std::unique_ptr<CCoinsMap> coinsDone;
+    std::unique_ptr<CAnchorsSaplingMap> anchorsDone;
+    std::unique_ptr<CNullifiersMap> nullifiersDone;
+    {
+        LOCK(cs);
+        coinsDone = std::move(snapCoins);
+        anchorsDone = std::move(snapSaplingAnchors);
+        nullifiersDone = std::move(snapSaplingNullifiers);
+        snapOnWritten = nullptr;
+        fWriting = false;
+        fWriteFailed = !fOk;
+    }
+    cond.notify_all();
+    LogPrint(BCLog::COINDB, "Background coin database write %s in %dms\n", fOk ? "completed" : "FAILED", GetTimeMillis() - nStart);
+}
+
+bool CCoinsViewAsyncFlush::WaitForFlush() const
+{
+    WAIT_LOCK(cs, lock);
+    while (fWriting) {
+        cond.wait(lock);
+    }
+    return !fWriteFailed;
+}
+
+CCoinsViewCursor* CCoinsViewAsyncFlush::DBCursor() const
+{
+    // A write leaves no best block until its last batch, and one landing while the
+    // cursor is opened changes it: the cursor is consistent if it is the same on both sides.
+    const uint256 hashBestBlock = db->GetBestBlock();
+    if (hashBestBlock.IsNull()) return nullptr;
+    std::unique_ptr<CCoinsViewCursor> pcursor(db->Cursor());
+    if (pcursor->GetBestBlock() != hashBestBlock) return nullptr;
+    return pcursor.release();
+}
+
+void CCoinsViewAsyncFlush::SetOnWritten(std::function<bool(CCoinsView*)> fn)
+{
+    fnOnWritten = std::move(fn);
+}
+
+CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe, "blockindex")
 {
 }
 
@@ -296,12 +505,44 @@ bool CBlockTreeDB::ReadInt(const std::string& name, int& nValue)
     return Read(std::make_pair('I', name), nValue);
 }
 
-bool CBlockTreeDB::LoadBlockIndexGuts(std::function<CBlockIndex*(const uint256&)> insertBlockIndex)
+/**
+ * Recompute the header hashes of a batch of block index entries, split over several threads,
+ * and check them against the hash the entries are keyed by.
+ */
+static bool CheckBlockIndexHashes(const std::vector<std::pair<uint256, CBlockHeader>>& vHeaders)
+{
+    const size_t nThreads = std::max(1, std::min(GetNumCores(), MAX_BLOCKINDEX_HASH_CHECK_THREADS));
+    std::vector<char> vMismatch(vHeaders.size(), false);
+    auto checkHeaders = [&](size_t nFirst) {
+        for (size_t i = nFirst; i < vHeaders.size(); i += nThreads) {
+            vMismatch[i] = vHeaders[i].second.GetHash() != vHeaders[i].first;
+        }
+    };
+    std::vector<std::thread> vCheckers;
+    for (size_t i = 1; i < std::min(nThreads, vHeaders.size()); i++) {
+        vCheckers.emplace_back(checkHeaders, i);
+    }
+    checkHeaders(0);
+    for (std::thread& t : vCheckers) t.join();
+
+    for (size_t i = 0; i < vHeaders.size(); i++) {
+        if (vMismatch[i])
+            return error("LoadBlockIndex() : block hash mismatch for %s: %s", vHeaders[i].first.ToString(), vHeaders[i].second.GetHash().ToString());
+    }
+    return true;
+}
+
+bool CBlockTreeDB::LoadBlockIndexGuts(std::function<CBlockIndex*(const uint256&)> insertBlockIndex, unsigned int nHashCheckRatio)
 {
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
 
     pcursor->Seek(std::make_pair(DB_BLOCK_INDEX, UINT256_ZERO));
 
+    FastRandomContext rng;
+    size_t nHashChecked = 0;
+    std::vector<std::pair<uint256, CBlockHeader>> vHashCheck;
+    vHashCheck.reserve(BLOCKINDEX_HASH_CHECK_BATCH);
+
     // Load mapBlockIndex
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
@@ -309,8 +550,21 @@ bool CBlockTreeDB::LoadBlockIndexGuts(std::function<CBlockIndex*(const uint256&)
         if (pcursor->GetKey(key) && key.first == DB_BLOCK_INDEX) {
             CDiskBlockIndex diskindex;
             if (pcursor->GetValue(diskindex)) {
+                // Entries were fully validated before being written: trust the hash they are keyed by,
+                // and only recompute it (HashQuark for pre-v4 headers) for a sample of them.
+                const uint256& hashBlock = key.second;
+                if (nHashCheckRatio <= 1 || rng.randrange(nHashCheckRatio) == 0) {
+                    vHashCheck.emplace_back(hashBlock, diskindex.GetBlockHeader());
+                    if (vHashCheck.size() == BLOCKINDEX_HASH_CHECK_BATCH) {
+                        if (!CheckBlockIndexHashes(vHashCheck))
+                            return false;
+                        nHashChecked += vHashCheck.size();
+                        vHashCheck.clear();
+                    }
+                }
+
                 // Construct block index object
-                CBlockIndex* pindexNew = insertBlockIndex(diskindex.GetBlockHash());
+                CBlockIndex* pindexNew = insertBlockIndex(hashBlock);
                 pindexNew->pprev = insertBlockIndex(diskindex.hashPrev);
                 pindexNew->nHeight = diskindex.nHeight;
                 pindexNew->nFile = diskindex.nFile;
@@ -329,7 +583,8 @@ bool CBlockTreeDB::LoadBlockIndexGuts(std::function<CBlockIndex*(const uint256&)
                 pindexNew->hashFinalSaplingRoot = diskindex.hashFinalSaplingRoot;
 
                 //zerocoin
-                pindexNew->nAccumulatorCheckpoint = diskindex.nAccumulatorCheckpoint;
+                if (!diskindex.nAccumulatorCheckpoint.IsNull())
+                    pindexNew->SetAccumulatorCheckpoint(diskindex.nAccumulatorCheckpoint);
 
                 //Proof Of Stake
                 pindexNew->nFlags = diskindex.nFlags;
@@ -349,6 +604,10 @@ bool CBlockTreeDB::LoadBlockIndexGuts(std::function<CBlockIndex*(const uint256&)
         }
     }
 
+    if (!CheckBlockIndexHashes(vHashCheck))
+        return false;
+    nHashChecked += vHashCheck.size();
+    LogPrintf("%s: verified the header hash of %u block index entries\n", __func__, nHashChecked);
     return true;
 }
 
@@ -357,7 +616,7 @@ bool CBlockTreeDB::ReadLegacyBlockIndex(const uint256& blockHash, CLegacyBlockIn
     return Read(std::make_pair(DB_BLOCK_INDEX, blockHash), biRet);
 }
 
-CZerocoinDB::CZerocoinDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "zerocoin", nCacheSize, fMemory, fWipe)
+CZerocoinDB::CZerocoinDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "zerocoin", nCacheSize, fMemory, fWipe, "zerocoin")
 {
 }
 
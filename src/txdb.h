@@ -13,8 +13,12 @@
 #include "libzerocoin/Coin.h"
 #include "libzerocoin/CoinSpend.h"
 
+#include <condition_variable>
+#include <functional>
 #include <map>
+#include <memory>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -27,10 +31,18 @@ static constexpr int MAX_BLOCK_COINSDB_USAGE = 10;
 static const int64_t nDefaultDbCache = 100;
 //! -dbbatchsize default (bytes)
 static const int64_t nDefaultDbBatchSize = 16 << 20;
+//! -asyncflush default
+static const bool DEFAULT_ASYNC_FLUSH = false;
 //! max. -dbcache in (MiB)
 static const int64_t nMaxDbCache = sizeof(void*) > 4 ? 16384 : 1024;
 //! min. -dbcache in (MiB)
 static const int64_t nMinDbCache = 4;
+//! When loading the block index, recompute the header hash of one entry every this many (all of them with -checkblockindex)
+static const unsigned int BLOCKINDEX_HASH_CHECK_RATIO = 256;
+//! When loading the block index, the header hashes are recomputed by batches of this many entries, on several threads
+static const size_t BLOCKINDEX_HASH_CHECK_BATCH = 16384;
+//! Maximum number of threads recomputing the header hashes of the block index entries
+static const int MAX_BLOCKINDEX_HASH_CHECK_THREADS = 16;
 
 struct CDiskTxPos : public CDiskBlockPos
 {
@@ -86,6 +98,13 @@ public:
                     CAnchorsSaplingMap& mapSaplingAnchors,
                     CNullifiersMap& mapSaplingNullifiers) override;
 
+    //! Same as BatchWrite, but leaves the passed maps untouched (so they can still be read concurrently)
+    bool WriteSnapshot(CCoinsMap& mapCoins,
+                       const uint256& hashBlock,
+                       const uint256& hashSaplingAnchor,
+                       CAnchorsSaplingMap& mapSaplingAnchors,
+                       CNullifiersMap& mapSaplingNullifiers);
+
     // Sapling, the implementation of the following functions can be found in sapling_txdb.cpp.
     bool GetSaplingAnchorAt(const uint256 &rt, SaplingMerkleTree &tree) const override;
     bool GetNullifier(const uint256 &nf) const override;
@@ -93,7 +112,90 @@ public:
     bool BatchWriteSapling(const uint256& hashSaplingAnchor,
                            CAnchorsSaplingMap& mapSaplingAnchors,
                            CNullifiersMap& mapSaplingNullifiers,
-                           CDBBatch& batch);
+                           CDBBatch& batch,
+                           bool fErase = true);
+
+private:
+    bool BatchWrite(CCoinsMap& mapCoins,
+                    const uint256& hashBlock,
+                    const uint256& hashSaplingAnchor,
+                    CAnchorsSaplingMap& mapSaplingAnchors,
+                    CNullifiersMap& mapSaplingNullifiers,
+                    bool fErase);
+};
+
+/**
+ * CCoinsView layer between the coins tip cache and the coins database, used for background
+ * flushes (-asyncflush). A flush freezes the changes of the cache into an immutable snapshot,
+ * which is written to the database by a background thread while the cache on top keeps
+ * connecting blocks. Reads are served from the snapshot first, then from the base view.
+ * Crash consistency relies on the DB_HEAD_BLOCKS marker written by every database flush:
+ * an interrupted background write gets replayed at startup like a synchronous one.
+ * Only one snapshot is in flight at any time: a flush waits for the previous one to complete.
+ */
+class CCoinsViewAsyncFlush : public CCoinsViewBacked
+{
+private:
+    CCoinsViewDB* db;
+    const bool fAsync;
+
+    mutable Mutex cs;
+    mutable std::condition_variable cond;
+    bool fWriting{false};
+    bool fWriteFailed{false};
+    std::thread writer;
+
+    // The snapshot being written (set under cs, and immutable while fWriting)
+    std::unique_ptr<CCoinsMap> snapCoins;
+    uint256 snapBestBlock;
+    uint256 snapBestAnchor;
+    std::unique_ptr<CAnchorsSaplingMap> snapSaplingAnchors;
+    std::unique_ptr<CNullifiersMap> snapSaplingNullifiers;
+
+    // Run once the changes of the next (resp. the in flight) write are on disk
+    std::function<bool(CCoinsView*)> fnOnWritten;
+    std::function<bool(CCoinsView*)> snapOnWritten;
+
+    void ThreadWriteSnapshot();
+
+public:
+    CCoinsViewAsyncFlush(CCoinsView* viewIn, CCoinsViewDB* dbIn, bool fAsyncIn);
+    ~CCoinsViewAsyncFlush();
+
+    bool GetCoin(const COutPoint& outpoint, Coin& coin) const override;
+    bool HaveCoin(const COutPoint& outpoint) const override;
+    uint256 GetBestBlock() const override;
+    CCoinsViewCursor* Cursor() const override;
+    bool GetSaplingAnchorAt(const uint256& rt, SaplingMerkleTree& tree) const override;
+    bool GetNullifier(const uint256& nullifier) const override;
+    uint256 GetBestAnchor() const override;
+
+    /**
+     * With -asyncflush, take over the passed changes as the new snapshot and return
+     * as soon as its background write has started. Otherwise write them synchronously.
+     * Returns false if the previous background write failed.
+     */
+    bool BatchWrite(CCoinsMap& mapCoins,
+                    const uint256& hashBlock,
+                    const uint256& hashSaplingAnchor,
+                    CAnchorsSaplingMap& mapSaplingAnchors,
+                    CNullifiersMap& mapSaplingNullifiers) override;
+
+    //! Wait for the snapshot in flight (if any) to be written. Returns whether it was successfully written.
+    bool WaitForFlush() const;
+
+    /**
+     * A cursor over the database as it is, consistent with its best block, without waiting
+     * for the snapshot in flight. Null while the database is in the middle of a write.
+     */
+    CCoinsViewCursor* DBCursor() const;
+
+    /**
+     * Run fn on the coin database once the changes of the next BatchWrite were successfully
+     * written (from the background writer with -asyncflush), for the state which must not
+     * get ahead of the coins on disk. Its failure counts as a failed write.
+     */
+    void SetOnWritten(std::function<bool(CCoinsView*)> fn);
 };
 
 /** Specialization of CCoinsViewCursor to iterate over a CCoinsViewDB */
@@ -141,7 +243,12 @@ public:
     bool ReadFlag(const std::string& name, bool& fValue);
     bool WriteInt(const std::string& name, int nValue);
     bool ReadInt(const std::string& name, int& nValue);
-    bool LoadBlockIndexGuts(std::function<CBlockIndex*(const uint256&)> insertBlockIndex);
+    /**
+     * Load every block index entry, keyed by the block hash stored in the db.
+     * Header hashes (HashQuark for pre-v4 blocks) are only recomputed and checked
+     * against the key for a random sample of 1 in nHashCheckRatio entries, in parallel.
+     */
+    bool LoadBlockIndexGuts(std::function<CBlockIndex*(const uint256&)> insertBlockIndex, unsigned int nHashCheckRatio = BLOCKINDEX_HASH_CHECK_RATIO);
     bool ReadLegacyBlockIndex(const uint256& blockHash, CLegacyBlockIndex& biRet);
 };
 
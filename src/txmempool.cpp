@@ -64,18 +64,46 @@ void CTxMemPoolEntry::UpdateFeeDelta(int64_t newFeeDelta)
     feeDelta = newFeeDelta;
 }
 
+CTxMemPool::EpochGuard::EpochGuard(const CTxMemPool& in) : pool(in)
+{
+    assert(!pool.m_has_epoch_guard);
+    ++pool.m_epoch;
+    pool.m_has_epoch_guard = true;
+}
+
+CTxMemPool::EpochGuard::~EpochGuard()
+{
+    // prevents stale results being used
+    ++pool.m_epoch;
+    pool.m_has_epoch_guard = false;
+}
+
+bool CTxMemPool::visited(txiter it) const
+{
+    assert(m_has_epoch_guard);
+    if (it->m_epoch == m_epoch) {
+        return true;
+    }
+    it->m_epoch = m_epoch;
+    return false;
+}
+
 // Update the given tx for any in-mempool descendants.
 // Assumes that setMemPoolChildren is correct for the given tx and all
 // descendants.
 void CTxMemPool::UpdateForDescendants(txiter updateIt, cacheMap &cachedDescendants, const std::set<uint256> &setExclude)
 {
-    setEntries stageEntries, setAllDescendants;
-    stageEntries = GetMemPoolChildren(updateIt);
+    const EpochGuard epoch(*this);
+    std::vector<txiter> stageEntries, vAllDescendants;
+    for (const txiter& childEntry : GetMemPoolChildren(updateIt)) {
+        visited(childEntry);
+        stageEntries.push_back(childEntry);
+    }
 
     while (!stageEntries.empty()) {
-        const txiter cit = *stageEntries.begin();
-        setAllDescendants.insert(cit);
-        stageEntries.erase(cit);
+        const txiter cit = stageEntries.back();
+        vAllDescendants.push_back(cit);
+        stageEntries.pop_back();
         const setEntries &setChildren = GetMemPoolChildren(cit);
         for (const txiter& childEntry : setChildren) {
             cacheMap::iterator cacheIt = cachedDescendants.find(childEntry);
@@ -83,25 +111,27 @@ void CTxMemPool::UpdateForDescendants(txiter updateIt, cacheMap &cachedDescendan
                 // We've already calculated this one, just add the entries for this set
                 // but don't traverse again.
                 for (const txiter& cacheEntry : cacheIt->second) {
-                    setAllDescendants.insert(cacheEntry);
+                    if (!visited(cacheEntry)) {
+                        vAllDescendants.push_back(cacheEntry);
+                    }
                 }
-            } else if (!setAllDescendants.count(childEntry)) {
+            } else if (!visited(childEntry)) {
                 // Schedule for later processing
-                stageEntries.insert(childEntry);
+                stageEntries.push_back(childEntry);
             }
         }
     }
-    // setAllDescendants now contains all in-mempool descendants of updateIt.
+    // vAllDescendants now contains all in-mempool descendants of updateIt, once each.
     // Update and add to cached descendant map
     int64_t modifySize = 0;
     CAmount modifyFee = 0;
     int64_t modifyCount = 0;
-    for (const txiter& cit : setAllDescendants) {
+    for (const txiter& cit : vAllDescendants) {
         if (!setExclude.count(cit->GetTx().GetHash())) {
             modifySize += cit->GetTxSize();
             modifyFee += cit->GetModifiedFee();
             modifyCount++;
-            cachedDescendants[updateIt].insert(cit);
+            cachedDescendants[updateIt].push_back(cit);
             // Update ancestor state for each descendant
             mapTx.modify(cit, update_ancestor_state(updateIt->GetTxSize(), updateIt->GetModifiedFee(), 1, updateIt->GetSigOpCount()));
         }
@@ -155,12 +185,18 @@ void CTxMemPool::UpdateTransactionsFromBlock(const std::vector<uint256> &vHashes
         }
         UpdateForDescendants(it, mapMemPoolDescendantsToUpdate, setAlreadyIncluded);
     }
+    nSnapshotSequence++;
 }
 
 bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntries &setAncestors, uint64_t limitAncestorCount, uint64_t limitAncestorSize, uint64_t limitDescendantCount, uint64_t limitDescendantSize, std::string &errString, bool fSearchForParents /* = true */) const
 {
-    setEntries parentHashes;
+    // The ancestors found but not walked yet, each visited once
+    const EpochGuard epoch(*this);
+    std::vector<txiter> parentHashes;
     const auto &tx = entry.GetSharedTx();
+    for (const txiter& ancestorIt : setAncestors) {
+        visited(ancestorIt);
+    }
 
     if (fSearchForParents) {
         // Get parents of this transaction that are in the mempool
@@ -168,8 +204,8 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
         // iterate mapTx to find parents.
         for (unsigned int i = 0; i < tx->vin.size(); i++) {
             txiter piter = mapTx.find(tx->vin[i].prevout.hash);
-            if (piter != mapTx.end()) {
-                parentHashes.insert(piter);
+            if (piter != mapTx.end() && !visited(piter)) {
+                parentHashes.push_back(piter);
                 if (parentHashes.size() + 1 > limitAncestorCount) {
                     errString = strprintf("too many unconfirmed parents [limit: %u]", limitAncestorCount);
                     return false;
@@ -180,16 +216,19 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
         // If we're not searching for parents, we require this to be an
         // entry in the mempool already.
         txiter it = mapTx.iterator_to(entry);
-        parentHashes = GetMemPoolParents(it);
+        for (const txiter& piter : GetMemPoolParents(it)) {
+            visited(piter);
+            parentHashes.push_back(piter);
+        }
     }
 
     size_t totalSizeWithAncestors = entry.GetTxSize();
 
     while (!parentHashes.empty()) {
-        txiter stageit = *parentHashes.begin();
+        txiter stageit = parentHashes.back();
 
         setAncestors.insert(stageit);
-        parentHashes.erase(stageit);
+        parentHashes.pop_back();
         totalSizeWithAncestors += stageit->GetTxSize();
 
         if (stageit->GetSizeWithDescendants() + entry.GetTxSize() > limitDescendantSize) {
@@ -206,8 +245,8 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
         const setEntries & setMemPoolParents = GetMemPoolParents(stageit);
         for (const txiter& phash : setMemPoolParents) {
             // If this is a new ancestor, add it.
-            if (setAncestors.count(phash) == 0) {
-                parentHashes.insert(phash);
+            if (!visited(phash)) {
+                parentHashes.push_back(phash);
             }
             if (parentHashes.size() + setAncestors.size() + 1 > limitAncestorCount) {
                 errString = strprintf("too many unconfirmed ancestors [limit: %u]", limitAncestorCount);
@@ -428,6 +467,7 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry,
     }
 
     nTransactionsUpdated++;
+    nSnapshotSequence++;
     totalTxSize += entry.GetTxSize();
     minerPolicyEstimator->processTransaction(entry, fCurrentEstimate);
 
@@ -503,6 +543,7 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
     mapLinks.erase(it);
     mapTx.erase(it);
     nTransactionsUpdated++;
+    nSnapshotSequence++;
     minerPolicyEstimator->removeTx(tx.GetHash());
 }
 
@@ -514,22 +555,25 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
 // can save time by not iterating over those entries.
 void CTxMemPool::CalculateDescendants(txiter entryit, setEntries &setDescendants)
 {
-    setEntries stage;
-    if (setDescendants.count(entryit) == 0) {
-        stage.insert(entryit);
+    if (setDescendants.count(entryit)) {
+        return;
     }
+    const EpochGuard epoch(*this);
+    std::vector<txiter> stage;
+    visited(entryit);
+    stage.push_back(entryit);
     // Traverse down the children of entry, only adding children that are not
     // accounted for in setDescendants already (because those children have either
     // already been walked, or will be walked in this iteration).
     while (!stage.empty()) {
-        txiter it = *stage.begin();
+        txiter it = stage.back();
         setDescendants.insert(it);
-        stage.erase(it);
+        stage.pop_back();
 
         const setEntries &setChildren = GetMemPoolChildren(it);
         for (const txiter& childiter : setChildren) {
-            if (!setDescendants.count(childiter)) {
-                stage.insert(childiter);
+            if (!visited(childiter) && !setDescendants.count(childiter)) {
+                stage.push_back(childiter);
             }
         }
     }
@@ -780,6 +824,7 @@ void CTxMemPool::_clear()
     blockSinceLastRollingFeeBump = false;
     rollingMinimumFeeRate = 0;
     ++nTransactionsUpdated;
+    ++nSnapshotSequence;
 }
 
 void CTxMemPool::clear()
@@ -899,7 +944,7 @@ void CTxMemPool::check(const CCoinsViewCache* pcoins) const
         else {
             CValidationState state;
             PrecomputedTransactionData precomTxData(tx);
-            assert(CheckInputs(tx, state, mempoolDuplicate, false, 0, false, precomTxData, NULL));
+            assert(CheckInputs(tx, state, mempoolDuplicate, false, 0, false, false, precomTxData, NULL));
             UpdateCoins(tx, mempoolDuplicate, 1000000);
         }
     }
@@ -915,7 +960,7 @@ void CTxMemPool::check(const CCoinsViewCache* pcoins) const
             assert(stepsSinceLastRemove < waitingOnDependants.size());
         } else {
             PrecomputedTransactionData precomTxData(entry->GetTx());
-            assert(CheckInputs(entry->GetTx(), state, mempoolDuplicate, false, 0, false, precomTxData, NULL));
+            assert(CheckInputs(entry->GetTx(), state, mempoolDuplicate, false, 0, false, false, precomTxData, NULL));
             UpdateCoins(entry->GetTx(), mempoolDuplicate, 1000000);
             stepsSinceLastRemove = 0;
         }
@@ -965,7 +1010,7 @@ namespace {
     class DepthAndScoreComparator
     {
     public:
-        bool operator()(const CTxMemPool::indexed_transaction_set::const_iterator& a, const CTxMemPool::indexed_transaction_set::const_iterator& b) const
+        bool operator()(const CTxMemPoolEntry* a, const CTxMemPoolEntry* b) const
         {
             uint64_t counta = a->GetCountWithAncestors();
             uint64_t countb = b->GetCountWithAncestors();
@@ -977,46 +1022,89 @@ namespace {
     };
 }
 
-std::vector<CTxMemPool::indexed_transaction_set::const_iterator> CTxMemPool::GetSortedDepthAndScore() const
+CTxMemPoolSnapshot::CTxMemPoolSnapshot(uint64_t nSequenceIn, std::vector<CTxMemPoolEntry>&& vEntriesIn) :
+    nSequence(nSequenceIn),
+    vEntries(std::move(vEntriesIn))
 {
-    std::vector<indexed_transaction_set::const_iterator> iters;
-    AssertLockHeld(cs);
+    vIndex.reserve(vEntries.size());
+    for (size_t i = 0; i < vEntries.size(); i++) {
+        vIndex.emplace_back(vEntries[i].GetTx().GetHash(), i);
+    }
+    std::sort(vIndex.begin(), vIndex.end());
+}
 
-    iters.reserve(mapTx.size());
+const CTxMemPoolEntry* CTxMemPoolSnapshot::Find(const uint256& hash) const
+{
+    auto it = std::lower_bound(vIndex.begin(), vIndex.end(), std::make_pair(hash, (size_t)0));
+    if (it == vIndex.end() || it->first != hash) {
+        return nullptr;
+    }
+    return &vEntries[it->second];
+}
 
-    for (indexed_transaction_set::iterator mi = mapTx.begin(); mi != mapTx.end(); ++mi) {
-        iters.push_back(mi);
+std::vector<const CTxMemPoolEntry*> CTxMemPoolSnapshot::GetSortedDepthAndScore() const
+{
+    std::vector<const CTxMemPoolEntry*> ret;
+    ret.reserve(vEntries.size());
+    for (const CTxMemPoolEntry& entry : vEntries) {
+        ret.push_back(&entry);
     }
-    std::sort(iters.begin(), iters.end(), DepthAndScoreComparator());
-    return iters;
+    std::sort(ret.begin(), ret.end(), DepthAndScoreComparator());
+    return ret;
 }
 
-void CTxMemPool::queryHashes(std::vector<uint256>& vtxid)
+CTxMemPoolSnapshotRef CTxMemPool::GetSnapshot() const
 {
+    uint64_t nSequence;
+    std::vector<CTxMemPoolEntry> vEntries;
+    {
+        LOCK(cs);
+        CTxMemPoolSnapshotRef snapshot = m_snapshot.lock();
+        if (snapshot && snapshot->GetSequence() == nSnapshotSequence) {
+            return snapshot;
+        }
+        nSequence = nSnapshotSequence;
+        vEntries.reserve(mapTx.size());
+        for (const CTxMemPoolEntry& entry : mapTx) {
+            vEntries.push_back(entry);
+        }
+    }
+
+    // The index is built without the lock
+    CTxMemPoolSnapshotRef snapshot = std::make_shared<const CTxMemPoolSnapshot>(nSequence, std::move(vEntries));
     LOCK(cs);
-    auto iters = GetSortedDepthAndScore();
+    if (nSnapshotSequence == nSequence) {
+        m_snapshot = snapshot;
+    }
+    return snapshot;
+}
+
+void CTxMemPool::queryHashes(std::vector<uint256>& vtxid)
+{
+    const CTxMemPoolSnapshotRef snapshot = GetSnapshot();
+    auto entries = snapshot->GetSortedDepthAndScore();
 
     vtxid.clear();
-    vtxid.reserve(mapTx.size());
+    vtxid.reserve(entries.size());
 
-    for (auto it : iters) {
-        vtxid.emplace_back(it->GetTx().GetHash());
+    for (const CTxMemPoolEntry* entry : entries) {
+        vtxid.emplace_back(entry->GetTx().GetHash());
     }
 }
 
-static TxMempoolInfo GetInfo(CTxMemPool::indexed_transaction_set::const_iterator it) {
-    return TxMempoolInfo{it->GetSharedTx(), it->GetTime(), CFeeRate(it->GetFee(), it->GetTxSize()), it->GetModifiedFee() - it->GetFee()};
+static TxMempoolInfo GetInfo(const CTxMemPoolEntry& entry) {
+    return TxMempoolInfo{entry.GetSharedTx(), entry.GetTime(), CFeeRate(entry.GetFee(), entry.GetTxSize()), entry.GetModifiedFee() - entry.GetFee()};
 }
 
 std::vector<TxMempoolInfo> CTxMemPool::infoAll() const
 {
-    LOCK(cs);
-    auto iters = GetSortedDepthAndScore();
+    const CTxMemPoolSnapshotRef snapshot = GetSnapshot();
+    auto entries = snapshot->GetSortedDepthAndScore();
 
     std::vector<TxMempoolInfo> ret;
-    ret.reserve(mapTx.size());
-    for (auto it : iters) {
-        ret.emplace_back(GetInfo(it));
+    ret.reserve(entries.size());
+    for (const CTxMemPoolEntry* entry : entries) {
+        ret.emplace_back(GetInfo(*entry));
     }
 
     return ret;
@@ -1046,7 +1134,7 @@ TxMempoolInfo CTxMemPool::info(const uint256& hash) const
     indexed_transaction_set::const_iterator i = mapTx.find(hash);
     if (i == mapTx.end())
         return TxMempoolInfo();
-    return GetInfo(i);
+    return GetInfo(*i);
 }
 
 bool CTxMemPool::existsProviderTxConflict(const CTransaction &tx) const {
@@ -1148,6 +1236,7 @@ void CTxMemPool::PrioritiseTransaction(const uint256 hash, const std::string str
             for (const txiter& ancestorIt : setAncestors) {
                 mapTx.modify(ancestorIt, update_descendant_state(0, nFeeDelta, 0));
             }
+            nSnapshotSequence++;
         }
     }
     LogPrintf("PrioritiseTransaction: %s priority += %f, fee += %d\n", strHash, dPriorityDelta, FormatMoney(nFeeDelta));
@@ -138,6 +138,9 @@ public:
     uint64_t GetSizeWithAncestors() const { return nSizeWithAncestors; }
     CAmount GetModFeesWithAncestors() const { return nModFeesWithAncestors; }
     unsigned int GetSigOpCountWithAncestors() const { return nSigOpCountWithAncestors; }
+
+    //! The epoch of the last walk of the mempool that visited this entry (see CTxMemPool::visited)
+    mutable uint64_t m_epoch{0};
 };
 
 // Helpers for modifying CTxMemPool::mapTx, which is a boost multi_index.
@@ -310,6 +313,38 @@ struct TxMempoolInfo
     int64_t nFeeDelta;
 };
 
+/**
+ * An immutable copy of the mempool entries, for the readers going through the whole mempool
+ * (RPCs, BIP35 replies, mempool.dat). Taking it only copies the entries, sharing their
+ * transactions, under the mempool lock; the sorting, lookups and serialization are then
+ * done without holding any lock. See CTxMemPool::GetSnapshot.
+ */
+class CTxMemPoolSnapshot
+{
+private:
+    const uint64_t nSequence;
+    //! In the order of mapTx
+    const std::vector<CTxMemPoolEntry> vEntries;
+    //! The positions of the entries in vEntries, sorted by txid
+    std::vector<std::pair<uint256, size_t> > vIndex;
+
+public:
+    CTxMemPoolSnapshot(uint64_t nSequenceIn, std::vector<CTxMemPoolEntry>&& vEntriesIn);
+
+    /** The state of the mempool it was taken from (see CTxMemPool::GetSnapshot) */
+    uint64_t GetSequence() const { return nSequence; }
+    size_t size() const { return vEntries.size(); }
+    const std::vector<CTxMemPoolEntry>& GetEntries() const { return vEntries; }
+
+    const CTxMemPoolEntry* Find(const uint256& hash) const;
+    bool exists(const uint256& hash) const { return Find(hash) != nullptr; }
+
+    /** The entries sorted by ancestor count, then by score: the parents come before their children */
+    std::vector<const CTxMemPoolEntry*> GetSortedDepthAndScore() const;
+};
+
+typedef std::shared_ptr<const CTxMemPoolSnapshot> CTxMemPoolSnapshotRef;
+
 /** Reason why a transaction was removed from the mempool,
  * this is passed to the notification signal.
  */
@@ -502,7 +537,7 @@ public:
     const setEntries & GetMemPoolParents(txiter entry) const;
     const setEntries & GetMemPoolChildren(txiter entry) const;
 private:
-    typedef std::map<txiter, setEntries, CompareIteratorByHash> cacheMap;
+    typedef std::map<txiter, std::vector<txiter>, CompareIteratorByHash> cacheMap;
 
     struct TxLinks {
         setEntries parents;
@@ -520,7 +555,30 @@ private:
     void UpdateParent(txiter entry, txiter parent, bool add);
     void UpdateChild(txiter entry, txiter child, bool add);
 
-    std::vector<indexed_transaction_set::const_iterator> GetSortedDepthAndScore() const;
+    //! Changed with mapTx, to share the snapshots of the same state of the mempool
+    uint64_t nSnapshotSequence{0};
+    //! The last snapshot taken, while it is in use
+    mutable std::weak_ptr<const CTxMemPoolSnapshot> m_snapshot;
+
+    /**
+     * The walks of the ancestors or descendants of a transaction mark the entries they reach
+     * with a fresh epoch, instead of collecting them in a set to know which ones they already
+     * visited. One walk at a time: an EpochGuard must be held while calling visited().
+     */
+    mutable uint64_t m_epoch{0};
+    mutable bool m_has_epoch_guard{false};
+
+    class EpochGuard
+    {
+        const CTxMemPool& pool;
+
+    public:
+        explicit EpochGuard(const CTxMemPool& in);
+        ~EpochGuard();
+    };
+
+    /** Whether the current walk already visited the entry, marking it visited. */
+    bool visited(txiter it) const;
 
 public:
     indirectmap<COutPoint, CTransactionRef> mapNextTx;
@@ -668,6 +726,12 @@ public:
     TxMempoolInfo info(const uint256& hash) const;
     std::vector<TxMempoolInfo> infoAll() const;
 
+    /**
+     * Take an immutable copy of the entries. Snapshots taken while the mempool does not change
+     * are shared, and released with their last reference.
+     */
+    CTxMemPoolSnapshotRef GetSnapshot() const;
+
     bool existsProviderTxConflict(const CTransaction &tx) const;
 
     /** Estimate fee rate needed to get into the next nBlocks
@@ -12,6 +12,8 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <memory>
+#include <unordered_map>
 #include <cassert>
 
 #include <sstream>        // .get_int64()
@@ -21,6 +23,8 @@ public:
     enum VType { VNULL, VOBJ, VARR, VSTR, VNUM, VBOOL, };
 
     UniValue() { typ = VNULL; }
+    UniValue(const UniValue& other);
+    UniValue(UniValue&& other) = default;
     UniValue(UniValue::VType initialType, const std::string& initialStr = "") {
         typ = initialType;
         val = initialStr;
@@ -48,6 +52,9 @@ public:
         setStr(s);
     }
 
+    UniValue& operator=(const UniValue& other);
+    UniValue& operator=(UniValue&& other) = default;
+
     void clear();
 
     bool setNull();
@@ -157,7 +164,18 @@ private:
     std::vector<std::string> keys;
     std::vector<UniValue> values;
 
+    // Objects of at least KEY_INDEX_MIN_SIZE keys index them by hash, so
+    // the lookups do not go through all of them. The index is kept up to
+    // date by the changes, the lookups only read it.
+    typedef std::unordered_multimap<size_t, size_t> KeyIndex;
+    static const size_t KEY_INDEX_MIN_SIZE = 16;
+    std::unique_ptr<KeyIndex> keyIndex;
+
+    void indexKey(size_t idx);
+    void buildKeyIndex();
     bool findKey(const std::string& key, size_t& retIdx) const;
+    size_t estimateSize() const;
+    void writeValue(unsigned int prettyIndent, unsigned int indentLevel, std::string& s) const;
     void writeArray(unsigned int prettyIndent, unsigned int indentLevel, std::string& s) const;
     void writeObject(unsigned int prettyIndent, unsigned int indentLevel, std::string& s) const;
 
@@ -12,12 +12,34 @@
 
 const UniValue NullUniValue;
 
+UniValue::UniValue(const UniValue& other) :
+    typ(other.typ),
+    val(other.val),
+    keys(other.keys),
+    values(other.values),
+    keyIndex(other.keyIndex ? new KeyIndex(*other.keyIndex) : nullptr)
+{
+}
+
+UniValue& UniValue::operator=(const UniValue& other)
+{
+    if (this != &other) {
+        typ = other.typ;
+        val = other.val;
+        keys = other.keys;
+        values = other.values;
+        keyIndex.reset(other.keyIndex ? new KeyIndex(*other.keyIndex) : nullptr);
+    }
+    return *this;
+}
+
 void UniValue::clear()
 {
     typ = VNULL;
     val.clear();
     keys.clear();
     values.clear();
+    keyIndex.reset();
 }
 
 bool UniValue::setNull()
@@ -56,20 +78,19 @@ bool UniValue::setNumStr(const std::string& val_)
 
 bool UniValue::setInt(uint64_t val_)
 {
-    std::ostringstream oss;
-
-    oss << val_;
-
-    return setNumStr(oss.str());
+    // Always a valid number
+    clear();
+    typ = VNUM;
+    val = std::to_string(val_);
+    return true;
 }
 
 bool UniValue::setInt(int64_t val_)
 {
-    std::ostringstream oss;
-
-    oss << val_;
-
-    return setNumStr(oss.str());
+    clear();
+    typ = VNUM;
+    val = std::to_string(val_);
+    return true;
 }
 
 bool UniValue::setFloat(double val_)
@@ -128,6 +149,7 @@ void UniValue::__pushKV(const std::string& key, const UniValue& val_)
 {
     keys.push_back(key);
     values.push_back(val_);
+    indexKey(keys.size() - 1);
 }
 
 bool UniValue::pushKV(const std::string& key, const UniValue& val_)
@@ -164,8 +186,37 @@ void UniValue::getObjMap(std::map<std::string,UniValue>& kv) const
         kv[keys[i]] = values[i];
 }
 
+void UniValue::indexKey(size_t idx)
+{
+    if (keyIndex)
+        keyIndex->emplace(std::hash<std::string>()(keys[idx]), idx);
+    else if (keys.size() >= KEY_INDEX_MIN_SIZE)
+        buildKeyIndex();
+}
+
+void UniValue::buildKeyIndex()
+{
+    keyIndex.reset(new KeyIndex());
+    keyIndex->reserve(keys.size());
+    for (size_t i = 0; i < keys.size(); i++)
+        keyIndex->emplace(std::hash<std::string>()(keys[i]), i);
+}
+
 bool UniValue::findKey(const std::string& key, size_t& retIdx) const
 {
+    if (keyIndex) {
+        // The first of the keys equal to key, as below
+        bool found = false;
+        auto range = keyIndex->equal_range(std::hash<std::string>()(key));
+        for (auto it = range.first; it != range.second; ++it) {
+            if (keys[it->second] == key && (!found || it->second < retIdx)) {
+                retIdx = it->second;
+                found = true;
+            }
+        }
+        return found;
+    }
+
     for (size_t i = 0; i < keys.size(); i++) {
         if (keys[i] == key) {
             retIdx = i;
@@ -233,9 +284,9 @@ const char *uvTypeName(UniValue::VType t)
 
 const UniValue& find_value(const UniValue& obj, const std::string& name)
 {
-    for (unsigned int i = 0; i < obj.keys.size(); i++)
-        if (obj.keys[i] == name)
-            return obj.values.at(i);
+    size_t idx;
+    if (obj.findKey(name, idx))
+        return obj.values.at(idx);
 
     return NullUniValue;
 }
@@ -45,6 +45,15 @@ public:
                 push_back_u(codepoint);
         }
     }
+    // Write a run of 7-bit ASCII chars
+    void append(const char *s, size_t len)
+    {
+        if (state) { // Invalid mid-sequence, let push_back account for it
+            for (size_t i = 0; i < len; i++)
+                push_back(s[i]);
+        } else
+            str.append(s, len);
+    }
     // Write codepoint directly, possibly collating surrogate pairs
     void push_back_u(unsigned int codepoint_)
     {
@@ -437,6 +437,12 @@ void ArgsManager::ForceSetArg(const std::string& strArg, const std::string& strV
     m_override_args[strArg] = {strValue};
 }
 
+void ArgsManager::ClearForcedArg(const std::string& strArg)
+{
+    LOCK(cs_args);
+    m_override_args.erase(strArg);
+}
+
 static const int screenWidth = 79;
 static const int optIndent = 2;
 static const int msgIndent = 7;
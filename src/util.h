@@ -223,6 +223,9 @@ public:
     // Forces a arg setting, used only in testing
     void ForceSetArg(const std::string& strArg, const std::string& strValue);
 
+    // Removes a forced arg setting, used only in testing
+    void ClearForcedArg(const std::string& strArg);
+
     /**
      * Looks for -regtest, -testnet and returns the appropriate BIP70 chain name.
      * @return CBaseChainParams::MAIN by default; raises runtime error if an invalid combination is given.
@@ -12,6 +12,8 @@
 
 #include "addrman.h"
 #include "amount.h"
+#include "blockcompression.h"
+#include "blockreadcache.h"
 #include "blocksignature.h"
 #include "budget/budgetmanager.h"
 #include "chainparams.h"
@@ -22,6 +24,8 @@
 #include "consensus/tx_verify.h"
 #include "consensus/validation.h"
 #include "consensus/zerocoin_verify.h"
+#include "crypto/common.h"
+#include "cuckoocache.h"
 #include "evo/deterministicmns.h"
 #include "evo/specialtx.h"
 #include "fs.h"
@@ -42,8 +46,10 @@
 #include "reverse_iterate.h"
 #include "sapling/sapling_validation.h"
 #include "script/sigcache.h"
+#include "sigbatch.h"
 #include "spork.h"
 #include "sporkdb.h"
+#include "support/allocators/monotonic.h"
 #include "evo/evodb.h"
 #include "txdb.h"
 #include "txmempool.h"
@@ -56,12 +62,15 @@
 #include "zqrtc/zerocoin.h"
 #include "zqrtc/zqrtcmodule.h"
 
+#include <condition_variable>
 #include <future>
 
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/thread.hpp>
 #include <atomic>
 #include <queue>
+#include <thread>
+#include <unordered_set>
 
 
 #if defined(NDEBUG)
@@ -101,6 +110,7 @@ std::atomic<bool> fReindex{false};
 bool fTxIndex = true;
 bool fRequireStandard = true;
 bool fCheckBlockIndex = false;
+bool fBlockCompression = DEFAULT_BLOCK_COMPRESSION;
 bool fVerifyingBlocks = false;
 size_t nCoinCacheUsage = 5000 * 300;
 
@@ -211,6 +221,7 @@ CBlockIndex* GetChainTip()
 }
 
 CCoinsViewCache* pcoinsTip = NULL;
+CCoinsViewAsyncFlush* pcoinsAsyncFlush = nullptr;
 CBlockTreeDB* pblocktree = NULL;
 CZerocoinDB* zerocoinDB = NULL;
 CSporkDB* pSporkDB = NULL;
@@ -388,14 +399,17 @@ void UpdateMempoolForReorg(DisconnectedBlockTransactions &disconnectpool, bool f
                               gArgs.GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60);
 }
 
-bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState &state, const CTransactionRef& _tx, bool fLimitFree,
-                              bool* pfMissingInputs, int64_t nAcceptTime, bool fOverrideMempoolLimit, bool fRejectAbsurdFee, bool ignoreFees,
-                              std::vector<COutPoint>& coins_to_uncache)
+MemPoolAccept::MemPoolAccept(const CTransactionRef& txIn, int64_t nAcceptTimeIn) : tx(txIn), nAcceptTime(nAcceptTimeIn) {}
+
+MemPoolAccept::~MemPoolAccept() {}
+
+static void CacheScriptExecution(const CTransaction& tx, unsigned int flags);
+
+//! The checks needing neither the chain nor the mempool
+static bool MemPoolPreChecks(MemPoolAccept& accept)
 {
-    AssertLockHeld(cs_main);
-    const CTransaction& tx = *_tx;
-    if (pfMissingInputs)
-        *pfMissingInputs = false;
+    const CTransaction& tx = *accept.tx;
+    CValidationState& state = accept.state;
 
     // Check maintenance mode
     bool hasTxZerocoins = tx.ContainsZerocoins();
@@ -406,10 +420,6 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState &state, const C
         return state.DoS(10, error("%s : Shielded transactions are temporarily disabled for maintenance",
                 __func__), REJECT_INVALID, "bad-tx-sapling-maintenance");
 
-    const CChainParams& params = Params();
-    const Consensus::Params& consensus = params.GetConsensus();
-    int chainHeight = chainActive.Height();
-
     // Zerocoin txes are not longer accepted in the mempool.
     if (hasTxZerocoins) {
         return state.DoS(100, error("%s : v5 upgrade enforced, zerocoin disabled", __func__),
@@ -420,13 +430,48 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState &state, const C
     bool fColdStakingActive = !sporkManager.IsSporkActive(SPORK_19_COLDSTAKING_MAINTENANCE);
     if (!CheckTransaction(tx, state, fColdStakingActive))
         return error("%s : transaction checks for %s failed with %s", __func__, tx.GetHash().ToString(), FormatStateMessage(state));
+    accept.fPreChecked = true;
+
+    // The Sapling proofs don't depend on the chain either. If they fail, ContextualCheckTransaction
+    // checks them again, to reject the transaction with the DoS level of the context.
+    if (tx.hasSaplingData() && !tx.IsCoinBase() && !tx.IsCoinStake()) {
+        CValidationState stateProofs;
+        accept.fProofsChecked = SaplingValidation::CheckTransactionProofs(tx, stateProofs, 0);
+    }
+    return true;
+}
+
+static bool CalculateMemPoolAncestors(CTxMemPool& pool, const CTxMemPoolEntry& entry, CTxMemPool::setEntries& setAncestors, CValidationState& state)
+{
+    size_t nLimitAncestors = gArgs.GetArg("-limitancestorcount", DEFAULT_ANCESTOR_LIMIT);
+    size_t nLimitAncestorSize = gArgs.GetArg("-limitancestorsize", DEFAULT_ANCESTOR_SIZE_LIMIT)*1000;
+    size_t nLimitDescendants = gArgs.GetArg("-limitdescendantcount", DEFAULT_DESCENDANT_LIMIT);
+    size_t nLimitDescendantSize = gArgs.GetArg("-limitdescendantsize", DEFAULT_DESCENDANT_SIZE_LIMIT)*1000;
+    std::string errString;
+    if (!pool.CalculateMemPoolAncestors(entry, setAncestors, nLimitAncestors, nLimitAncestorSize, nLimitDescendants, nLimitDescendantSize, errString)) {
+        return state.DoS(0, error("%s : %s", __func__, errString), REJECT_NONSTANDARD, "too-long-mempool-chain", false);
+    }
+    return true;
+}
+
+//! The checks against the chain and the mempool
+static bool MemPoolPrepare(CTxMemPool& pool, MemPoolAccept& accept, bool fDeferScripts)
+{
+    AssertLockHeld(cs_main);
+    const CTransactionRef& _tx = accept.tx;
+    const CTransaction& tx = *_tx;
+    CValidationState& state = accept.state;
+    accept.fMissingInputs = false;
+
+    const CChainParams& params = Params();
+    const Consensus::Params& consensus = params.GetConsensus();
+    int chainHeight = chainActive.Height();
 
     int nextBlockHeight = chainHeight + 1;
     // Check transaction contextually against consensus rules at block height
-    if (!ContextualCheckTransaction(_tx, state, params, nextBlockHeight, false /* isMined */, IsInitialBlockDownload())) {
+    if (!ContextualCheckTransaction(_tx, state, params, nextBlockHeight, false /* isMined */, IsInitialBlockDownload(), !accept.fProofsChecked)) {
         return error("AcceptToMemoryPool: ContextualCheckTransaction failed");
     }
-
     // Coinbase is only valid in a block, not as a loose transaction
     if (tx.IsCoinBase())
         return state.DoS(100, false, REJECT_INVALID, "coinbase");
@@ -492,7 +537,7 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState &state, const C
             bool had_coin_in_cache = pcoinsTip->HaveCoinInCache(outpoint);
             if (view.HaveCoin(outpoint)) {
                 if (!had_coin_in_cache) {
-                    coins_to_uncache.push_back(outpoint);
+                    accept.coins_to_uncache.push_back(outpoint);
                 }
                 return state.Invalid(false, REJECT_ALREADY_KNOWN, "txn-already-known");
             }
@@ -501,12 +546,10 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState &state, const C
         // do all inputs exist?
         for (const CTxIn& txin : tx.vin) {
             if (!pcoinsTip->HaveCoinInCache(txin.prevout)) {
-                coins_to_uncache.push_back(txin.prevout);
+                accept.coins_to_uncache.push_back(txin.prevout);
             }
             if (!view.HaveCoin(txin.prevout)) {
-                if (pfMissingInputs) {
-                    *pfMissingInputs = true;
-                }
+                accept.fMissingInputs = true;
                 return false; // fMissingInputs and !state.IsInvalid() is used to detect this condition, don't set state.Invalid()
             }
         }
@@ -556,13 +599,14 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState &state, const C
             }
         }
 
-        CTxMemPoolEntry entry(_tx, nFees, nAcceptTime, dPriority, chainHeight, pool.HasNoInputsOf(tx), inChainInputValue, fSpendsCoinbaseOrCoinstake, nSigOps);
+        accept.entry.emplace(_tx, nFees, accept.nAcceptTime, dPriority, chainHeight, pool.HasNoInputsOf(tx), inChainInputValue, fSpendsCoinbaseOrCoinstake, nSigOps);
+        const CTxMemPoolEntry& entry = *accept.entry;
         unsigned int nSize = entry.GetTxSize();
 
         // Don't accept it if it can't get into a block
-        if (!ignoreFees) {
+        if (!accept.fIgnoreFees) {
             const CAmount txMinFee = GetMinRelayFee(tx, pool, nSize, false);
-            if (fLimitFree && nFees < txMinFee)
+            if (accept.fLimitFree && nFees < txMinFee)
                 return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "insufficient fee", false,
                     strprintf("%d < %d", nFees, txMinFee));
 
@@ -574,7 +618,7 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState &state, const C
             // Continuously rate-limit free (really, very-low-fee) transactions
             // This mitigates 'penny-flooding' -- sending thousands of free transactions just to
             // be annoying or make others' transactions take longer to confirm.
-            if (fLimitFree && nFees < ::minRelayTxFee.GetFee(nSize)) {
+            if (accept.fLimitFree && nFees < ::minRelayTxFee.GetFee(nSize)) {
                 static RecursiveMutex csFreeLimiter;
                 static double dFreeCount;
                 static int64_t nLastTime;
@@ -594,7 +638,7 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState &state, const C
             }
         }
 
-        if (fRejectAbsurdFee) {
+        if (accept.fRejectAbsurdFee) {
             const CAmount nMaxFee = tx.IsShieldedTx() ? GetShieldedTxMinFee(tx) * 100 :
                                                         GetMinRelayFee(nSize, false) * 10000;
             if (nFees > nMaxFee)
@@ -611,14 +655,8 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState &state, const C
         }
 
         // Calculate in-mempool ancestors, up to a limit.
-        CTxMemPool::setEntries setAncestors;
-        size_t nLimitAncestors = gArgs.GetArg("-limitancestorcount", DEFAULT_ANCESTOR_LIMIT);
-        size_t nLimitAncestorSize = gArgs.GetArg("-limitancestorsize", DEFAULT_ANCESTOR_SIZE_LIMIT)*1000;
-        size_t nLimitDescendants = gArgs.GetArg("-limitdescendantcount", DEFAULT_DESCENDANT_LIMIT);
-        size_t nLimitDescendantSize = gArgs.GetArg("-limitdescendantsize", DEFAULT_DESCENDANT_SIZE_LIMIT)*1000;
-        std::string errString;
-        if (!pool.CalculateMemPoolAncestors(entry, setAncestors, nLimitAncestors, nLimitAncestorSize, nLimitDescendants, nLimitDescendantSize, errString)) {
-            return state.DoS(0, error("%s : %s", __func__, errString), REJECT_NONSTANDARD, "too-long-mempool-chain", false);
+        if (!CalculateMemPoolAncestors(pool, entry, accept.setAncestors, state)) {
+            return false;
         }
 
         if (!CheckSpecialTx(tx, chainActive.Tip(), state)) {
@@ -634,34 +672,101 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState &state, const C
         if (fCLTVIsActivated)
             flags |= SCRIPT_VERIFY_CHECKLOCKTIMEVERIFY;
 
-        PrecomputedTransactionData precomTxData(tx);
-        if (!CheckInputs(tx, state, view, true, flags, true, precomTxData)) {
+        accept.precomTxData.reset(new PrecomputedTransactionData(tx));
+        accept.nBlockScriptFlags = GetBlockScriptFlags(fCLTVIsActivated);
+        if (fDeferScripts) {
+            // Only the inputs are checked here, the scripts are left to VerifyMemPoolAcceptScripts:
+            // the ones with the standard flags first, then the ones with the flags of the next block.
+            if (!CheckInputs(tx, state, view, true, flags, true, false, *accept.precomTxData, &accept.vScriptChecks)) {
+                return false;
+            }
+            accept.nStandardScriptChecks = accept.vScriptChecks.size();
+            if (!CheckInputs(tx, state, view, true, accept.nBlockScriptFlags, true, true, *accept.precomTxData, &accept.vScriptChecks)) {
+                return false;
+            }
+            accept.fScriptsDeferred = true;
+        } else {
+            if (!CheckInputs(tx, state, view, true, flags, true, false, *accept.precomTxData)) {
+                return false;
+            }
+
+            // Check again against the consensus-critical script verification flags
+            // of the next block, in case of bugs in the standard flags that cause
+            // transactions to pass as valid when they're actually invalid. For
+            // instance the STRICTENC flag was incorrectly allowing certain
+            // CHECKSIG NOT scripts to pass, even though they were invalid.
+            //
+            // There is a similar check in CreateNewBlock() to prevent creating
+            // invalid blocks, however allowing such transactions into the mempool
+            // can be exploited as a DoS attack.
+            //
+            // Using the flags of the blocks allows to cache the result, so that the
+            // scripts are not executed again when the transaction gets in a block.
+            if (!CheckInputs(tx, state, view, true, accept.nBlockScriptFlags, true, true, *accept.precomTxData)) {
+                return error("%s: BUG! PLEASE REPORT THIS! ConnectInputs failed against MANDATORY but not STANDARD flags %s, %s",
+                        __func__, hash.ToString(), FormatStateMessage(state));
+            }
+        }
+    }
+
+    accept.pindexPrepared = chainActive.Tip();
+    return true;
+}
+
+//! Whether the checks of MemPoolPrepare whose scripts were deferred still hold, the mempool having changed since
+static bool MemPoolRecheck(CTxMemPool& pool, const MemPoolAccept& accept)
+{
+    AssertLockHeld(cs_main);
+    if (!accept.fScriptsChecked || accept.pindexPrepared != chainActive.Tip()) {
+        return false;
+    }
+
+    const CTransaction& tx = *accept.tx;
+    LOCK(pool.cs);
+    if (pool.exists(tx.GetHash()) || pool.existsProviderTxConflict(tx)) {
+        return false;
+    }
+    for (const CTxIn& txin : tx.vin) {
+        // Spent by another transaction of the mempool, or created by one gone since
+        if (pool.mapNextTx.count(txin.prevout) ||
+                (!pool.exists(txin.prevout.hash) && !pcoinsTip->HaveCoin(txin.prevout))) {
             return false;
         }
+    }
+    if (tx.IsShieldedTx()) {
+        for (const auto& sd : tx.sapData->vShieldedSpend) {
+            if (pool.nullifierExists(sd.nullifier))
+                return false;
+        }
+    }
+    return true;
+}
 
-        // Check again against just the consensus-critical mandatory script
-        // verification flags, in case of bugs in the standard flags that cause
-        // transactions to pass as valid when they're actually invalid. For
-        // instance the STRICTENC flag was incorrectly allowing certain
-        // CHECKSIG NOT scripts to pass, even though they were invalid.
-        //
-        // There is a similar check in CreateNewBlock() to prevent creating
-        // invalid blocks, however allowing such transactions into the mempool
-        // can be exploited as a DoS attack.
-        flags = MANDATORY_SCRIPT_VERIFY_FLAGS;
-        if (fCLTVIsActivated)
-            flags |= SCRIPT_VERIFY_CHECKLOCKTIMEVERIFY;
-        if (!CheckInputs(tx, state, view, true, flags, true, precomTxData)) {
-            return error("%s: BUG! PLEASE REPORT THIS! ConnectInputs failed against MANDATORY but not STANDARD flags %s, %s",
-                    __func__, hash.ToString(), FormatStateMessage(state));
+static bool MemPoolAdd(CTxMemPool& pool, MemPoolAccept& accept)
+{
+    AssertLockHeld(cs_main);
+    const CTransaction& tx = *accept.tx;
+    const uint256& hash = tx.GetHash();
+    CValidationState& state = accept.state;
+
+    {
+        LOCK(pool.cs);
+        if (accept.fScriptsDeferred) {
+            // The mempool changed while the scripts were checked
+            accept.setAncestors.clear();
+            if (!CalculateMemPoolAncestors(pool, *accept.entry, accept.setAncestors, state)) {
+                return false;
+            }
+            // The scripts passed with the flags of the next block, no need to run them again then
+            CacheScriptExecution(tx, accept.nBlockScriptFlags);
         }
         // todo: pool.removeStaged for all conflicting entries
 
         // Store transaction in memory
-        pool.addUnchecked(hash, entry, setAncestors, !IsInitialBlockDownload());
+        pool.addUnchecked(hash, *accept.entry, accept.setAncestors, !IsInitialBlockDownload());
 
         // trim mempool and check if tx was trimmed
-        if (!fOverrideMempoolLimit) {
+        if (!accept.fOverrideMempoolLimit) {
             LimitMempoolSize(pool, gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000, gArgs.GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60);
             if (!pool.exists(hash))
                 return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "mempool full");
@@ -672,23 +777,120 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState &state, const C
             return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "mempool full");
     }
 
-    GetMainSignals().TransactionAddedToMempool(_tx);
+    GetMainSignals().TransactionAddedToMempool(accept.tx);
 
     return true;
 }
 
-bool AcceptToMemoryPoolWithTime(CTxMemPool& pool, CValidationState &state, const CTransactionRef& tx, bool fLimitFree,
-                        bool* pfMissingInputs, int64_t nAcceptTime, bool fOverrideMempoolLimit, bool fRejectAbsurdFee, bool fIgnoreFees)
+bool PreCheckMemPoolAccept(MemPoolAccept& accept)
+{
+    if (accept.fValid && !MemPoolPreChecks(accept)) {
+        accept.fValid = false;
+    }
+    return accept.fValid;
+}
+
+bool PrepareMemPoolAccept(CTxMemPool& pool, MemPoolAccept& accept, bool fDeferScripts)
+{
+    if (accept.fValid) {
+        assert(accept.fPreChecked);
+        accept.fValid = MemPoolPrepare(pool, accept, fDeferScripts);
+    }
+    return accept.fValid;
+}
+
+/**
+ * Set the reject state of a failed script check: a failure caused by a non-mandatory flag
+ * only (non-standard DER encodings, non-null dummy arguments...) doesn't trigger the DoS
+ * protection, to avoid splitting the network between upgraded and non-upgraded nodes.
+ */
+static bool ScriptCheckFailed(const CScriptCheck& check, CValidationState& state)
+{
+    if (check.GetFlags() & STANDARD_NOT_MANDATORY_VERIFY_FLAGS) {
+        CScriptCheck check2 = check.WithFlags(check.GetFlags() & ~STANDARD_NOT_MANDATORY_VERIFY_FLAGS);
+        if (check2())
+            return state.Invalid(false, REJECT_NONSTANDARD, strprintf("non-mandatory-script-verify-flag (%s)", ScriptErrorString(check.GetScriptError())));
+    }
+    // Failures of other flags indicate a transaction that is
+    // invalid in new blocks, e.g. a invalid P2SH. We DoS ban
+    // such nodes as they are not following the protocol. That
+    // said during an upgrade careful thought should be taken
+    // as to the correct behavior - we may want to continue
+    // peering with non-upgraded nodes even after a soft-fork
+    // super-majority vote has passed.
+    return state.DoS(100, false, REJECT_INVALID, strprintf("mandatory-script-verify-flag-failed (%s)", ScriptErrorString(check.GetScriptError())));
+}
+
+bool VerifyMemPoolAcceptScripts(MemPoolAccept& accept)
+{
+    for (size_t i = 0; i < accept.vScriptChecks.size(); i++) {
+        CScriptCheck& check = accept.vScriptChecks[i];
+        if (!check()) {
+            // No need to go through the checks again in FinishMemPoolAccept: the outcome is
+            // the one MemPoolPrepare gets running the scripts in place.
+            ScriptCheckFailed(check, accept.state);
+            if (i >= accept.nStandardScriptChecks) {
+                error("%s: BUG! PLEASE REPORT THIS! ConnectInputs failed against MANDATORY but not STANDARD flags %s, %s",
+                        __func__, accept.tx->GetHash().ToString(), FormatStateMessage(accept.state));
+            }
+            accept.vScriptChecks.clear();
+            accept.fValid = false;
+            return false;
+        }
+    }
+    accept.vScriptChecks.clear();
+    accept.fScriptsChecked = true;
+    return true;
+}
+
+bool FinishMemPoolAccept(CTxMemPool& pool, MemPoolAccept& accept)
 {
-    std::vector<COutPoint> coins_to_uncache;
-    bool res = AcceptToMemoryPoolWorker(pool, state, tx, fLimitFree, pfMissingInputs, nAcceptTime, fOverrideMempoolLimit, fRejectAbsurdFee, fIgnoreFees, coins_to_uncache);
-    if (!res) {
-        for (const COutPoint& outpoint: coins_to_uncache)
+    AssertLockHeld(cs_main);
+    if (accept.fValid && accept.fScriptsDeferred && !MemPoolRecheck(pool, accept)) {
+        // Something the transaction depends on changed. Go through the checks again, running
+        // the scripts in place (the signatures verified are cached), to get the exact outcome.
+        accept.state = CValidationState();
+        accept.entry = nullopt;
+        accept.setAncestors.clear();
+        accept.vScriptChecks.clear();
+        accept.fScriptsDeferred = false;
+        accept.fValid = MemPoolPrepare(pool, accept, false);
+    }
+    if (accept.fValid) {
+        accept.fValid = MemPoolAdd(pool, accept);
+    }
+
+    if (!accept.fValid) {
+        for (const COutPoint& outpoint : accept.coins_to_uncache)
             pcoinsTip->Uncache(outpoint);
     }
     // After we've (potentially) uncached entries, ensure our coins cache is still within its size limits
     CValidationState stateDummy;
     FlushStateToDisk(stateDummy, FLUSH_STATE_PERIODIC);
+    return accept.fValid;
+}
+
+static bool AcceptToMemoryPoolWorker(CTxMemPool& pool, MemPoolAccept& accept)
+{
+    AssertLockHeld(cs_main);
+    if (PreCheckMemPoolAccept(accept)) {
+        PrepareMemPoolAccept(pool, accept, false);
+    }
+    return FinishMemPoolAccept(pool, accept);
+}
+
+bool AcceptToMemoryPoolWithTime(CTxMemPool& pool, CValidationState &state, const CTransactionRef& tx, bool fLimitFree,
+                        bool* pfMissingInputs, int64_t nAcceptTime, bool fOverrideMempoolLimit, bool fRejectAbsurdFee, bool fIgnoreFees)
+{
+    MemPoolAccept accept(tx, nAcceptTime);
+    accept.fLimitFree = fLimitFree;
+    accept.fOverrideMempoolLimit = fOverrideMempoolLimit;
+    accept.fRejectAbsurdFee = fRejectAbsurdFee;
+    accept.fIgnoreFees = fIgnoreFees;
+    bool res = AcceptToMemoryPoolWorker(pool, accept);
+    state = accept.state;
+    if (pfMissingInputs)
+        *pfMissingInputs = accept.fMissingInputs;
     return res;
 }
 
@@ -713,6 +915,94 @@ bool GetOutput(const uint256& hash, unsigned int index, CValidationState& state,
     return true;
 }
 
+/** Size of the header of the records of the block files: message start and block size */
+static const unsigned int BLOCK_RECORD_HEADER_SIZE = MESSAGE_START_SIZE + sizeof(uint32_t);
+
+/**
+ * Blocks stored compressed (-blockcompression) have the same record header as the raw ones, except
+ * that the last byte of the message start is complemented: the two kinds of records are told apart,
+ * and software unaware of the compressed ones skips them when scanning the files. The size is the
+ * one of the frame (see blockcompression.h) that follows, and the position of the block in the index
+ * is the one of the frame, like it is the one of the serialized block for raw records.
+ */
+static bool IsCompressedMessageStart(const unsigned char* pchMessageStart)
+{
+    const CMessageHeader::MessageStartChars& start = Params().MessageStart();
+    return memcmp(pchMessageStart, start, MESSAGE_START_SIZE - 1) == 0 &&
+           pchMessageStart[MESSAGE_START_SIZE - 1] == (unsigned char)~start[MESSAGE_START_SIZE - 1];
+}
+
+/** Serialize and compress a block. Returns false if it does not get smaller, then it is stored raw. */
+static bool CompressBlock(const CBlock& block, std::vector<unsigned char>& vFrame)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << block;
+    CompressBlockFrame((const unsigned char*)ss.data(), ss.size(), vFrame);
+    return vFrame.size() < ss.size();
+}
+
+/** Decompress a block frame. Malformed frames throw, like malformed serialized blocks do. */
+static void DecompressBlock(const unsigned char* pframe, size_t nFrameSize, std::vector<unsigned char>& vRaw)
+{
+    if (!DecompressBlockFrame(pframe, nFrameSize, vRaw, MAX_BLOCK_SIZE_CURRENT))
+        throw std::ios_base::failure("malformed compressed block");
+}
+
+static void DeserializeBlockFrame(const unsigned char* pframe, size_t nFrameSize, CBlock& block)
+{
+    std::vector<unsigned char> vRaw;
+    DecompressBlock(pframe, nFrameSize, vRaw);
+    CMemoryReader reader(SER_DISK, CLIENT_VERSION, vRaw.data(), vRaw.size());
+    reader >> block;
+}
+
+/** Read the block frame of nSize bytes at the position of the stream, and decompress it */
+template <typename Stream>
+static void ReadBlockFrame(Stream& s, unsigned int nSize, std::vector<unsigned char>& vRaw)
+{
+    std::vector<unsigned char> vFrame(nSize);
+    s.read((char*)vFrame.data(), vFrame.size());
+    DecompressBlock(vFrame.data(), vFrame.size(), vRaw);
+}
+
+/** Read the block of a raw or compressed record, at the position of the stream */
+template <typename Stream>
+static void ReadBlockRecord(Stream& s, bool fCompressed, unsigned int nSize, CBlock& block)
+{
+    if (!fCompressed) {
+        s >> block;
+        return;
+    }
+    std::vector<unsigned char> vRaw;
+    ReadBlockFrame(s, nSize, vRaw);
+    CMemoryReader reader(SER_DISK, CLIENT_VERSION, vRaw.data(), vRaw.size());
+    reader >> block;
+}
+
+/**
+ * Open the block file at the block at pos, after reading the header of its record: whether it is
+ * compressed, and its size.
+ */
+static FILE* OpenBlockRecord(const CDiskBlockPos& pos, bool& fCompressed, unsigned int& nSize)
+{
+    fCompressed = false;
+    nSize = 0;
+    if (pos.nPos < BLOCK_RECORD_HEADER_SIZE)
+        return OpenBlockFile(pos, true);
+    FILE* file = OpenBlockFile(CDiskBlockPos(pos.nFile, pos.nPos - BLOCK_RECORD_HEADER_SIZE), true);
+    if (!file)
+        return nullptr;
+    unsigned char header[BLOCK_RECORD_HEADER_SIZE];
+    if (fread(header, 1, sizeof(header), file) != sizeof(header)) {
+        LogPrintf("Unable to read the header of the block at %d:%u\n", pos.nFile, pos.nPos);
+        fclose(file);
+        return nullptr;
+    }
+    fCompressed = IsCompressedMessageStart(header);
+    nSize = ReadLE32(header + MESSAGE_START_SIZE);
+    return file;
+}
+
 /** Return transaction in tx, and if it was found inside a block, its hash is placed in hashBlock */
 bool GetTransaction(const uint256& hash, CTransactionRef& txOut, uint256& hashBlock, bool fAllowSlow, CBlockIndex* blockIndex)
 {
@@ -731,14 +1021,26 @@ bool GetTransaction(const uint256& hash, CTransactionRef& txOut, uint256& hashBl
         if (fTxIndex) {
             CDiskTxPos postx;
             if (pblocktree->ReadTxIndex(hash, postx)) {
-                CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
+                bool fCompressed;
+                unsigned int nRecordSize;
+                CAutoFile file(OpenBlockRecord(postx, fCompressed, nRecordSize), SER_DISK, CLIENT_VERSION);
                 if (file.IsNull())
                     return error("%s: OpenBlockFile failed", __func__);
                 CBlockHeader header;
                 try {
-                    file >> header;
-                    fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
-                    file >> txOut;
+                    if (fCompressed) {
+                        // Transaction offsets are relative to the uncompressed block
+                        std::vector<unsigned char> vRaw;
+                        ReadBlockFrame(file, nRecordSize, vRaw);
+                        CMemoryReader reader(SER_DISK, CLIENT_VERSION, vRaw.data(), vRaw.size());
+                        reader >> header;
+                        reader.ignore(postx.nTxOffset);
+                        reader >> txOut;
+                    } else {
+                        file >> header;
+                        fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
+                        file >> txOut;
+                    }
                 } catch (const std::exception& e) {
                     return error("%s : Deserialize or I/O error - %s", __func__, e.what());
                 }
@@ -801,40 +1103,151 @@ bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos)
     return true;
 }
 
-bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos)
+/** Write a compressed block frame, see IsCompressedMessageStart */
+static bool WriteBlockFrameToDisk(const std::vector<unsigned char>& vFrame, CDiskBlockPos& pos)
 {
-    block.SetNull();
+    // Open history file to append
+    CAutoFile fileout(OpenBlockFile(pos), SER_DISK, CLIENT_VERSION);
+    if (fileout.IsNull())
+        return error("%s : OpenBlockFile failed", __func__);
 
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("ReadBlockFromDisk : OpenBlockFile failed");
+    // Write index header
+    CMessageHeader::MessageStartChars start;
+    memcpy(start, Params().MessageStart(), MESSAGE_START_SIZE);
+    start[MESSAGE_START_SIZE - 1] = ~start[MESSAGE_START_SIZE - 1];
+    fileout << start << (unsigned int)vFrame.size();
 
-    // Read block
-    try {
-        filein >> block;
-    } catch (const std::exception& e) {
-        return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+    // Write frame
+    long fileOutPos = ftell(fileout.Get());
+    if (fileOutPos < 0)
+        return error("%s : ftell failed", __func__);
+    pos.nPos = (unsigned int)fileOutPos;
+    fileout.write((const char*)vFrame.data(), vFrame.size());
+
+    return true;
+}
+
+/** Size of the record of the block stored at pos, if it is compressed (nRawSize otherwise) */
+static unsigned int GetStoredBlockSize(const CDiskBlockPos& pos, unsigned int nRawSize)
+{
+    bool fCompressed;
+    unsigned int nSize;
+    FILE* file = OpenBlockRecord(pos, fCompressed, nSize);
+    if (!file)
+        return nRawSize;
+    fclose(file);
+    return fCompressed ? nSize : nRawSize;
+}
+
+CBlockReadCache blockReadCache;
+
+/** Memory mapping of the block (prefix "blk") or undo ("rev") file of pos, if it can be used */
+static std::shared_ptr<const CMappedBlockFile> GetMappedBlockFile(const CDiskBlockPos& pos, const char* prefix)
+{
+    // Files are rewritten while reindexing: don't map them.
+    if (pos.IsNull() || fReindex || !blockReadCache.IsEnabled()) return nullptr;
+    return blockReadCache.GetMappedFile(pos.nFile, prefix, GetBlockPosFilename(pos, prefix), (size_t)pos.nPos + 1);
+}
+
+static bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const uint256* pExpectedHash)
+{
+    block.SetNull();
+
+    // Read block, from the memory mapped file if possible
+    bool fRead = false;
+    std::shared_ptr<const CMappedBlockFile> mapped = GetMappedBlockFile(pos, "blk");
+    if (mapped) {
+        try {
+            const unsigned char* pblock = mapped->data() + pos.nPos;
+            const size_t nAvailable = mapped->size() - pos.nPos;
+            if (pos.nPos >= BLOCK_RECORD_HEADER_SIZE && IsCompressedMessageStart(pblock - BLOCK_RECORD_HEADER_SIZE)) {
+                const unsigned int nSize = ReadLE32(pblock - sizeof(uint32_t));
+                if (nSize > nAvailable)
+                    throw std::ios_base::failure("compressed block past the end of the mapping");
+                DeserializeBlockFrame(pblock, nSize, block);
+            } else {
+                CMemoryReader reader(SER_DISK, CLIENT_VERSION, pblock, nAvailable);
+                reader >> block;
+            }
+            fRead = true;
+        } catch (const std::exception& e) {
+            // The block may have been written after the file was mapped: read it from the file.
+            block.SetNull();
+        }
+    }
+    if (!fRead) {
+        bool fCompressed;
+        unsigned int nRecordSize;
+        CAutoFile filein(OpenBlockRecord(pos, fCompressed, nRecordSize), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+            return error("ReadBlockFromDisk : OpenBlockFile failed");
+        try {
+            ReadBlockRecord(filein, fCompressed, nRecordSize, block);
+        } catch (const std::exception& e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
     }
 
-    // Check the header
+    // Hash the header exactly once: checked against the index, and against the target for PoW blocks.
+    // The hash stays memoized in the block.
+    const uint256 hash = block.CacheHash();
+    if (pExpectedHash && hash != *pExpectedHash) {
+        LogPrintf("%s : block=%s index=%s\n", __func__, hash.GetHex(), pExpectedHash->GetHex());
+        return error("ReadBlockFromDisk(CBlock&, CBlockIndex*) : GetHash() doesn't match index");
+    }
     if (block.IsProofOfWork()) {
-        if (!CheckProofOfWork(block.GetHash(), block.nBits))
+        if (!CheckProofOfWork(hash, block.nBits))
             return error("ReadBlockFromDisk : Errors in block header");
     }
 
     return true;
 }
 
+bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos)
+{
+    return ReadBlockFromDisk(block, pos, nullptr);
+}
+
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex)
 {
+    const uint256 hashExpected = pindex->GetBlockHash();
+    std::shared_ptr<const CBlock> pcached = blockReadCache.GetBlock(hashExpected);
+    if (pcached) {
+        block = *pcached;
+        return true;
+    }
+
     CDiskBlockPos blockPos = WITH_LOCK(cs_main, return pindex->GetBlockPos(); );
-    if (!ReadBlockFromDisk(block, blockPos)) {
+    if (!ReadBlockFromDisk(block, blockPos, &hashExpected))
         return false;
+    if (blockReadCache.IsEnabled()) {
+        blockReadCache.AddBlock(hashExpected, std::make_shared<const CBlock>(block));
     }
-    if (block.GetHash() != pindex->GetBlockHash()) {
-        LogPrintf("%s : block=%s index=%s\n", __func__, block.GetHash().GetHex(), pindex->GetBlockHash().GetHex());
-        return error("ReadBlockFromDisk(CBlock&, CBlockIndex*) : GetHash() doesn't match index");
+    return true;
+}
+
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& vBlock, const CDiskBlockPos& pos)
+{
+    vBlock.clear();
+    if (pos.nPos < BLOCK_RECORD_HEADER_SIZE)
+        return error("%s : no record at %d:%u", __func__, pos.nFile, pos.nPos);
+
+    bool fCompressed;
+    unsigned int nRecordSize;
+    CAutoFile filein(OpenBlockRecord(pos, fCompressed, nRecordSize), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return error("%s : OpenBlockFile failed", __func__);
+    if (nRecordSize > MAX_BLOCK_SIZE_CURRENT)
+        return error("%s : record too large at %d:%u", __func__, pos.nFile, pos.nPos);
+    try {
+        if (fCompressed) {
+            ReadBlockFrame(filein, nRecordSize, vBlock);
+        } else {
+            vBlock.resize(nRecordSize);
+            filein.read((char*)vBlock.data(), vBlock.size());
+        }
+    } catch (const std::exception& e) {
+        return error("%s : I/O error - %s", __func__, e.what());
     }
     return true;
 }
@@ -1134,7 +1547,49 @@ bool CheckTxInputs(const CTransaction& tx, CValidationState& state, const CCoins
 }
 }// namespace Consensus
 
-bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheStore, PrecomputedTransactionData& precomTxData, std::vector<CScriptCheck> *pvChecks)
+unsigned int GetBlockScriptFlags(bool fCLTVIsActivated)
+{
+    unsigned int flags = SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_DERSIG;
+    if (fCLTVIsActivated)
+        flags |= SCRIPT_VERIFY_CHECKLOCKTIMEVERIFY;
+    return flags;
+}
+
+/**
+ * Cache of the transactions whose scripts were all executed successfully, so that
+ * the transactions accepted to the mempool are not verified again when they get in
+ * a block. Entries are SHA256(nonce || txid || flags): the txid commits to the
+ * outpoints, thus to the scripts and amounts of the coins spent.
+ */
+static CuckooCache::cache<uint256, SignatureCacheHasher> scriptExecutionCache;
+static uint256 scriptExecutionCacheNonce;
+
+void InitScriptExecutionCache()
+{
+    scriptExecutionCacheNonce = GetRandHash();
+    // nMaxCacheSize is unsigned. If -maxsigcachesize is set to zero,
+    // setup_bytes creates the minimum possible cache (2 elements).
+    size_t nMaxCacheSize = std::min(std::max((int64_t)0, gArgs.GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE) / 2), MAX_MAX_SIG_CACHE_SIZE) * ((size_t) 1 << 20);
+    size_t nElems = scriptExecutionCache.setup_bytes(nMaxCacheSize);
+    LogPrintf("Using %zu MiB out of %zu requested for script execution cache, able to store %zu elements\n",
+            (nElems*sizeof(uint256)) >>20, nMaxCacheSize>>20, nElems);
+}
+
+static uint256 ScriptExecutionCacheEntry(const CTransaction& tx, unsigned int flags)
+{
+    uint256 hashCacheEntry;
+    CSHA256().Write(scriptExecutionCacheNonce.begin(), 32).Write(tx.GetHash().begin(), 32).Write((const unsigned char*)&flags, sizeof(flags)).Finalize(hashCacheEntry.begin());
+    return hashCacheEntry;
+}
+
+/** Record that the scripts of tx passed with these flags (checked without CheckInputs) */
+static void CacheScriptExecution(const CTransaction& tx, unsigned int flags)
+{
+    AssertLockHeld(cs_main); // the cache is not thread safe
+    scriptExecutionCache.insert(ScriptExecutionCacheEntry(tx, flags));
+}
+
+bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& precomTxData, std::vector<CScriptCheck> *pvChecks)
 {
     if (!tx.IsCoinBase() && !tx.HasZerocoinSpendInputs()) {
 
@@ -1152,6 +1607,17 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
         // before the last block chain checkpoint. This is safe because block merkle hashes are
         // still computed and checked, and any change will be caught at the next checkpoint.
         if (fScriptChecks) {
+            // First check if script executions have been cached with the same
+            // flags. Note that this assumes that the inputs provided are
+            // correct (ie that the transaction hash which is in tx's prevouts
+            // properly commits to the scriptPubKey in the inputs view of that
+            // transaction).
+            const uint256 hashCacheEntry = ScriptExecutionCacheEntry(tx, flags);
+            AssertLockHeld(cs_main); // the cache is not thread safe
+            if (scriptExecutionCache.contains(hashCacheEntry, !cacheFullScriptStore)) {
+                return true;
+            }
+
             for (unsigned int i = 0; i < tx.vin.size(); i++) {
                 const COutPoint& prevout = tx.vin[i].prevout;
                 const Coin& coin = inputs.AccessCoin(prevout);
@@ -1166,33 +1632,20 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
                 const CAmount amount = coin.out.nValue;
 
                 // Verify signature
-                CScriptCheck check(scriptPubKey, amount, tx, i, flags, cacheStore, &precomTxData);
+                CScriptCheck check(scriptPubKey, amount, tx, i, flags, cacheSigStore, &precomTxData);
                 if (pvChecks) {
                     pvChecks->emplace_back();
                     check.swap(pvChecks->back());
                 } else if (!check()) {
-                    if (flags & STANDARD_NOT_MANDATORY_VERIFY_FLAGS) {
-                        // Check whether the failure was caused by a
-                        // non-mandatory script verification check, such as
-                        // non-standard DER encodings or non-null dummy
-                        // arguments; if so, don't trigger DoS protection to
-                        // avoid splitting the network between upgraded and
-                        // non-upgraded nodes.
-                        CScriptCheck check2(scriptPubKey, amount, tx, i,
-                            flags & ~STANDARD_NOT_MANDATORY_VERIFY_FLAGS, cacheStore, &precomTxData);
-                        if (check2())
-                            return state.Invalid(false, REJECT_NONSTANDARD, strprintf("non-mandatory-script-verify-flag (%s)", ScriptErrorString(check.GetScriptError())));
-                    }
-                    // Failures of other flags indicate a transaction that is
-                    // invalid in new blocks, e.g. a invalid P2SH. We DoS ban
-                    // such nodes as they are not following the protocol. That
-                    // said during an upgrade careful thought should be taken
-                    // as to the correct behavior - we may want to continue
-                    // peering with non-upgraded nodes even after a soft-fork
-                    // super-majority vote has passed.
-                    return state.DoS(100, false, REJECT_INVALID, strprintf("mandatory-script-verify-flag-failed (%s)", ScriptErrorString(check.GetScriptError())));
+                    return ScriptCheckFailed(check, state);
                 }
             }
+
+            if (cacheFullScriptStore && !pvChecks) {
+                // We executed all of the provided scripts, and were told to
+                // cache the result. Do so now.
+                scriptExecutionCache.insert(hashCacheEntry);
+            }
         }
     }
 
@@ -1246,20 +1699,16 @@ bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint
     return true;
 }
 
-bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uint256& hashBlock)
+template <typename Stream>
+bool UndoReadFromStream(Stream& stream, CBlockUndo& blockundo, const uint256& hashBlock)
 {
-    // Open history file to read
-    CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("%s : OpenBlockFile failed", __func__);
-
     // Read block
     uint256 hashChecksum;
-    CHashVerifier<CAutoFile> verifier(&filein); // We need a CHashVerifier as reserializing may lose data
+    CHashVerifier<Stream> verifier(&stream); // We need a CHashVerifier as reserializing may lose data
     try {
         verifier << hashBlock;
         verifier >> blockundo;
-        filein >> hashChecksum;
+        stream >> hashChecksum;
     } catch (const std::exception& e) {
         return error("%s : Deserialize or I/O error - %s", __func__, e.what());
     }
@@ -1271,8 +1720,62 @@ bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uin
     return true;
 }
 
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uint256& hashBlock)
+{
+    // Read from the memory mapped file if possible. Undo data can be appended to any
+    // file: fall back to regular file access if it was written after the mapping.
+    std::shared_ptr<const CMappedBlockFile> mapped = GetMappedBlockFile(pos, "rev");
+    if (mapped) {
+        CMemoryReader reader(SER_DISK, CLIENT_VERSION, mapped->data() + pos.nPos, mapped->size() - pos.nPos);
+        if (UndoReadFromStream(reader, blockundo, hashBlock))
+            return true;
+        blockundo = CBlockUndo();
+    }
+
+    // Open history file to read
+    CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return error("%s : OpenBlockFile failed", __func__);
+
+    return UndoReadFromStream(filein, blockundo, hashBlock);
+}
+
 } // anon namespace
 
+bool ReadRawUndoFromDisk(std::vector<unsigned char>& vUndo, const CDiskBlockPos& pos, const uint256& hashBlock)
+{
+    vUndo.clear();
+    if (pos.nPos < BLOCK_RECORD_HEADER_SIZE)
+        return error("%s : no record at %d:%u", __func__, pos.nFile, pos.nPos);
+
+    // The record: message start, size, undo data, checksum
+    CAutoFile filein(OpenUndoFile(CDiskBlockPos(pos.nFile, pos.nPos - BLOCK_RECORD_HEADER_SIZE), true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return error("%s : OpenUndoFile failed", __func__);
+    uint256 hashChecksum;
+    try {
+        CMessageHeader::MessageStartChars start;
+        unsigned int nSize;
+        filein >> start >> nSize;
+        if (memcmp(start, Params().MessageStart(), MESSAGE_START_SIZE) != 0 || nSize > MAX_SIZE)
+            return error("%s : bad record header at %d:%u", __func__, pos.nFile, pos.nPos);
+        vUndo.resize(nSize);
+        filein.read((char*)vUndo.data(), vUndo.size());
+        filein >> hashChecksum;
+    } catch (const std::exception& e) {
+        return error("%s : I/O error - %s", __func__, e.what());
+    }
+
+    // Verify checksum
+    CHashWriter hasher(SER_GETHASH, PROTOCOL_VERSION);
+    hasher << hashBlock;
+    hasher.write((const char*)vUndo.data(), vUndo.size());
+    if (hashChecksum != hasher.GetHash())
+        return error("%s : Checksum mismatch", __func__);
+
+    return true;
+}
+
 enum DisconnectResult
 {
     DISCONNECT_OK,      // All good.
@@ -1456,7 +1959,12 @@ void static FlushBlockFile(bool fFinalize = false)
 
 bool FindUndoPos(CValidationState& state, int nFile, CDiskBlockPos& pos, unsigned int nAddSize);
 
-static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
+static CCheckQueue<CBlockCheck> scriptcheckqueue(128);
+
+//! Below this many transactions, CheckBlock checks them in the calling thread
+static const size_t MIN_PARALLEL_CHECK_TXES = 64;
+//! Number of transactions checked by each job given to the script check threads by CheckBlock
+static const size_t CHECK_TXES_PER_CHUNK = 16;
 
 void ThreadScriptCheck()
 {
@@ -1464,11 +1972,76 @@ void ThreadScriptCheck()
     scriptcheckqueue.Thread();
 }
 
+/**
+ * Closure reading one coin from a thread safe view (the coins database), used to
+ * prefetch the inputs of a block in parallel before connecting it.
+ */
+class CCoinsPrefetch
+{
+private:
+    const CCoinsView* view;
+    COutPoint outpoint;
+    Coin* coin;
+    char* found;
+
+public:
+    CCoinsPrefetch() : view(nullptr), coin(nullptr), found(nullptr) {}
+    CCoinsPrefetch(const CCoinsView* viewIn, const COutPoint& outpointIn, Coin* coinIn, char* foundIn) :
+        view(viewIn), outpoint(outpointIn), coin(coinIn), found(foundIn) {}
+
+    bool operator()()
+    {
+        // A coin not found is not an error here: ConnectBlock will find out.
+        // Neither is a failure to read it, which must not escape the worker thread:
+        // the coin is left to ConnectBlock, reading it through pcoinsTip.
+        try {
+            *found = view->GetCoin(outpoint, *coin);
+        } catch (const std::exception& e) {
+            LogPrintf("%s: error prefetching %s: %s\n", __func__, outpoint.ToString(), e.what());
+            *found = false;
+        }
+        return true;
+    }
+
+    void swap(CCoinsPrefetch& check)
+    {
+        std::swap(view, check.view);
+        std::swap(outpoint, check.outpoint);
+        std::swap(coin, check.coin);
+        std::swap(found, check.found);
+    }
+};
+
+static CCheckQueue<CCoinsPrefetch> coinsprefetchqueue(16);
+
+void ThreadCoinsPrefetch()
+{
+    util::ThreadRename("quirkyturt-prefetch");
+    coinsprefetchqueue.Thread();
+}
+
 static int64_t nTimeVerify = 0;
 static int64_t nTimeProcessSpecial = 0;
 static int64_t nTimeConnect = 0;
 static int64_t nTimeIndex = 0;
 static int64_t nTimeTotal = 0;
+static uint64_t nArenaAllocations = 0;
+static uint64_t nArenaBytes = 0;
+
+/** The temporaries of ConnectBlock that do not outlive it, released after each block. */
+static MonotonicResource blockArena;
+
+/** Releases the block arena, once everything allocated from it has been destroyed. */
+class CBlockArenaRelease
+{
+public:
+    ~CBlockArenaRelease()
+    {
+        nArenaAllocations += blockArena.NumAllocations();
+        nArenaBytes += blockArena.AllocatedBytes();
+        blockArena.Release();
+    }
+};
 
 /** Apply the effects of this block (with given index) on the UTXO set represented by coins.
  *  Validity checks that depend on the UTXO set are also done; ConnectBlock()
@@ -1546,7 +2119,14 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
         fCLTVIsActivated = consensus.NetworkUpgradeActive(pindex->pprev->nHeight, Consensus::UPGRADE_BIP65);
     }
 
-    CCheckQueueControl<CScriptCheck> control(fScriptChecks && nScriptCheckThreads ? &scriptcheckqueue : nullptr);
+    // The script checks point into precomTxData: it must be declared before the control,
+    // which waits for them to finish when leaving early.
+    CBlockArenaRelease arenaRelease;
+    std::vector<PrecomputedTransactionData, MonotonicAllocator<PrecomputedTransactionData> > precomTxData{MonotonicAllocator<PrecomputedTransactionData>(&blockArena)};
+    precomTxData.reserve(block.vtx.size()); // Required so that pointers to individual precomTxData don't get invalidated
+
+    const bool fParallelChecks = fScriptChecks && nScriptCheckThreads;
+    CCheckQueueControl<CBlockCheck> control(fParallelChecks ? &scriptcheckqueue : nullptr);
 
     int64_t nTimeStart = GetTimeMicros();
     CAmount nFees = 0;
@@ -1561,7 +2141,7 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
     CAmount nValueOut = 0;
     CAmount nValueIn = 0;
     unsigned int nMaxBlockSigOps = MAX_BLOCK_SIGOPS_CURRENT;
-    std::vector<uint256> vSpendsInBlock;
+    std::vector<uint256, MonotonicAllocator<uint256> > vSpendsInBlock{MonotonicAllocator<uint256>(&blockArena)};
     uint256 hashBlock = block.GetHash();
 
     // Sapling
@@ -1571,8 +2151,9 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
     //
     bool isV5UpgradeEnforced = consensus.NetworkUpgradeActive(pindex->nHeight, Consensus::UPGRADE_V5_0);
 
-    std::vector<PrecomputedTransactionData> precomTxData;
-    precomTxData.reserve(block.vtx.size()); // Required so that pointers to individual precomTxData don't get invalidated
+    // Reused from one transaction to the next
+    std::vector<CScriptCheck> vChecks;
+    std::vector<CBlockCheck> vBlockChecks;
     bool fInitialBlockDownload = IsInitialBlockDownload();
     bool fZerocoinMaintenance =  (block.nTime > sporkManager.GetSporkValue(SPORK_16_ZEROCOIN_MAINTENANCE_MODE));
     bool fSaplingMaintenance =  (block.nTime > sporkManager.GetSporkValue(SPORK_20_SAPLING_MAINTENANCE));
@@ -1663,22 +2244,24 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
         }
 
         // Cache the sig ser hashes
-        precomTxData.emplace_back(tx);
+        precomTxData.emplace_back(tx, &blockArena);
 
         if (!tx.IsCoinBase()) {
             if (!tx.IsCoinStake())
                 nFees += view.GetValueIn(tx) - tx.GetValueOut();
             nValueIn += view.GetValueIn(tx);
 
-            std::vector<CScriptCheck> vChecks;
-            unsigned int flags = SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_DERSIG;
-            if (fCLTVIsActivated)
-                flags |= SCRIPT_VERIFY_CHECKLOCKTIMEVERIFY;
+            vChecks.clear();
+            unsigned int flags = GetBlockScriptFlags(fCLTVIsActivated);
 
             bool fCacheResults = fJustCheck; /* Don't cache results if we're actually connecting blocks (still consult the cache, though) */
-            if (!CheckInputs(tx, state, view, fScriptChecks, flags, fCacheResults, precomTxData[i], nScriptCheckThreads ? &vChecks : NULL))
+            if (!CheckInputs(tx, state, view, fScriptChecks, flags, fCacheResults, fCacheResults, precomTxData[i], nScriptCheckThreads ? &vChecks : NULL))
                 return error("%s: Check inputs on %s failed with %s", __func__, tx.GetHash().ToString(), FormatStateMessage(state));
-            control.Add(vChecks);
+            vBlockChecks.clear();
+            vBlockChecks.reserve(vChecks.size());
+            for (CScriptCheck& check : vChecks)
+                vBlockChecks.emplace_back(std::move(check));
+            control.Add(vBlockChecks);
         }
         nValueOut += tx.GetValueOut();
 
@@ -1740,13 +2323,27 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
         return false;
     }
 
-    if (!control.Wait())
+    // The signatures of the special txes are verified along with the scripts
+    std::vector<CBlockCheck> vSpecialChecks;
+    if (!CheckSpecialTxsInBlock(block, pindex, state, fParallelChecks ? &vSpecialChecks : nullptr)) {
+        return error("%s: Special tx check failed with %s", __func__, FormatStateMessage(state));
+    }
+    const bool fSpecialChecks = !vSpecialChecks.empty();
+    control.Add(vSpecialChecks);
+
+    if (!control.Wait()) {
+        // Check the special txes again, to report their failure
+        if (fSpecialChecks && !CheckSpecialTxsInBlock(block, pindex, state)) {
+            return error("%s: Special tx check failed with %s", __func__, FormatStateMessage(state));
+        }
         return state.DoS(100, error("%s: CheckQueue failed", __func__), REJECT_INVALID, "block-validation-failed");
+    }
     int64_t nTime2 = GetTimeMicros();
     nTimeVerify += nTime2 - nTimeStart;
     LogPrint(BCLog::BENCH, "    - Verify %u txins: %.2fms (%.3fms/txin) [%.2fs]\n", nInputs - 1, 0.001 * (nTime2 - nTimeStart), nInputs <= 1 ? 0 : 0.001 * (nTime2 - nTimeStart) / (nInputs - 1), nTimeVerify * 0.000001);
+    LogPrint(BCLog::BENCH, "    - Block arena: %u allocations, %.2fkB in %u chunks [%u allocations, %.2fMB]\n", (unsigned)blockArena.NumAllocations(), blockArena.AllocatedBytes() * 0.001, (unsigned)blockArena.NumAllocatedChunks(), (unsigned)(nArenaAllocations + blockArena.NumAllocations()), (nArenaBytes + blockArena.AllocatedBytes()) * 0.000001);
 
-    if (!ProcessSpecialTxsInBlock(block, pindex, state, fJustCheck)) {
+    if (!ProcessSpecialTxsInBlock(block, pindex, state, fJustCheck, false /* fCheckTxs */)) {
         return error("%s: Special tx processing failed with %s", __func__, FormatStateMessage(state));
     }
     int64_t nTime3 = GetTimeMicros();
@@ -1887,17 +2484,37 @@ bool static FlushStateToDisk(CValidationState& state, FlushStateMode mode)
             // overwrite one. Still, use a conservative safety factor of 2.
             if (!CheckDiskSpace(48 * 2 * 2 * pcoinsTip->GetCacheSize()))
                 return state.Error("out of disk space");
+            // EvoDB must not get ahead of the coins on disk: its changes are set aside here and
+            // written once the coins are, along with the money supply (read from the coin database).
+            // The previous background write must be done first, as it writes the changes set aside before.
+            if (pcoinsAsyncFlush && !pcoinsAsyncFlush->WaitForFlush())
+                return AbortNode(state, "Failed to write to coin database");
+            evoDb->FreezeRootTransaction();
+            const int nHeight = chainActive.Height();
+            const bool fUpdateSupply = !ShutdownRequested() && !IsInitialBlockDownload();
+            std::function<bool(CCoinsView*)> fnWritten = [nHeight, fUpdateSupply](CCoinsView* pcoinsdb) {
+                if (!evoDb->CommitFrozenTransaction()) {
+                    return error("FlushStateToDisk: failed to commit EvoDB");
+                }
+                if (fUpdateSupply) {
+                    // An empty cache iterates over the database directly
+                    MoneySupply.Update(CCoinsViewCache(pcoinsdb).GetTotalAmount(), nHeight);
+                }
+                return true;
+            };
+            if (pcoinsAsyncFlush) pcoinsAsyncFlush->SetOnWritten(fnWritten);
             // Flush the chainstate (which may refer to block index entries).
+            // With -asyncflush this only hands the changes to the background writer,
+            // a failure of the previous background write is reported here.
             if (!pcoinsTip->Flush())
                 return AbortNode(state, "Failed to write to coin database");
-            if (!evoDb->CommitRootTransaction()) {
+            // Explicit flushes (e.g. at shutdown) must be on disk when returning.
+            if (mode == FLUSH_STATE_ALWAYS && pcoinsAsyncFlush && !pcoinsAsyncFlush->WaitForFlush())
+                return AbortNode(state, "Failed to write to coin database");
+            if (!pcoinsAsyncFlush && !fnWritten(pcoinsTip)) {
                 return AbortNode(state, "Failed to commit EvoDB");
             }
             nLastFlush = nNow;
-            // Update money supply on memory, reading data from disk
-            if (!ShutdownRequested() && !IsInitialBlockDownload()) {
-                MoneySupply.Update(pcoinsTip->GetTotalAmount(), chainActive.Height());
-            }
         }
         if ((mode == FLUSH_STATE_ALWAYS || mode == FLUSH_STATE_PERIODIC) && nNow > nLastSetChain + (int64_t)DATABASE_WRITE_INTERVAL * 1000000) {
             // Update best block in wallet (so we can detect restored wallets).
@@ -2041,6 +2658,9 @@ bool static DisconnectTip(CValidationState& state, const CChainParams& chainpara
 }
 
 static int64_t nTimeReadFromDisk = 0;
+static int64_t nTimePrefetch = 0;
+static uint64_t nPrefetchHits = 0;
+static uint64_t nPrefetchMisses = 0;
 static int64_t nTimeConnectTotal = 0;
 static int64_t nTimeFlush = 0;
 static int64_t nTimeChainState = 0;
@@ -2086,6 +2706,59 @@ public:
     }
 };
 
+/**
+ * Warm up pcoinsTip with the coins spent by a block, reading the ones not in the
+ * cache from the database in parallel (ConnectBlock would otherwise read them one
+ * by one). Coins created by the block itself are skipped.
+ * Updates the hit (already cached) and miss (read from the database) counters.
+ */
+static void PrefetchBlockInputs(const CBlock& block)
+{
+    AssertLockHeld(cs_main);
+    if (!nScriptCheckThreads || !pcoinsAsyncFlush) return;
+
+    std::unordered_set<uint256, SaltedIdHasher> setBlockTxids;
+    std::vector<COutPoint> vPrefetch;
+    for (const CTransactionRef& tx : block.vtx) {
+        if (!tx->IsCoinBase()) {
+            for (const CTxIn& txin : tx->vin) {
+                if (txin.prevout.IsNull() || setBlockTxids.count(txin.prevout.hash)) continue;
+                if (pcoinsTip->HaveCoinInCache(txin.prevout)) {
+                    nPrefetchHits++;
+                } else {
+                    vPrefetch.push_back(txin.prevout);
+                }
+            }
+        }
+        setBlockTxids.insert(tx->GetHash());
+    }
+    if (vPrefetch.empty()) return;
+    nPrefetchMisses += vPrefetch.size();
+
+    // The database (behind the async flush layer) is safe to read concurrently,
+    // pcoinsTip is only updated here, under cs_main, once all the reads are done.
+    std::vector<Coin> vCoins(vPrefetch.size());
+    std::vector<char> vFound(vPrefetch.size(), 0);
+    std::vector<CCoinsPrefetch> vChecks;
+    vChecks.reserve(vPrefetch.size());
+    for (size_t i = 0; i < vPrefetch.size(); i++) {
+        vChecks.emplace_back(pcoinsAsyncFlush, vPrefetch[i], &vCoins[i], &vFound[i]);
+    }
+    CCheckQueueControl<CCoinsPrefetch> control(&coinsprefetchqueue);
+    control.Add(vChecks);
+    control.Wait();
+    for (size_t i = 0; i < vPrefetch.size(); i++) {
+        if (vFound[i]) pcoinsTip->InsertFetchedCoin(vPrefetch[i], std::move(vCoins[i]));
+    }
+}
+
+void GetInputsPrefetchStats(uint64_t& nCached, uint64_t& nRead)
+{
+    AssertLockHeld(cs_main);
+    nCached = nPrefetchHits;
+    nRead = nPrefetchMisses;
+}
+
 /**
  * Connect a new block to chainActive. pblock is either NULL or a pointer to a CBlock
  * corresponding to pindexNew, to bypass loading it again from disk.
@@ -2100,6 +2773,7 @@ bool static ConnectTip(CValidationState& state, CBlockIndex* pindexNew, const st
 
     // Read block from disk.
     int64_t nTime1 = GetTimeMicros();
+    const uint64_t nHeaderHashes1 = GetBlockHeaderHashCount();
     std::shared_ptr<const CBlock> pthisBlock;
     if (!pblock) {
         std::shared_ptr<CBlock> pblockNew = std::make_shared<CBlock>();
@@ -2116,6 +2790,10 @@ bool static ConnectTip(CValidationState& state, CBlockIndex* pindexNew, const st
     nTimeReadFromDisk += nTime2 - nTime1;
     int64_t nTime3;
     LogPrint(BCLog::BENCH, "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * 0.001, nTimeReadFromDisk * 0.000001);
+    PrefetchBlockInputs(blockConnecting);
+    int64_t nTimePrefetched = GetTimeMicros();
+    nTimePrefetch += nTimePrefetched - nTime2;
+    LogPrint(BCLog::BENCH, "  - Prefetch inputs: %.2fms [%.2fs (%u cached, %u read)]\n", (nTimePrefetched - nTime2) * 0.001, nTimePrefetch * 0.000001, nPrefetchHits, nPrefetchMisses);
     {
         auto dbTx = evoDb->BeginTransaction();
 
@@ -2134,6 +2812,10 @@ bool static ConnectTip(CValidationState& state, CBlockIndex* pindexNew, const st
         assert(flushed);
         dbTx->Commit();
     }
+    // Keep the new tip around: it is likely to be requested soon (by peers, or by DisconnectTip)
+    if (blockReadCache.IsEnabled()) {
+        blockReadCache.AddBlock(pindexNew->GetBlockHash(), pthisBlock);
+    }
     int64_t nTime4 = GetTimeMicros();
     nTimeFlush += nTime4 - nTime3;
     LogPrint(BCLog::BENCH, "  - Flush: %.2fms [%.2fs]\n", (nTime4 - nTime3) * 0.001, nTimeFlush * 0.000001);
@@ -2162,6 +2844,7 @@ bool static ConnectTip(CValidationState& state, CBlockIndex* pindexNew, const st
     nTimeTotal += nTime6 - nTime1;
     LogPrint(BCLog::BENCH, "  - Connect postprocess: %.2fms [%.2fs]\n", (nTime6 - nTime5) * 0.001, nTimePostConnect * 0.000001);
     LogPrint(BCLog::BENCH, "- Connect block: %.2fms [%.2fs]\n", (nTime6 - nTime1) * 0.001, nTimeTotal * 0.000001);
+    LogPrint(BCLog::BENCH, "- Header hashes computed: %u\n", GetBlockHeaderHashCount() - nHeaderHashes1);
 
     connectTrace.BlockConnected(pindexNew, std::move(pthisBlock));
     return true;
@@ -2647,6 +3330,7 @@ bool FindBlockPos(CValidationState& state, CDiskBlockPos& pos, unsigned int nAdd
         }
         FlushBlockFile(!fKnown);
         nLastBlockFile = nFile;
+        blockReadCache.SetWriteFile(nLastBlockFile);
     }
 
     vinfoBlockFile[nFile].AddBlock(nHeight, nTime);
@@ -2767,6 +3451,87 @@ static unsigned int GetTotalShieldedTxSize(const CBlock& block)
     return nSizeShielded;
 }
 
+/** The context free checks of a transaction of a block. */
+static bool CheckBlockTransaction(const CTransaction& tx, CValidationState& state, bool fColdStakingActive, bool fSaplingActive)
+{
+    if (!CheckTransaction(tx, state, fColdStakingActive)) {
+        return state.Invalid(false, state.GetRejectCode(), state.GetRejectReason(),
+                strprintf("Transaction check failed (tx hash %s) %s", tx.GetHash().ToString(), state.GetDebugMessage()));
+    }
+
+    // Non-contextual checks for special txes
+    if (!CheckSpecialTxNoContext(tx, state)) {
+        // pass the state returned by the function above
+        return false;
+    }
+
+    // No need to check for zerocoin anymore after sapling, they are networkely disabled
+    // and checkpoints are preventing the chain for any massive reorganization.
+    if (fSaplingActive && tx.ContainsZerocoins()) {
+        return state.DoS(100, error("CheckBlock : v5 upgrade enforced, zerocoin disabled"),
+                         REJECT_INVALID, "bad-blk-with-zc");
+    }
+    return true;
+}
+
+/**
+ * Check all the transactions of a block and count their legacy sigops. Large blocks are split
+ * in chunks of transactions checked by the script check threads, each chunk stopping at its
+ * first invalid transaction, and the error reported is the one of the first invalid transaction
+ * of the block, as when checking them in order.
+ */
+static bool CheckBlockTransactions(const CBlock& block, CValidationState& state, bool fColdStakingActive, bool fSaplingActive, unsigned int& nSigOps)
+{
+    struct ChunkResult {
+        CValidationState state;
+        size_t nInvalid{std::numeric_limits<size_t>::max()};
+        unsigned int nSigOps{0};
+    };
+
+    const size_t nTxes = block.vtx.size();
+    const bool fParallelChecks = nScriptCheckThreads && nTxes >= MIN_PARALLEL_CHECK_TXES;
+    const size_t nPerChunk = fParallelChecks ? CHECK_TXES_PER_CHUNK : std::max<size_t>(nTxes, 1);
+    std::vector<ChunkResult> vResults((nTxes + nPerChunk - 1) / nPerChunk);
+    auto checkChunk = [&](size_t nChunk) {
+        ChunkResult& result = vResults[nChunk];
+        for (size_t i = nChunk * nPerChunk; i < std::min(nTxes, (nChunk + 1) * nPerChunk); i++) {
+            const CTransaction& tx = *block.vtx[i];
+            if (!CheckBlockTransaction(tx, result.state, fColdStakingActive, fSaplingActive)) {
+                result.nInvalid = i;
+                return;
+            }
+            result.nSigOps += GetLegacySigOpCount(tx);
+        }
+    };
+
+    if (fParallelChecks) {
+        // The chunks never fail, so that none is skipped
+        CCheckQueueControl<CBlockCheck> control(&scriptcheckqueue);
+        std::vector<CBlockCheck> vChecks;
+        vChecks.reserve(vResults.size());
+        for (size_t nChunk = 0; nChunk < vResults.size(); nChunk++) {
+            vChecks.emplace_back([&checkChunk, nChunk]() {
+                checkChunk(nChunk);
+                return true;
+            });
+        }
+        control.Add(vChecks);
+        control.Wait();
+    } else if (!vResults.empty()) {
+        checkChunk(0);
+    }
+
+    nSigOps = 0;
+    for (const ChunkResult& result : vResults) {
+        if (result.nInvalid != std::numeric_limits<size_t>::max()) {
+            state = result.state;
+            return false;
+        }
+        nSigOps += result.nSigOps;
+    }
+    return true;
+}
+
 bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bool fCheckMerkleRoot, bool fCheckSig)
 {
     if (block.fChecked)
@@ -2877,32 +3642,12 @@ bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bo
 
     // Check transactions
     bool fSaplingActive = Params().GetConsensus().NetworkUpgradeActive(nHeight, Consensus::UPGRADE_V5_0);
-    std::vector<CBigNum> vBlockSerials;
-    for (const auto& txIn : block.vtx) {
-        const CTransaction& tx = *txIn;
-        if (!CheckTransaction(tx, state, fColdStakingActive)) {
-            return state.Invalid(false, state.GetRejectCode(), state.GetRejectReason(),
-                    strprintf("Transaction check failed (tx hash %s) %s", tx.GetHash().ToString(), state.GetDebugMessage()));
-        }
-
-        // Non-contextual checks for special txes
-        if (!CheckSpecialTxNoContext(tx, state)) {
-            // pass the state returned by the function above
-            return false;
-        }
-
-        // No need to check for zerocoin anymore after sapling, they are networkely disabled
-        // and checkpoints are preventing the chain for any massive reorganization.
-        if (fSaplingActive && tx.ContainsZerocoins()) {
-            return state.DoS(100, error("%s : v5 upgrade enforced, zerocoin disabled", __func__),
-                             REJECT_INVALID, "bad-blk-with-zc");
-        }
-    }
-
     unsigned int nSigOps = 0;
-    for (const auto& tx : block.vtx) {
-        nSigOps += GetLegacySigOpCount(*tx);
+    if (!CheckBlockTransactions(block, state, fColdStakingActive, fSaplingActive, nSigOps)) {
+        // pass the state of the first invalid transaction
+        return false;
     }
+
     unsigned int nMaxBlockSigOps = fZerocoinActive ? MAX_BLOCK_SIGOPS_CURRENT : MAX_BLOCK_SIGOPS_LEGACY;
     if (nSigOps > nMaxBlockSigOps)
         return state.DoS(100, error("%s : out-of-bounds SigOpCount", __func__),
@@ -3056,13 +3801,26 @@ bool ContextualCheckBlock(const CBlock& block, CValidationState& state, CBlockIn
     const int nHeight = pindexPrev == nullptr ? 0 : pindexPrev->nHeight + 1;
     const CChainParams& chainparams = Params();
 
+    // The Sapling proofs are verified by the script check threads
+    const bool fParallelChecks = nScriptCheckThreads;
+    CCheckQueueControl<CBlockCheck> control(fParallelChecks ? &scriptcheckqueue : nullptr);
+
     // Check that all transactions are finalized
     for (const auto& tx : block.vtx) {
 
         // Check transaction contextually against consensus rules at block height
-        if (!ContextualCheckTransaction(tx, state, chainparams, nHeight, true /* isMined */, IsInitialBlockDownload())) {
+        if (!ContextualCheckTransaction(tx, state, chainparams, nHeight, true /* isMined */, IsInitialBlockDownload(), !fParallelChecks)) {
             return false;
         }
+        if (fParallelChecks && tx->hasSaplingData() &&
+                chainparams.GetConsensus().NetworkUpgradeActive(nHeight, Consensus::UPGRADE_V5_0)) {
+            std::vector<CBlockCheck> vChecks;
+            vChecks.emplace_back([tx]() {
+                CValidationState dummyState;
+                return SaplingValidation::CheckTransactionProofs(*tx, dummyState, 100);
+            });
+            control.Add(vChecks);
+        }
 
         if (!IsFinalTx(tx, nHeight, block.GetBlockTime())) {
             return state.DoS(10, false, REJECT_INVALID, "bad-txns-nonfinal", false, "non-final transaction");
@@ -3078,6 +3836,16 @@ bool ContextualCheckBlock(const CBlock& block, CValidationState& state, CBlockIn
         }
     }
 
+    if (!control.Wait()) {
+        // Find the transaction that failed, to report it
+        for (const auto& tx : block.vtx) {
+            if (tx->hasSaplingData() && !SaplingValidation::CheckTransactionProofs(*tx, state, 100)) {
+                return false;
+            }
+        }
+        return state.DoS(100, false, REJECT_INVALID, "bad-txns-sapling-proofs");
+    }
+
     return true;
 }
 
@@ -3149,7 +3917,7 @@ bool AcceptBlockHeader(const CBlock& block, CValidationState& state, CBlockIndex
     return true;
 }
 
-bool AcceptBlock(const CBlock& block, CValidationState& state, CBlockIndex** ppindex, CDiskBlockPos* dbp)
+bool AcceptBlock(const CBlock& block, CValidationState& state, CBlockIndex** ppindex, CDiskBlockPos* dbp, CSignatureBatch* pbatch)
 {
     AssertLockHeld(cs_main);
 
@@ -3168,8 +3936,19 @@ bool AcceptBlock(const CBlock& block, CValidationState& state, CBlockIndex** ppi
     bool isPoS = block.IsProofOfStake();
     if (isPoS) {
         std::string strError;
-        if (!CheckProofOfStake(block, strError, pindexPrev))
+        if (!CheckProofOfStake(block, strError, pindexPrev, pbatch))
             return state.DoS(100, error("%s: proof of stake check failed (%s)", __func__, strError));
+        if (pbatch) {
+            if (!pbatch->Verify()) {
+                // Let the serial checks find the bad signature: the verdict never depends on the batching
+                if (!CheckBlockSignature(block))
+                    return state.DoS(100, error("%s : bad proof-of-stake block signature", __func__),
+                                     REJECT_INVALID, "bad-PoS-sig", true);
+                if (!CheckProofOfStake(block, strError, pindexPrev))
+                    return state.DoS(100, error("%s: proof of stake check failed (%s)", __func__, strError));
+            }
+            block.fChecked = true;
+        }
     }
 
     if (!AcceptBlockHeader(block, state, &pindex, pindexPrev))
@@ -3377,14 +4156,18 @@ bool AcceptBlock(const CBlock& block, CValidationState& state, CBlockIndex** ppi
 
     // Write block to history file
     try {
-        unsigned int nBlockSize = ::GetSerializeSize(block, SER_DISK, CLIENT_VERSION);
+        std::vector<unsigned char> vFrame;
+        const bool fCompressed = dbp == NULL && fBlockCompression && CompressBlock(block, vFrame);
+        unsigned int nBlockSize = fCompressed ? vFrame.size() : ::GetSerializeSize(block, SER_DISK, CLIENT_VERSION);
         CDiskBlockPos blockPos;
-        if (dbp != NULL)
+        if (dbp != NULL) {
             blockPos = *dbp;
+            nBlockSize = GetStoredBlockSize(blockPos, nBlockSize);
+        }
         if (!FindBlockPos(state, blockPos, nBlockSize + 8, nHeight, block.GetBlockTime(), dbp != NULL))
             return error("AcceptBlock() : FindBlockPos failed");
         if (dbp == NULL)
-            if (!WriteBlockToDisk(block, blockPos))
+            if (fCompressed ? !WriteBlockFrameToDisk(vFrame, blockPos) : !WriteBlockToDisk(block, blockPos))
                 return AbortNode(state, "Failed to write block");
         if (!ReceivedBlockTransactions(block, state, pindex, blockPos))
             return error("AcceptBlock() : ReceivedBlockTransactions failed");
@@ -3406,13 +4189,21 @@ bool ProcessNewBlock(CValidationState& state, CNode* pfrom, const std::shared_pt
     {
         // CheckBlock requires cs_main lock
         LOCK(cs_main);
-        if (!CheckBlock(*pblock, state)) {
+        // The signature of a proof-of-stake block is verified by AcceptBlock, in a batch
+        // with the signature of the coinstake input
+        CSignatureBatch sigs;
+        const bool fBatchSig = pblock->IsProofOfStake() && !pblock->fChecked;
+        if (!CheckBlock(*pblock, state, true, true, !fBatchSig)) {
             return error ("%s : CheckBlock FAILED for block %s, %s", __func__, pblock->GetHash().GetHex(), FormatStateMessage(state));
         }
+        if (fBatchSig && !CheckBlockSignature(*pblock, &sigs)) {
+            state.DoS(100, false, REJECT_INVALID, "bad-PoS-sig", true);
+            return error("%s : bad proof-of-stake block signature for block %s", __func__, pblock->GetHash().GetHex());
+        }
 
         // Store to disk
         CBlockIndex* pindex = nullptr;
-        bool ret = AcceptBlock(*pblock, state, &pindex, dbp);
+        bool ret = AcceptBlock(*pblock, state, &pindex, dbp, fBatchSig ? &sigs : nullptr);
         if (fAccepted) *fAccepted = ret;
         CheckBlockIndex();
         if (!ret) {
@@ -3541,9 +4332,12 @@ CBlockIndex* InsertBlockIndex(uint256 hash)
 
 bool static LoadBlockIndexDB(std::string& strError)
 {
-    if (!pblocktree->LoadBlockIndexGuts(InsertBlockIndex))
+    if (!pblocktree->LoadBlockIndexGuts(InsertBlockIndex, fCheckBlockIndex ? 1 : BLOCKINDEX_HASH_CHECK_RATIO))
         return false;
 
+    LogPrintf("%s: loaded %u block index entries (%.1f MiB)\n", __func__, mapBlockIndex.size(),
+              (memusage::DynamicUsage(mapBlockIndex) + mapBlockIndex.size() * memusage::MallocUsage(sizeof(CBlockIndex))) * (1.0 / (1 << 20)));
+
     boost::this_thread::interruption_point();
 
     // Calculate nChainWork
@@ -3594,6 +4388,7 @@ bool static LoadBlockIndexDB(std::string& strError)
 
     // Load block file info
     pblocktree->ReadLastBlockFile(nLastBlockFile);
+    blockReadCache.SetWriteFile(nLastBlockFile);
     vinfoBlockFile.resize(nLastBlockFile + 1);
     LogPrintf("%s: last block file = %i\n", __func__, nLastBlockFile);
     for (int nFile = 0; nFile <= nLastBlockFile; nFile++) {
@@ -3713,6 +4508,9 @@ bool CVerifyDB::VerifyDB(CCoinsView* coinsview, int nCheckLevel, int nCheckDepth
     CBlockIndex* pindexFailure = NULL;
     int nGoodTransactions = 0;
     CValidationState state;
+    // The PoS block signatures are verified together at the end, with the block of each one
+    CSignatureBatch blockSigs;
+    std::vector<const CBlockIndex*> vBlockSigIndexes;
     for (CBlockIndex* pindex = chainActive.Tip(); pindex && pindex->pprev; pindex = pindex->pprev) {
         boost::this_thread::interruption_point();
         uiInterface.ShowProgress(_("Verifying blocks..."), std::max(1, std::min(99, (int)(((double)(chainHeight - pindex->nHeight)) / (double)nCheckDepth * (nCheckLevel >= 4 ? 50 : 100)))));
@@ -3723,8 +4521,13 @@ bool CVerifyDB::VerifyDB(CCoinsView* coinsview, int nCheckLevel, int nCheckDepth
         if (!ReadBlockFromDisk(block, pindex))
             return error("%s: *** ReadBlockFromDisk failed at %d, hash=%s", __func__, pindex->nHeight, pindex->GetBlockHash().ToString());
         // check level 1: verify block validity
-        if (nCheckLevel >= 1 && !CheckBlock(block, state))
-            return error("%s: *** found bad block at %d, hash=%s (%s)\n", __func__, pindex->nHeight, pindex->GetBlockHash().ToString(), FormatStateMessage(state));
+        if (nCheckLevel >= 1) {
+            if (!CheckBlock(block, state, true, true, false))
+                return error("%s: *** found bad block at %d, hash=%s (%s)\n", __func__, pindex->nHeight, pindex->GetBlockHash().ToString(), FormatStateMessage(state));
+            if (!CheckBlockSignature(block, &blockSigs))
+                return error("%s: *** found bad block signature at %d, hash=%s\n", __func__, pindex->nHeight, pindex->GetBlockHash().ToString());
+            vBlockSigIndexes.resize(blockSigs.size(), pindex);
+        }
         // check level 2: verify undo validity
         if (nCheckLevel >= 2 && pindex) {
             CBlockUndo undo;
@@ -3753,6 +4556,11 @@ bool CVerifyDB::VerifyDB(CCoinsView* coinsview, int nCheckLevel, int nCheckDepth
         if (ShutdownRequested())
             return true;
     }
+    std::vector<bool> vBlockSigResults;
+    if (!blockSigs.Verify(std::max(1, nScriptCheckThreads), &vBlockSigResults)) {
+        const size_t nBad = std::find(vBlockSigResults.begin(), vBlockSigResults.end(), false) - vBlockSigResults.begin();
+        return error("%s: *** found bad block signature at %d, hash=%s\n", __func__, vBlockSigIndexes[nBad]->nHeight, vBlockSigIndexes[nBad]->GetBlockHash().ToString());
+    }
     if (pindexFailure)
         return error("%s: *** coin database inconsistencies found (last %i blocks, %i good transactions before that)\n", __func__, chainHeight - pindexFailure->nHeight + 1, nGoodTransactions);
 
@@ -3882,6 +4690,8 @@ void UnloadBlockIndex()
     mapBlocksUnlinked.clear();
     vinfoBlockFile.clear();
     nLastBlockFile = 0;
+    blockReadCache.Clear();
+    blockReadCache.SetWriteFile(nLastBlockFile);
     nBlockSequenceId = 1;
     setDirtyBlockIndex.clear();
     setDirtyFileInfo.clear();
@@ -3890,6 +4700,7 @@ void UnloadBlockIndex()
         delete entry.second;
     }
     mapBlockIndex.clear();
+    ClearAccumulatorCheckpoints();
 }
 
 bool LoadBlockIndex(std::string& strError)
@@ -3967,17 +4778,19 @@ bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos* dbp)
             nRewind++;         // start one byte further next time, in case of failure
             blkdat.SetLimit(); // remove former limit
             unsigned int nSize = 0;
+            bool fCompressed = false;
             try {
                 // locate a header
                 unsigned char buf[MESSAGE_START_SIZE];
                 blkdat.FindByte(Params().MessageStart()[0]);
                 nRewind = blkdat.GetPos()+1;
                 blkdat >> buf;
-                if (memcmp(buf, Params().MessageStart(), MESSAGE_START_SIZE))
+                fCompressed = IsCompressedMessageStart(buf);
+                if (!fCompressed && memcmp(buf, Params().MessageStart(), MESSAGE_START_SIZE))
                     continue;
                 // read size
                 blkdat >> nSize;
-                if (nSize < 80 || nSize > MAX_BLOCK_SIZE_CURRENT)
+                if (nSize < (fCompressed ? BLOCK_FRAME_HEADER_SIZE + 1 : 80) || nSize > MAX_BLOCK_SIZE_CURRENT)
                     continue;
             } catch (const std::exception&) {
                 // no valid block header found; don't complain
@@ -3991,11 +4804,11 @@ bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos* dbp)
                 blkdat.SetLimit(nBlockPos + nSize);
                 blkdat.SetPos(nBlockPos);
                 CBlock block;
-                blkdat >> block;
+                ReadBlockRecord(blkdat, fCompressed, nSize, block);
                 nRewind = blkdat.GetPos();
 
                 // detect out of order blocks, and store them for later
-                uint256 hash = block.GetHash();
+                uint256 hash = block.CacheHash();
                 if (hash != Params().GetConsensus().hashGenesisBlock && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
                     LogPrint(BCLog::REINDEX, "%s: Out of order block %s, parent %s not known\n", __func__,
                             hash.GetHex(), block.hashPrevBlock.GetHex());
@@ -4051,6 +4864,242 @@ bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos* dbp)
     return nLoaded > 0;
 }
 
+/** A block located while scanning the block files for -reindex */
+struct CReindexBlock {
+    uint256 hash;
+    uint256 hashPrev;
+    CDiskBlockPos pos;
+};
+
+/**
+ * Locate every block stored in a blk?????.dat file, deserializing only their headers (compressed
+ * blocks are decompressed first).
+ * Blocks are found the same way LoadExternalBlockFile does (message start + size).
+ */
+static void ScanBlockFile(int nFile, std::vector<CReindexBlock>& vBlocks)
+{
+    CDiskBlockPos pos(nFile, 0);
+    FILE* file = OpenBlockFile(pos, true);
+    if (!file)
+        return; // This error is logged in OpenBlockFile
+
+    try {
+        // This takes over file and calls fclose() on it in the CBufferedFile destructor
+        CBufferedFile blkdat(file, 2 * MAX_BLOCK_SIZE_CURRENT, MAX_BLOCK_SIZE_CURRENT + 8, SER_DISK, CLIENT_VERSION);
+        std::vector<char> vSkip(1 << 16);
+        uint64_t nRewind = blkdat.GetPos();
+        while (!blkdat.eof() && !ShutdownRequested()) {
+            blkdat.SetPos(nRewind);
+            nRewind++;         // start one byte further next time, in case of failure
+            blkdat.SetLimit(); // remove former limit
+            unsigned int nSize = 0;
+            bool fCompressed = false;
+            try {
+                // locate a header
+                unsigned char buf[MESSAGE_START_SIZE];
+                blkdat.FindByte(Params().MessageStart()[0]);
+                nRewind = blkdat.GetPos()+1;
+                blkdat >> buf;
+                fCompressed = IsCompressedMessageStart(buf);
+                if (!fCompressed && memcmp(buf, Params().MessageStart(), MESSAGE_START_SIZE))
+                    continue;
+                // read size
+                blkdat >> nSize;
+                if (nSize < (fCompressed ? BLOCK_FRAME_HEADER_SIZE + 1 : 80) || nSize > MAX_BLOCK_SIZE_CURRENT)
+                    continue;
+            } catch (const std::exception&) {
+                // no valid block header found; don't complain
+                break;
+            }
+            try {
+                const uint64_t nBlockPos = blkdat.GetPos();
+                const uint64_t nBlockEnd = nBlockPos + nSize;
+                blkdat.SetLimit(nBlockEnd);
+                CBlockHeader header;
+                if (fCompressed) {
+                    CBlock block;
+                    ReadBlockRecord(blkdat, fCompressed, nSize, block);
+                    header = block.GetBlockHeader();
+                } else {
+                    blkdat >> header;
+                    // skip the transactions, the block is read again when it gets processed
+                    while (blkdat.GetPos() < nBlockEnd) {
+                        blkdat.read(vSkip.data(), std::min<uint64_t>(vSkip.size(), nBlockEnd - blkdat.GetPos()));
+                    }
+                }
+                nRewind = blkdat.GetPos();
+                vBlocks.push_back({header.GetHash(), header.hashPrevBlock, CDiskBlockPos(nFile, (unsigned int)nBlockPos)});
+            } catch (const std::exception& e) {
+                LogPrintf("%s : Deserialize or I/O error in blk%05u.dat - %s\n", __func__, (unsigned int)nFile, e.what());
+            }
+        }
+    } catch (const std::runtime_error& e) {
+        AbortNode(std::string("System error: ") + e.what());
+    }
+}
+
+bool ReindexBlockFiles(int nThreads)
+{
+    int64_t nStart = GetTimeMillis();
+
+    int nFiles = 0;
+    while (fs::exists(GetBlockPosFilename(CDiskBlockPos(nFiles, 0), "blk")))
+        nFiles++;
+    nThreads = std::max(1, std::min(nThreads, std::min(nFiles, MAX_REINDEX_THREADS)));
+    LogPrintf("Reindexing %d block files using %d threads...\n", nFiles, nThreads);
+
+    // Scan all the block files concurrently
+    std::vector<std::vector<CReindexBlock>> vFileBlocks(nFiles);
+    std::atomic<int> nNextFile{0};
+    auto scanFiles = [&]() {
+        for (int nFile = nNextFile++; nFile < nFiles && !ShutdownRequested(); nFile = nNextFile++) {
+            ScanBlockFile(nFile, vFileBlocks[nFile]);
+        }
+    };
+    std::vector<std::thread> vScanners;
+    for (int i = 1; i < nThreads; i++) {
+        vScanners.emplace_back(scanFiles);
+    }
+    scanFiles();
+    for (std::thread& t : vScanners) t.join();
+    if (ShutdownRequested())
+        return false;
+
+    // Build the header map. Keep the first copy of blocks stored more than once.
+    std::unordered_map<uint256, CDiskBlockPos, BlockHasher> mapBlockPos;
+    std::unordered_multimap<uint256, uint256, BlockHasher> mapChildren;
+    for (const std::vector<CReindexBlock>& vBlocks : vFileBlocks) {
+        for (const CReindexBlock& b : vBlocks) {
+            if (mapBlockPos.emplace(b.hash, b.pos).second)
+                mapChildren.emplace(b.hashPrev, b.hash);
+        }
+    }
+    vFileBlocks.clear();
+    LogPrintf("Found %u blocks in %dms, processing them in chain order\n", mapBlockPos.size(), GetTimeMillis() - nStart);
+
+    // Order the blocks breadth-first from the genesis block, so that every parent is processed
+    // before its children without having to rewind through the files.
+    std::vector<std::pair<uint256, CDiskBlockPos>> vOrdered;
+    vOrdered.reserve(mapBlockPos.size());
+    const uint256& hashGenesis = Params().GetConsensus().hashGenesisBlock;
+    if (mapBlockPos.count(hashGenesis)) {
+        vOrdered.emplace_back(hashGenesis, mapBlockPos.at(hashGenesis));
+    }
+    for (size_t i = 0; i < vOrdered.size(); i++) {
+        auto range = mapChildren.equal_range(vOrdered[i].first);
+        std::vector<std::pair<uint256, CDiskBlockPos>> vChildren;
+        for (auto it = range.first; it != range.second; it++) {
+            vChildren.emplace_back(it->second, mapBlockPos.at(it->second));
+        }
+        // deterministic order between siblings: first stored first
+        std::sort(vChildren.begin(), vChildren.end(), [](const std::pair<uint256, CDiskBlockPos>& a, const std::pair<uint256, CDiskBlockPos>& b) {
+            return std::make_pair(a.second.nFile, a.second.nPos) < std::make_pair(b.second.nFile, b.second.nPos);
+        });
+        vOrdered.insert(vOrdered.end(), vChildren.begin(), vChildren.end());
+    }
+    if (vOrdered.size() < mapBlockPos.size()) {
+        LogPrintf("%s: ignoring %u blocks not connected to the genesis block\n", __func__, mapBlockPos.size() - vOrdered.size());
+    }
+    mapChildren.clear();
+    mapBlockPos.clear();
+
+    // Process the blocks in order, while a pool of reader threads reads the next ones.
+    const size_t nReadAhead = 4 * nThreads;
+    Mutex csRead;
+    std::condition_variable condRead;
+    std::map<size_t, std::shared_ptr<CBlock>> mapRead; // the blocks read ahead by their index in vOrdered, null if they could not be read
+    size_t nNextRead = 0;
+    size_t nProcessing = 0;
+    bool fStopReaders = false;
+    auto readBlocks = [&]() {
+        while (true) {
+            size_t nRead;
+            {
+                WAIT_LOCK(csRead, lock);
+                condRead.wait(lock, [&]() { return fStopReaders || (nNextRead < vOrdered.size() && nNextRead < nProcessing + nReadAhead); });
+                if (fStopReaders)
+                    return;
+                nRead = nNextRead++;
+            }
+            std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+            if (!ReadBlockFromDisk(*pblock, vOrdered[nRead].second)) {
+                pblock.reset();
+            }
+            {
+                LOCK(csRead);
+                mapRead.emplace(nRead, std::move(pblock));
+            }
+            condRead.notify_all();
+        }
+    };
+    std::vector<std::thread> vReaders;
+    for (int i = 0; i < nThreads; i++) {
+        vReaders.emplace_back(readBlocks);
+    }
+    auto stopReaders = [&]() {
+        {
+            LOCK(csRead);
+            fStopReaders = true;
+        }
+        condRead.notify_all();
+        for (std::thread& t : vReaders) t.join();
+    };
+
+    int nLoaded = 0;
+    bool fComplete = true;
+    try {
+        for (size_t i = 0; i < vOrdered.size(); i++) {
+            boost::this_thread::interruption_point();
+            std::shared_ptr<CBlock> pblock;
+            {
+                WAIT_LOCK(csRead, lock);
+                nProcessing = i;
+                condRead.notify_all();
+                condRead.wait(lock, [&]() { return mapRead.count(i) > 0; });
+                pblock = std::move(mapRead.at(i));
+                mapRead.erase(i);
+            }
+
+            const uint256& hash = vOrdered[i].first;
+            if (!pblock || pblock->GetHash() != hash) {
+                LogPrintf("%s: failed to read block %s\n", __func__, hash.ToString());
+                continue;
+            }
+
+            // process in case the block isn't known yet
+            bool fHaveData = false;
+            int nHeight = 0;
+            {
+                LOCK(cs_main);
+                BlockMap::const_iterator it = mapBlockIndex.find(hash);
+                if (it != mapBlockIndex.end()) {
+                    fHaveData = it->second->nStatus & BLOCK_HAVE_DATA;
+                    nHeight = it->second->nHeight;
+                }
+            }
+            if (!fHaveData) {
+                CValidationState state;
+                CDiskBlockPos pos = vOrdered[i].second;
+                if (ProcessNewBlock(state, nullptr, pblock, &pos))
+                    nLoaded++;
+                if (state.IsError()) {
+                    fComplete = false;
+                    break;
+                }
+            } else if (hash != hashGenesis && nHeight % 1000 == 0) {
+                LogPrintf("Block Import: already had block %s at height %d\n", hash.ToString(), nHeight);
+            }
+        }
+    } catch (...) {
+        stopReaders();
+        throw;
+    }
+    stopReaders();
+
+    LogPrintf("Reindexed %i blocks in %dms\n", nLoaded, GetTimeMillis() - nStart);
+    return fComplete && !ShutdownRequested();
+}
+
 void static CheckBlockIndex()
 {
     if (!fCheckBlockIndex) {
@@ -4355,6 +5404,7 @@ public:
         for (; it1 != mapBlockIndex.end(); it1++)
             delete (*it1).second;
         mapBlockIndex.clear();
+        ClearAccumulatorCheckpoints();
     }
 } instance_of_cmaincleanup;
 
@@ -21,6 +21,7 @@
 #include "consensus/validation.h"
 #include "fs.h"
 #include "moneysupply.h"
+#include "optional.h"
 #include "policy/feerate.h"
 #include "script/script_error.h"
 #include "sync.h"
@@ -29,6 +30,7 @@
 #include <algorithm>
 #include <atomic>
 #include <exception>
+#include <functional>
 #include <map>
 #include <memory>
 #include <set>
@@ -38,7 +40,9 @@
 #include <vector>
 
 class CBlockIndex;
+class CBlockReadCache;
 class CBlockTreeDB;
+class CCoinsViewAsyncFlush;
 class CBudgetManager;
 class CZerocoinDB;
 class CSporkDB;
@@ -47,6 +51,7 @@ class CInv;
 class CConnman;
 class CNode;
 class CScriptCheck;
+class CSignatureBatch;
 
 struct PrecomputedTransactionData;
 
@@ -78,6 +83,10 @@ static const unsigned int MAX_ZEROCOIN_TX_SIZE = 150000;
 static const unsigned int MAX_DISCONNECTED_TX_POOL_SIZE = 20000;
 /** Default for -checkblocks */
 static const signed int DEFAULT_CHECKBLOCKS = 10;
+/** Default for -blockcompression */
+static const bool DEFAULT_BLOCK_COMPRESSION = false;
+/** Default for -blockreadcache, memory budget of the cache of recently read blocks (MiB) */
+static const int64_t DEFAULT_BLOCK_READ_CACHE = 32;
 /** The maximum size of a blk?????.dat file (since 0.8) */
 static const unsigned int MAX_BLOCKFILE_SIZE = 0x8000000; // 128 MiB
 /** The pre-allocation chunk size for blk?????.dat files (since 0.8) */
@@ -88,6 +97,10 @@ static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
 static const int MAX_SCRIPTCHECK_THREADS = 16;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** -reindexthreads default (number of threads scanning block files during -reindex, 0 = serial scan) */
+static const int DEFAULT_REINDEX_THREADS = 0;
+/** Maximum number of threads scanning block files during -reindex */
+static const int MAX_REINDEX_THREADS = 16;
 /** Number of blocks that can be requested at any given time from a single peer. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
@@ -144,6 +157,8 @@ extern int nScriptCheckThreads;
 extern bool fTxIndex;
 extern bool fRequireStandard;
 extern bool fCheckBlockIndex;
+/** Whether new blocks are stored compressed in the block files */
+extern bool fBlockCompression;
 extern size_t nCoinCacheUsage;
 extern CFeeRate minRelayTxFee;
 extern int64_t nMaxTipAge;
@@ -185,6 +200,12 @@ FILE* OpenUndoFile(const CDiskBlockPos& pos, bool fReadOnly = false);
 fs::path GetBlockPosFilename(const CDiskBlockPos& pos, const char* prefix);
 /** Import blocks from an external file */
 bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos* dbp = NULL);
+/**
+ * Reindex from the blk?????.dat files: scan all of them concurrently on nThreads threads,
+ * building an in-memory map of the headers found, then process the blocks in chain order.
+ * Returns false if it was interrupted by a shutdown or a disk error before the end.
+ */
+bool ReindexBlockFiles(int nThreads);
 /** Ensures we have a genesis block in the block tree, possibly writing one to disk. */
 bool LoadGenesisBlock();
 /** Load the block tree and coins database from disk,
@@ -198,6 +219,8 @@ void UnloadBlockIndex();
 int ActiveProtocol();
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Run an instance of the coins prefetching thread */
+void ThreadCoinsPrefetch();
 
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
 bool IsInitialBlockDownload();
@@ -217,6 +240,8 @@ CAmount GetBlockValue(int nHeight);
 CBlockIndex* InsertBlockIndex(uint256 hash);
 /** Flush all state, indexes and buffers to disk. */
 void FlushStateToDisk();
+/** The number of inputs of the blocks connected found in the coins cache, and prefetched from the database (see -par) */
+void GetInputsPrefetchStats(uint64_t& nCached, uint64_t& nRead) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
 
 /** (try to) add transaction to memory pool **/
@@ -249,12 +274,20 @@ CAmount GetShieldedTxMinFee(const CTransaction& tx);
  *   DUP CHECKSIG DROP ... repeated 100 times... OP_1
  */
 
+/** Initializes the script-execution cache */
+void InitScriptExecutionCache();
+
+/** Script verification flags enforced on the transactions of the blocks */
+unsigned int GetBlockScriptFlags(bool fCLTVIsActivated);
+
 /**
  * Check whether all inputs of this transaction are valid (no double spends, scripts & sigs, amounts)
  * This does not modify the UTXO set. If pvChecks is not NULL, script checks are pushed onto it
- * instead of being performed inline.
+ * instead of being performed inline. Transactions whose scripts were all executed successfully
+ * with the same flags are skipped: cacheSigStore caches the valid signatures, cacheFullScriptStore
+ * the successful execution of all the scripts (only done when they are performed inline).
  */
-bool CheckInputs(const CTransaction& tx, CValidationState& state, const CCoinsViewCache& view, bool fScriptChecks, unsigned int flags, bool cacheStore, PrecomputedTransactionData& precomTxData, std::vector<CScriptCheck>* pvChecks = NULL);
+bool CheckInputs(const CTransaction& tx, CValidationState& state, const CCoinsViewCache& view, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& precomTxData, std::vector<CScriptCheck>* pvChecks = NULL);
 
 /** Apply the effects of this transaction on the UTXO set represented by view */
 void UpdateCoins(const CTransaction& tx, CCoinsViewCache& inputs, int nHeight, bool fSkipInvalid = false);
@@ -321,13 +354,110 @@ public:
     }
 
     ScriptError GetScriptError() const { return error; }
+    unsigned int GetFlags() const { return nFlags; }
+
+    //! The same check, with other flags
+    CScriptCheck WithFlags(unsigned int nFlagsIn) const
+    {
+        CScriptCheck check(*this);
+        check.nFlags = nFlagsIn;
+        check.error = SCRIPT_ERR_UNKNOWN_ERROR;
+        return check;
+    }
 };
 
+/**
+ * Closure representing one check run by the script check threads: the verification
+ * of one script, or any other check that doesn't depend on the others (the Sapling
+ * proofs of a transaction, the payload signature of a special transaction).
+ */
+class CBlockCheck
+{
+private:
+    CScriptCheck scriptCheck;
+    std::function<bool()> check;
+
+public:
+    CBlockCheck() {}
+    explicit CBlockCheck(CScriptCheck&& scriptCheckIn) { scriptCheck.swap(scriptCheckIn); }
+    explicit CBlockCheck(std::function<bool()> checkIn) : check(std::move(checkIn)) {}
+
+    bool operator()() { return check ? check() : scriptCheck(); }
+
+    void swap(CBlockCheck& x)
+    {
+        scriptCheck.swap(x.scriptCheck);
+        check.swap(x.check);
+    }
+};
+
+/**
+ * A transaction on its way to the mempool. AcceptToMemoryPool runs the steps below in a
+ * row, the acceptance queue (txacceptqueue.h) runs them apart so that only the short ones
+ * hold cs_main:
+ * - PreCheckMemPoolAccept: the context-free checks and the Sapling proofs, without any lock,
+ * - PrepareMemPoolAccept (cs_main): everything needing the coins, the chain or the mempool,
+ *   except the scripts which can be left in vScriptChecks,
+ * - VerifyMemPoolAcceptScripts: the script checks left, without any lock, setting the reject
+ *   state of the first one failing as CheckInputs does,
+ * - FinishMemPoolAccept (cs_main): adds the transaction to the mempool, provided nothing the
+ *   scripts depend on changed since PrepareMemPoolAccept (otherwise that is run again, with
+ *   the scripts in place, to get the exact outcome).
+ * A failed step sets fValid to false and the next ones are skipped, except for
+ * FinishMemPoolAccept, which must be called in any case.
+ */
+struct MemPoolAccept
+{
+    CTransactionRef tx;
+    int64_t nAcceptTime;
+    bool fLimitFree{true};
+    bool fOverrideMempoolLimit{false};
+    bool fRejectAbsurdFee{false};
+    bool fIgnoreFees{false};
+
+    //! The outcome, AcceptToMemoryPool style
+    bool fValid{true};
+    CValidationState state;
+    bool fMissingInputs{false};
+
+    //! Set by PreCheckMemPoolAccept
+    bool fPreChecked{false};
+    bool fProofsChecked{false};
+
+    //! Set by PrepareMemPoolAccept
+    const CBlockIndex* pindexPrepared{nullptr};
+    Optional<CTxMemPoolEntry> entry;
+    CTxMemPool::setEntries setAncestors;
+    std::vector<COutPoint> coins_to_uncache;
+    std::unique_ptr<PrecomputedTransactionData> precomTxData;
+    //! The scripts left to check, the first nStandardScriptChecks with the standard flags, then
+    //! the ones with the flags of the next block
+    std::vector<CScriptCheck> vScriptChecks;
+    size_t nStandardScriptChecks{0};
+    unsigned int nBlockScriptFlags{0};
+    bool fScriptsDeferred{false};
+
+    //! Set by VerifyMemPoolAcceptScripts, when all the scripts passed
+    bool fScriptsChecked{false};
+
+    MemPoolAccept(const CTransactionRef& txIn, int64_t nAcceptTimeIn);
+    ~MemPoolAccept();
+};
+
+bool PreCheckMemPoolAccept(MemPoolAccept& accept);
+bool PrepareMemPoolAccept(CTxMemPool& pool, MemPoolAccept& accept, bool fDeferScripts) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+bool VerifyMemPoolAcceptScripts(MemPoolAccept& accept);
+bool FinishMemPoolAccept(CTxMemPool& pool, MemPoolAccept& accept) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
 
 /** Functions for disk access for blocks */
 bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos);
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex);
+/** Read the serialized block at pos, decompressed if it is stored compressed, without deserializing it */
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& vBlock, const CDiskBlockPos& pos);
+/** Read the serialized undo data at pos, checked against its checksum (hashBlock is the hash of the previous block) */
+bool ReadRawUndoFromDisk(std::vector<unsigned char>& vUndo, const CDiskBlockPos& pos, const uint256& hashBlock);
 
 
 /** Functions for validating blocks and updating the block tree */
@@ -343,8 +473,12 @@ bool ContextualCheckBlock(const CBlock& block, CValidationState& state, CBlockIn
 /** Check a block is completely valid from start to finish (only works on top of our current best block, with cs_main held) */
 bool TestBlockValidity(CValidationState& state, const CBlock& block, CBlockIndex* pindexPrev, bool fCheckPOW = true, bool fCheckMerkleRoot = true, bool fCheckBlockSig = true);
 
-/** Store block on disk. If dbp is provided, the file is known to already reside on disk */
-bool AcceptBlock(const CBlock& block, CValidationState& state, CBlockIndex** pindex, CDiskBlockPos* dbp = NULL);
+/**
+ * Store block on disk. If dbp is provided, the file is known to already reside on disk.
+ * If pbatch is provided, it holds the signature of the proof-of-stake block, that passed CheckBlock
+ * without it: it is verified together with the coinstake input signature.
+ */
+bool AcceptBlock(const CBlock& block, CValidationState& state, CBlockIndex** pindex, CDiskBlockPos* dbp = NULL, CSignatureBatch* pbatch = nullptr);
 bool AcceptBlockHeader(const CBlock& block, CValidationState& state, CBlockIndex** ppindex = nullptr, CBlockIndex* pindexPrev = nullptr);
 
 
@@ -375,6 +509,12 @@ extern CChain chainActive;
 /** Global variable that points to the active CCoinsView (protected by cs_main) */
 extern CCoinsViewCache* pcoinsTip;
 
+/** Layer between pcoinsTip and the coins database, writing flushes in the background if enabled */
+extern CCoinsViewAsyncFlush* pcoinsAsyncFlush;
+
+/** Cache of recently read blocks, and of the memory mappings of the block and undo files */
+extern CBlockReadCache blockReadCache;
+
 /** Global variable that points to the active block tree (protected by cs_main) */
 extern CBlockTreeDB* pblocktree;
 
@@ -16,6 +16,7 @@
 #include "masternode-sync.h"
 #include "net.h"
 #include "policy/feerate.h"
+#include "rpc/jsonstream.h"
 #include "rpc/server.h"
 #include "timedata.h"
 #include "util.h"
@@ -3380,6 +3381,19 @@ UniValue encryptwallet(const JSONRPCRequest& request)
     return "wallet encrypted; quirkyturt server stopping, restart to run with encrypted wallet. The keypool has been flushed, you need to make a new backup.";
 }
 
+struct unspentitem {
+    uint256 txid;
+    int vout;
+    bool fGenerated;
+    CTxOut txout;
+    Optional<CTxDestination> address;
+    Optional<std::string> label;
+    Optional<CScript> redeemScript;
+    int nDepth;
+    bool fSpendable;
+    bool fSolvable;
+};
+
 UniValue listunspent(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() > 4)
@@ -3461,56 +3475,80 @@ UniValue listunspent(const JSONRPCRequest& request)
     CCoinControl coinControl;
     coinControl.fAllowWatchOnly = nWatchonlyConfig == 2;
 
-    UniValue results(UniValue::VARR);
-    std::vector<COutput> vecOutputs;
-    LOCK2(cs_main, pwalletMain->cs_wallet);
-    CWallet::AvailableCoinsFilter coinFilter;
-    coinFilter.fOnlyConfirmed = false;
-    pwalletMain->AvailableCoins(&vecOutputs, &coinControl, coinFilter);
-    for (const COutput& out : vecOutputs) {
-        if (out.nDepth < nMinDepth || out.nDepth > nMaxDepth)
-            continue;
-
-        if (!destinations.empty()) {
-            CTxDestination address;
-            if (!ExtractDestination(out.tx->tx->vout[out.i].scriptPubKey, address))
+    // The data of the entries is gathered under the locks, their JSON is built as they are written
+    std::vector<unspentitem> vItems;
+    {
+        std::vector<COutput> vecOutputs;
+        LOCK2(cs_main, pwalletMain->cs_wallet);
+        CWallet::AvailableCoinsFilter coinFilter;
+        coinFilter.fOnlyConfirmed = false;
+        pwalletMain->AvailableCoins(&vecOutputs, &coinControl, coinFilter);
+        for (const COutput& out : vecOutputs) {
+            if (out.nDepth < nMinDepth || out.nDepth > nMaxDepth)
                 continue;
 
-            if (!destinations.count(address))
-                continue;
-        }
+            if (!destinations.empty()) {
+                CTxDestination address;
+                if (!ExtractDestination(out.tx->tx->vout[out.i].scriptPubKey, address))
+                    continue;
 
-        CAmount nValue = out.tx->tx->vout[out.i].nValue;
-        const CScript& pk = out.tx->tx->vout[out.i].scriptPubKey;
-        UniValue entry(UniValue::VOBJ);
-        entry.pushKV("txid", out.tx->GetHash().GetHex());
-        entry.pushKV("vout", out.i);
-        entry.pushKV("generated", out.tx->IsCoinStake() || out.tx->IsCoinBase());
-        CTxDestination address;
-        if (ExtractDestination(out.tx->tx->vout[out.i].scriptPubKey, address)) {
-            entry.pushKV("address", EncodeDestination(address));
-            if (pwalletMain->HasAddressBook(address)) {
-                entry.pushKV("label", pwalletMain->GetNameForAddressBookEntry(address));
+                if (!destinations.count(address))
+                    continue;
             }
-        }
-        entry.pushKV("scriptPubKey", HexStr(pk.begin(), pk.end()));
-        if (pk.IsPayToScriptHash()) {
+
+            unspentitem item;
+            item.txid = out.tx->GetHash();
+            item.vout = out.i;
+            item.fGenerated = out.tx->IsCoinStake() || out.tx->IsCoinBase();
+            item.txout = out.tx->tx->vout[out.i];
+            const CScript& pk = item.txout.scriptPubKey;
             CTxDestination address;
             if (ExtractDestination(pk, address)) {
-                const CScriptID& hash = boost::get<CScriptID>(address);
-                CScript redeemScript;
-                if (pwalletMain->GetCScript(hash, redeemScript))
-                    entry.pushKV("redeemScript", HexStr(redeemScript.begin(), redeemScript.end()));
+                item.address = address;
+                if (pwalletMain->HasAddressBook(address)) {
+                    item.label = pwalletMain->GetNameForAddressBookEntry(address);
+                }
+                if (pk.IsPayToScriptHash()) {
+                    const CScriptID& hash = boost::get<CScriptID>(address);
+                    CScript redeemScript;
+                    if (pwalletMain->GetCScript(hash, redeemScript))
+                        item.redeemScript = redeemScript;
+                }
             }
+            item.nDepth = out.nDepth;
+            item.fSpendable = out.fSpendable;
+            item.fSolvable = out.fSolvable;
+            vItems.push_back(std::move(item));
         }
-        entry.pushKV("amount", ValueFromAmount(nValue));
-        entry.pushKV("confirmations", out.nDepth);
-        entry.pushKV("spendable", out.fSpendable);
-        entry.pushKV("solvable", out.fSolvable);
-        results.push_back(entry);
     }
 
-    return results;
+    // Written without the locks: the result may be streamed to a slow client
+    RPCResultWriter results(request.stream);
+    results.BeginArray();
+    for (const unspentitem& item : vItems) {
+        const CScript& pk = item.txout.scriptPubKey;
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("txid", item.txid.GetHex());
+        entry.pushKV("vout", item.vout);
+        entry.pushKV("generated", item.fGenerated);
+        if (item.address) {
+            entry.pushKV("address", EncodeDestination(*item.address));
+            if (item.label) {
+                entry.pushKV("label", *item.label);
+            }
+        }
+        entry.pushKV("scriptPubKey", HexStr(pk.begin(), pk.end()));
+        if (item.redeemScript) {
+            entry.pushKV("redeemScript", HexStr(item.redeemScript->begin(), item.redeemScript->end()));
+        }
+        entry.pushKV("amount", ValueFromAmount(item.txout.nValue));
+        entry.pushKV("confirmations", item.nDepth);
+        entry.pushKV("spendable", item.fSpendable);
+        entry.pushKV("solvable", item.fSolvable);
+        results.Value(entry);
+    }
+    results.EndArray();
+    return results.GetResult();
 }
 
 UniValue lockunspent(const JSONRPCRequest& request)
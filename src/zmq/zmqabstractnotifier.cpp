@@ -3,15 +3,44 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "zmqabstractnotifier.h"
+#include "chain.h"
+#include "streams.h"
 #include "util.h"
+#include "validation.h"
+#include "version.h"
 
+uint256 CZMQBlock::GetHash() const
+{
+    return pindex->GetBlockHash();
+}
+
+const std::vector<unsigned char>* CZMQBlock::GetSerialized() const
+{
+    if (fSerialized)
+        return pserialized.get();
+    fSerialized = true;
+
+    CBlock blockRead;
+    const CBlock* pblockToWrite = pblock.get();
+    if (!pblockToWrite) {
+        // Not passed along: read it back
+        CDiskBlockPos pos = WITH_LOCK(cs_main, return pindex->GetBlockPos(););
+        if (!ReadBlockFromDisk(blockRead, pos) || blockRead.GetHash() != GetHash())
+            return nullptr;
+        pblockToWrite = &blockRead;
+    }
+    pserialized.reset(new std::vector<unsigned char>());
+    pserialized->reserve(::GetSerializeSize(*pblockToWrite, SER_NETWORK, PROTOCOL_VERSION));
+    CVectorWriter(SER_NETWORK, PROTOCOL_VERSION, *pserialized, 0) << *pblockToWrite;
+    return pserialized.get();
+}
 
 CZMQAbstractNotifier::~CZMQAbstractNotifier()
 {
     assert(!psocket);
 }
 
-bool CZMQAbstractNotifier::NotifyBlock(const CBlockIndex * /*CBlockIndex*/)
+bool CZMQAbstractNotifier::NotifyBlock(const CZMQBlock & /*block*/)
 {
     return true;
 }
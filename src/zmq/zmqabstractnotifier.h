@@ -7,9 +7,35 @@
 
 #include "zmqconfig.h"
 
+#include <memory>
+#include <vector>
+
 class CBlockIndex;
 class CZMQAbstractNotifier;
 
+/**
+ * A block to publish: the block connected is passed along from the validation interface,
+ * and serialized once, on first use, for all the notifiers publishing it raw.
+ */
+class CZMQBlock
+{
+public:
+    CZMQBlock(const CBlockIndex* pindexIn, std::shared_ptr<const CBlock> pblockIn) :
+        pindex(pindexIn),
+        pblock(std::move(pblockIn)) {}
+
+    const CBlockIndex* GetIndex() const { return pindex; }
+    uint256 GetHash() const;
+    /** The serialized block, read from disk if it was not passed along. Null if it cannot be read. */
+    const std::vector<unsigned char>* GetSerialized() const;
+
+private:
+    const CBlockIndex* pindex;
+    std::shared_ptr<const CBlock> pblock;
+    mutable std::unique_ptr<std::vector<unsigned char> > pserialized;
+    mutable bool fSerialized{false};
+};
+
 typedef CZMQAbstractNotifier* (*CZMQNotifierFactory)();
 
 class CZMQAbstractNotifier
@@ -32,8 +58,10 @@ public:
     virtual bool Initialize(void *pcontext) = 0;
     virtual void Shutdown() = 0;
 
-    virtual bool NotifyBlock(const CBlockIndex *pindex);
+    virtual bool NotifyBlock(const CZMQBlock &block);
     virtual bool NotifyTransaction(const CTransaction &transaction);
+    /** Account for notifications dropped before they were published, see CZMQNotificationInterface */
+    virtual void SkipNotifications(uint32_t nBlocks, uint32_t nTransactions) {}
 
 protected:
     void *psocket;
@@ -5,6 +5,7 @@
 #include "zmqnotificationinterface.h"
 #include "zmqpublishnotifier.h"
 
+#include "chain.h"
 #include "version.h"
 #include "streams.h"
 #include "util.h"
@@ -16,6 +17,7 @@ void zmqError(const char *str)
 
 CZMQNotificationInterface::CZMQNotificationInterface() : pcontext(NULL)
 {
+    nMaxQueueSize = std::max<int64_t>(1, gArgs.GetArg("-zmqqueuesize", DEFAULT_ZMQ_QUEUE_SIZE));
 }
 
 CZMQNotificationInterface::~CZMQNotificationInterface()
@@ -102,6 +104,9 @@ bool CZMQNotificationInterface::Initialize()
         return false;
     }
 
+    // The messages are sent from their own thread, so slow consumers do not hold up validation
+    threadPublish = std::thread(&TraceThread<std::function<void()> >, "zmqpub", std::function<void()>(std::bind(&CZMQNotificationInterface::ThreadPublish, this)));
+
     return true;
 }
 
@@ -109,6 +114,13 @@ bool CZMQNotificationInterface::Initialize()
 void CZMQNotificationInterface::Shutdown()
 {
     LogPrint(BCLog::ZMQ, "Shutdown notification interface\n");
+    {
+        LOCK(cs);
+        fStop = true;
+    }
+    condPublish.notify_all();
+    if (threadPublish.joinable()) threadPublish.join();
+
     if (pcontext)
     {
         for (std::list<CZMQAbstractNotifier*>::iterator i=notifiers.begin(); i!=notifiers.end(); ++i)
@@ -123,36 +135,59 @@ void CZMQNotificationInterface::Shutdown()
     }
 }
 
-void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+void CZMQNotificationInterface::Push(std::function<void()> func, size_t nBytes, uint32_t nBlocks, uint32_t nTransactions)
 {
-    if (fInitialDownload || pindexNew == pindexFork) // In IBD or blocks were disconnected without any new ones
-        return;
+    {
+        LOCK(cs);
+        if (fStop)
+            return;
+        if (!queue.empty() && (queue.size() >= nMaxQueueSize || nQueueBytes + nBytes > MAX_ZMQ_QUEUE_BYTES))
+        {
+            // As a ZMQ PUB socket past its high water mark. The sequence numbers of the messages
+            // dropped are skipped, after the last notification queued, so subscribers see the gap.
+            queue.back().nSkippedBlocks += nBlocks;
+            queue.back().nSkippedTransactions += nTransactions;
+            if (nDropped++ % DEFAULT_ZMQ_QUEUE_SIZE == 0)
+                LogPrintf("%s: publisher queue full, %d notifications dropped\n", __func__, nDropped);
+            return;
+        }
+        queue.push_back({std::move(func), nBytes, 0, 0});
+        nQueueBytes += nBytes;
+    }
+    condPublish.notify_one();
+}
 
-    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
+void CZMQNotificationInterface::ThreadPublish()
+{
+    while (true)
     {
-        CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyBlock(pindexNew))
+        Job job;
         {
-            i++;
+            WAIT_LOCK(cs, lock);
+            condPublish.wait(lock, [this]() EXCLUSIVE_LOCKS_REQUIRED(cs) { return fStop || !queue.empty(); });
+            // The notifications queued are still sent on shutdown
+            if (queue.empty())
+                return;
+            // The drops are counted on the job until it leaves the queue
+            job = std::move(queue.front());
+            queue.pop_front();
         }
-        else
+        job.func();
+        WITH_LOCK(cs, nQueueBytes -= job.nBytes);
+        if (job.nSkippedBlocks || job.nSkippedTransactions)
         {
-            notifier->Shutdown();
-            i = notifiers.erase(i);
+            for (CZMQAbstractNotifier* notifier : notifiers)
+                notifier->SkipNotifications(job.nSkippedBlocks, job.nSkippedTransactions);
         }
     }
 }
 
-void CZMQNotificationInterface::TransactionAddedToMempool(const CTransactionRef& ptx)
+void CZMQNotificationInterface::Notify(const std::function<bool(CZMQAbstractNotifier*)>& func)
 {
-    // Used by BlockConnected and BlockDisconnected as well, because they're
-    // all the same external callback.
-    const CTransaction& tx = *ptx;
-
     for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
     {
         CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyTransaction(tx))
+        if (func(notifier))
         {
             i++;
         }
@@ -164,18 +199,48 @@ void CZMQNotificationInterface::TransactionAddedToMempool(const CTransactionRef&
     }
 }
 
+void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+{
+    // The block connected last is the new tip, unless blocks were only disconnected
+    std::shared_ptr<const CBlock> pblock;
+    if (pblockConnected && pblockConnected->GetHash() == pindexNew->GetBlockHash())
+        pblock = std::move(pblockConnected);
+    pblockConnected.reset();
+
+    if (fInitialDownload || pindexNew == pindexFork) // In IBD or blocks were disconnected without any new ones
+        return;
+
+    const size_t nBytes = pblock ? ::GetSerializeSize(*pblock, SER_NETWORK, PROTOCOL_VERSION) : 0;
+    Push([this, pindexNew, pblock]() {
+        CZMQBlock block(pindexNew, pblock);
+        Notify([&block](CZMQAbstractNotifier* notifier) { return notifier->NotifyBlock(block); });
+    }, nBytes, 1, 0);
+}
+
+void CZMQNotificationInterface::TransactionAddedToMempool(const CTransactionRef& ptx)
+{
+    Push([this, ptx]() {
+        Notify([&ptx](CZMQAbstractNotifier* notifier) { return notifier->NotifyTransaction(*ptx); });
+    }, ptx->GetTotalSize(), 0, 1);
+}
+
 void CZMQNotificationInterface::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindexConnected)
 {
-    for (const CTransactionRef& ptx : pblock->vtx) {
-        // Do a normal notify for each transaction added in the block
-        TransactionAddedToMempool(ptx);
-    }
+    pblockConnected = pblock;
+    // Do a normal notify for each transaction added in the block
+    Push([this, pblock]() {
+        for (const CTransactionRef& ptx : pblock->vtx) {
+            Notify([&ptx](CZMQAbstractNotifier* notifier) { return notifier->NotifyTransaction(*ptx); });
+        }
+    }, ::GetSerializeSize(*pblock, SER_NETWORK, PROTOCOL_VERSION), 0, pblock->vtx.size());
 }
 
 void CZMQNotificationInterface::BlockDisconnected(const std::shared_ptr<const CBlock>& pblock, const uint256& blockHash, int nBlockHeight, int64_t blockTime)
 {
-    for (const CTransactionRef& ptx : pblock->vtx) {
-        // Do a normal notify for each transaction removed in block disconnection
-        TransactionAddedToMempool(ptx);
-    }
+    // Do a normal notify for each transaction removed in block disconnection
+    Push([this, pblock]() {
+        for (const CTransactionRef& ptx : pblock->vtx) {
+            Notify([&ptx](CZMQAbstractNotifier* notifier) { return notifier->NotifyTransaction(*ptx); });
+        }
+    }, ::GetSerializeSize(*pblock, SER_NETWORK, PROTOCOL_VERSION), 0, pblock->vtx.size());
 }
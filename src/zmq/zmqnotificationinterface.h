@@ -5,14 +5,24 @@
 #ifndef BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
 #define BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
 
+#include "sync.h"
 #include "validationinterface.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <string>
 #include <map>
 #include <list>
+#include <thread>
 
 class CBlockIndex;
 class CZMQAbstractNotifier;
 
+//! Default for -zmqqueuesize, the maximum number of notifications waiting for the publisher thread
+static const int DEFAULT_ZMQ_QUEUE_SIZE = 1000;
+//! Maximum size of the blocks and transactions held by the notifications waiting for the publisher thread
+static const size_t MAX_ZMQ_QUEUE_BYTES = 64 * 1024 * 1024;
+
 class CZMQNotificationInterface : public CValidationInterface
 {
 public:
@@ -33,8 +43,40 @@ protected:
 private:
     CZMQNotificationInterface();
 
+    /** A notification waiting for the publisher thread */
+    struct Job
+    {
+        std::function<void()> func;
+        //! Size of the blocks and transactions it holds
+        size_t nBytes;
+        //! Notifications dropped after it, to skip the sequence numbers of once it ran
+        uint32_t nSkippedBlocks;
+        uint32_t nSkippedTransactions;
+    };
+
+    /**
+     * Hand a notification of nBlocks blocks and nTransactions transactions to the publisher
+     * thread. It is dropped if the queue is full.
+     */
+    void Push(std::function<void()> func, size_t nBytes, uint32_t nBlocks, uint32_t nTransactions);
+    /** Call func on each notifier, shutting down those it fails for */
+    void Notify(const std::function<bool(CZMQAbstractNotifier*)>& func);
+    void ThreadPublish();
+
     void *pcontext;
+    //! Only used by the publisher thread once it runs
     std::list<CZMQAbstractNotifier*> notifiers;
+    //! The last block connected, passed to the notifiers when it becomes the tip
+    std::shared_ptr<const CBlock> pblockConnected;
+
+    Mutex cs;
+    std::condition_variable condPublish;
+    std::deque<Job> queue GUARDED_BY(cs);
+    size_t nMaxQueueSize;
+    size_t nQueueBytes GUARDED_BY(cs){0};
+    bool fStop GUARDED_BY(cs){false};
+    uint64_t nDropped GUARDED_BY(cs){0};
+    std::thread threadPublish;
 };
 
 #endif // BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
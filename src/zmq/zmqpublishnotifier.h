@@ -24,6 +24,9 @@ public:
     */
     bool SendMessage(const char *command, const void* data, size_t size);
 
+    /* skip sequence numbers, for messages dropped before being sent */
+    void SkipMessages(uint32_t nCount) { nSequence += nCount; }
+
     bool Initialize(void *pcontext);
     void Shutdown();
 };
@@ -31,25 +34,29 @@ public:
 class CZMQPublishHashBlockNotifier : public CZMQAbstractPublishNotifier
 {
 public:
-    bool NotifyBlock(const CBlockIndex *pindex);
+    bool NotifyBlock(const CZMQBlock &block);
+    void SkipNotifications(uint32_t nBlocks, uint32_t nTransactions) { SkipMessages(nBlocks); }
 };
 
 class CZMQPublishHashTransactionNotifier : public CZMQAbstractPublishNotifier
 {
 public:
     bool NotifyTransaction(const CTransaction &transaction);
+    void SkipNotifications(uint32_t nBlocks, uint32_t nTransactions) { SkipMessages(nTransactions); }
 };
 
 class CZMQPublishRawBlockNotifier : public CZMQAbstractPublishNotifier
 {
 public:
-    bool NotifyBlock(const CBlockIndex *pindex);
+    bool NotifyBlock(const CZMQBlock &block);
+    void SkipNotifications(uint32_t nBlocks, uint32_t nTransactions) { SkipMessages(nBlocks); }
 };
 
 class CZMQPublishRawTransactionNotifier : public CZMQAbstractPublishNotifier
 {
 public:
     bool NotifyTransaction(const CTransaction &transaction);
+    void SkipNotifications(uint32_t nBlocks, uint32_t nTransactions) { SkipMessages(nTransactions); }
 };
 
 #endif // BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H
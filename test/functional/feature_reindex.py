@@ -6,6 +6,7 @@
 
 - Start a single node and generate 3 blocks.
 - Stop the node and restart it with -reindex. Verify that the node has reindexed up to block 3.
+- Stop the node and restart it with -reindex -reindexthreads=2. Verify that the node has reindexed up to block 3.
 - Stop the node and restart it with -reindex-chainstate. Verify that the node has reindexed up to block 3.
 """
 
@@ -19,17 +20,18 @@ class ReindexTest(quirkyturtTestFramework):
         self.setup_clean_chain = True
         self.num_nodes = 1
 
-    def reindex(self):
+    def reindex(self, reindex_threads=0):
         self.nodes[0].generate(3)
         blockcount = self.nodes[0].getblockcount()
         self.stop_nodes()
-        extra_args = [["-reindex", "-checkblockindex=1"]]
+        extra_args = [["-reindex", "-checkblockindex=1", "-reindexthreads=%d" % reindex_threads]]
         self.start_nodes(extra_args)
         assert_equal(self.nodes[0].getblockcount(), blockcount)  # start_node is blocking on reindex
         self.log.info("Success")
 
     def run_test(self):
         self.reindex()
+        self.reindex(reindex_threads=2)
 
 if __name__ == '__main__':
     ReindexTest().main()
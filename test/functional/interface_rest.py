@@ -20,6 +20,27 @@ def deser_uint256(f):
         r += t << (i * 32)
     return r
 
+def deser_varint(f):
+    n = 0
+    while True:
+        ch = f.read(1)[0]
+        n = (n << 7) | (ch & 0x7F)
+        if ch & 0x80:
+            n += 1
+        else:
+            return n
+
+#splits the size prefixed records of the /rest/blocks/ and /rest/undo/ replies
+def deser_records(data):
+    f = BytesIO(data)
+    records = []
+    while f.tell() < len(data):
+        size = unpack("<I", f.read(4))[0]
+        record = f.read(size)
+        assert_equal(len(record), size)
+        records.append(record)
+    return records
+
 #allows simple http get calls
 def http_get_call(host, port, path, response_object = 0):
     conn = http.client.HTTPConnection(host, port)
@@ -322,5 +343,80 @@ class RESTTest (quirkyturtTestFramework):
         json_obj = json.loads(json_string)
         assert_equal(json_obj['bestblockhash'], bb_hash)
 
+        #################################
+        # /rest/blocks/ and /rest/undo/ #
+        #################################
+        tip_height = self.nodes[0].getblockcount()
+
+        # each record is a block, as served by /rest/block/
+        response = http_get_call(url.hostname, url.port, '/rest/blocks/1/5'+self.FORMAT_SEPARATOR+'bin', True)
+        assert_equal(response.status, 200)
+        assert_equal(response.getheader('content-type'), 'application/octet-stream')
+        records = deser_records(response.read())
+        assert_equal(len(records), 5)
+        for i, record in enumerate(records):
+            block_hash = self.nodes[0].getblockhash(1 + i)
+            block_bin = http_get_call(url.hostname, url.port, '/rest/block/'+block_hash+self.FORMAT_SEPARATOR+'bin', True).read()
+            assert_equal(record, block_bin)
+
+        # the range stops at the tip
+        response = http_get_call(url.hostname, url.port, '/rest/blocks/'+str(tip_height - 1)+'/10'+self.FORMAT_SEPARATOR+'bin', True)
+        assert_equal(response.status, 200)
+        records = deser_records(response.read())
+        assert_equal(len(records), 2)
+        tip_bin = http_get_call(url.hostname, url.port, '/rest/block/'+bb_hash+self.FORMAT_SEPARATOR+'bin', True).read()
+        assert_equal(records[1], tip_bin)
+
+        # the undo record of the genesis block is empty, the others are not
+        response = http_get_call(url.hostname, url.port, '/rest/undo/0/3'+self.FORMAT_SEPARATOR+'bin', True)
+        assert_equal(response.status, 200)
+        records = deser_records(response.read())
+        assert_equal(len(records), 3)
+        assert_equal(records[0], b'')
+        assert_greater_than(len(records[1]), 0)
+        assert_greater_than(len(records[2]), 0)
+
+        # invalid ranges and formats
+        response = http_get_call(url.hostname, url.port, '/rest/blocks/'+str(tip_height + 1)+'/1'+self.FORMAT_SEPARATOR+'bin', True)
+        assert_equal(response.status, 404)
+        response = http_get_call(url.hostname, url.port, '/rest/blocks/0/0'+self.FORMAT_SEPARATOR+'bin', True)
+        assert_equal(response.status, 400)
+        response = http_get_call(url.hostname, url.port, '/rest/undo/0/10001'+self.FORMAT_SEPARATOR+'bin', True)
+        assert_equal(response.status, 400)
+        response = http_get_call(url.hostname, url.port, '/rest/blocks/0'+self.FORMAT_SEPARATOR+'bin', True)
+        assert_equal(response.status, 400)
+        response = http_get_call(url.hostname, url.port, '/rest/blocks/0/1'+self.FORMAT_SEPARATOR+'json', True)
+        assert_equal(response.status, 404)
+
+        ##################
+        # /rest/utxoset/ #
+        ##################
+
+        # the set is served as of the last flush of the coins database, gettxoutsetinfo flushes it
+        txoutset = self.nodes[0].gettxoutsetinfo()
+        response = http_get_call(url.hostname, url.port, '/rest/utxoset'+self.FORMAT_SEPARATOR+'bin', True)
+        assert_equal(response.status, 200)
+        data = response.read()
+        f = BytesIO(data)
+        assert_equal(hex(deser_uint256(f))[2:].zfill(64), txoutset['bestblock'])
+        assert_equal(unpack("<i", f.read(4))[0], txoutset['height'])
+        # count the outpoint and coin records
+        n_coins = 0
+        while f.tell() < len(data):
+            f.read(36) # outpoint
+            deser_varint(f) # height and flags
+            deser_varint(f) # compressed amount
+            script_size = deser_varint(f)
+            if script_size < 6:
+                f.read(20 if script_size < 2 else 32)
+            else:
+                f.read(script_size - 6)
+            n_coins += 1
+        assert_equal(f.tell(), len(data))
+        assert_equal(n_coins, txoutset['txouts'])
+
+        response = http_get_call(url.hostname, url.port, '/rest/utxoset'+self.FORMAT_SEPARATOR+'json', True)
+        assert_equal(response.status, 404)
+
 if __name__ == '__main__':
     RESTTest ().main ()
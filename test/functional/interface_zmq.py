@@ -11,6 +11,7 @@ import time
 from test_framework.test_framework import quirkyturtTestFramework, SkipTest
 from test_framework.mininode import CTransaction
 from test_framework.util import (assert_equal,
+                                 assert_greater_than,
                                  bytes_to_hex_str,
                                  hash256,
                                 )
@@ -65,6 +66,7 @@ class ZMQTest (quirkyturtTestFramework):
         socket = self.zmq_context.socket(zmq.SUB)
         socket.set(zmq.RCVTIMEO, 60000)
         socket.connect(address)
+        self.socket = socket
 
         # Subscribe to all available topics.
         self.hashblock = ZMQSubscriber(socket, b"hashblock")
@@ -108,9 +110,10 @@ class ZMQTest (quirkyturtTestFramework):
             # The block should only have the coinbase txid.
             assert_equal([bytes_to_hex_str(txid)], self.nodes[1].getblock(hash)["tx"])
 
-            # Should receive the generated raw block.
+            # Should receive the generated raw block, as stored.
             block = self.rawblock.receive()
             assert_equal(genhashes[x], bytes_to_hex_str(hash256(block[:80])))
+            assert_equal(bytes_to_hex_str(block), self.nodes[0].getblock(hash, False))
 
         self.log.info("Wait for tx from second node")
         payment_txid = self.nodes[1].sendtoaddress(self.nodes[0].getnewaddress(), 1.0)
@@ -124,5 +127,35 @@ class ZMQTest (quirkyturtTestFramework):
         hex = self.rawtx.receive()
         assert_equal(payment_txid, bytes_to_hex_str(hash256(hex)))
 
+        self.log.info("Restart the first node with a tiny publisher queue")
+        # Notifications dropped past the queue size skip their sequence numbers
+        self.restart_node(0, self.extra_args[0] + ["-zmqqueuesize=1"])
+        time.sleep(10)
+        num_blocks = 50
+        self.nodes[0].generate(num_blocks)
+        # Once the queue drained, the last block is published whatever was dropped
+        time.sleep(5)
+        last_hash = self.nodes[0].generate(1)[0]
+        last = self.receive_until_block(last_hash)
+        # The sequence numbers start over on restart, all the blocks are counted. So are their
+        # transactions, on top of the mempool ones.
+        assert_equal(last[b"hashblock"], num_blocks)
+        assert_equal(last[b"rawblock"], num_blocks)
+        assert_greater_than(last[b"hashtx"], num_blocks - 1)
+        assert_greater_than(last[b"rawtx"], num_blocks - 1)
+
+    def receive_until_block(self, blockhash):
+        """Receive the messages of all the topics, gaps allowed, until the ones of the block
+        blockhash. Returns the last sequence number of each topic."""
+        last = {}
+        while True:
+            topic, body, seq = self.socket.recv_multipart()
+            seq = struct.unpack('<I', seq)[-1]
+            if topic in last:
+                assert_greater_than(seq, last[topic])
+            last[topic] = seq
+            if topic == b"rawblock" and bytes_to_hex_str(hash256(body[:80])) == blockhash:
+                return last
+
 if __name__ == '__main__':
     ZMQTest().main()